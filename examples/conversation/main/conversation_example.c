@@ -115,7 +115,6 @@ static void app_task(void *pvParameters) {
     xai_err_t err = xai_conversation_complete(client, conv, &response);
     if (err == XAI_OK && response.content) {
         printf("Assistant: %s\n\n", response.content);
-        xai_conversation_add_assistant(conv, response.content);
         xai_response_free(&response);
     } else {
         ESP_LOGE(TAG, "Conversation failed: %s", xai_err_to_string(err));
@@ -129,7 +128,6 @@ static void app_task(void *pvParameters) {
     err = xai_conversation_complete(client, conv, &response);
     if (err == XAI_OK && response.content) {
         printf("Assistant: %s\n\n", response.content);
-        xai_conversation_add_assistant(conv, response.content);
         xai_response_free(&response);
     }
 
@@ -164,7 +162,6 @@ static void app_task(void *pvParameters) {
     err = xai_conversation_complete(client, conv, &response);
     if (err == XAI_OK && response.content) {
         printf("Assistant: %s\n\n", response.content);
-        xai_conversation_add_assistant(conv, response.content);
         xai_response_free(&response);
     }
 
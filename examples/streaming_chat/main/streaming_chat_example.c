@@ -138,6 +138,11 @@ static void app_task(void *pvParameters) {
     options.temperature = 0.8f;
     options.max_tokens = 150;
 
+    // Batch single-token deltas so printf/fflush runs far less often
+    options.stream_coalesce.min_bytes = 64;
+    options.stream_coalesce.max_delay_ms = 30;
+    options.stream_coalesce.flush_on_sentence = true;
+
     // Example 1: Simple streaming chat
     printf("\n=== Example 1: Streaming Chat ===\n");
     printf("User: %s\n", message.content);
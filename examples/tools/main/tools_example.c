@@ -2,7 +2,8 @@
  * @file tools_example.c
  * @brief Example of client-side tool/function calling with xAI Grok
  * 
- * Demonstrates how to define tools, execute them locally, and integrate results
+ * Demonstrates how to define tools and let xai_run_with_tools() execute
+ * them locally, in parallel, until the model answers
  * 
  * @copyright 2025
  */
@@ -55,7 +56,7 @@ static esp_err_t wifi_init(void) {
 }
 
 // Tool: Get ESP32 internal temperature
-static char* tool_get_temperature(const char *args_json) {
+static char* tool_get_temperature(const char *args_json, void *user_data) {
     ESP_LOGI(TAG, "Executing tool: get_temperature");
     
     // Read ESP32 internal temperature sensor
@@ -73,7 +74,7 @@ static char* tool_get_temperature(const char *args_json) {
 }
 
 // Tool: Get system memory info
-static char* tool_get_memory(const char *args_json) {
+static char* tool_get_memory(const char *args_json, void *user_data) {
     ESP_LOGI(TAG, "Executing tool: get_memory");
     
     size_t free_heap = esp_get_free_heap_size();
@@ -90,7 +91,7 @@ static char* tool_get_memory(const char *args_json) {
 }
 
 // Tool: Control LED
-static char* tool_control_led(const char *args_json) {
+static char* tool_control_led(const char *args_json, void *user_data) {
     ESP_LOGI(TAG, "Executing tool: control_led with args: %s", args_json);
     
     cJSON *args = cJSON_Parse(args_json);
@@ -131,157 +132,79 @@ static void app_task(void *pvParameters) {
         return;
     }
 
-    // Define available tools
-    xai_tool_t tools[] = {
+    // Define available tools and the handlers that run them
+    xai_tool_binding_t tools[] = {
         {
-            .name = "get_temperature",
-            .description = "Get the current internal temperature of the ESP32 chip",
-            .parameters_json = "{\"type\":\"object\",\"properties\":{},\"required\":[]}"
+            .tool = {
+                .name = "get_temperature",
+                .description = "Get the current internal temperature of the ESP32 chip",
+                .parameters_json = "{\"type\":\"object\",\"properties\":{},\"required\":[]}"
+            },
+            .handler = tool_get_temperature
         },
         {
-            .name = "get_memory",
-            .description = "Get current free heap memory information",
-            .parameters_json = "{\"type\":\"object\",\"properties\":{},\"required\":[]}"
+            .tool = {
+                .name = "get_memory",
+                .description = "Get current free heap memory information",
+                .parameters_json = "{\"type\":\"object\",\"properties\":{},\"required\":[]}"
+            },
+            .handler = tool_get_memory
         },
         {
-            .name = "control_led",
-            .description = "Control the LED state (on/off)",
-            .parameters_json = "{\"type\":\"object\",\"properties\":{\"state\":{\"type\":\"string\",\"enum\":[\"on\",\"off\"],\"description\":\"LED state\"}},\"required\":[\"state\"]}"
+            .tool = {
+                .name = "control_led",
+                .description = "Control the LED state (on/off)",
+                .parameters_json = "{\"type\":\"object\",\"properties\":{\"state\":{\"type\":\"string\",\"enum\":[\"on\",\"off\"],\"description\":\"LED state\"}},\"required\":[\"state\"]}"
+            },
+            .handler = tool_control_led,
+            .timeout_ms = 1000
         }
     };
+    size_t tool_count = sizeof(tools) / sizeof(tools[0]);
 
     printf("\n=== Client-Side Tool Calling Example ===\n\n");
-    
-    // Initial user message
-    xai_message_t user_msg = {
-        .role = XAI_ROLE_USER,
-        .content = "What's the current temperature of the ESP32? Also check the memory status.",
-        .name = NULL,
-        .tool_call_id = NULL,
-        .images = NULL,
-        .image_count = 0,
-        .tool_calls = NULL,
-        .tool_call_count = 0
+
+    xai_conversation_t conv = xai_conversation_create(NULL);
+    if (!conv) {
+        ESP_LOGE(TAG, "Failed to create conversation");
+        xai_destroy(client);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    const char *question = "What's the current temperature of the ESP32? Also check the memory status.";
+    printf("User: %s\n\n", question);
+    xai_conversation_add_user(conv, question);
+
+    // The SDK runs the requested tools side by side, sends the results
+    // back and repeats until the model answers
+    xai_tool_stats_t tool_stats[3] = {0};
+    xai_tool_run_stats_t stats;
+    xai_tool_run_options_t run = {
+        .stats = &stats,
+        .tool_stats = tool_stats,
     };
-    
-    xai_options_t options = xai_options_default();
-    options.tools = tools;
-    options.tool_count = 3;
-    options.tool_choice = "auto";
-    
     xai_response_t response;
-    memset(&response, 0, sizeof(response));
-    
-    printf("User: %s\n\n", user_msg.content);
-    
-    xai_err_t err = xai_chat_completion(client, &user_msg, 1, &options, &response);
-    
+    xai_err_t err = xai_run_with_tools(client, conv, tools, tool_count, &run, &response);
+
     if (err == XAI_OK) {
-        // Check if model wants to call tools
-        if (response.tool_call_count > 0) {
-            printf("Model requested %zu tool call(s):\n", response.tool_call_count);
-            
-            // Execute all tool calls and collect results
-            char **tool_results = malloc(sizeof(char*) * response.tool_call_count);
-            if (!tool_results) {
-                ESP_LOGE(TAG, "Failed to allocate memory for tool results");
-                xai_response_free(&response);
-                xai_destroy(client);
-                vTaskDelete(NULL);
-                return;
-            }
-            
-            for (size_t i = 0; i < response.tool_call_count; i++) {
-                xai_tool_call_t *call = &response.tool_calls[i];
-                printf("  - %s(%s)\n", call->name, call->arguments);
-                
-                // Execute the tool locally
-                if (strcmp(call->name, "get_temperature") == 0) {
-                    tool_results[i] = tool_get_temperature(call->arguments);
-                } else if (strcmp(call->name, "get_memory") == 0) {
-                    tool_results[i] = tool_get_memory(call->arguments);
-                } else if (strcmp(call->name, "control_led") == 0) {
-                    tool_results[i] = tool_control_led(call->arguments);
-                } else {
-                    tool_results[i] = strdup("{\"error\":\"Unknown tool\"}");
-                }
-                
-                if (tool_results[i]) {
-                    printf("    Result: %s\n", tool_results[i]);
-                }
-            }
-            
-            printf("\n");
-            
-            // Build complete message history: user message + assistant response + all tool results
-            size_t total_messages = 2 + response.tool_call_count;  // user + assistant + tool results
-            xai_message_t *messages = malloc(sizeof(xai_message_t) * total_messages);
-            
-            if (!messages) {
-                ESP_LOGE(TAG, "Failed to allocate memory for messages");
-                for (size_t i = 0; i < response.tool_call_count; i++) {
-                    if (tool_results[i]) free(tool_results[i]);
-                }
-                free(tool_results);
-                xai_response_free(&response);
-                xai_destroy(client);
-                vTaskDelete(NULL);
-                return;
-            }
-            
-            // Message 1: Original user message
-            messages[0] = user_msg;
-            
-            // Message 2: Assistant's response with tool calls
-            messages[1].role = XAI_ROLE_ASSISTANT;
-            messages[1].content = response.content;  // May be NULL
-            messages[1].name = NULL;
-            messages[1].tool_call_id = NULL;
-            messages[1].images = NULL;
-            messages[1].image_count = 0;
-            messages[1].tool_calls = response.tool_calls;
-            messages[1].tool_call_count = response.tool_call_count;
-            
-            // Messages 3+: Tool results
-            for (size_t i = 0; i < response.tool_call_count; i++) {
-                messages[2 + i].role = XAI_ROLE_TOOL;
-                messages[2 + i].content = tool_results[i];
-                messages[2 + i].name = response.tool_calls[i].name;
-                messages[2 + i].tool_call_id = response.tool_calls[i].id;
-                messages[2 + i].images = NULL;
-                messages[2 + i].image_count = 0;
-                messages[2 + i].tool_calls = NULL;
-                messages[2 + i].tool_call_count = 0;
-            }
-            
-            // Send all messages together for final response
-            xai_response_t final_response;
-            memset(&final_response, 0, sizeof(final_response));
-            
-            err = xai_chat_completion(client, messages, total_messages, &options, &final_response);
-            
-            if (err == XAI_OK && final_response.content) {
-                printf("Assistant: %s\n", final_response.content);
-                xai_response_free(&final_response);
-            } else {
-                ESP_LOGE(TAG, "Final completion failed: %s", xai_err_to_string(err));
-            }
-            
-            // Cleanup
-            for (size_t i = 0; i < response.tool_call_count; i++) {
-                if (tool_results[i]) free(tool_results[i]);
-            }
-            free(tool_results);
-            free(messages);
-        } else if (response.content) {
-            printf("Assistant: %s\n", response.content);
-        }
-        
+        printf("Assistant: %s\n\n", response.content ? response.content : "");
         xai_response_free(&response);
     } else {
-        ESP_LOGE(TAG, "Chat failed: %s", xai_err_to_string(err));
+        ESP_LOGE(TAG, "Tool run failed: %s", xai_err_to_string(err));
+    }
+
+    printf("%lu requests, %lu tool calls: %lu ms waiting (%lu ms if run in turn)\n",
+           (unsigned long)stats.requests, (unsigned long)stats.tool_calls,
+           (unsigned long)stats.tools_ms, (unsigned long)stats.tools_serial_ms);
+    for (size_t i = 0; i < tool_count; i++) {
+        if (tool_stats[i].calls) {
+            printf("  %s: %lu calls, max %lu ms\n", tools[i].tool.name,
+                   (unsigned long)tool_stats[i].calls, (unsigned long)tool_stats[i].max_ms);
+        }
     }
 
+    xai_conversation_destroy(conv);
     xai_destroy(client);
     ESP_LOGI(TAG, "Example complete");
     vTaskDelete(NULL);
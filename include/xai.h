@@ -32,6 +32,9 @@ typedef struct xai_client_s* xai_client_t;
 /** Opaque conversation handle */
 typedef struct xai_conversation_s* xai_conversation_t;
 
+/** Opaque stream ring handle */
+typedef struct xai_stream_ring_s* xai_stream_ring_t;
+
 /**
  * @brief Error codes
  */
@@ -48,7 +51,8 @@ typedef enum {
     XAI_ERR_NOT_SUPPORTED,          /**< Feature not supported */
     XAI_ERR_NOT_READY,              /**< Operation requested before ready (e.g. session not configured yet) */
     XAI_ERR_WS_FAILED,              /**< WebSocket operation failed */
-    XAI_ERR_BUSY                    /**< Client busy (e.g. turn already in progress) */
+    XAI_ERR_BUSY,                   /**< Client busy (e.g. turn already in progress) */
+    XAI_ERR_CANCELLED               /**< Request cancelled before completion */
 } xai_err_t;
 
 /**
@@ -80,6 +84,59 @@ typedef enum {
     XAI_SOURCE_RSS                  /**< RSS feeds */
 } xai_search_source_type_t;
 
+/**
+ * @brief What a stream ring does when a delta does not fit
+ */
+typedef enum {
+    XAI_STREAM_RING_BLOCK,          /**< Wait for the reader (stalls TCP receive) */
+    XAI_STREAM_RING_DROP_OLDEST,    /**< Discard the oldest unread bytes */
+    XAI_STREAM_RING_CANCEL          /**< Abort the request */
+} xai_stream_ring_policy_t;
+
+/**
+ * @brief Where a streaming call parses SSE and runs its callback
+ */
+typedef enum {
+    XAI_STREAM_PIPELINE_AUTO = 0,   /**< Pipelined when CONFIG_XAI_STREAM_PIPELINE is set */
+    XAI_STREAM_PIPELINE_OFF,        /**< On the receiving task */
+    XAI_STREAM_PIPELINE_ON          /**< On the pipeline worker (if built in) */
+} xai_stream_pipeline_mode_t;
+
+/**
+ * @brief Structured stream event types
+ */
+typedef enum {
+    XAI_STREAM_EVENT_CONTENT,           /**< Content delta (text) */
+    XAI_STREAM_EVENT_REASONING,         /**< Reasoning delta (text, grok-4 models) */
+    XAI_STREAM_EVENT_TOOL_CALL_START,   /**< New tool call (tool_index, tool_call_id, tool_name) */
+    XAI_STREAM_EVENT_TOOL_CALL_ARGS,    /**< Tool call argument fragment (tool_index, text) */
+    XAI_STREAM_EVENT_USAGE,             /**< Token usage (sent after the finish reason) */
+    XAI_STREAM_EVENT_FINISH,            /**< Finish reason (text: "stop", "length", "tool_calls") */
+    XAI_STREAM_EVENT_CITATIONS,         /**< Citation URLs (citations, citation_count) */
+    XAI_STREAM_EVENT_ERROR,             /**< Stream-level error (error, text may hold a message) */
+    XAI_STREAM_EVENT_DONE               /**< End of stream ("[DONE]" received) */
+} xai_stream_event_type_t;
+
+/**
+ * @brief Scheduling class of a request
+ */
+typedef enum {
+    XAI_PRIORITY_NORMAL = 0,            /**< Default */
+    XAI_PRIORITY_INTERACTIVE,           /**< User-facing: always next on the connection */
+    XAI_PRIORITY_BACKGROUND,            /**< Token counting, model listing, prefetch */
+    XAI_PRIORITY_COUNT
+} xai_priority_t;
+
+/**
+ * @brief Per-request response cache behaviour
+ */
+typedef enum {
+    XAI_CACHE_DEFAULT = 0,              /**< Use the cache if the request is deterministic (temperature 0) */
+    XAI_CACHE_BYPASS,                   /**< Neither read nor write the cache */
+    XAI_CACHE_REFRESH,                  /**< Skip the lookup, store the fresh response */
+    XAI_CACHE_SAMPLED                   /**< Use the cache even at temperature > 0 */
+} xai_cache_mode_t;
+
 /** @} */
 
 /**
@@ -87,6 +144,141 @@ typedef enum {
  * @{
  */
 
+/**
+ * @brief Preferred heap for a class of SDK allocations
+ */
+typedef enum {
+    XAI_PLACE_AUTO = 0,             /**< Class default: hot in internal RAM, bulk in PSRAM */
+    XAI_PLACE_INTERNAL,             /**< Internal RAM, PSRAM once internal RAM is exhausted */
+    XAI_PLACE_PSRAM                 /**< PSRAM, internal RAM without PSRAM or once it is exhausted */
+} xai_placement_pref_t;
+
+/**
+ * @brief Heap placement policy
+ * 
+ * SDK allocations are hot-small (client and response structs, strings,
+ * short-lived request state) or bulk (pool buffers, arena blocks, SSE and
+ * ring buffers, anything of at least bulk_threshold bytes). DMA buffers
+ * always come from DMA-capable internal RAM. Allocations made during
+ * client creation and client calls follow the client's policy, all others
+ * the default one.
+ */
+typedef struct {
+    xai_placement_pref_t hot;       /**< Hot-small allocations (default: internal RAM) */
+    xai_placement_pref_t bulk;      /**< Bulk allocations (default: PSRAM when present) */
+    size_t bulk_threshold;          /**< Bytes from which a generic allocation is bulk (0 = CONFIG_XAI_PLACEMENT_BULK_THRESHOLD) */
+} xai_placement_t;
+
+/**
+ * @brief Request scheduler configuration
+ * 
+ * A client has one connection. Calls waiting for it are served
+ * interactive first, then by class with aging: every aging_ms of waiting
+ * lifts a background call to normal. Aging never lifts a call above an
+ * interactive one.
+ */
+typedef struct {
+    uint16_t max_calls[XAI_PRIORITY_COUNT];  /**< Calls of a class running or queued at once (0 = Kconfig default) */
+    uint32_t aging_ms;              /**< Wait that lifts a call one class (0 = CONFIG_XAI_SCHED_AGING_MS) */
+} xai_scheduler_config_t;
+
+/**
+ * @brief Response cache configuration (opt-in)
+ * 
+ * xai_chat_completion() responses are cached under a hash of the full
+ * request body, so model, messages and options all take part in the key.
+ * Only requests sent with temperature 0 are cached unless allow_sampled
+ * is set or the request asks for XAI_CACHE_SAMPLED.
+ */
+typedef struct {
+    bool enabled;                   /**< Create the cache with the client */
+    size_t ram_bytes;               /**< RAM tier size, LRU (0 = CONFIG_XAI_CACHE_RAM_SIZE) */
+    uint32_t ttl_s;                 /**< Entry lifetime in seconds (0 = CONFIG_XAI_CACHE_TTL_S) */
+    const char *fs_path;            /**< Directory on a mounted LittleFS/FAT volume (NULL = RAM only) */
+    size_t fs_bytes;                /**< File tier size (0 = CONFIG_XAI_CACHE_FS_SIZE) */
+    bool allow_sampled;             /**< Also cache requests with temperature > 0 */
+} xai_cache_config_t;
+
+/**
+ * @brief Most candidate models a router chooses between
+ */
+#define XAI_ROUTER_MAX_MODELS 4
+
+/**
+ * @brief Prompt size classes the router keeps separate first-token
+ *        statistics for: below 1K estimated tokens, below 8K, larger
+ */
+#define XAI_ROUTER_PROMPT_CLASSES 3
+
+/**
+ * @brief What the router optimizes among the candidates that qualify
+ */
+typedef enum {
+    XAI_ROUTE_FASTEST_FIRST_TOKEN = 0,  /**< Lowest expected time to first token */
+    XAI_ROUTE_FASTEST_COMPLETION,       /**< Lowest expected time to first token plus generation */
+    XAI_ROUTE_IN_ORDER                  /**< First candidate in list order that qualifies */
+} xai_route_goal_t;
+
+/**
+ * @brief Why a request went to its model
+ */
+typedef enum {
+    XAI_ROUTE_REASON_BEST = 0,          /**< Best qualifying candidate under the goal */
+    XAI_ROUTE_REASON_EXPLORE,           /**< Measuring an unmeasured or stale candidate */
+    XAI_ROUTE_REASON_FALLBACK,          /**< None met the latency limits: best capable candidate */
+    XAI_ROUTE_REASON_PINNED             /**< The request named a candidate itself (measured only) */
+} xai_route_reason_t;
+
+/**
+ * @brief A routing decision and its measured outcome
+ */
+typedef struct {
+    const char *model;              /**< Model the request went to */
+    xai_route_reason_t reason;
+    uint32_t prompt_tokens;         /**< Prompt size estimate the decision used */
+    uint32_t predicted_ttft_ms;     /**< Expected time to first token (0 = no estimate yet) */
+    uint32_t predicted_total_ms;    /**< Expected time to the last token (0 = no estimate yet) */
+    xai_err_t err;                  /**< Outcome of the request */
+    bool streamed;
+    uint32_t ttft_ms;               /**< Measured time to first token (streams; 0 = not measured) */
+    uint32_t total_ms;              /**< Measured request time, connection wait excluded */
+    uint32_t completion_tokens;     /**< Tokens generated, reasoning included */
+} xai_route_decision_t;
+
+/**
+ * @brief Called once a routed or measured request has finished
+ *
+ * Runs on the calling task with the client locked: it must not call the
+ * client.
+ */
+typedef void (*xai_route_callback_t)(const xai_route_decision_t *decision, void *user_data);
+
+/**
+ * @brief Latency-aware model routing (opt-in)
+ *
+ * Chat calls that do not name a model go to a candidate chosen per
+ * request. A candidate qualifies when the model registry says it has the
+ * capabilities the request uses (images, tools, reasoning_effort, search)
+ * plus required_caps, its context holds the prompt and max_tokens, and its
+ * measured latency meets the limits. The SDK measures time to first token
+ * and tokens per second of every request that goes to a candidate.
+ *
+ * "Fastest model with tools under 800 ms p95" is
+ * { .goal = XAI_ROUTE_FASTEST_FIRST_TOKEN, .required_caps = XAI_MODEL_CAP_TOOLS,
+ *   .max_ttft_p95_ms = 800 }.
+ */
+typedef struct {
+    bool enabled;                   /**< Route requests without options.model */
+    const char *models[XAI_ROUTER_MAX_MODELS];  /**< Candidates (all NULL = grok-3-mini-fast, grok-3-fast, grok-4-fast-non-reasoning) */
+    xai_route_goal_t goal;          /**< What to optimize */
+    uint32_t required_caps;         /**< XAI_MODEL_CAP_* flags every routed request needs */
+    uint32_t max_ttft_p95_ms;       /**< Skip candidates slower than this to first token at p95 (0 = no limit) */
+    uint32_t min_tokens_per_s;      /**< Skip candidates generating slower than this (0 = no limit) */
+    uint32_t explore_every;         /**< Re-measure the stalest candidate every N decisions (0 = CONFIG_XAI_ROUTER_EXPLORE_EVERY) */
+    xai_route_callback_t on_decision;   /**< Decision and outcome of each request (optional) */
+    void *user_data;                /**< Passed to on_decision */
+} xai_router_config_t;
+
 /**
  * @brief Client configuration
  */
@@ -98,8 +290,25 @@ typedef struct {
     uint32_t max_retries;           /**< Max retry attempts (default: 3) */
     size_t max_tokens;              /**< Default max tokens (default: 1024) */
     float temperature;              /**< Default temperature (default: 1.0) */
+    xai_placement_t placement;      /**< Heap placement (default: hot internal, bulk PSRAM) */
+    xai_scheduler_config_t scheduler;  /**< Request scheduling (default: Kconfig) */
+    xai_cache_config_t cache;       /**< Response cache (default: off) */
+    xai_router_config_t router;     /**< Model routing (default: off) */
 } xai_config_t;
 
+/**
+ * @brief Configuration for a client living entirely in caller memory
+ * 
+ * See xai_create_static().
+ */
+typedef struct {
+    xai_config_t config;            /**< Client configuration (strings are copied) */
+    void *memory;                   /**< Caller-owned memory, kept until xai_destroy() */
+    size_t memory_size;             /**< At least xai_static_memory_size() bytes */
+    size_t json_arena_size;         /**< cJSON working memory per call (0 = CONFIG_XAI_JSON_ARENA_SIZE) */
+    size_t response_storage_size;   /**< Parsed response fields (0 = CONFIG_XAI_MAX_RESPONSE_SIZE) */
+} xai_static_config_t;
+
 /**
  * @brief Image for vision models
  */
@@ -213,6 +422,106 @@ typedef struct {
     const char *parameters_json;    /**< JSON schema for parameters */
 } xai_tool_t;
 
+/**
+ * @brief Stream delta coalescing (opt-in)
+ * 
+ * Batches streamed content deltas so the stream callback fires less often
+ * with larger chunks. Buffered text is delivered when any enabled trigger
+ * fires. A UTF-8 code point is never split across deliveries. A
+ * max_delay_ms deadline that expires between deltas is delivered from a
+ * flush task the client starts for it; deliveries never overlap.
+ * 
+ * All fields zero = coalescing disabled (one callback per SSE chunk).
+ */
+typedef struct {
+    size_t min_bytes;               /**< Deliver once this many bytes are buffered (0 = no size trigger) */
+    uint32_t max_delay_ms;          /**< Upper bound on added latency, e.g. 30 (0 = no time trigger) */
+    bool flush_on_sentence;         /**< Deliver at sentence ends (". ", "! ", "? ") and newlines */
+} xai_stream_coalesce_t;
+
+/**
+ * @brief Request hedging (opt-in, xai_chat_completion() only)
+ * 
+ * When no byte of the response has arrived after the hedge delay, a backup
+ * request goes out on a second connection. The first to get a byte back
+ * wins and the call returns once it has answered; the loser closes its
+ * connection at its own first byte, on its own task. A losing primary
+ * takes the client's connection with it and the client opens a new one.
+ * The backup connection is opened per hedge and needs heap, so static
+ * clients never hedge.
+ */
+typedef struct {
+    bool enabled;                   /**< Send a backup request for slow calls */
+    uint32_t delay_ms;              /**< Fixed delay (0 = p95 of the client's recent times to first byte) */
+    const char *model;              /**< Backup model, e.g. "grok-3-mini-fast" (NULL = same model) */
+} xai_hedge_t;
+
+/**
+ * @brief Stream ring configuration
+ */
+typedef struct {
+    size_t capacity;                /**< Ring size in bytes (placed in PSRAM when available) */
+    xai_stream_ring_policy_t policy;    /**< Behaviour when the ring is full */
+    uint32_t block_timeout_ms;      /**< BLOCK: give up and cancel after this long (0 = wait forever) */
+} xai_stream_ring_config_t;
+
+/**
+ * @brief Stream ring statistics (cumulative over the ring's lifetime)
+ */
+typedef struct {
+    size_t capacity;                /**< Usable ring size in bytes */
+    size_t high_water;              /**< Most bytes ever waiting to be read */
+    size_t bytes_written;           /**< Bytes accepted into the ring */
+    size_t bytes_read;              /**< Bytes drained by the reader */
+    size_t bytes_dropped;           /**< Bytes discarded by DROP_OLDEST */
+    uint32_t full_events;           /**< Deltas that did not fit on arrival */
+    uint32_t blocked_ms;            /**< Total time the producer waited for space */
+} xai_stream_ring_stats_t;
+
+/**
+ * @brief Inter-token latency: gaps between consecutive content deltas
+ *        handed to the stream callback
+ */
+typedef struct {
+    uint32_t streams;               /**< Streams measured */
+    uint32_t deltas;                /**< Content deltas delivered */
+    uint32_t gaps;                  /**< Gaps measured (deltas after the first of each stream) */
+    uint64_t gap_us;                /**< Sum of the gaps; gap_us / gaps is the mean */
+    uint32_t max_gap_us;            /**< Longest gap */
+} xai_stream_latency_t;
+
+/**
+ * @brief Streaming statistics (cumulative since client creation)
+ * 
+ * The pipeline fields cover pipelined streams only. parse_busy_us / wall_us
+ * is the worker's utilization; rx_stall_us / wall_us is the share of time
+ * receive was held up because the worker fell behind.
+ */
+typedef struct {
+    xai_stream_latency_t direct;    /**< Streams parsed on the receiving task */
+    xai_stream_latency_t pipelined; /**< Streams parsed on the pipeline worker */
+    uint64_t bytes;                 /**< SSE bytes passed through the pipeline queue */
+    uint64_t wall_us;               /**< Pipelined transfer time, first request byte to last delivery */
+    uint64_t rx_stall_us;           /**< Receive stage blocked on a full queue */
+    uint64_t parse_busy_us;         /**< Worker parsing SSE and running callbacks */
+    size_t queue_size;              /**< Queue capacity in bytes */
+    size_t queue_high_water;        /**< Most bytes ever queued */
+} xai_stream_stats_t;
+
+/**
+ * @brief Buffer pool statistics (cumulative since client creation)
+ */
+typedef struct {
+    size_t buffer_count;            /**< Buffers in the pool (CONFIG_XAI_BUFFER_POOL_SIZE) */
+    size_t buffer_size;             /**< Bytes per buffer (CONFIG_XAI_MAX_RESPONSE_SIZE) */
+    size_t in_use;                  /**< Buffers currently acquired */
+    size_t peak_in_use;             /**< Most buffers acquired at once */
+    uint32_t hits;                  /**< Acquires served immediately */
+    uint32_t waits;                 /**< Acquires that had to wait for a release */
+    uint32_t misses;                /**< Acquires that timed out */
+    uint32_t wait_ms;               /**< Total time spent waiting */
+} xai_buffer_pool_stats_t;
+
 /**
  * @brief Request options
  * 
@@ -247,6 +556,15 @@ typedef struct {
     xai_tool_t *tools;              /**< Array of available tools */
     size_t tool_count;              /**< Number of tools */
     const char *tool_choice;        /**< Tool choice: "auto", "none", or function name */
+    
+    // Streaming
+    xai_stream_coalesce_t stream_coalesce;  /**< Delta coalescing for streaming calls */
+    xai_stream_pipeline_mode_t stream_pipeline;  /**< Parse on the other core (default: Kconfig) */
+
+    // Scheduling
+    xai_priority_t priority;        /**< Scheduling class (default: normal) */
+    xai_hedge_t hedge;              /**< Backup request for slow responses (default: off) */
+    xai_cache_mode_t cache;         /**< Response cache use (default: deterministic requests only) */
 } xai_options_t;
 
 /**
@@ -288,6 +606,16 @@ typedef struct {
     bool supports_search;           /**< Supports search/grounding */
 } xai_model_info_t;
 
+/**
+ * @brief Model capability flags for xai_model_supports()
+ */
+typedef enum {
+    XAI_MODEL_CAP_VISION    = 1 << 0,   /**< Image input */
+    XAI_MODEL_CAP_TOOLS     = 1 << 1,   /**< Function calling */
+    XAI_MODEL_CAP_REASONING = 1 << 2,   /**< reasoning_effort */
+    XAI_MODEL_CAP_SEARCH    = 1 << 3,   /**< Search/grounding */
+} xai_model_cap_t;
+
 /**
  * @brief Image generation request
  * 
@@ -323,6 +651,137 @@ typedef struct {
     size_t image_count;             /**< Number of images */
 } xai_image_response_t;
 
+/**
+ * @brief One request of a batch
+ */
+typedef struct {
+    const xai_message_t *messages;  /**< Conversation messages */
+    size_t message_count;           /**< Number of messages */
+    const xai_options_t *options;   /**< Request options (NULL = the batch's options) */
+} xai_batch_request_t;
+
+/**
+ * @brief Result of one request of a batch
+ */
+typedef struct {
+    xai_err_t err;                  /**< Outcome of this request */
+    xai_response_t response;        /**< Response if err is XAI_OK (free with xai_response_free()) */
+    uint32_t latency_ms;            /**< Time from send to parsed response */
+    uint8_t connection;             /**< Connection that served it (0 = the client's own) */
+} xai_batch_result_t;
+
+/**
+ * @brief Aggregate statistics of a batch
+ */
+typedef struct {
+    uint32_t succeeded;             /**< Requests with XAI_OK */
+    uint32_t failed;                /**< Requests with an error */
+    uint32_t connections;           /**< Connections actually used */
+    uint32_t elapsed_ms;            /**< Wall time of the whole batch */
+    uint32_t total_latency_ms;      /**< Sum of per-request latencies (sequential cost) */
+    uint32_t max_latency_ms;        /**< Slowest request */
+} xai_batch_stats_t;
+
+/**
+ * @brief Batch options
+ */
+typedef struct {
+    uint8_t concurrency;            /**< Connections to use (0 = CONFIG_XAI_BATCH_CONCURRENCY) */
+    const xai_options_t *options;   /**< Options for requests without their own (can be NULL) */
+    xai_batch_stats_t *stats;       /**< Optional output: aggregate statistics */
+} xai_batch_options_t;
+
+/**
+ * @brief Client-side tool handler
+ * 
+ * Runs on a tool worker task, possibly alongside other handlers.
+ * 
+ * @param arguments JSON arguments from the model
+ * @param user_data User data from the binding
+ * @return Result for the model (JSON or text), allocated with malloc() and
+ *         freed by the SDK; NULL reports a failure
+ */
+typedef char *(*xai_tool_handler_t)(const char *arguments, void *user_data);
+
+/**
+ * @brief Tool definition with the handler that runs it
+ */
+typedef struct {
+    xai_tool_t tool;                /**< Definition sent to the model */
+    xai_tool_handler_t handler;     /**< Runs the call */
+    void *user_data;                /**< Passed to handler */
+    uint32_t timeout_ms;            /**< Result deadline from dispatch (0 = CONFIG_XAI_TOOL_TIMEOUT_MS) */
+} xai_tool_binding_t;
+
+/**
+ * @brief Per-tool call statistics
+ */
+typedef struct {
+    uint32_t calls;                 /**< Calls dispatched */
+    uint32_t timeouts;              /**< Calls past their deadline */
+    uint32_t failures;              /**< Calls whose handler returned NULL */
+    uint32_t total_ms;              /**< Sum of call latencies */
+    uint32_t max_ms;                /**< Slowest call */
+} xai_tool_stats_t;
+
+/**
+ * @brief Statistics of one tool loop run
+ */
+typedef struct {
+    uint32_t requests;              /**< Model requests made */
+    uint32_t tool_rounds;           /**< Requests answered with tool calls */
+    uint32_t tool_calls;            /**< Calls dispatched */
+    uint32_t timeouts;              /**< Calls past their deadline */
+    uint32_t failures;              /**< Calls that failed or named no bound tool */
+    uint32_t model_ms;              /**< Time spent in model requests */
+    uint32_t tools_ms;              /**< Wall time waiting for tool results */
+    uint32_t tools_serial_ms;       /**< Sum of call latencies (the cost of running them in turn) */
+} xai_tool_run_stats_t;
+
+/**
+ * @brief Tool loop options
+ */
+typedef struct {
+    const xai_options_t *options;   /**< Request options (NULL for defaults); tools are set by the loop */
+    uint8_t max_rounds;             /**< Tool rounds before the model must answer (0 = CONFIG_XAI_TOOL_MAX_ROUNDS) */
+    uint8_t workers;                /**< Handlers running at once (0 = CONFIG_XAI_TOOL_WORKERS) */
+    xai_tool_run_stats_t *stats;    /**< Optional output: statistics of this run */
+    xai_tool_stats_t *tool_stats;   /**< Optional: one entry per binding, accumulated across runs */
+} xai_tool_run_options_t;
+
+/**
+ * @brief Structured stream event
+ * 
+ * Only the fields listed for the event type are set. Pointers are valid for
+ * the duration of the callback only; copy what you need to keep.
+ */
+typedef struct {
+    xai_stream_event_type_t type;   /**< Event type */
+    const char *text;               /**< Delta text, argument fragment, finish reason or error message */
+    size_t length;                  /**< Length of text */
+    int tool_index;                 /**< Tool call index within the turn */
+    const char *tool_call_id;       /**< Tool call ID (TOOL_CALL_START) */
+    const char *tool_name;          /**< Function name (TOOL_CALL_START) */
+    uint32_t prompt_tokens;         /**< USAGE: prompt tokens */
+    uint32_t completion_tokens;     /**< USAGE: completion tokens */
+    uint32_t total_tokens;          /**< USAGE: total tokens */
+    uint32_t reasoning_tokens;      /**< USAGE: reasoning tokens (0 if not reported) */
+    const char *const *citations;   /**< CITATIONS: URL strings */
+    size_t citation_count;          /**< CITATIONS: number of URLs */
+    xai_err_t error;                /**< ERROR: error code */
+} xai_stream_event_t;
+
+/**
+ * @brief Structured stream event callback function type
+ * 
+ * @param event Event (valid for the duration of the call)
+ * @param user_data User data from streaming call
+ */
+typedef void (*xai_stream_event_callback_t)(
+    const xai_stream_event_t *event,
+    void *user_data
+);
+
 /**
  * @brief Stream callback function type
  * 
@@ -380,6 +839,34 @@ xai_client_t xai_create_config(const xai_config_t *config);
  */
 void xai_destroy(xai_client_t client);
 
+/**
+ * @brief Bytes of memory needed by xai_create_static() for a configuration
+ * 
+ * @param config Static configuration (memory and memory_size are ignored)
+ * @return Required size, or 0 if config is invalid
+ */
+size_t xai_static_memory_size(const xai_static_config_t *config);
+
+/**
+ * @brief Create xAI client without heap allocation
+ * 
+ * The client structure, buffer pool, JSON arena, response storage, SSE
+ * parser and FreeRTOS semaphores are all placed in config->memory, so
+ * chat completions (plain and streaming), the Responses API, token
+ * counting and static conversations run without malloc once the client
+ * exists. A parsed xai_response_t points into the client's response
+ * storage and stays valid until the next call on the same client.
+ * 
+ * Not available on a static client: stream coalescing. Image generation,
+ * xai_count_tokens_messages() and xai_text_completion() still allocate.
+ * esp_http_client and TLS keep their own internal allocations.
+ * Requires CONFIG_XAI_JSON_ARENA.
+ * 
+ * @param config Static configuration
+ * @return Client handle, or NULL on failure (e.g. memory too small)
+ */
+xai_client_t xai_create_static(const xai_static_config_t *config);
+
 /** @} */
 
 /**
@@ -425,6 +912,184 @@ xai_err_t xai_chat_completion_stream(
     void *user_data
 );
 
+/**
+ * @brief Streaming chat completion with structured events
+ * 
+ * Like xai_chat_completion_stream(), but surfaces reasoning deltas,
+ * tool-call deltas, usage, finish reason and citations as typed events, so
+ * tool loops and token accounting can run on the streaming path.
+ * stream_coalesce options are ignored in this mode.
+ * 
+ * @param client Client handle
+ * @param messages Array of messages
+ * @param message_count Number of messages
+ * @param options Request options (NULL for defaults)
+ * @param callback Event callback function
+ * @param user_data User data passed to callback
+ * @return Error code
+ */
+xai_err_t xai_chat_completion_stream_events(
+    xai_client_t client,
+    const xai_message_t *messages,
+    size_t message_count,
+    const xai_options_t *options,
+    xai_stream_event_callback_t callback,
+    void *user_data
+);
+
+/**
+ * @brief Get default stream ring configuration (4 KB, BLOCK, no timeout)
+ * 
+ * @return xai_stream_ring_config_t Default configuration
+ */
+xai_stream_ring_config_t xai_stream_ring_config_default(void);
+
+/**
+ * @brief Create a stream ring
+ * 
+ * A stream ring decouples the network from a slow consumer: the SDK writes
+ * content deltas into the ring from the HTTP task and the application
+ * drains it from its own task with xai_stream_ring_read().
+ * 
+ * @param config Ring configuration (NULL for defaults)
+ * @return Ring handle, or NULL on failure
+ */
+xai_stream_ring_t xai_stream_ring_create(const xai_stream_ring_config_t *config);
+
+/**
+ * @brief Destroy a stream ring
+ * 
+ * Must not be called while a stream is writing into the ring.
+ * 
+ * @param ring Ring handle
+ */
+void xai_stream_ring_destroy(xai_stream_ring_t ring);
+
+/**
+ * @brief Streaming chat completion into a stream ring
+ * 
+ * Blocks the calling task until the response ends, like
+ * xai_chat_completion_stream(). The ring is emptied when the call starts.
+ * stream_coalesce options are ignored: the reader takes text in its own
+ * chunk sizes.
+ * 
+ * @param client Client handle
+ * @param messages Array of messages
+ * @param message_count Number of messages
+ * @param options Request options (NULL for defaults)
+ * @param ring Destination ring
+ * @return Error code (XAI_ERR_CANCELLED if the CANCEL policy fired,
+ *         XAI_ERR_TIMEOUT if BLOCK gave up waiting)
+ */
+xai_err_t xai_chat_completion_stream_ring(
+    xai_client_t client,
+    const xai_message_t *messages,
+    size_t message_count,
+    const xai_options_t *options,
+    xai_stream_ring_t ring
+);
+
+/**
+ * @brief Read streamed text from a ring
+ * 
+ * Chunk boundaries are arbitrary and may split a UTF-8 code point.
+ * 
+ * @param ring Ring handle
+ * @param buffer Destination buffer
+ * @param size Buffer size
+ * @param out_len Bytes read; 0 with XAI_OK means the stream has ended
+ * @param timeout_ms Maximum time to wait for data
+ * @return XAI_OK, or XAI_ERR_TIMEOUT if no data arrived in time
+ */
+xai_err_t xai_stream_ring_read(
+    xai_stream_ring_t ring,
+    char *buffer,
+    size_t size,
+    size_t *out_len,
+    uint32_t timeout_ms
+);
+
+/**
+ * @brief Get stream ring statistics
+ * 
+ * Use high_water to size the ring for a given consumer.
+ * 
+ * @param ring Ring handle
+ * @param stats Output statistics
+ * @return Error code
+ */
+xai_err_t xai_stream_ring_get_stats(xai_stream_ring_t ring, xai_stream_ring_stats_t *stats);
+
+/**
+ * @brief Get streaming statistics
+ * 
+ * Compare direct.gap_us / direct.gaps with the pipelined figure to see
+ * what the receive/parse pipeline (CONFIG_XAI_STREAM_PIPELINE) buys.
+ * 
+ * @param client Client handle
+ * @param stats Output statistics
+ * @return Error code
+ */
+xai_err_t xai_get_stream_stats(xai_client_t client, xai_stream_stats_t *stats);
+
+/**
+ * @brief SSE parser benchmark results
+ */
+typedef struct {
+    uint32_t iterations;            /**< Passes over the recorded stream */
+    size_t stream_bytes;            /**< Size of the recorded stream */
+    size_t chunk_size;              /**< Bytes handed to the parser per call */
+    uint32_t events;                /**< SSE events per pass */
+    uint32_t deltas;                /**< Content deltas delivered per pass */
+    uint32_t framing_us;            /**< Duration with events framed but not parsed */
+    uint32_t parse_us;              /**< Duration with every event parsed as JSON */
+    float framing_mb_s;             /**< Framing throughput (MB/s) */
+    float parse_mb_s;               /**< End-to-end throughput (MB/s) */
+} xai_stream_parser_bench_t;
+
+/**
+ * @brief Measure SSE parser throughput on a recorded stream
+ * 
+ * Feeds an embedded chat.completion.chunk stream through a private parser
+ * in chunk_size pieces, once without and once with JSON parsing of each
+ * event. Does not touch any client or the network.
+ * 
+ * @param iterations Passes over the stream (e.g. 1000)
+ * @param chunk_size Bytes per feed (0 = 1460, one TCP segment)
+ * @param result Output results
+ * @return Error code (XAI_ERR_NOT_SUPPORTED if streaming is disabled)
+ */
+xai_err_t xai_stream_parser_benchmark(uint32_t iterations, size_t chunk_size,
+                                      xai_stream_parser_bench_t *result);
+
+/**
+ * @brief Stream allocation soak results
+ */
+typedef struct {
+    uint32_t streams;               /**< Streams replayed after the warm-up */
+    uint32_t chunks;                /**< Chunks fed across those streams */
+    uint32_t deltas;                /**< Content deltas delivered */
+    uint32_t allocations;           /**< SDK heap allocations during those streams */
+} xai_stream_soak_t;
+
+/**
+ * @brief Check that streaming does no heap allocation in steady state
+ * 
+ * Replays a recorded stream through the client's own SSE parser and pool
+ * buffer in small chunks, with the client locked as for a streaming call
+ * but without the network. One warm-up stream runs first, then the SDK's
+ * allocation count (xai_get_alloc_count()) must stay unchanged. cJSON
+ * allocations are only seen when they come from the JSON arena
+ * (CONFIG_XAI_JSON_ARENA). The count is global, so run the soak while no
+ * other SDK call is in progress.
+ * 
+ * @param client Client handle
+ * @param streams Streams to replay (e.g. 1000)
+ * @param result Output results
+ * @return Error code (XAI_ERR_NO_MEMORY if any stream allocated)
+ */
+xai_err_t xai_stream_soak(xai_client_t client, uint32_t streams, xai_stream_soak_t *result);
+
 /**
  * @brief Simple text completion (single user message)
  * 
@@ -441,6 +1106,67 @@ xai_err_t xai_text_completion(
     size_t *response_len
 );
 
+/**
+ * @brief Run several chat completions concurrently
+ * 
+ * Requests are handed out in order to up to opts->concurrency connections:
+ * the client's own, which keeps its scheduling, and extra ones opened for
+ * the batch. Every extra connection costs a TLS session plus a buffer pool
+ * and runs in its own task; it is closed when the batch returns. Extra
+ * connections have no cache or router of their own: every request is
+ * routed and looked up in the client's cache before any is sent, and the
+ * fresh responses are stored and the router fed in request order when the
+ * batch is done. Clients without heap for extra connections run the batch
+ * on their own connection only.
+ * 
+ * results[i] belongs to requests[i] whatever the completion order. Free
+ * each successful response with xai_response_free().
+ * 
+ * @param client Client handle
+ * @param requests Requests
+ * @param count Number of requests
+ * @param results Output results (count entries)
+ * @param opts Batch options (can be NULL)
+ * @return XAI_OK if every request succeeded, XAI_ERR_NOT_SUPPORTED for a
+ *         static client, otherwise the error of the first failed request
+ */
+xai_err_t xai_chat_completion_batch(
+    xai_client_t client,
+    const xai_batch_request_t *requests,
+    size_t count,
+    xai_batch_result_t *results,
+    const xai_batch_options_t *opts
+);
+
+/**
+ * @brief Batch benchmark results
+ */
+typedef struct {
+    uint32_t requests;              /**< Requests per pass */
+    uint32_t connections;           /**< Connections the batch used */
+    uint32_t sequential_ms;         /**< The requests one by one with xai_chat_completion() */
+    uint32_t batch_ms;              /**< The same requests through xai_chat_completion_batch() */
+    uint32_t failed;                /**< Failed requests over both passes */
+} xai_batch_bench_t;
+
+/**
+ * @brief Compare a loop of chat completions with the same requests as a batch
+ * 
+ * Creates its own client (no cache, no router) and sends `requests` short
+ * prompts twice: one after another, then as one batch over `concurrency`
+ * connections. Point base_url at a local mock server to measure the SDK
+ * rather than the model. Every request is billed when run against the API.
+ * 
+ * @param api_key API key
+ * @param base_url Server to benchmark (NULL = the default xAI endpoint)
+ * @param requests Requests per pass (e.g. 16)
+ * @param concurrency Batch connections (0 = CONFIG_XAI_BATCH_CONCURRENCY)
+ * @param result Output results
+ * @return Error code (the first failed request's, if any failed)
+ */
+xai_err_t xai_batch_benchmark(const char *api_key, const char *base_url, uint32_t requests,
+                              uint8_t concurrency, xai_batch_bench_t *result);
+
 /**
  * @brief Free response memory
  * 
@@ -606,6 +1332,39 @@ xai_err_t xai_chat_completion_with_tools(
     xai_response_t *response
 );
 
+/**
+ * @brief Run a conversation turn with client-side tools until the model
+ *        answers
+ * 
+ * Completes the conversation with the tools offered. When the reply asks
+ * for tool calls, the calls and their results join the history, the calls
+ * are dispatched to up to workers handler tasks at once, and the history
+ * goes back to the model as soon as every result is in or past its
+ * deadline. A call past its deadline, a failed one or one naming no bound
+ * tool is answered with an error object for the model. After max_rounds
+ * tool rounds the model is asked to answer without tools. The final reply
+ * joins the history as xai_conversation_complete() would add it.
+ * 
+ * A handler past its deadline keeps its task until it returns; its result
+ * is discarded.
+ * 
+ * @param client Client handle
+ * @param conv Conversation handle (ends with the user's message)
+ * @param tools Tool bindings
+ * @param tool_count Number of bindings
+ * @param run_options Loop options (NULL for defaults)
+ * @param response Output: the final response
+ * @return Error code (XAI_ERR_API_ERROR if the model kept calling tools)
+ */
+xai_err_t xai_run_with_tools(
+    xai_client_t client,
+    xai_conversation_t conv,
+    const xai_tool_binding_t *tools,
+    size_t tool_count,
+    const xai_tool_run_options_t *run_options,
+    xai_response_t *response
+);
+
 /** @} */
 
 /**
@@ -681,6 +1440,56 @@ xai_tool_t xai_tool_code_execution(void);
 
 /** @} */
 
+/**
+ * @brief What a conversation does with turns that no longer fit
+ */
+typedef enum {
+    XAI_WINDOW_EVICT = 0,               /**< Drop the oldest turns */
+    XAI_WINDOW_SUMMARIZE                /**< Replace them with a summary written by the model */
+} xai_window_policy_t;
+
+/**
+ * @brief Conversation history budget
+ *
+ * Before each completion the oldest turns after the system prompt go
+ * until the history fits both budgets. All fields zero = fit the default
+ * model's context (less the reply) and the request buffer.
+ */
+typedef struct {
+    uint32_t max_tokens;            /**< Prompt tokens (0 = model context minus reply_tokens) */
+    uint32_t reply_tokens;          /**< Kept free for the reply (0 = the client's max_tokens) */
+    size_t max_bytes;               /**< Request body bytes (0 = CONFIG_XAI_MAX_RESPONSE_SIZE) */
+    xai_window_policy_t policy;     /**< Evict (default) or summarize */
+} xai_conversation_window_t;
+
+/**
+ * @brief Conversation stream callback
+ * 
+ * @param delta Text delta (not NUL-terminated)
+ * @param length Delta length
+ * @param user_data User data from xai_conversation_complete_stream()
+ * @return true to continue, false to cancel the stream
+ */
+typedef bool (*xai_conversation_stream_callback_t)(
+    const char *delta,
+    size_t length,
+    void *user_data
+);
+
+/**
+ * @brief Conversation history figures
+ */
+typedef struct {
+    size_t messages;                /**< Messages in the history, system prompt included */
+    uint32_t tokens;                /**< Prompt tokens the history costs (server-corrected estimate) */
+    size_t bytes;                   /**< Request body bytes the history costs */
+    uint32_t evicted_turns;         /**< Turns dropped or summarized to fit */
+    uint32_t summaries;             /**< Summaries written */
+    size_t text_used;               /**< Text arena bytes in use, dropped text not yet reclaimed included */
+    size_t text_size;               /**< Text arena capacity */
+    uint32_t compactions;           /**< Times dropped text was reclaimed */
+} xai_conversation_stats_t;
+
 /**
  * @defgroup xai_conversation Conversation Helpers
  * @{
@@ -689,11 +1498,46 @@ xai_tool_t xai_tool_code_execution(void);
 /**
  * @brief Create conversation context
  * 
+ * Message text is kept in one arena (PSRAM preferred) that doubles when
+ * full, so adding a message allocates only when the arena grows and
+ * xai_conversation_clear() frees nothing.
+ * 
  * @param system_prompt System prompt (can be NULL)
  * @return Conversation handle
  */
 xai_conversation_t xai_conversation_create(const char *system_prompt);
 
+/**
+ * @brief Bytes needed by xai_conversation_create_static()
+ * 
+ * @param max_messages Message capacity, including the system prompt
+ * @param text_size Bytes for message text (NUL terminators included)
+ * @return Required memory size
+ */
+size_t xai_conversation_static_size(size_t max_messages, size_t text_size);
+
+/**
+ * @brief Create conversation context in caller memory
+ * 
+ * Messages and their text are stored in memory; adding a message never
+ * allocates. Once all message slots are used, the oldest turn makes way
+ * for a new message, and likewise when the text does not fit. A message
+ * that does not fit even then is dropped with an error log.
+ * xai_conversation_clear() releases all text except the system prompt.
+ * 
+ * @param system_prompt System prompt (can be NULL)
+ * @param memory Caller-owned memory, kept until xai_conversation_destroy()
+ * @param memory_size Size of memory
+ * @param max_messages Message capacity, including the system prompt
+ * @return Conversation handle, or NULL if memory is too small
+ */
+xai_conversation_t xai_conversation_create_static(
+    const char *system_prompt,
+    void *memory,
+    size_t memory_size,
+    size_t max_messages
+);
+
 /**
  * @brief Add user message to conversation
  * 
@@ -713,6 +1557,9 @@ void xai_conversation_add_assistant(xai_conversation_t conv, const char *message
 /**
  * @brief Complete conversation and get response
  * 
+ * Fits the history to the conversation's window first, then adds the
+ * reply to it.
+ * 
  * @param client Client handle
  * @param conv Conversation handle
  * @param response Output response
@@ -724,6 +1571,52 @@ xai_err_t xai_conversation_complete(
     xai_response_t *response
 );
 
+/**
+ * @brief Complete conversation, streaming the reply into its history
+ * 
+ * Fits the history like xai_conversation_complete(). Each content delta
+ * is appended to the conversation's text storage as it arrives and then
+ * passed to the callback; the reply joins the history when the stream
+ * ends. A stream that fails, is cancelled or outgrows the storage leaves
+ * no trace of the reply. A static conversation does not evict turns while
+ * the reply streams in: a reply that outgrows the free text storage fails
+ * with XAI_ERR_NO_MEMORY and the history stays as it was. The conversation
+ * must not be used by another task until the call returns.
+ * 
+ * @param client Client handle
+ * @param conv Conversation handle
+ * @param callback Delta callback (can be NULL); return false to cancel
+ * @param user_data User data passed to callback
+ * @return Error code (XAI_ERR_CANCELLED if the callback cancelled,
+ *         XAI_ERR_NO_MEMORY if the reply did not fit)
+ */
+xai_err_t xai_conversation_complete_stream(
+    xai_client_t client,
+    xai_conversation_t conv,
+    xai_conversation_stream_callback_t callback,
+    void *user_data
+);
+
+/**
+ * @brief Set the conversation's history budget
+ * 
+ * Summarizing makes an extra request per fit; static conversations
+ * always evict.
+ * 
+ * @param conv Conversation handle
+ * @param window Budget (NULL = defaults)
+ */
+void xai_conversation_set_window(xai_conversation_t conv, const xai_conversation_window_t *window);
+
+/**
+ * @brief Get the conversation's history figures
+ * 
+ * @param conv Conversation handle
+ * @param stats Output figures
+ * @return Error code
+ */
+xai_err_t xai_conversation_get_stats(xai_conversation_t conv, xai_conversation_stats_t *stats);
+
 /**
  * @brief Clear conversation history
  * 
@@ -748,9 +1641,16 @@ void xai_conversation_destroy(xai_conversation_t conv);
 /**
  * @brief List available models
  * 
+ * Parses GET /models into the model registry, which is also kept in NVS
+ * (CONFIG_XAI_MODELS_CACHE_NVS) together with the response's ETag. Within
+ * CONFIG_XAI_MODELS_CACHE_TTL_S of the last fetch the registry is returned
+ * without a request; after that it is revalidated with If-None-Match. If
+ * the server cannot be reached, a stored list is returned.
+ * 
  * @param client Client handle
- * @param model_ids Output array of model IDs (caller must free)
- * @param count Output number of models
+ * @param models Output array, owned by the library; stays valid, but a
+ *               changed list is written over it
+ * @param model_count Output number of models
  * @return Error code
  */
 xai_err_t xai_list_models(
@@ -762,11 +1662,58 @@ xai_err_t xai_list_models(
 /**
  * @brief Get model information
  * 
+ * Looks in the registry (loaded from NVS at first use, updated by
+ * xai_list_models()) and then in the built-in model database, by binary
+ * search over both. An unknown "<id>-latest" or dated "<id>-NNNN" falls
+ * back to <id>.
+ * 
  * @param model_id Model ID
- * @return Model info, or NULL if unknown
+ * @return Model info, or NULL if unknown; never freed or changed, even
+ *         when the registry changes
  */
 const xai_model_info_t* xai_get_model_info(const char *model_id);
 
+/**
+ * @brief Check model capabilities
+ * 
+ * @param model_id Model ID (aliases resolved as by xai_get_model_info())
+ * @param caps Required XAI_MODEL_CAP_* flags, ORed together
+ * @return true if the model is known and has all of them
+ */
+bool xai_model_supports(const char *model_id, uint32_t caps);
+
+/**
+ * @brief Context size of a model
+ * 
+ * @param model_id Model ID
+ * @return Maximum context tokens, or 0 if unknown
+ */
+uint32_t xai_model_context_tokens(const char *model_id);
+
+/**
+ * @brief Check a request against what its model supports
+ * 
+ * Catches what the server would reject, before any bytes are sent:
+ * images for a model without vision, tools, reasoning_effort or search
+ * for a model without them, max_tokens past the context size, and
+ * out-of-range sampling options. Models the registry does not know, or
+ * knows only by name, are not checked. Chat calls run this first when
+ * CONFIG_XAI_VALIDATE_OPTIONS is set.
+ * 
+ * @param model_id Model the request is for (NULL = check options only)
+ * @param messages Messages (may be NULL if message_count is 0)
+ * @param message_count Number of messages
+ * @param options Options (may be NULL)
+ * @return XAI_ERR_NOT_SUPPORTED for a missing capability,
+ *         XAI_ERR_INVALID_ARG for a bad value, XAI_OK otherwise
+ */
+xai_err_t xai_validate_options(
+    const char *model_id,
+    const xai_message_t *messages,
+    size_t message_count,
+    const xai_options_t *options
+);
+
 /** @} */
 
 /**
@@ -837,12 +1784,61 @@ xai_err_t xai_count_tokens_messages(
 );
 
 /**
- * @brief Estimate memory needed for response
- * 
- * @param token_count Expected token count
- * @return Estimated memory in bytes
+ * @brief Local tokenizer statistics (process-wide, since boot)
  */
-size_t xai_estimate_memory(uint32_t token_count);
+typedef struct {
+    bool loaded;                    /**< A vocabulary partition is mapped */
+    uint32_t vocab_size;            /**< Tokens in the mapped vocabulary */
+    uint32_t local_counts;          /**< Counts done on the device */
+    uint32_t remote_counts;         /**< Counts sent to /tokenize-text */
+    uint64_t local_bytes;           /**< Text bytes counted on the device */
+    uint64_t local_us;              /**< Time spent counting on the device */
+    uint32_t verified;              /**< xai_tokenizer_verify() calls */
+    uint32_t mismatches;            /**< Of those, local and server counts differed */
+} xai_tokenizer_stats_t;
+
+/**
+ * @brief Count tokens on the device only
+ *
+ * Requires CONFIG_XAI_ENABLE_LOCAL_TOKENIZER and a vocabulary partition.
+ * xai_count_tokens() and xai_count_tokens_messages() use the same counter
+ * for the models the vocabulary serves and fall back to the network
+ * otherwise.
+ *
+ * @param text Text to tokenize
+ * @param token_count Output token count
+ * @return XAI_ERR_NOT_SUPPORTED if no vocabulary is available
+ */
+xai_err_t xai_count_tokens_local(const char *text, uint32_t *token_count);
+
+/**
+ * @brief Count text both locally and on the server
+ *
+ * Use it on recorded prompts to confirm the vocabulary matches the
+ * server's tokenizer. A difference is logged and counted as a mismatch.
+ *
+ * @param client Client handle
+ * @param text Text to tokenize
+ * @param model Model to use (NULL = default)
+ * @param local_count Output local count
+ * @param remote_count Output server count
+ * @return Error code; XAI_OK even if the counts differ
+ */
+xai_err_t xai_tokenizer_verify(
+    xai_client_t client,
+    const char *text,
+    const char *model,
+    uint32_t *local_count,
+    uint32_t *remote_count
+);
+
+/**
+ * @brief Get local tokenizer statistics
+ *
+ * @param stats Output statistics
+ * @return XAI_ERR_NOT_SUPPORTED if the local tokenizer is disabled
+ */
+xai_err_t xai_get_tokenizer_stats(xai_tokenizer_stats_t *stats);
 
 /** @} */
 
@@ -859,6 +1855,383 @@ size_t xai_estimate_memory(uint32_t token_count);
  */
 const char* xai_err_to_string(xai_err_t err);
 
+/**
+ * @brief Get buffer pool statistics
+ * 
+ * Request/response bodies and SSE event buffers come from a fixed pool of
+ * CONFIG_XAI_BUFFER_POOL_SIZE buffers of CONFIG_XAI_MAX_RESPONSE_SIZE bytes
+ * (plus CONFIG_XAI_BUFFER_POOL_SMALL_COUNT small ones, if configured).
+ * Non-zero waits or misses mean the pool is too small for the workload.
+ * 
+ * @param client Client handle
+ * @param stats Output statistics
+ * @return Error code
+ */
+xai_err_t xai_get_buffer_pool_stats(xai_client_t client, xai_buffer_pool_stats_t *stats);
+
+/**
+ * @brief Request scheduler statistics, per priority class
+ */
+typedef struct {
+    uint32_t queued[XAI_PRIORITY_COUNT];        /**< Calls waiting now */
+    uint32_t max_queued[XAI_PRIORITY_COUNT];    /**< Most calls ever waiting at once */
+    uint32_t granted[XAI_PRIORITY_COUNT];       /**< Calls given the connection */
+    uint32_t aged[XAI_PRIORITY_COUNT];          /**< Granted while lifted by aging */
+    uint32_t rejected[XAI_PRIORITY_COUNT];      /**< Refused with XAI_ERR_BUSY (class limit) */
+    uint32_t timeouts[XAI_PRIORITY_COUNT];      /**< Gave up waiting */
+    uint64_t total_wait_us[XAI_PRIORITY_COUNT]; /**< Queue wait of granted calls */
+    uint32_t max_wait_us[XAI_PRIORITY_COUNT];   /**< Longest queue wait */
+} xai_scheduler_stats_t;
+
+/**
+ * @brief Get request scheduler statistics
+ * 
+ * Chat calls use xai_options_t.priority. Token counting and model listing
+ * are background, the Responses API and image generation normal.
+ * 
+ * @param client Client handle
+ * @param stats Output statistics
+ * @return Error code
+ */
+xai_err_t xai_get_scheduler_stats(xai_client_t client, xai_scheduler_stats_t *stats);
+
+/**
+ * @brief Request hedging statistics
+ */
+typedef struct {
+    uint32_t calls;                 /**< Chat calls with hedging enabled */
+    uint32_t hedged;                /**< Backup requests sent */
+    uint32_t backup_wins;           /**< Backups that answered first */
+    uint32_t detached;              /**< Calls that returned before the losing primary closed */
+    uint32_t ttfb_samples;          /**< Times to first byte in the rolling window */
+    uint32_t ttfb_p95_ms;           /**< p95 of the window: the current hedge delay */
+} xai_hedge_stats_t;
+
+/**
+ * @brief Get request hedging statistics
+ * 
+ * hedged / calls is the extra request rate paid; backup_wins / hedged is
+ * how often that paid off.
+ * 
+ * @param client Client handle
+ * @param stats Output statistics
+ * @return Error code
+ */
+xai_err_t xai_get_hedge_stats(xai_client_t client, xai_hedge_stats_t *stats);
+
+/**
+ * @brief Hedge check results
+ */
+typedef struct {
+    uint32_t hedge_delay_ms;        /**< Wait before the backup was sent */
+    uint32_t elapsed_ms;            /**< Time until the call returned */
+    bool backup_won;                /**< The backup answered first */
+} xai_hedge_check_t;
+
+/**
+ * @brief Check that a hedged call returns with the backup's answer
+ *        instead of waiting for a slow primary
+ * 
+ * Sends one short hedged chat request (client's default model, hedge
+ * delay primary_delay_ms / 4). The primary waits primary_delay_ms before
+ * it is sent, so it cannot get a first byte before then. The check
+ * passes if the backup won and the call returned before that. Pick a
+ * delay well above the server's time to first byte, e.g. 5000 ms. The
+ * call counts in the client's hedge statistics and costs two requests.
+ * 
+ * @param client Client handle
+ * @param primary_delay_ms How long the primary is held back
+ * @param result Output results
+ * @return Error code (XAI_ERR_TIMEOUT if the call waited for the primary,
+ *         XAI_ERR_NOT_SUPPORTED for a static client)
+ */
+xai_err_t xai_hedge_check(xai_client_t client, uint32_t primary_delay_ms,
+                          xai_hedge_check_t *result);
+
+/**
+ * @brief Response cache statistics (cumulative since client creation)
+ */
+typedef struct {
+    uint32_t ram_hits;              /**< Answered from RAM */
+    uint32_t fs_hits;               /**< Answered from the file tier (then kept in RAM) */
+    uint32_t misses;                /**< Cacheable requests sent to the server, refreshes included */
+    uint32_t skipped;               /**< Bypassed, or not cacheable because temperature > 0 */
+    uint32_t stores;                /**< Responses stored */
+    uint32_t evictions;             /**< Entries dropped to make room */
+    uint32_t expired;               /**< Entries found past their TTL */
+    uint32_t ram_entries;           /**< Entries in RAM now */
+    size_t ram_bytes;               /**< RAM tier bytes in use */
+    size_t fs_bytes;                /**< File tier bytes in use */
+    uint64_t hit_us;                /**< Total call time of hits; / (ram_hits + fs_hits) is the mean */
+    uint64_t miss_us;               /**< Total call time of misses; / misses is the mean */
+} xai_cache_stats_t;
+
+/**
+ * @brief Get response cache statistics
+ * 
+ * @param client Client handle
+ * @param stats Output statistics
+ * @return XAI_ERR_NOT_SUPPORTED if the client has no cache
+ */
+xai_err_t xai_get_cache_stats(xai_client_t client, xai_cache_stats_t *stats);
+
+/**
+ * @brief Drop every cached response, in RAM and on the file tier
+ * 
+ * @param client Client handle
+ * @return XAI_ERR_NOT_SUPPORTED if the client has no cache
+ */
+xai_err_t xai_cache_clear(xai_client_t client);
+
+/**
+ * @brief Measurements of one router candidate
+ *
+ * Times to first token are exponentially weighted moving averages per
+ * prompt class; p95 is estimated as mean + 2 x mean deviation.
+ */
+typedef struct {
+    const char *model;              /**< Candidate model ID */
+    uint32_t requests;              /**< Requests it served, pinned ones included */
+    uint32_t routed;                /**< Requests the router chose it for */
+    uint32_t errors;                /**< Requests that failed */
+    uint32_t ttft_samples[XAI_ROUTER_PROMPT_CLASSES];
+    uint32_t ttft_ms[XAI_ROUTER_PROMPT_CLASSES];      /**< Mean time to first token */
+    uint32_t ttft_p95_ms[XAI_ROUTER_PROMPT_CLASSES];  /**< Estimated p95 time to first token */
+    uint32_t tps_samples;
+    uint32_t tokens_per_s;          /**< Mean generation rate (0 = not measured) */
+} xai_router_model_stats_t;
+
+/**
+ * @brief Model router statistics (cumulative since client creation)
+ */
+typedef struct {
+    xai_router_model_stats_t models[XAI_ROUTER_MAX_MODELS];
+    size_t model_count;
+    uint32_t decisions;             /**< Requests the router chose a model for */
+    uint32_t explored;              /**< ...to measure a candidate */
+    uint32_t fallbacks;             /**< ...with no candidate meeting the latency limits */
+    uint32_t unroutable;            /**< Left on the default model: no candidate capable */
+    uint32_t pinned;                /**< Requests naming a candidate, measured */
+    uint32_t answer_tokens;         /**< Typical completion length used for predictions */
+} xai_router_stats_t;
+
+/**
+ * @brief Get model router statistics
+ *
+ * @param client Client handle
+ * @param stats Output statistics
+ * @return XAI_ERR_NOT_SUPPORTED if routing is not enabled
+ */
+xai_err_t xai_get_router_stats(xai_client_t client, xai_router_stats_t *stats);
+
+/**
+ * @brief API endpoints tracked by memory telemetry
+ */
+typedef enum {
+    XAI_ENDPOINT_CHAT,                  /**< xai_chat_completion() and wrappers */
+    XAI_ENDPOINT_CHAT_STREAM,           /**< Streaming chat completions */
+    XAI_ENDPOINT_RESPONSES,             /**< Responses API */
+    XAI_ENDPOINT_TOKENIZE,              /**< Token counting */
+    XAI_ENDPOINT_IMAGES,                /**< Image generation */
+    XAI_ENDPOINT_MODELS,                /**< Model listing */
+    XAI_ENDPOINT_COUNT
+} xai_endpoint_t;
+
+/**
+ * @brief Request phases measured by memory telemetry
+ */
+typedef enum {
+    XAI_MEM_PHASE_BUILD,                /**< Building the request body */
+    XAI_MEM_PHASE_TRANSFER,             /**< Connection, TLS and body transfer (streams parse here) */
+    XAI_MEM_PHASE_PARSE,                /**< Parsing a buffered response */
+    XAI_MEM_PHASE_COUNT
+} xai_mem_phase_t;
+
+/**
+ * @brief Histogram buckets: bucket 0 counts peaks below 1 KB, bucket i
+ *        peaks below 1 KB << i, the last bucket everything larger
+ */
+#define XAI_MEM_HIST_BUCKETS 12
+
+/**
+ * @brief Measured heap usage of one endpoint
+ * 
+ * A peak is how far free heap dropped below its level at the start of the
+ * call. Heap is shared, so allocations by other tasks during the call are
+ * included.
+ */
+typedef struct {
+    uint32_t requests;                  /**< Calls measured */
+    uint32_t rejected;                  /**< Calls refused by admission control */
+    size_t last_peak_internal;          /**< Internal RAM peak of the last call */
+    size_t last_peak_psram;             /**< PSRAM peak of the last call */
+    size_t max_peak_internal;           /**< Largest internal RAM peak */
+    size_t max_peak_psram;              /**< Largest PSRAM peak */
+    size_t phase_peak_internal[XAI_MEM_PHASE_COUNT];  /**< Largest internal RAM peak per phase */
+    size_t phase_peak_psram[XAI_MEM_PHASE_COUNT];     /**< Largest PSRAM peak per phase */
+    uint32_t hist_internal[XAI_MEM_HIST_BUCKETS];     /**< Internal RAM peaks per call */
+    uint32_t hist_psram[XAI_MEM_HIST_BUCKETS];        /**< PSRAM peaks per call */
+    uint64_t phase_us[XAI_MEM_PHASE_COUNT];           /**< Total time spent per phase */
+} xai_mem_stats_t;
+
+/**
+ * @brief Get measured heap usage of an endpoint
+ * 
+ * @param client Client handle
+ * @param endpoint Endpoint
+ * @param stats Output statistics
+ * @return Error code
+ */
+xai_err_t xai_get_memory_stats(xai_client_t client, xai_endpoint_t endpoint, xai_mem_stats_t *stats);
+
+/**
+ * @brief Predict the heap a call to an endpoint will need
+ * 
+ * The prediction is the 95th percentile of the endpoint's measured peaks,
+ * capped at the largest peak seen. With CONFIG_XAI_ADMISSION_CONTROL a call
+ * is rejected with XAI_ERR_NO_MEMORY when its prediction exceeds the
+ * largest free block of the same memory.
+ * 
+ * @param client Client handle
+ * @param endpoint Endpoint
+ * @param internal_bytes Output internal RAM prediction
+ * @param psram_bytes Output PSRAM prediction (can be NULL)
+ * @return Error code (XAI_ERR_NOT_SUPPORTED until the endpoint has been measured)
+ */
+xai_err_t xai_predict_memory(
+    xai_client_t client,
+    xai_endpoint_t endpoint,
+    size_t *internal_bytes,
+    size_t *psram_bytes
+);
+
+/**
+ * @brief Allocation classes of the placement policy
+ */
+typedef enum {
+    XAI_ALLOC_DMA,                      /**< Needs DMA-capable internal RAM */
+    XAI_ALLOC_HOT,                      /**< Small and frequently touched */
+    XAI_ALLOC_BULK,                     /**< Large buffers */
+    XAI_ALLOC_CLASS_COUNT
+} xai_alloc_class_t;
+
+/**
+ * @brief Heap regions
+ */
+typedef enum {
+    XAI_MEM_REGION_INTERNAL,            /**< Internal RAM */
+    XAI_MEM_REGION_PSRAM,               /**< External PSRAM */
+    XAI_MEM_REGION_COUNT
+} xai_mem_region_t;
+
+/**
+ * @brief Where SDK allocations landed, counted since boot or the last reset
+ */
+typedef struct {
+    uint64_t bytes[XAI_ALLOC_CLASS_COUNT][XAI_MEM_REGION_COUNT];   /**< Bytes allocated per class and region */
+    uint32_t allocs[XAI_ALLOC_CLASS_COUNT][XAI_MEM_REGION_COUNT];  /**< Allocations per class and region */
+    uint32_t fallbacks;                 /**< Allocations that missed their preferred region */
+    uint32_t failures;                  /**< Allocations no region could serve */
+} xai_placement_stats_t;
+
+/**
+ * @brief Get placement statistics for all clients
+ * 
+ * Counts are cumulative: freeing does not decrease them. Allocations inside
+ * esp_http_client and TLS are not seen.
+ * 
+ * @param stats Output statistics
+ */
+void xai_get_placement_stats(xai_placement_stats_t *stats);
+
+/**
+ * @brief Reset placement statistics
+ */
+void xai_reset_placement_stats(void);
+
+/**
+ * @brief Allocation hook
+ * 
+ * @param size Requested bytes
+ * @param user_data User data from xai_set_alloc_hook()
+ * @return true to let the allocation proceed, false to fail it
+ */
+typedef bool (*xai_alloc_hook_t)(size_t size, void *user_data);
+
+/**
+ * @brief Install a hook called before every heap allocation the SDK makes
+ * 
+ * Intended for tests: installed after xai_create_static(), a hook that
+ * counts and returns false proves a workload runs without the heap.
+ * Allocations inside esp_http_client and TLS are not seen.
+ * 
+ * @param hook Hook, or NULL to remove it
+ * @param user_data Passed to the hook
+ */
+void xai_set_alloc_hook(xai_alloc_hook_t hook, void *user_data);
+
+/**
+ * @brief Heap allocations made by the SDK since boot
+ * 
+ * @return Allocation count (including ones failed by the hook)
+ */
+uint32_t xai_get_alloc_count(void);
+
+/**
+ * @brief Buffer pool benchmark results
+ */
+typedef struct {
+    uint32_t tasks;                 /**< Contending tasks (spread over all cores) */
+    uint32_t ops;                   /**< Acquire/release pairs completed */
+    uint32_t avg_ns;                /**< Mean time per pair, per task */
+    uint32_t max_us;                /**< Slowest single pair */
+    uint32_t waits;                 /**< Acquires that blocked for a buffer */
+    uint32_t misses;                /**< Acquires that timed out */
+} xai_buffer_pool_bench_t;
+
+/**
+ * @brief Measure buffer pool acquire/release latency under contention
+ * 
+ * Runs two tasks per core against a private two-buffer pool, so acquires
+ * race across cores and regularly block. Does not touch any client.
+ * 
+ * @param iterations Acquire/release pairs per task
+ * @param result Output results
+ * @return Error code
+ */
+xai_err_t xai_buffer_pool_benchmark(uint32_t iterations, xai_buffer_pool_bench_t *result);
+
+/**
+ * @brief JSON arena fragmentation soak results
+ * 
+ * Largest free block sizes are for internal RAM.
+ */
+typedef struct {
+    uint32_t iterations;            /**< Simulated requests per phase */
+    size_t largest_free_start;      /**< Before the soak */
+    size_t largest_free_heap;       /**< After the phase with cJSON on malloc */
+    size_t min_largest_free_heap;   /**< Worst value seen during that phase */
+    size_t largest_free_arena;      /**< After the phase with cJSON on the arena */
+    size_t min_largest_free_arena;  /**< Worst value seen during that phase */
+    size_t arena_high_water;        /**< Most arena bytes used by one request */
+    uint32_t heap_us;               /**< Duration of the malloc phase */
+    uint32_t arena_us;              /**< Duration of the arena phase */
+} xai_json_arena_bench_t;
+
+/**
+ * @brief Compare heap fragmentation with and without the JSON arena
+ * 
+ * Simulates requests that build a tool-calling request and parse a response
+ * with tool calls and citations, keeping the last few responses alive. The
+ * loop runs once with cJSON on malloc and once on an arena, and records the
+ * largest free internal RAM block. Requires CONFIG_XAI_JSON_ARENA.
+ * 
+ * @param iterations Requests per phase (e.g. 10000)
+ * @param result Output results
+ * @return Error code (XAI_ERR_NOT_SUPPORTED if the arena is disabled)
+ */
+xai_err_t xai_json_arena_benchmark(uint32_t iterations, xai_json_arena_bench_t *result);
+
 /** @} */
 
 /**
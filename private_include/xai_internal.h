@@ -17,45 +17,364 @@
 
 #include "xai.h"
 #include "esp_http_client.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "freertos/stream_buffer.h"
 #include "cJSON.h"
+#include <stdatomic.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**
- * @brief HTTP client handle
+ * @brief Buffer for memory management
+ */
+typedef struct {
+    char *data;
+    size_t capacity;
+    size_t used;
+    uint8_t size_class;             /**< Pool size class (pool buffers only) */
+    uint8_t index;                  /**< Bit in the class free mask (pool buffers only) */
+} xai_buffer_t;
+
+/**
+ * @brief Caller-provided memory being carved up by xai_create_static()
+ *
+ * Pieces are taken front to back at XAI_STATIC_ALIGN; nothing is returned
+ * before the whole client is destroyed.
+ */
+typedef struct {
+    uint8_t *base;
+    size_t size;
+    size_t used;
+} xai_static_region_t;
+
+#define XAI_STATIC_ALIGN 8
+#define XAI_STATIC_SIZE(n) (((size_t)(n) + XAI_STATIC_ALIGN - 1) & ~(size_t)(XAI_STATIC_ALIGN - 1))
+
+/**
+ * @brief Pool limits: size classes per pool, buffers per class (free mask width)
+ */
+#define XAI_POOL_MAX_CLASSES        4
+#define XAI_POOL_CLASS_MAX_BUFFERS  32
+
+/**
+ * @brief Size class description for xai_buffer_pool_create_classes()
+ */
+typedef struct {
+    size_t buffer_size;
+    size_t buffer_count;
+} xai_buffer_class_config_t;
+
+/**
+ * @brief Buffers of one size; bit i of free_mask set = buffers[i] is free
  */
 typedef struct {
+    xai_buffer_t *buffers;
+    size_t count;
+    size_t buffer_size;
+    atomic_uint_fast32_t free_mask;
+} xai_buffer_class_t;
+
+/**
+ * @brief Buffer pool
+ * 
+ * Serves request bodies, response bodies and SSE event buffers. A request
+ * holds at most two buffers at once (request + response or SSE), so the
+ * pool size bounds how many requests can be in flight.
+ *
+ * Acquire and release are lock-free (compare-and-swap on the class free
+ * masks). The semaphore is only used to park acquirers that chose to wait.
+ */
+typedef struct {
+    xai_buffer_class_t classes[XAI_POOL_MAX_CLASSES];  /**< Ascending buffer_size */
+    size_t class_count;
+    size_t buffer_count;            /**< Total over all classes */
+    SemaphoreHandle_t available;    /**< Given on release while acquirers wait */
+    StaticSemaphore_t available_buf;
+    bool static_storage;            /**< Carved from caller memory: nothing to free */
+    atomic_uint waiters;
+    atomic_uint in_use;
+    atomic_uint peak_in_use;
+    atomic_uint hits;
+    atomic_uint waits;
+    atomic_uint misses;
+    atomic_uint wait_ms;
+} xai_buffer_pool_t;
+
+/**
+ * @brief Arena block; the first block of an arena is kept, overflow blocks
+ *        are freed when the outermost scope ends
+ */
+typedef struct xai_arena_block_s {
+    struct xai_arena_block_s *next;
+    size_t size;
+    size_t used;
+    char data[];
+} xai_arena_block_t;
+
+/**
+ * @brief Bump allocator serving cJSON for the duration of an API call
+ *
+ * Installed per task by xai_arena_begin(). cJSON frees are no-ops apart
+ * from a live count; once every node is freed the arena rewinds, so each
+ * SSE event reuses the same bytes. Nothing allocated in an arena may
+ * outlive the scope.
+ */
+typedef struct xai_arena_s {
+    xai_arena_block_t *blocks;      /**< Current block first; the kept block is last */
+    size_t block_size;
+    uint32_t live;                  /**< Allocations not yet freed */
+    uint32_t depth;                 /**< Nested begin() count on the owning task */
+    struct xai_arena_s *outer;      /**< Arena active before this one on the task */
+    size_t high_water;              /**< Most bytes in use at once */
+    uint32_t overflow_blocks;       /**< Extra blocks allocated so far */
+    bool fixed;                     /**< Static: no overflow blocks, no heap fallback */
+} xai_arena_t;
+
+/**
+ * @brief Pool acquire timeout used by request paths
+ */
+#define XAI_POOL_ACQUIRE_TIMEOUT_MS 5000
+
+struct xai_http_client_s;
+struct xai_stream_pipeline_s;
+
+/**
+ * @brief Cache validators of a GET response, sent back to revalidate it
+ */
+typedef struct {
+    char etag[80];                  /**< ETag, quotes included ("" = none) */
+    char last_modified[40];         /**< Last-Modified ("" = none) */
+} xai_http_validators_t;
+
+/**
+ * @brief Called on the first response byte of a request
+ */
+typedef void (*xai_http_first_byte_cb_t)(struct xai_http_client_s *http, void *ctx);
+
+/**
+ * @brief HTTP client handle
+ */
+typedef struct xai_http_client_s {
     esp_http_client_handle_t client;
     char *base_url;                 /**< Stored base URL for reconstructing paths */
-    char *response_buffer;
-    size_t response_size;
-    size_t response_capacity;
+    xai_buffer_pool_t *pool;        /**< Owner's pool (response bodies, SSE buffers) */
+    xai_buffer_t *response;         /**< Pool buffer receiving the current response body */
+    bool response_overflow;         /**< Body did not fit in the response buffer */
     xai_stream_callback_t stream_callback;
     void *stream_user_data;
+    volatile bool abort_requested;  /**< Set by xai_http_abort() during a stream */
+    bool abort_closed;              /**< Transfer task has closed the aborted connection */
+    struct xai_stream_parser_s *stream_parser;  /**< Reused across streams, created on first use */
+    bool static_storage;            /**< Carved from caller memory: nothing to free */
+    int64_t request_start_us;       /**< When the current request was started */
+    int64_t first_byte_us;          /**< When its first response byte arrived (0 = not yet) */
+    xai_http_first_byte_cb_t first_byte_cb;  /**< Optional hook for the first byte */
+    void *first_byte_ctx;
+    xai_stream_pipeline_mode_t pipeline_mode;  /**< For the next stream, then back to AUTO */
+    struct xai_stream_pipeline_s *pipeline;  /**< Created on first pipelined stream */
+    xai_stream_stats_t stream_stats;
+    xai_http_validators_t *validators;  /**< Receives the current GET's validators, if set */
 } xai_http_client_t;
 
 /**
- * @brief Buffer for memory management
+ * @brief Stream delta coalescer
+ * 
+ * Owned by the client and reused across streams. Its flush task, started
+ * by the first stream with a time trigger, lives as long as the coalescer.
  */
 typedef struct {
-    char *data;
+    xai_stream_coalesce_t cfg;
+    xai_stream_callback_t callback;
+    void *user_data;
+    char *buf;
     size_t capacity;
     size_t used;
-    bool in_use;
-} xai_buffer_t;
+    int64_t first_us;               /**< Arrival of the first delta since the buffer was empty */
+    TaskHandle_t task;              /**< Enforces cfg.max_delay_ms between deltas */
+    SemaphoreHandle_t done_sem;     /**< Given by the flush task as it exits */
+    bool shutdown;                  /**< Flush task should exit */
+    bool active;                    /**< Between begin() and end() */
+    SemaphoreHandle_t mutex;        /**< Serializes deliveries (stream task vs flush task) */
+    uint32_t deltas_in;
+    uint32_t deliveries;
+} xai_stream_coalescer_t;
 
 /**
- * @brief Buffer pool
+ * @brief Stream ring implementation structure
+ * 
+ * Producer is the HTTP task (through xai_stream_ring_feed), consumer is the
+ * application task. The mutex guards the stream buffer because DROP_OLDEST
+ * makes the producer read from it too; data_sem and space_sem carry the
+ * wakeups so neither side ever blocks while holding the mutex.
  */
-typedef struct {
-    xai_buffer_t *buffers;
-    size_t count;
+struct xai_stream_ring_s {
+    xai_stream_ring_config_t cfg;
+    StreamBufferHandle_t sb;
+    StaticStreamBuffer_t sb_struct;
+    uint8_t *storage;               /**< capacity + 1 bytes, PSRAM preferred */
+    size_t capacity;
     SemaphoreHandle_t mutex;
-} xai_buffer_pool_t;
+    SemaphoreHandle_t data_sem;     /**< Given after every write and at end of stream */
+    SemaphoreHandle_t space_sem;    /**< Given after every read */
+    struct xai_client_s *client;    /**< Its connection is aborted by the CANCEL policy */
+    bool finished;                  /**< End-of-stream marker seen */
+    xai_err_t result;               /**< Why the producer stopped early, XAI_OK otherwise */
+    int64_t blocked_us;             /**< Producer wait time, reported as stats.blocked_ms */
+    xai_stream_ring_stats_t stats;
+};
+
+/**
+ * @brief Receive/parse pipeline for streaming responses
+ * 
+ * The HTTP task copies received SSE bytes into a single-producer,
+ * single-consumer byte queue; a worker pinned to the other core runs the
+ * SSE parser and the user callback straight out of it. head is written by
+ * the producer only and tail by the worker only, so neither side takes a
+ * lock; the semaphores only carry wakeups.
+ */
+typedef struct xai_stream_pipeline_s {
+    char *queue;                    /**< capacity bytes, internal RAM */
+    size_t capacity;                /**< Power of two */
+    atomic_size_t head;             /**< Bytes queued so far (producer) */
+    atomic_size_t tail;             /**< Bytes parsed so far (worker) */
+    atomic_bool eos;                /**< Producer is done with the current stream */
+    SemaphoreHandle_t start_sem;    /**< Given by the producer when a stream begins */
+    SemaphoreHandle_t data_sem;     /**< Given after every write and at end of stream */
+    SemaphoreHandle_t space_sem;    /**< Given after every read */
+    SemaphoreHandle_t done_sem;     /**< Given by the worker once the stream is drained */
+    TaskHandle_t worker;
+    bool shutdown;
+    xai_http_client_t *http;        /**< Skip parsing once it is aborted */
+    struct xai_stream_parser_s *parser;  /**< Current stream's parser */
+    xai_arena_t *arena;             /**< Caller's JSON arena, lent to the worker */
+    const xai_placement_t *placement;   /**< Caller's placement policy, likewise */
+    size_t bytes;                   /**< Current stream: bytes queued */
+    int64_t rx_stall_us;            /**< Current stream: producer waits */
+    int64_t parse_busy_us;          /**< Current stream: worker parse time */
+    size_t high_water;              /**< Most bytes ever queued */
+} xai_stream_pipeline_t;
+
+/**
+ * @brief Heap measurement of the call in progress on a client
+ *
+ * Free sizes are sampled at phase changes, on every HTTP event and after
+ * response parsing; the lowest values give the call's peak usage.
+ */
+typedef struct {
+    xai_endpoint_t endpoint;
+    xai_mem_stats_t *stats;         /**< The endpoint's entry in the client's stats */
+    xai_mem_phase_t phase;
+    size_t base_internal;           /**< Free internal RAM when the call started */
+    size_t base_psram;
+    size_t min_internal;            /**< Lowest free internal RAM during the call */
+    size_t min_psram;
+    size_t phase_min_internal;      /**< Lowest free internal RAM in the current phase */
+    size_t phase_min_psram;
+    int64_t phase_start_us;         /**< When the current phase began */
+} xai_mem_probe_t;
+
+/**
+ * @brief A call waiting for the client's connection (lives on its stack)
+ */
+typedef struct xai_sched_waiter_s {
+    struct xai_sched_waiter_s *next;
+    SemaphoreHandle_t wake;         /**< Given when the call is granted */
+    StaticSemaphore_t wake_buf;
+    xai_priority_t priority;
+    int64_t enqueued_us;
+    bool granted;
+} xai_sched_waiter_t;
+
+/**
+ * @brief Priority scheduler in front of the client's connection
+ */
+typedef struct {
+    SemaphoreHandle_t lock;         /**< Guards everything below; held briefly */
+    StaticSemaphore_t lock_buf;
+    bool busy;                      /**< A call holds the connection */
+    xai_priority_t active;          /**< Class of that call */
+    xai_sched_waiter_t *head;       /**< Waiting calls, oldest first */
+    xai_sched_waiter_t *tail;
+    uint16_t calls[XAI_PRIORITY_COUNT];      /**< Running plus waiting, per class */
+    uint16_t max_calls[XAI_PRIORITY_COUNT];
+    int64_t aging_us;
+    xai_scheduler_stats_t stats;
+} xai_sched_t;
+
+/**
+ * @brief A cached response body in the RAM tier
+ */
+typedef struct xai_cache_entry_s {
+    struct xai_cache_entry_s *prev; /**< Towards the most recently used */
+    struct xai_cache_entry_s *next;
+    uint64_t key;                   /**< Hash of the request body */
+    int64_t expires_us;             /**< esp_timer time after which the entry is stale */
+    size_t len;
+    char data[];                    /**< len bytes of response JSON plus a NUL */
+} xai_cache_entry_t;
+
+/**
+ * @brief Response cache (guarded by the client mutex)
+ */
+typedef struct {
+    xai_cache_entry_t *head;        /**< Most recently used */
+    xai_cache_entry_t *tail;        /**< Next to evict */
+    size_t ram_capacity;
+    int64_t ttl_us;
+    char *fs_path;                  /**< File tier directory, NULL = RAM only */
+    size_t fs_capacity;
+    bool allow_sampled;
+    xai_cache_stats_t stats;
+} xai_cache_t;
+
+/**
+ * @brief Moving average and mean deviation of a router latency, in ms
+ */
+typedef struct {
+    uint32_t samples;
+    int32_t mean_ms;
+    int32_t dev_ms;
+} xai_route_ewma_t;
+
+/**
+ * @brief One router candidate
+ */
+typedef struct {
+    char id[48];
+    xai_route_ewma_t ttft[XAI_ROUTER_PROMPT_CLASSES];
+    int32_t tokens_per_s;
+    uint32_t tps_samples;
+    uint32_t measured_at;           /**< Decision count at its last sample */
+    uint32_t requests;
+    uint32_t routed;
+    uint32_t errors;
+} xai_route_model_t;
+
+/**
+ * @brief Per-client model router
+ *
+ * Has its own lock so a decision never waits for the connection.
+ */
+typedef struct {
+    bool enabled;
+    SemaphoreHandle_t lock;         /**< Guards everything below */
+    StaticSemaphore_t lock_buf;
+    xai_router_config_t cfg;        /**< models[] point into model[].id */
+    xai_route_model_t model[XAI_ROUTER_MAX_MODELS];
+    size_t model_count;
+    int32_t answer_tokens;          /**< Moving average of completion length */
+    xai_router_stats_t stats;       /**< Counters; per-model figures come from model[] */
+} xai_router_t;
+
+/**
+ * @brief Times to first byte kept for the hedge delay
+ */
+#define XAI_TTFB_WINDOW 32
 
 /**
  * @brief Client implementation structure
@@ -71,38 +390,132 @@ struct xai_client_s {
     
     xai_http_client_t *http_client;
     xai_buffer_pool_t *buffer_pool;
+    xai_stream_coalescer_t *coalescer;  /**< Created on first coalesced stream */
+    xai_arena_t *json_arena;        /**< cJSON allocations while the client is locked */
+    xai_arena_t *response_storage;  /**< Static clients: response strings, reset per call */
+    xai_arena_t *outer_response_storage;  /**< Storage active on the task before the lock */
+    xai_placement_t placement;      /**< Heap placement policy */
+    const xai_placement_t *outer_placement;  /**< Policy active on the task before the lock */
     SemaphoreHandle_t mutex;
+    StaticSemaphore_t mutex_buf;
+    bool static_storage;            /**< Created by xai_create_static() */
+    xai_mem_probe_t mem_probe;      /**< Current call (guarded by mutex) */
+    xai_mem_stats_t mem_stats[XAI_ENDPOINT_COUNT];  /**< Guarded by mutex */
+    xai_sched_t sched;              /**< Orders calls waiting for the connection */
+    uint32_t ttfb_ms[XAI_TTFB_WINDOW];  /**< Recent chat times to first byte (guarded by mutex) */
+    uint32_t ttfb_count;
+    uint32_t ttfb_next;
+    xai_hedge_stats_t hedge_stats;  /**< Guarded by mutex */
+    xai_cache_t *cache;             /**< Response cache, NULL unless enabled */
+    xai_router_t router;            /**< Model routing (router.enabled) */
 };
 
+/**
+ * @brief Where a conversation message's text lives and what it costs in a
+ *        request
+ */
+typedef struct {
+    uint32_t offset;                /**< Start of the text in the text arena */
+    uint32_t tokens;                /**< Server-reported, else estimated */
+    uint32_t bytes;                 /**< Serialized size in the request body */
+    uint16_t tool_calls;            /**< Assistant: calls stored after the content */
+} xai_conv_meta_t;
+
 /**
  * @brief Conversation implementation structure
+ *
+ * The history sent is messages[first .. first + message_count), the system
+ * prompt first. Dropping the oldest turns moves the system prompt forward
+ * and advances first; the array is compacted only when it is full.
+ *
+ * All message text lives in one arena: the system prompt at offset 0, the
+ * rest from text_base on in history order. Dropped text stays until the
+ * arena runs short, when the live text is moved down over it and the
+ * offsets and content pointers follow. A reply being streamed grows at the
+ * end of the arena and becomes a message only once the stream succeeded.
+ *
+ * A message's record is its content, then for a tool result the name and
+ * call ID, and for an assistant's tool calls an aligned xai_tool_call_t
+ * array followed by each call's ID, name and arguments. Text only ever
+ * moves by multiples of the alignment, so the arrays stay aligned.
  */
 struct xai_conversation_s {
     xai_message_t *messages;
+    xai_conv_meta_t *meta;          /**< Parallel to messages */
+    size_t first;                   /**< Start of the history in messages[] */
     size_t message_count;
     size_t message_capacity;
-    char *system_prompt;
+    char *system_prompt;            /**< Points to text, or NULL */
+    bool static_storage;            /**< Fixed capacity in caller memory */
+    char *text;                     /**< Message text arena; grows unless static */
+    size_t text_size;
+    size_t text_used;
+    size_t text_base;               /**< text_used right after the system prompt */
+    bool streaming;                 /**< A reply is being streamed in at stream_offset */
+    size_t stream_offset;           /**< Start of the partial reply, text_used its end */
+    uint32_t tokens;                /**< Sum of meta[].tokens over the history */
+    size_t bytes;                   /**< Sum of meta[].bytes over the history */
+    int32_t token_bias;             /**< Server prompt_tokens minus tokens, last completion */
+    xai_conversation_window_t window;
+    uint32_t evicted_turns;
+    uint32_t summaries;
+    uint32_t compactions;
 };
 
 /**
- * @brief SSE stream parser state
+ * @brief SSE stream parser state (position within the current line)
  */
 typedef enum {
-    SSE_STATE_IDLE,
-    SSE_STATE_FIELD,
-    SSE_STATE_VALUE,
-    SSE_STATE_EOL
+    SSE_STATE_LINE_START,           /**< At the beginning of a line */
+    SSE_STATE_FIELD,                /**< Reading the field name (up to ':') */
+    SSE_STATE_VALUE                 /**< Reading the field value (up to end of line) */
 } sse_state_t;
 
+/**
+ * @brief SSE field kind, classified once per line
+ */
+typedef enum {
+    SSE_FIELD_IGNORED,              /**< Comment or unknown field */
+    SSE_FIELD_DATA,                 /**< "data" */
+    SSE_FIELD_EVENT,                /**< "event" */
+    SSE_FIELD_ID,                   /**< "id" */
+    SSE_FIELD_RETRY                 /**< "retry" */
+} sse_field_t;
+
 /**
  * @brief SSE stream parser
  */
-typedef struct {
+typedef struct xai_stream_parser_s {
     sse_state_t state;
-    char field_buffer[32];
-    xai_buffer_t *data_buffer;
+    sse_field_t field;
+    char field_buffer[8];           /**< Field name (only short names are meaningful) */
+    size_t field_len;
+    char value_buffer[64];          /**< Value of event/id/retry fields */
+    size_t value_len;
+    bool skip_space;                /**< Drop a single space following ':' */
+    bool pending_cr;                /**< Previous chunk ended in CR (swallow a leading LF) */
+    bool stream_start;              /**< No bytes seen yet (UTF-8 BOM check) */
+
+    char event_type[32];            /**< Current event type ("" = message) */
+    char last_event_id[64];         /**< Last event ID */
+    uint32_t retry_ms;              /**< Reconnection time advertised by the server */
+
+    size_t data_lines;              /**< Data lines in the pending event */
+    bool data_overflow;             /**< Pending event exceeded the size cap */
+    xai_err_t error;                /**< First error seen on this stream */
+    size_t max_event_size;          /**< Cap on data_buffer growth */
+    xai_buffer_t *data_buffer;      /**< Current event buffer: borrowed storage or own_buffer */
+    xai_buffer_t own_buffer;        /**< Heap fallback; grows geometrically, never shrinks */
     xai_stream_callback_t callback;
+    xai_stream_event_callback_t event_callback;  /**< Set instead of callback in event mode */
     void *user_data;
+    bool static_storage;            /**< Carved from caller memory; events never leave storage */
+    int64_t last_delta_us;          /**< When the previous content delta was delivered */
+    xai_stream_latency_t latency;   /**< This stream's inter-token latency */
+    int64_t first_token_us;         /**< When the first content or reasoning delta arrived */
+    uint32_t completion_tokens;     /**< From the usage event, reasoning included */
+    uint32_t events;                /**< Events dispatched on this stream */
+    bool framing_only;              /**< Benchmark: dispatch events without parsing them */
 } xai_stream_parser_t;
 
 // ============================================================================
@@ -115,7 +528,22 @@ typedef struct {
 xai_http_client_t* xai_http_client_create(
     const char *base_url,
     const char *api_key,
-    uint32_t timeout_ms
+    uint32_t timeout_ms,
+    xai_buffer_pool_t *pool
+);
+
+/**
+ * @brief Create HTTP client with its handle and SSE parser carved from region
+ *
+ * base_url must outlive the client. esp_http_client still allocates its
+ * own connection state internally.
+ */
+xai_http_client_t* xai_http_client_create_static(
+    xai_static_region_t *region,
+    const char *base_url,
+    const char *api_key,
+    uint32_t timeout_ms,
+    xai_buffer_pool_t *pool
 );
 
 /**
@@ -125,13 +553,16 @@ void xai_http_client_destroy(xai_http_client_t *client);
 
 /**
  * @brief Perform POST request
+ * 
+ * On success *response is a NUL-terminated pool buffer; release it with
+ * xai_buffer_pool_release() once parsed.
  */
 xai_err_t xai_http_post(
     xai_http_client_t *client,
     const char *path,
     const char *body,
     size_t body_len,
-    char **response,
+    xai_buffer_t **response,
     size_t *response_len
 );
 
@@ -148,15 +579,68 @@ xai_err_t xai_http_post_stream(
 );
 
 /**
- * @brief Perform GET request
+ * @brief Perform streaming POST request delivering structured events
+ */
+xai_err_t xai_http_post_stream_events(
+    xai_http_client_t *client,
+    const char *path,
+    const char *body,
+    size_t body_len,
+    xai_stream_event_callback_t callback,
+    void *user_data
+);
+
+/**
+ * @brief Run body through the client's SSE parser as a stream would,
+ *        chunk_size bytes at a time, without the network
+ * 
+ * Uses the same pool buffer and reused parser as xai_http_post_stream().
+ * The caller holds the client mutex.
+ */
+xai_err_t xai_http_stream_replay(
+    xai_http_client_t *client,
+    const char *body,
+    size_t body_len,
+    size_t chunk_size,
+    xai_stream_callback_t callback,
+    void *user_data
+);
+
+/**
+ * @brief Ask the in-flight request to stop delivering and close
+ * 
+ * Safe from any task: it only raises a flag. The task running the
+ * transfer closes its own connection at its next receive event, and the
+ * request then returns XAI_ERR_CANCELLED.
+ */
+void xai_http_abort(xai_http_client_t *client);
+
+/**
+ * @brief Perform GET request (response handling as xai_http_post)
  */
 xai_err_t xai_http_get(
     xai_http_client_t *client,
     const char *path,
-    char **response,
+    xai_buffer_t **response,
     size_t *response_len
 );
 
+/**
+ * @brief Perform a conditional GET
+ * 
+ * Sends If-None-Match / If-Modified-Since from validators. On 304 Not
+ * Modified, *not_modified is set and no response buffer is returned.
+ * On 200, validators is updated from the response headers.
+ */
+xai_err_t xai_http_get_conditional(
+    xai_http_client_t *client,
+    const char *path,
+    xai_http_validators_t *validators,
+    xai_buffer_t **response,
+    size_t *response_len,
+    bool *not_modified
+);
+
 
 // ============================================================================
 // JSON Functions (xai_json.c)
@@ -175,6 +659,19 @@ xai_err_t xai_json_build_chat_request(
     const char *default_model
 );
 
+/**
+ * @brief Serialize a cJSON tree into a pool buffer
+ *
+ * Tries the smallest buffer that holds size_hint bytes first and falls back
+ * to a full-size buffer if the JSON does not fit. Returns NULL on failure;
+ * the caller releases the buffer to the pool.
+ */
+xai_buffer_t* xai_json_print_pooled(
+    xai_buffer_pool_t *pool,
+    const cJSON *root,
+    size_t size_hint
+);
+
 /**
  * @brief Parse chat completion response
  */
@@ -184,12 +681,12 @@ xai_err_t xai_json_parse_chat_response(
 );
 
 /**
- * @brief Parse streaming chunk
+ * @brief Parse streaming chunk into structured events
  */
-xai_err_t xai_json_parse_stream_chunk(
+xai_err_t xai_json_parse_stream_events(
     const char *json_str,
-    char **content_delta,
-    bool *is_done
+    xai_stream_event_callback_t callback,
+    void *user_data
 );
 
 // ============================================================================
@@ -204,6 +701,38 @@ xai_stream_parser_t* xai_stream_parser_create(
     void *user_data
 );
 
+/**
+ * @brief Re-arm a parser for a new stream
+ * 
+ * Exactly one of callback / event_callback should be set. Events are
+ * accumulated in storage (e.g. a pool buffer borrowed for the stream);
+ * an event that outgrows it moves to the parser's own heap buffer. With
+ * storage NULL the own buffer is used from the start.
+ */
+xai_err_t xai_stream_parser_reset(
+    xai_stream_parser_t *parser,
+    xai_stream_callback_t callback,
+    xai_stream_event_callback_t event_callback,
+    void *user_data,
+    xai_buffer_t *storage
+);
+
+/**
+ * @brief Create stream parser that delivers structured events
+ */
+xai_stream_parser_t* xai_stream_parser_create_events(
+    xai_stream_event_callback_t callback,
+    void *user_data
+);
+
+/**
+ * @brief Create a parser inside region, armed with xai_stream_parser_reset()
+ *
+ * A static parser never allocates: an event larger than its storage is
+ * reported as XAI_ERR_NO_MEMORY instead of moving to a heap buffer.
+ */
+xai_stream_parser_t* xai_stream_parser_create_static(xai_static_region_t *region);
+
 /**
  * @brief Feed data to stream parser
  */
@@ -213,24 +742,614 @@ void xai_stream_parser_feed(
     void *user_data
 );
 
+/**
+ * @brief Flush an event left pending when the stream ends without a blank line
+ */
+void xai_stream_parser_finish(xai_stream_parser_t *parser);
+
 /**
  * @brief Destroy stream parser
  */
 void xai_stream_parser_destroy(xai_stream_parser_t *parser);
 
 // ============================================================================
-// Buffer Pool Functions (xai.c)
+// Response Cache Functions (xai_cache.c)
+// ============================================================================
+
+/**
+ * @brief Create a response cache; the file tier directory is created if missing
+ */
+xai_cache_t* xai_cache_create(const xai_cache_config_t *config);
+
+/**
+ * @brief Configuration that creates a cache like this one (disabled for
+ *        NULL; fs_path is borrowed)
+ */
+xai_cache_config_t xai_cache_config(const xai_cache_t *cache);
+
+/**
+ * @brief Free the RAM tier (files stay for the next boot)
+ */
+void xai_cache_destroy(xai_cache_t *cache);
+
+/**
+ * @brief Whether a request may use the cache; counts it as skipped if not
+ */
+bool xai_cache_usable(xai_cache_t *cache, const xai_options_t *options);
+
+/**
+ * @brief Cache key of a serialized request
+ */
+uint64_t xai_cache_key(const char *body, size_t len);
+
+/**
+ * @brief Look up a response body
+ * 
+ * A RAM hit returns the entry's own copy, valid until the cache is next
+ * changed. A file hit is read into scratch and promoted to RAM.
+ * 
+ * @return The NUL-terminated body, or NULL on a miss
+ */
+const char* xai_cache_get(xai_cache_t *cache, uint64_t key, xai_buffer_t *scratch);
+
+/**
+ * @brief Store a response body in both tiers
+ */
+void xai_cache_put(xai_cache_t *cache, uint64_t key, const char *body, size_t len);
+
+/**
+ * @brief Add a finished call's duration to the hit or miss latency totals
+ */
+void xai_cache_record_latency(xai_cache_t *cache, bool hit, int64_t us);
+
+// ============================================================================
+// Local Tokenizer Functions (xai_tokenizer.c)
+// ============================================================================
+
+/**
+ * @brief One buffer of text to count; spans are counted as if joined
+ */
+typedef struct {
+    const char *data;
+    size_t len;
+} xai_token_span_t;
+
+/**
+ * @brief Map the vocabulary partition on first use
+ *
+ * @return true if a vocabulary is mapped
+ */
+bool xai_tokenizer_load(void);
+
+/**
+ * @brief Whether the mapped vocabulary is the one model uses
+ */
+bool xai_tokenizer_covers(const char *model);
+
+/**
+ * @brief Count the tokens of spans with the mapped vocabulary
+ */
+uint32_t xai_tokenizer_count(const xai_token_span_t *spans, size_t span_count);
+
+/**
+ * @brief Add a network count and/or a verification to the statistics
+ */
+void xai_tokenizer_record(bool remote, bool verified, bool mismatch);
+
+/**
+ * @brief Snapshot the statistics (zeroed if no vocabulary is mapped)
+ */
+void xai_tokenizer_get_stats(xai_tokenizer_stats_t *stats);
+
+// ============================================================================
+// Stream Pipeline Functions (xai_stream_pipeline.c)
+// ============================================================================
+
+/**
+ * @brief Create a pipeline and start its pinned worker
+ */
+xai_stream_pipeline_t* xai_stream_pipeline_create(void);
+
+/**
+ * @brief Hand the worker a new stream for parser
+ * 
+ * The caller's JSON arena and placement policy are lent to the worker
+ * until xai_stream_pipeline_end().
+ */
+void xai_stream_pipeline_begin(
+    xai_stream_pipeline_t *pipeline,
+    xai_http_client_t *http,
+    xai_stream_parser_t *parser
+);
+
+/**
+ * @brief Queue received bytes (signature matches xai_stream_callback_t)
+ */
+void xai_stream_pipeline_feed(
+    const char *chunk,
+    size_t length,
+    void *user_data
+);
+
+/**
+ * @brief Mark the end of the stream, wait until the worker has drained it
+ *        and add the stream's stage times to stats
+ */
+void xai_stream_pipeline_end(xai_stream_pipeline_t *pipeline, xai_stream_stats_t *stats);
+
+/**
+ * @brief Stop the worker and free the pipeline
+ */
+void xai_stream_pipeline_destroy(xai_stream_pipeline_t *pipeline);
+
+// ============================================================================
+// Stream Coalescing Functions (xai_stream_coalesce.c)
+// ============================================================================
+
+/**
+ * @brief Create stream coalescer
+ */
+xai_stream_coalescer_t* xai_stream_coalescer_create(void);
+
+/**
+ * @brief Check whether options request coalescing
+ */
+bool xai_stream_coalesce_enabled(const xai_stream_coalesce_t *cfg);
+
+/**
+ * @brief Start coalescing a stream into callback
+ */
+xai_err_t xai_stream_coalescer_begin(
+    xai_stream_coalescer_t *coalescer,
+    const xai_stream_coalesce_t *cfg,
+    xai_stream_callback_t callback,
+    void *user_data
+);
+
+/**
+ * @brief Feed a delta (signature matches xai_stream_callback_t)
+ */
+void xai_stream_coalescer_feed(
+    const char *chunk,
+    size_t length,
+    void *user_data
+);
+
+/**
+ * @brief Deliver buffered text and stop the deadline timer
+ */
+void xai_stream_coalescer_end(xai_stream_coalescer_t *coalescer);
+
+/**
+ * @brief Destroy stream coalescer
+ */
+void xai_stream_coalescer_destroy(xai_stream_coalescer_t *coalescer);
+
+// ============================================================================
+// Stream Ring
+// ============================================================================
+
+/**
+ * @brief Write a delta into a ring (signature matches xai_stream_callback_t)
+ */
+void xai_stream_ring_feed(
+    const char *chunk,
+    size_t length,
+    void *user_data
+);
+
+// ============================================================================
+// Memory Helpers (xai.c)
+// ============================================================================
+
+/**
+ * @brief Bulk allocation (buffers), placed by the active policy
+ */
+void *xai_malloc_bulk(size_t size);
+void *xai_realloc_bulk(void *ptr, size_t size);
+
+/**
+ * @brief Allocation of a given class with an explicit preference, for
+ *        modules with their own placement setting
+ */
+void *xai_malloc_placed(xai_alloc_class_t cls, xai_placement_pref_t pref, size_t size);
+
+/**
+ * @brief Make a placement policy active on the calling task
+ *
+ * @return The previously active policy, to pass to xai_placement_end()
+ */
+const xai_placement_t *xai_placement_begin(const xai_placement_t *placement);
+
+/**
+ * @brief Restore the policy returned by xai_placement_begin()
+ */
+void xai_placement_end(const xai_placement_t *outer);
+
+/**
+ * @brief Heap allocation wrappers used throughout the SDK
+ *
+ * Each call is counted and offered to the hook installed with
+ * xai_set_alloc_hook(), which may fail it. Allocations of at least the
+ * policy's bulk_threshold are bulk, smaller ones hot. Release with free().
+ */
+void *xai_malloc(size_t size);
+void *xai_calloc(size_t count, size_t size);
+void *xai_realloc(void *ptr, size_t size);
+char *xai_strdup(const char *str);
+
+/**
+ * @brief Take size bytes (zeroed, aligned) from a static region
+ *
+ * @return Pointer, or NULL once the region is exhausted
+ */
+void *xai_static_take(xai_static_region_t *region, size_t size);
+
+// ============================================================================
+// Client Lock (xai.c)
+// ============================================================================
+
+/**
+ * @brief Wait for the connection by priority, take the client mutex, admit
+ *        the call and open its scopes
+ *
+ * Starts memory measurement for endpoint and opens the JSON arena and
+ * response storage scopes.
+ *
+ * @return XAI_OK, XAI_ERR_BUSY if the class is at its call limit,
+ *         XAI_ERR_TIMEOUT if the client stayed busy, or XAI_ERR_NO_MEMORY
+ *         if admission control rejected the call
+ */
+xai_err_t xai_client_lock(struct xai_client_s *client, xai_endpoint_t endpoint,
+                          xai_priority_t priority);
+
+/**
+ * @brief Close the scopes, record the call's memory use, give the mutex
+ *        and hand the connection to the next call
+ */
+void xai_client_unlock(struct xai_client_s *client);
+
+/**
+ * @brief Configuration that recreates a client (strings are borrowed)
+ */
+xai_config_t xai_client_config(const struct xai_client_s *client);
+
+// ============================================================================
+// Request Hedging (xai_hedge.c)
 // ============================================================================
 
 /**
- * @brief Create buffer pool
+ * @brief Record the last chat request's time to first byte (mutex held)
+ */
+void xai_hedge_record_ttfb(struct xai_client_s *client);
+
+/**
+ * @brief Model and timing of a chat request, for recording after the
+ *        fact (the winner of a hedged call, a request of a batch)
+ */
+typedef struct {
+    const char *model;              /**< Model that answered (or failed) */
+    int64_t start_us;               /**< Its request start */
+    int64_t first_byte_us;          /**< 0 = no byte arrived */
+    int64_t end_us;
+} xai_request_outcome_t;
+
+/**
+ * @brief Send a chat request with a backup after the hedge delay and parse
+ *        whichever answer wins (mutex held)
+ *
+ * Returns once the winner has answered; a loser still waiting for its
+ * first byte finishes on its own task. If that is the primary, the client
+ * gets a new connection.
+ *
+ * @param body Request body built for the primary request
+ * @param outcome Output: timing of the winning request
+ */
+xai_err_t xai_hedge_chat(
+    struct xai_client_s *client,
+    const xai_message_t *messages,
+    size_t message_count,
+    const xai_options_t *options,
+    const char *body,
+    size_t body_len,
+    xai_response_t *response,
+    xai_request_outcome_t *outcome
+);
+
+// ============================================================================
+// Model Registry (xai_models.c)
+// ============================================================================
+
+/**
+ * @brief XAI_MODEL_CAP_* flags a chat request makes use of
+ */
+uint32_t xai_request_caps(
+    const xai_message_t *messages,
+    size_t message_count,
+    const xai_options_t *options
+);
+
+// ============================================================================
+// Model Router (xai_router.c)
+// ============================================================================
+
+/**
+ * @brief Set up a client's router (no heap; cannot fail)
+ */
+void xai_router_init(xai_router_t *router, const xai_router_config_t *config);
+
+/**
+ * @brief Release the router's lock
+ */
+void xai_router_deinit(xai_router_t *router);
+
+/**
+ * @brief Choose the model of a chat request that names none
+ *
+ * Requests naming a candidate are only measured. decision->model stays
+ * NULL when the request is neither routed nor measured.
+ *
+ * @param routed Storage for options carrying the chosen model
+ * @return The options to send the request with: routed or options
+ */
+const xai_options_t* xai_router_route(
+    struct xai_client_s *client,
+    const xai_message_t *messages,
+    size_t message_count,
+    const xai_options_t *options,
+    xai_options_t *routed,
+    xai_route_decision_t *decision
+);
+
+/**
+ * @brief Feed the outcome of the request just made into its candidate's
+ *        statistics and report the decision (mutex held)
+ *
+ * Not called for cache hits, whose timing says nothing about the model.
+ *
+ * @param completion_tokens Usage of a buffered call; streams take it from
+ *        the stream parser
+ */
+void xai_router_record(
+    struct xai_client_s *client,
+    xai_route_decision_t *decision,
+    xai_err_t err,
+    bool streamed,
+    uint32_t completion_tokens
+);
+
+/**
+ * @brief xai_router_record() for a request whose model and timing were
+ *        taken elsewhere: a hedged call's winner, or a request sent on
+ *        another connection of a batch (mutex held)
+ *
+ * A request to a model that is not a candidate is not recorded.
+ */
+void xai_router_record_outcome(
+    struct xai_client_s *client,
+    xai_route_decision_t *decision,
+    xai_err_t err,
+    const xai_request_outcome_t *outcome,
+    uint32_t completion_tokens
+);
+
+// ============================================================================
+// Tool Calls (xai_tools.c)
+// ============================================================================
+
+/**
+ * @brief Outcome of one tool call
+ */
+typedef struct {
+    char *result;                   /**< Handler result (free()), NULL unless err is XAI_OK */
+    xai_err_t err;                  /**< XAI_ERR_TIMEOUT, XAI_ERR_NOT_SUPPORTED (no such tool),
+                                         XAI_ERR_API_ERROR (handler failed), XAI_ERR_NO_MEMORY */
+    int tool;                       /**< Binding that ran the call, -1 if none matched */
+    uint32_t latency_ms;            /**< Handler run time, or the deadline on timeout */
+} xai_tool_outcome_t;
+
+/**
+ * @brief Run tool calls on up to workers tasks and wait for every result
+ *        or deadline
+ *
+ * Calls start in order. A call past its deadline is given up on; its task
+ * finishes it and discards the result.
+ */
+void xai_tools_run(
+    const xai_tool_call_t *calls,
+    size_t count,
+    const xai_tool_binding_t *tools,
+    size_t tool_count,
+    size_t workers,
+    xai_tool_outcome_t *outcomes
+);
+
+// ============================================================================
+// Request Scheduler (xai_sched.c)
+// ============================================================================
+
+/**
+ * @brief Initialise a scheduler (no heap; cannot fail)
+ */
+void xai_sched_init(xai_sched_t *sched, const xai_scheduler_config_t *config);
+
+/**
+ * @brief Release the scheduler's lock (no calls may be waiting)
+ */
+void xai_sched_deinit(xai_sched_t *sched);
+
+/**
+ * @brief Wait until the connection is granted to a call of this class
+ *
+ * @return XAI_OK, XAI_ERR_BUSY if the class is at its limit, or
+ *         XAI_ERR_TIMEOUT after timeout_ms
+ */
+xai_err_t xai_sched_acquire(xai_sched_t *sched, xai_priority_t priority, uint32_t timeout_ms);
+
+/**
+ * @brief Give the connection to the next waiting call, if any
+ */
+void xai_sched_release(xai_sched_t *sched);
+
+// ============================================================================
+// Memory Telemetry (xai_memory.c)
+// ============================================================================
+
+/**
+ * @brief Start measuring a call; the client mutex is held
+ *
+ * @return XAI_OK, or XAI_ERR_NO_MEMORY if the predicted peak does not fit
+ */
+xai_err_t xai_mem_begin(struct xai_client_s *client, xai_endpoint_t endpoint);
+
+/**
+ * @brief Enter the next phase of the call measured on this task
+ */
+void xai_mem_phase(xai_mem_phase_t phase);
+
+/**
+ * @brief Sample free heap for the call measured on this task (if any)
+ */
+void xai_mem_sample(void);
+
+/**
+ * @brief Finish measuring and record the call in the endpoint's stats
+ */
+void xai_mem_end(struct xai_client_s *client);
+
+// ============================================================================
+// JSON Arena (xai_arena.c)
+// ============================================================================
+
+/**
+ * @brief Create an arena whose kept block holds block_size bytes
+ */
+xai_arena_t* xai_arena_create(size_t block_size);
+
+/**
+ * @brief Destroy an arena (must not be active)
+ */
+void xai_arena_destroy(xai_arena_t *arena);
+
+/**
+ * @brief Route the calling task's cJSON allocations to arena (nestable)
+ */
+void xai_arena_begin(xai_arena_t *arena);
+
+/**
+ * @brief End a scope opened by xai_arena_begin(); the outermost end rewinds
+ *        the arena and frees overflow blocks
+ */
+void xai_arena_end(xai_arena_t *arena);
+
+/**
+ * @brief Detach the calling task's arena while running user code
+ *
+ * @return The arena to hand back to xai_arena_resume()
+ */
+xai_arena_t* xai_arena_suspend(void);
+
+/**
+ * @brief Re-attach an arena returned by xai_arena_suspend()
+ */
+void xai_arena_resume(xai_arena_t *arena);
+
+/**
+ * @brief Create a fixed arena (no overflow, no heap fallback) inside region
+ *
+ * @return Arena, or NULL if the arena is disabled or region is too small
+ */
+xai_arena_t* xai_arena_create_static(xai_static_region_t *region, size_t block_size);
+
+/**
+ * @brief Region bytes taken by xai_arena_create_static()
+ */
+size_t xai_arena_static_size(size_t block_size);
+
+// ============================================================================
+// Response Storage (xai_arena.c)
+// ============================================================================
+
+/**
+ * @brief Route the calling task's response allocations to storage
+ *
+ * storage is rewound first: responses parsed into it stay valid until the
+ * next call on the same client. NULL routes them back to the heap.
+ *
+ * @return Storage active before, for xai_response_storage_end()
+ */
+xai_arena_t* xai_response_storage_begin(xai_arena_t *storage);
+
+/**
+ * @brief Restore the storage returned by xai_response_storage_begin()
+ */
+void xai_response_storage_end(xai_arena_t *outer);
+
+/**
+ * @brief Storage currently serving response allocations, NULL for heap
+ *
+ * Parsers record it in xai_response_t._internal so xai_response_free()
+ * knows not to free the fields.
+ */
+xai_arena_t* xai_response_storage(void);
+
+/**
+ * @brief Zeroed response allocation (static storage or heap)
+ */
+void *xai_response_calloc(size_t count, size_t size);
+
+/**
+ * @brief strdup() into response storage (static storage or heap)
+ */
+char *xai_response_strdup(const char *str);
+
+// ============================================================================
+// Buffer Pool Functions (xai_buffer_pool.c)
+// ============================================================================
+
+/**
+ * @brief Create buffer pool with a single size class
  */
 xai_buffer_pool_t* xai_buffer_pool_create(size_t buffer_count, size_t buffer_size);
 
 /**
- * @brief Acquire buffer from pool
+ * @brief Create buffer pool with up to XAI_POOL_MAX_CLASSES size classes
  */
-xai_buffer_t* xai_buffer_pool_acquire(xai_buffer_pool_t *pool);
+xai_buffer_pool_t* xai_buffer_pool_create_classes(
+    const xai_buffer_class_config_t *classes,
+    size_t class_count
+);
+
+/**
+ * @brief Create buffer pool with its buffers and semaphore carved from region
+ */
+xai_buffer_pool_t* xai_buffer_pool_create_static(
+    xai_static_region_t *region,
+    const xai_buffer_class_config_t *classes,
+    size_t class_count
+);
+
+/**
+ * @brief Region bytes taken by xai_buffer_pool_create_static()
+ */
+size_t xai_buffer_pool_static_size(const xai_buffer_class_config_t *classes, size_t class_count);
+
+/**
+ * @brief Acquire a buffer of the largest class, waiting up to timeout_ms
+ */
+xai_buffer_t* xai_buffer_pool_acquire(xai_buffer_pool_t *pool, uint32_t timeout_ms);
+
+/**
+ * @brief Acquire the smallest free buffer of at least min_size bytes
+ *
+ * Falls back to larger classes when the best fit is exhausted; waits up to
+ * timeout_ms when no class fits.
+ */
+xai_buffer_t* xai_buffer_pool_acquire_size(
+    xai_buffer_pool_t *pool,
+    size_t min_size,
+    uint32_t timeout_ms
+);
 
 /**
  * @brief Release buffer back to pool
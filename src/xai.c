@@ -10,8 +10,10 @@
 #include "xai_internal.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_heap_caps.h"
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 static const char *TAG = "xai";
 
@@ -25,13 +27,29 @@ static const char *TAG = "xai";
 
 // From Kconfig
 #ifndef CONFIG_XAI_MAX_RESPONSE_SIZE
-#define CONFIG_XAI_MAX_RESPONSE_SIZE 8192
+#define CONFIG_XAI_MAX_RESPONSE_SIZE 16384
 #endif
 
 #ifndef CONFIG_XAI_BUFFER_POOL_SIZE
 #define CONFIG_XAI_BUFFER_POOL_SIZE 2
 #endif
 
+#ifndef CONFIG_XAI_JSON_ARENA_SIZE
+#define CONFIG_XAI_JSON_ARENA_SIZE 8192
+#endif
+
+#ifndef CONFIG_XAI_BUFFER_POOL_SMALL_COUNT
+#define CONFIG_XAI_BUFFER_POOL_SMALL_COUNT 0
+#endif
+
+#ifndef CONFIG_XAI_BUFFER_POOL_SMALL_SIZE
+#define CONFIG_XAI_BUFFER_POOL_SMALL_SIZE 2048
+#endif
+
+#ifndef CONFIG_XAI_PLACEMENT_BULK_THRESHOLD
+#define CONFIG_XAI_PLACEMENT_BULK_THRESHOLD 1024
+#endif
+
 // ============================================================================
 // Configuration Helpers
 // ============================================================================
@@ -44,7 +62,12 @@ xai_config_t xai_config_default(void) {
         .timeout_ms = XAI_DEFAULT_TIMEOUT_MS,
         .max_retries = XAI_DEFAULT_MAX_RETRIES,
         .max_tokens = XAI_DEFAULT_MAX_TOKENS,
-        .temperature = XAI_DEFAULT_TEMPERATURE
+        .temperature = XAI_DEFAULT_TEMPERATURE,
+        .placement = {
+            .hot = XAI_PLACE_AUTO,
+            .bulk = XAI_PLACE_AUTO,
+            .bulk_threshold = CONFIG_XAI_PLACEMENT_BULK_THRESHOLD
+        }
     };
     return config;
 }
@@ -65,124 +88,279 @@ xai_options_t xai_options_default(void) {
         .parallel_function_calling = false,
         .tools = NULL,
         .tool_count = 0,
-        .tool_choice = NULL
+        .tool_choice = NULL,
+        .stream_coalesce = {
+            .min_bytes = 0,
+            .max_delay_ms = 0,
+            .flush_on_sentence = false
+        },
+        .stream_pipeline = XAI_STREAM_PIPELINE_AUTO,
+        .priority = XAI_PRIORITY_NORMAL,
+        .hedge = {
+            .enabled = false,
+            .delay_ms = 0,
+            .model = NULL
+        },
+        .cache = XAI_CACHE_DEFAULT
     };
     return options;
 }
 
 // ============================================================================
-// Buffer Pool Implementation
+// Memory Helpers
 // ============================================================================
 
-xai_buffer_pool_t* xai_buffer_pool_create(size_t buffer_count, size_t buffer_size) {
-    xai_buffer_pool_t *pool = calloc(1, sizeof(xai_buffer_pool_t));
-    if (!pool) {
-        ESP_LOGE(TAG, "Failed to allocate buffer pool");
-        return NULL;
+static xai_alloc_hook_t s_alloc_hook;
+static void *s_alloc_hook_data;
+static atomic_uint s_alloc_count;
+
+/**
+ * @brief Count an SDK heap allocation and let the hook veto it
+ */
+static bool alloc_admit(size_t size) {
+    atomic_fetch_add_explicit(&s_alloc_count, 1, memory_order_relaxed);
+    xai_alloc_hook_t hook = s_alloc_hook;
+    return !hook || hook(size, s_alloc_hook_data);
+}
+
+void xai_set_alloc_hook(xai_alloc_hook_t hook, void *user_data) {
+    s_alloc_hook_data = user_data;
+    s_alloc_hook = hook;
+}
+
+uint32_t xai_get_alloc_count(void) {
+    return atomic_load_explicit(&s_alloc_count, memory_order_relaxed);
+}
+
+#define PLACE_CAPS_INTERNAL (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#define PLACE_CAPS_PSRAM    (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define PLACE_CAPS_DMA      (MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+static const xai_placement_t s_placement_default = {
+    .hot = XAI_PLACE_AUTO,
+    .bulk = XAI_PLACE_AUTO,
+    .bulk_threshold = CONFIG_XAI_PLACEMENT_BULK_THRESHOLD,
+};
+
+static __thread const xai_placement_t *s_placement;
+
+static struct {
+    _Atomic uint64_t bytes[XAI_ALLOC_CLASS_COUNT][XAI_MEM_REGION_COUNT];
+    atomic_uint allocs[XAI_ALLOC_CLASS_COUNT][XAI_MEM_REGION_COUNT];
+    atomic_uint fallbacks;
+    atomic_uint failures;
+} s_place_stats;
+
+const xai_placement_t *xai_placement_begin(const xai_placement_t *placement) {
+    const xai_placement_t *outer = s_placement;
+    s_placement = placement;
+    return outer;
+}
+
+void xai_placement_end(const xai_placement_t *outer) {
+    s_placement = outer;
+}
+
+static bool place_has_psram(void) {
+    // PSRAM is registered at boot and never goes away
+    static int8_t has_psram = -1;
+    if (has_psram < 0) {
+        has_psram = heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
     }
+    return has_psram;
+}
 
-    pool->buffers = calloc(buffer_count, sizeof(xai_buffer_t));
-    if (!pool->buffers) {
-        ESP_LOGE(TAG, "Failed to allocate buffers");
-        free(pool);
-        return NULL;
+/**
+ * @brief Regions to try for an allocation, preferred one first
+ */
+static size_t place_regions(xai_alloc_class_t cls, xai_placement_pref_t pref,
+                            xai_mem_region_t order[XAI_MEM_REGION_COUNT]) {
+    if (cls == XAI_ALLOC_DMA || !place_has_psram()) {
+        order[0] = XAI_MEM_REGION_INTERNAL;
+        return 1;
     }
+    if (pref == XAI_PLACE_AUTO) {
+        pref = cls == XAI_ALLOC_BULK ? XAI_PLACE_PSRAM : XAI_PLACE_INTERNAL;
+    }
+    bool psram_first = pref == XAI_PLACE_PSRAM;
+    order[0] = psram_first ? XAI_MEM_REGION_PSRAM : XAI_MEM_REGION_INTERNAL;
+    order[1] = psram_first ? XAI_MEM_REGION_INTERNAL : XAI_MEM_REGION_PSRAM;
+    return 2;
+}
 
-    pool->count = buffer_count;
-    pool->mutex = xSemaphoreCreateMutex();
-    if (!pool->mutex) {
-        ESP_LOGE(TAG, "Failed to create mutex");
-        free(pool->buffers);
-        free(pool);
+/**
+ * @brief Allocate (ptr NULL) or reallocate from the regions of a class
+ */
+static void *place_alloc(xai_alloc_class_t cls, xai_placement_pref_t pref, void *ptr, size_t size) {
+    if (!alloc_admit(size)) {
         return NULL;
     }
+    // heap_caps_realloc() frees on size 0, heap_caps_malloc() fails on it
+    if (size == 0) {
+        size = 1;
+    }
 
-    // Allocate individual buffers
-    for (size_t i = 0; i < buffer_count; i++) {
-        pool->buffers[i].data = malloc(buffer_size);
-        if (!pool->buffers[i].data) {
-            ESP_LOGE(TAG, "Failed to allocate buffer %zu", i);
-            // Cleanup already allocated buffers
-            for (size_t j = 0; j < i; j++) {
-                free(pool->buffers[j].data);
+    xai_mem_region_t order[XAI_MEM_REGION_COUNT];
+    size_t count = place_regions(cls, pref, order);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t caps = cls == XAI_ALLOC_DMA ? PLACE_CAPS_DMA :
+                        order[i] == XAI_MEM_REGION_PSRAM ? PLACE_CAPS_PSRAM : PLACE_CAPS_INTERNAL;
+        void *p = ptr ? heap_caps_realloc(ptr, size, caps) : heap_caps_malloc(size, caps);
+        if (p) {
+            atomic_fetch_add_explicit(&s_place_stats.bytes[cls][order[i]], size, memory_order_relaxed);
+            atomic_fetch_add_explicit(&s_place_stats.allocs[cls][order[i]], 1, memory_order_relaxed);
+            if (i > 0) {
+                atomic_fetch_add_explicit(&s_place_stats.fallbacks, 1, memory_order_relaxed);
             }
-            vSemaphoreDelete(pool->mutex);
-            free(pool->buffers);
-            free(pool);
-            return NULL;
+            return p;
         }
-        pool->buffers[i].capacity = buffer_size;
-        pool->buffers[i].used = 0;
-        pool->buffers[i].in_use = false;
     }
-
-    ESP_LOGI(TAG, "Created buffer pool: %zu buffers of %zu bytes each", buffer_count, buffer_size);
-    return pool;
+    atomic_fetch_add_explicit(&s_place_stats.failures, 1, memory_order_relaxed);
+    return NULL;
 }
 
-xai_buffer_t* xai_buffer_pool_acquire(xai_buffer_pool_t *pool) {
-    if (!pool) return NULL;
+/**
+ * @brief Class and preference of a generic allocation under the active policy
+ */
+static xai_alloc_class_t place_classify(size_t size, xai_placement_pref_t *pref) {
+    const xai_placement_t *policy = s_placement ? s_placement : &s_placement_default;
+    if (size >= policy->bulk_threshold) {
+        *pref = policy->bulk;
+        return XAI_ALLOC_BULK;
+    }
+    *pref = policy->hot;
+    return XAI_ALLOC_HOT;
+}
 
-    xSemaphoreTake(pool->mutex, portMAX_DELAY);
+void *xai_malloc(size_t size) {
+    xai_placement_pref_t pref;
+    xai_alloc_class_t cls = place_classify(size, &pref);
+    return place_alloc(cls, pref, NULL, size);
+}
 
-    xai_buffer_t *buffer = NULL;
-    for (size_t i = 0; i < pool->count; i++) {
-        if (!pool->buffers[i].in_use) {
-            pool->buffers[i].in_use = true;
-            pool->buffers[i].used = 0;
-            buffer = &pool->buffers[i];
-            break;
-        }
+void *xai_calloc(size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *p = xai_malloc(count * size);
+    if (p) {
+        memset(p, 0, count * size);
     }
+    return p;
+}
 
-    xSemaphoreGive(pool->mutex);
+void *xai_realloc(void *ptr, size_t size) {
+    xai_placement_pref_t pref;
+    xai_alloc_class_t cls = place_classify(size, &pref);
+    return place_alloc(cls, pref, ptr, size);
+}
 
-    if (!buffer) {
-        ESP_LOGW(TAG, "No available buffers in pool");
+char *xai_strdup(const char *str) {
+    size_t len = strlen(str) + 1;
+    char *copy = xai_malloc(len);
+    if (copy) {
+        memcpy(copy, str, len);
     }
+    return copy;
+}
 
-    return buffer;
+void *xai_malloc_bulk(size_t size) {
+    const xai_placement_t *policy = s_placement ? s_placement : &s_placement_default;
+    return place_alloc(XAI_ALLOC_BULK, policy->bulk, NULL, size);
 }
 
-void xai_buffer_pool_release(xai_buffer_pool_t *pool, xai_buffer_t *buffer) {
-    if (!pool || !buffer) return;
+void *xai_realloc_bulk(void *ptr, size_t size) {
+    const xai_placement_t *policy = s_placement ? s_placement : &s_placement_default;
+    return place_alloc(XAI_ALLOC_BULK, policy->bulk, ptr, size);
+}
 
-    xSemaphoreTake(pool->mutex, portMAX_DELAY);
+void *xai_malloc_placed(xai_alloc_class_t cls, xai_placement_pref_t pref, size_t size) {
+    return place_alloc(cls, pref, NULL, size);
+}
 
-    // Find and release the buffer
-    for (size_t i = 0; i < pool->count; i++) {
-        if (&pool->buffers[i] == buffer) {
-            pool->buffers[i].in_use = false;
-            pool->buffers[i].used = 0;
-            break;
+void xai_get_placement_stats(xai_placement_stats_t *stats) {
+    if (!stats) {
+        return;
+    }
+    for (size_t c = 0; c < XAI_ALLOC_CLASS_COUNT; c++) {
+        for (size_t r = 0; r < XAI_MEM_REGION_COUNT; r++) {
+            stats->bytes[c][r] = atomic_load_explicit(&s_place_stats.bytes[c][r], memory_order_relaxed);
+            stats->allocs[c][r] = atomic_load_explicit(&s_place_stats.allocs[c][r], memory_order_relaxed);
         }
     }
-
-    xSemaphoreGive(pool->mutex);
+    stats->fallbacks = atomic_load_explicit(&s_place_stats.fallbacks, memory_order_relaxed);
+    stats->failures = atomic_load_explicit(&s_place_stats.failures, memory_order_relaxed);
 }
 
-void xai_buffer_pool_destroy(xai_buffer_pool_t *pool) {
-    if (!pool) return;
-
-    if (pool->buffers) {
-        for (size_t i = 0; i < pool->count; i++) {
-            free(pool->buffers[i].data);
+void xai_reset_placement_stats(void) {
+    for (size_t c = 0; c < XAI_ALLOC_CLASS_COUNT; c++) {
+        for (size_t r = 0; r < XAI_MEM_REGION_COUNT; r++) {
+            atomic_store_explicit(&s_place_stats.bytes[c][r], 0, memory_order_relaxed);
+            atomic_store_explicit(&s_place_stats.allocs[c][r], 0, memory_order_relaxed);
         }
-        free(pool->buffers);
     }
+    atomic_store_explicit(&s_place_stats.fallbacks, 0, memory_order_relaxed);
+    atomic_store_explicit(&s_place_stats.failures, 0, memory_order_relaxed);
+}
 
-    if (pool->mutex) {
-        vSemaphoreDelete(pool->mutex);
+void *xai_static_take(xai_static_region_t *region, size_t size) {
+    size = XAI_STATIC_SIZE(size ? size : 1);
+    if (!region || region->size - region->used < size) {
+        return NULL;
     }
 
-    free(pool);
-    ESP_LOGI(TAG, "Destroyed buffer pool");
+    void *ptr = region->base + region->used;
+    region->used += size;
+    memset(ptr, 0, size);
+    return ptr;
 }
 
 // ============================================================================
 // Client Lifecycle
 // ============================================================================
 
+/**
+ * @brief Pool layout from Kconfig: full-size buffers plus optional small
+ *        ones for request bodies of known size
+ */
+static size_t client_pool_classes(xai_buffer_class_config_t classes[2]) {
+    classes[0].buffer_size = CONFIG_XAI_MAX_RESPONSE_SIZE;
+    classes[0].buffer_count = CONFIG_XAI_BUFFER_POOL_SIZE;
+    classes[1].buffer_size = CONFIG_XAI_BUFFER_POOL_SMALL_SIZE;
+    classes[1].buffer_count = CONFIG_XAI_BUFFER_POOL_SMALL_COUNT;
+    return (CONFIG_XAI_BUFFER_POOL_SMALL_COUNT > 0 &&
+            CONFIG_XAI_BUFFER_POOL_SMALL_SIZE < CONFIG_XAI_MAX_RESPONSE_SIZE) ? 2 : 1;
+}
+
+/**
+ * @brief Copy the numeric configuration fields, applying defaults
+ */
+static void client_apply_config(struct xai_client_s *client, const xai_config_t *config) {
+    client->timeout_ms = config->timeout_ms ? config->timeout_ms : XAI_DEFAULT_TIMEOUT_MS;
+    client->max_retries = config->max_retries;
+    client->default_temperature = config->temperature;
+    client->default_max_tokens = config->max_tokens ? config->max_tokens : XAI_DEFAULT_MAX_TOKENS;
+    client->placement = config->placement;
+    if (client->placement.bulk_threshold == 0) {
+        client->placement.bulk_threshold = CONFIG_XAI_PLACEMENT_BULK_THRESHOLD;
+    }
+}
+
+xai_config_t xai_client_config(const struct xai_client_s *client) {
+    xai_config_t config = xai_config_default();
+    config.api_key = client->api_key;
+    config.base_url = client->base_url;
+    config.default_model = client->default_model;
+    config.timeout_ms = client->timeout_ms;
+    config.max_retries = client->max_retries;
+    config.max_tokens = client->default_max_tokens;
+    config.temperature = client->default_temperature;
+    config.placement = client->placement;
+    config.cache = xai_cache_config(client->cache);
+    config.router = client->router.cfg;
+    return config;
+}
+
 xai_client_t xai_create(const char *api_key) {
     if (!api_key || strlen(api_key) == 0) {
         ESP_LOGE(TAG, "API key is required");
@@ -207,21 +385,26 @@ xai_client_t xai_create_config(const xai_config_t *config) {
 
     ESP_LOGI(TAG, "Creating xAI client");
 
+    // Everything the client owns is placed by its own policy
+    xai_placement_t placement = config->placement;
+    if (placement.bulk_threshold == 0) {
+        placement.bulk_threshold = CONFIG_XAI_PLACEMENT_BULK_THRESHOLD;
+    }
+    const xai_placement_t *outer_placement = xai_placement_begin(&placement);
+
     // Allocate client structure
-    struct xai_client_s *client = calloc(1, sizeof(struct xai_client_s));
+    struct xai_client_s *client = xai_calloc(1, sizeof(struct xai_client_s));
     if (!client) {
         ESP_LOGE(TAG, "Failed to allocate client");
+        xai_placement_end(outer_placement);
         return NULL;
     }
 
     // Copy configuration
-    client->api_key = strdup(config->api_key);
-    client->base_url = strdup(config->base_url ? config->base_url : XAI_DEFAULT_BASE_URL);
-    client->default_model = strdup(config->default_model ? config->default_model : XAI_DEFAULT_MODEL);
-    client->timeout_ms = config->timeout_ms ? config->timeout_ms : XAI_DEFAULT_TIMEOUT_MS;
-    client->max_retries = config->max_retries;
-    client->default_temperature = config->temperature;
-    client->default_max_tokens = config->max_tokens ? config->max_tokens : XAI_DEFAULT_MAX_TOKENS;
+    client->api_key = xai_strdup(config->api_key);
+    client->base_url = xai_strdup(config->base_url ? config->base_url : XAI_DEFAULT_BASE_URL);
+    client->default_model = xai_strdup(config->default_model ? config->default_model : XAI_DEFAULT_MODEL);
+    client_apply_config(client, config);
 
     if (!client->api_key || !client->base_url || !client->default_model) {
         ESP_LOGE(TAG, "Failed to copy configuration strings");
@@ -234,41 +417,65 @@ xai_client_t xai_create_config(const xai_config_t *config) {
         ESP_LOGE(TAG, "Failed to create client mutex");
         goto error;
     }
+    xai_sched_init(&client->sched, &config->scheduler);
+    xai_router_init(&client->router, &config->router);
 
     // Create buffer pool
-    client->buffer_pool = xai_buffer_pool_create(
-        CONFIG_XAI_BUFFER_POOL_SIZE,
-        CONFIG_XAI_MAX_RESPONSE_SIZE
-    );
+    xai_buffer_class_config_t pool_classes[2];
+    size_t pool_class_count = client_pool_classes(pool_classes);
+    client->buffer_pool = xai_buffer_pool_create_classes(pool_classes, pool_class_count);
     if (!client->buffer_pool) {
         ESP_LOGE(TAG, "Failed to create buffer pool");
         goto error;
     }
 
+#ifdef CONFIG_XAI_JSON_ARENA
+    client->json_arena = xai_arena_create(CONFIG_XAI_JSON_ARENA_SIZE);
+    if (!client->json_arena) {
+        ESP_LOGE(TAG, "Failed to create JSON arena");
+        goto error;
+    }
+#endif
+
     // Create HTTP client
     client->http_client = xai_http_client_create(
         client->base_url,
         client->api_key,
-        client->timeout_ms
+        client->timeout_ms,
+        client->buffer_pool
     );
     if (!client->http_client) {
         ESP_LOGE(TAG, "Failed to create HTTP client");
         goto error;
     }
 
+    if (config->cache.enabled) {
+        client->cache = xai_cache_create(&config->cache);
+        if (!client->cache) {
+            ESP_LOGE(TAG, "Failed to create response cache");
+            goto error;
+        }
+    }
+
+    xai_placement_end(outer_placement);
     ESP_LOGI(TAG, "xAI client created successfully (model: %s)", client->default_model);
     return (xai_client_t)client;
 
 error:
+    xai_placement_end(outer_placement);
     if (client->http_client) {
         xai_http_client_destroy(client->http_client);
     }
     if (client->buffer_pool) {
         xai_buffer_pool_destroy(client->buffer_pool);
     }
+    xai_arena_destroy(client->json_arena);
+    xai_cache_destroy(client->cache);
     if (client->mutex) {
         vSemaphoreDelete(client->mutex);
     }
+    xai_sched_deinit(&client->sched);
+    xai_router_deinit(&client->router);
     free(client->api_key);
     free(client->base_url);
     free(client->default_model);
@@ -291,18 +498,174 @@ void xai_destroy(xai_client_t client) {
         xai_buffer_pool_destroy(impl->buffer_pool);
     }
 
+#ifdef CONFIG_XAI_ENABLE_STREAMING
+    if (impl->coalescer) {
+        xai_stream_coalescer_destroy(impl->coalescer);
+    }
+#endif
+
+    xai_arena_destroy(impl->json_arena);
+    xai_cache_destroy(impl->cache);
+
     if (impl->mutex) {
         vSemaphoreDelete(impl->mutex);
     }
-
-    free(impl->api_key);
-    free(impl->base_url);
-    free(impl->default_model);
-    free(impl);
+    xai_sched_deinit(&impl->sched);
+    xai_router_deinit(&impl->router);
+
+    // A static client lives in the caller's memory
+    if (!impl->static_storage) {
+        free(impl->api_key);
+        free(impl->base_url);
+        free(impl->default_model);
+        free(impl);
+    }
 
     ESP_LOGI(TAG, "xAI client destroyed");
 }
 
+// ============================================================================
+// Static Clients
+// ============================================================================
+
+static size_t static_json_arena_size(const xai_static_config_t *config) {
+    return config->json_arena_size ? config->json_arena_size : CONFIG_XAI_JSON_ARENA_SIZE;
+}
+
+static size_t static_response_size(const xai_static_config_t *config) {
+    return config->response_storage_size ? config->response_storage_size
+                                         : CONFIG_XAI_MAX_RESPONSE_SIZE;
+}
+
+static char *static_strdup(xai_static_region_t *region, const char *str) {
+    size_t len = strlen(str) + 1;
+    char *copy = xai_static_take(region, len);
+    if (copy) {
+        memcpy(copy, str, len);
+    }
+    return copy;
+}
+
+size_t xai_static_memory_size(const xai_static_config_t *config) {
+    if (!config || !config->config.api_key) {
+        return 0;
+    }
+
+    const xai_config_t *cfg = &config->config;
+    xai_buffer_class_config_t pool_classes[2];
+    size_t pool_class_count = client_pool_classes(pool_classes);
+
+    return (XAI_STATIC_ALIGN - 1) +  // Unaligned start
+           XAI_STATIC_SIZE(sizeof(struct xai_client_s)) +
+           XAI_STATIC_SIZE(strlen(cfg->api_key) + 1) +
+           XAI_STATIC_SIZE(strlen(cfg->base_url ? cfg->base_url : XAI_DEFAULT_BASE_URL) + 1) +
+           XAI_STATIC_SIZE(strlen(cfg->default_model ? cfg->default_model : XAI_DEFAULT_MODEL) + 1) +
+           xai_buffer_pool_static_size(pool_classes, pool_class_count) +
+           xai_arena_static_size(static_json_arena_size(config)) +
+           xai_arena_static_size(static_response_size(config)) +
+           XAI_STATIC_SIZE(sizeof(xai_http_client_t)) +
+           XAI_STATIC_SIZE(sizeof(xai_stream_parser_t));
+}
+
+xai_client_t xai_create_static(const xai_static_config_t *config) {
+    if (!config || !config->memory || !config->config.api_key) {
+        ESP_LOGE(TAG, "Static config, memory and API key are required");
+        return NULL;
+    }
+
+#ifndef CONFIG_XAI_JSON_ARENA
+    // cJSON would fall back to malloc on every request
+    ESP_LOGE(TAG, "Static clients require CONFIG_XAI_JSON_ARENA");
+    return NULL;
+#else
+    size_t needed = xai_static_memory_size(config);
+    if (config->memory_size < needed) {
+        ESP_LOGE(TAG, "Static memory too small: %zu bytes, need %zu",
+                 config->memory_size, needed);
+        return NULL;
+    }
+
+    uintptr_t start = XAI_STATIC_SIZE((uintptr_t)config->memory);
+    xai_static_region_t region = {
+        .base = (uint8_t *)start,
+        .size = config->memory_size - (start - (uintptr_t)config->memory),
+        .used = 0,
+    };
+
+    const xai_config_t *cfg = &config->config;
+    if (cfg->cache.enabled) {
+        // Cache entries are heap allocations
+        ESP_LOGW(TAG, "Static clients have no response cache");
+    }
+    struct xai_client_s *client = xai_static_take(&region, sizeof(struct xai_client_s));
+    client->static_storage = true;
+    client->api_key = static_strdup(&region, cfg->api_key);
+    client->base_url = static_strdup(&region, cfg->base_url ? cfg->base_url : XAI_DEFAULT_BASE_URL);
+    client->default_model = static_strdup(&region, cfg->default_model ? cfg->default_model
+                                                                      : XAI_DEFAULT_MODEL);
+    client_apply_config(client, cfg);
+
+    client->mutex = xSemaphoreCreateMutexStatic(&client->mutex_buf);
+    xai_sched_init(&client->sched, &cfg->scheduler);
+    xai_router_init(&client->router, &cfg->router);
+
+    xai_buffer_class_config_t pool_classes[2];
+    size_t pool_class_count = client_pool_classes(pool_classes);
+    client->buffer_pool = xai_buffer_pool_create_static(&region, pool_classes, pool_class_count);
+    client->json_arena = xai_arena_create_static(&region, static_json_arena_size(config));
+    client->response_storage = xai_arena_create_static(&region, static_response_size(config));
+    if (client->buffer_pool) {
+        client->http_client = xai_http_client_create_static(
+            &region, client->base_url, client->api_key, client->timeout_ms, client->buffer_pool
+        );
+    }
+
+    if (!client->buffer_pool || !client->json_arena || !client->response_storage ||
+        !client->http_client) {
+        ESP_LOGE(TAG, "Failed to create static client");
+        xai_destroy((xai_client_t)client);
+        return NULL;
+    }
+
+    ESP_LOGI(TAG, "Static xAI client created (%zu of %zu bytes, model: %s)",
+             region.used, region.size, client->default_model);
+    return (xai_client_t)client;
+#endif
+}
+
+xai_err_t xai_client_lock(struct xai_client_s *client, xai_endpoint_t endpoint,
+                          xai_priority_t priority) {
+    xai_err_t err = xai_sched_acquire(&client->sched, priority, client->timeout_ms);
+    if (err != XAI_OK) {
+        return err;
+    }
+    // Granted: only stats readers can still hold the mutex, briefly
+    if (xSemaphoreTake(client->mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        xai_sched_release(&client->sched);
+        return XAI_ERR_TIMEOUT;
+    }
+    err = xai_mem_begin(client, endpoint);
+    if (err != XAI_OK) {
+        xSemaphoreGive(client->mutex);
+        xai_sched_release(&client->sched);
+        return err;
+    }
+    client->outer_placement = xai_placement_begin(&client->placement);
+    xai_arena_begin(client->json_arena);
+    client->outer_response_storage = xai_response_storage_begin(client->response_storage);
+    return XAI_OK;
+}
+
+void xai_client_unlock(struct xai_client_s *client) {
+    xai_response_storage_end(client->outer_response_storage);
+    xai_placement_end(client->outer_placement);
+    // Overflow blocks are still held: they count towards the peak
+    xai_mem_end(client);
+    xai_arena_end(client->json_arena);
+    xSemaphoreGive(client->mutex);
+    xai_sched_release(&client->sched);
+}
+
 // ============================================================================
 // Response Memory Management
 // ============================================================================
@@ -310,6 +673,12 @@ void xai_destroy(xai_client_t client) {
 void xai_response_free(xai_response_t *response) {
     if (!response) return;
 
+    // Parsed into a static client's storage: nothing to free
+    if (response->_internal) {
+        memset(response, 0, sizeof(xai_response_t));
+        return;
+    }
+
     free(response->content);
     free(response->reasoning_content);
     free(response->model);
@@ -358,6 +727,7 @@ const char* xai_err_to_string(xai_err_t err) {
         case XAI_ERR_TIMEOUT:       return "Request timeout";
         case XAI_ERR_API_ERROR:     return "API error";
         case XAI_ERR_NOT_SUPPORTED: return "Feature not supported";
+        case XAI_ERR_CANCELLED:     return "Request cancelled";
         default:                    return "Unknown error";
     }
 }
@@ -0,0 +1,487 @@
+/**
+ * @file xai_arena.c
+ * @brief Per-request bump allocator for cJSON
+ *
+ * Request building and response parsing create hundreds of short-lived
+ * cJSON nodes and strings. Served by malloc they interleave with long-lived
+ * allocations and fragment internal RAM over hours of uptime. While a client
+ * is locked, its arena serves them instead: allocation bumps a pointer in
+ * one block, frees only count down, and the arena rewinds as soon as every
+ * node is gone.
+ *
+ * cJSON hooks are process-wide, so the hooks installed here consult a
+ * per-task "active arena" and fall through to malloc/free for every other
+ * task and for calls made outside an API request.
+ *
+ * Static clients use fixed arenas carved from caller memory: they never
+ * grow and never fall back to the heap. A second fixed arena holds the
+ * strings of parsed responses until the client's next call.
+ */
+
+#include "sdkconfig.h"
+#include "xai_internal.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/task.h"
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+static const char *TAG = "xai_arena";
+
+#define ARENA_ALIGN 8
+
+#ifdef CONFIG_XAI_JSON_ARENA
+
+static __thread xai_arena_t *s_active;
+static bool s_hooks_installed;
+
+static size_t arena_align(size_t n) {
+    return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static xai_arena_block_t* arena_block_new(size_t size) {
+    xai_arena_block_t *block = xai_malloc_bulk(sizeof(xai_arena_block_t) + size);
+    if (block) {
+        block->next = NULL;
+        block->size = size;
+        block->used = 0;
+    }
+    return block;
+}
+
+static bool arena_owns(const xai_arena_t *arena, const void *ptr) {
+    const char *p = (const char *)ptr;
+    for (const xai_arena_block_t *b = arena->blocks; b; b = b->next) {
+        if (p >= b->data && p < b->data + b->size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void arena_rewind(xai_arena_t *arena) {
+    for (xai_arena_block_t *b = arena->blocks; b; b = b->next) {
+        b->used = 0;
+    }
+}
+
+static size_t arena_in_use(const xai_arena_t *arena) {
+    size_t used = 0;
+    for (const xai_arena_block_t *b = arena->blocks; b; b = b->next) {
+        used += b->used;
+    }
+    return used;
+}
+
+static void *arena_alloc(xai_arena_t *arena, size_t size) {
+    size = arena_align(size ? size : 1);
+
+    xai_arena_block_t *block = arena->blocks;
+    while (block && block->size - block->used < size) {
+        block = block->next;
+    }
+
+    if (!block) {
+        if (arena->fixed) {
+            return NULL;
+        }
+        // Overflow: one more block, at least as big as the kept one
+        block = arena_block_new(size > arena->block_size ? size : arena->block_size);
+        if (!block) {
+            return NULL;
+        }
+        block->next = arena->blocks;
+        arena->blocks = block;
+        arena->overflow_blocks++;
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    arena->live++;
+
+    size_t in_use = arena_in_use(arena);
+    if (in_use > arena->high_water) {
+        arena->high_water = in_use;
+    }
+    return ptr;
+}
+
+static void *arena_hook_malloc(size_t size);
+static void arena_hook_free(void *ptr);
+
+static void arena_install_hooks(void) {
+    if (!s_hooks_installed) {
+        cJSON_Hooks hooks = {
+            .malloc_fn = arena_hook_malloc,
+            .free_fn = arena_hook_free,
+        };
+        cJSON_InitHooks(&hooks);
+        s_hooks_installed = true;
+    }
+}
+
+static void *arena_hook_malloc(size_t size) {
+    xai_arena_t *arena = s_active;
+    if (arena) {
+        void *ptr = arena_alloc(arena, size);
+        if (ptr || arena->fixed) {
+            return ptr;
+        }
+        // Out of arena memory: the heap still works, free() tells them apart
+        return xai_malloc(size);
+    }
+    return malloc(size);
+}
+
+static void arena_hook_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    xai_arena_t *arena = s_active;
+    if (arena && arena_owns(arena, ptr)) {
+        if (arena->live > 0 && --arena->live == 0) {
+            arena_rewind(arena);
+        }
+        return;
+    }
+    free(ptr);
+}
+
+xai_arena_t* xai_arena_create(size_t block_size) {
+    xai_arena_t *arena = xai_calloc(1, sizeof(xai_arena_t));
+    if (!arena) {
+        ESP_LOGE(TAG, "Failed to allocate arena");
+        return NULL;
+    }
+
+    arena->block_size = arena_align(block_size);
+    arena->blocks = arena_block_new(arena->block_size);
+    if (!arena->blocks) {
+        ESP_LOGE(TAG, "Failed to allocate arena block (%zu bytes)", arena->block_size);
+        free(arena);
+        return NULL;
+    }
+
+    arena_install_hooks();
+    return arena;
+}
+
+size_t xai_arena_static_size(size_t block_size) {
+    return XAI_STATIC_SIZE(sizeof(xai_arena_t)) +
+           XAI_STATIC_SIZE(sizeof(xai_arena_block_t) + arena_align(block_size));
+}
+
+xai_arena_t* xai_arena_create_static(xai_static_region_t *region, size_t block_size) {
+    xai_arena_t *arena = xai_static_take(region, sizeof(xai_arena_t));
+    if (!arena) {
+        return NULL;
+    }
+
+    arena->block_size = arena_align(block_size);
+    arena->blocks = xai_static_take(region, sizeof(xai_arena_block_t) + arena->block_size);
+    if (!arena->blocks) {
+        return NULL;
+    }
+    arena->blocks->size = arena->block_size;
+    arena->fixed = true;
+
+    arena_install_hooks();
+    return arena;
+}
+
+void xai_arena_destroy(xai_arena_t *arena) {
+    if (!arena || arena->fixed) {
+        return;
+    }
+
+    xai_arena_block_t *b = arena->blocks;
+    while (b) {
+        xai_arena_block_t *next = b->next;
+        heap_caps_free(b);
+        b = next;
+    }
+    free(arena);
+}
+
+void xai_arena_begin(xai_arena_t *arena) {
+    if (!arena) {
+        return;
+    }
+
+    if (arena->depth++ == 0) {
+        arena->outer = s_active;
+        s_active = arena;
+    }
+}
+
+void xai_arena_end(xai_arena_t *arena) {
+    if (!arena || arena->depth == 0 || --arena->depth > 0) {
+        return;
+    }
+
+    s_active = arena->outer;
+    arena->outer = NULL;
+
+    if (arena->live > 0) {
+        // Something leaked a cJSON tree; its memory goes with the rewind
+        ESP_LOGW(TAG, "%" PRIu32 " allocations still live at end of request", arena->live);
+        arena->live = 0;
+    }
+
+    // Keep only the original block
+    while (arena->blocks->next) {
+        xai_arena_block_t *overflow = arena->blocks;
+        arena->blocks = overflow->next;
+        heap_caps_free(overflow);
+    }
+    arena_rewind(arena);
+}
+
+xai_arena_t* xai_arena_suspend(void) {
+    xai_arena_t *arena = s_active;
+    s_active = NULL;
+    return arena;
+}
+
+void xai_arena_resume(xai_arena_t *arena) {
+    s_active = arena;
+}
+
+// ============================================================================
+// Response Storage
+// ============================================================================
+
+static __thread xai_arena_t *s_response;
+
+xai_arena_t* xai_response_storage_begin(xai_arena_t *storage) {
+    xai_arena_t *outer = s_response;
+    if (storage) {
+        // The previous response on this client is given up here
+        storage->live = 0;
+        arena_rewind(storage);
+    }
+    s_response = storage;
+    return outer;
+}
+
+void xai_response_storage_end(xai_arena_t *outer) {
+    s_response = outer;
+}
+
+xai_arena_t* xai_response_storage(void) {
+    return s_response;
+}
+
+void *xai_response_calloc(size_t count, size_t size) {
+    xai_arena_t *storage = s_response;
+    if (!storage) {
+        return xai_calloc(count, size);
+    }
+    if (size && count > SIZE_MAX / size) {
+        return NULL;
+    }
+
+    void *ptr = arena_alloc(storage, count * size);
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    } else {
+        ESP_LOGE(TAG, "Response storage full (%zu bytes)", storage->block_size);
+    }
+    return ptr;
+}
+
+char *xai_response_strdup(const char *str) {
+    if (!s_response) {
+        return xai_strdup(str);
+    }
+
+    size_t len = strlen(str) + 1;
+    char *copy = xai_response_calloc(1, len);
+    if (copy) {
+        memcpy(copy, str, len);
+    }
+    return copy;
+}
+
+// ============================================================================
+// Fragmentation Soak
+// ============================================================================
+
+#define SOAK_RETAINED 8
+
+static const char SOAK_RESPONSE[] =
+    "{\"id\":\"soak\",\"model\":\"grok-3-latest\",\"choices\":[{\"index\":0,"
+    "\"message\":{\"role\":\"assistant\",\"content\":\"The forecast calls for light rain "
+    "in the afternoon with temperatures around 14 degrees.\",\"tool_calls\":["
+    "{\"id\":\"call_1\",\"type\":\"function\",\"function\":{\"name\":\"get_weather\","
+    "\"arguments\":\"{\\\"city\\\":\\\"Lisbon\\\",\\\"unit\\\":\\\"c\\\"}\"}},"
+    "{\"id\":\"call_2\",\"type\":\"function\",\"function\":{\"name\":\"get_time\","
+    "\"arguments\":\"{\\\"tz\\\":\\\"Europe/Lisbon\\\"}\"}}]},"
+    "\"finish_reason\":\"tool_calls\"}],"
+    "\"citations\":[\"https://example.com/a\",\"https://example.com/b\",\"https://example.com/c\","
+    "\"https://example.com/d\",\"https://example.com/e\",\"https://example.com/f\"],"
+    "\"usage\":{\"prompt_tokens\":120,\"completion_tokens\":40,\"total_tokens\":160}}";
+
+static const xai_tool_t SOAK_TOOLS[] = {
+    { "get_weather", "Current weather for a city",
+      "{\"type\":\"object\",\"properties\":{\"city\":{\"type\":\"string\"},"
+      "\"unit\":{\"type\":\"string\",\"enum\":[\"c\",\"f\"]}},\"required\":[\"city\"]}" },
+    { "get_time", "Local time in a time zone",
+      "{\"type\":\"object\",\"properties\":{\"tz\":{\"type\":\"string\"}}}" },
+};
+
+/**
+ * @brief One simulated request: build a tool request, parse a response with
+ *        citations and tool calls, keep the result for a while
+ */
+static xai_err_t soak_request(char *request, size_t request_size,
+                              xai_response_t *retained, uint32_t i) {
+    xai_message_t messages[] = {
+        { .role = XAI_ROLE_SYSTEM, .content = "You are a concise assistant." },
+        { .role = XAI_ROLE_USER, .content = "What is the weather in Lisbon right now?" },
+    };
+    xai_options_t options = xai_options_default();
+    options.tools = (xai_tool_t *)SOAK_TOOLS;
+    options.tool_count = sizeof(SOAK_TOOLS) / sizeof(SOAK_TOOLS[0]);
+
+    size_t len = 0;
+    xai_err_t err = xai_json_build_chat_request(request, request_size, &len, messages, 2,
+                                                &options, "grok-3-latest");
+    if (err != XAI_OK) {
+        return err;
+    }
+
+    // Long-lived results interleave with the transient nodes, as in an app
+    xai_response_t *slot = &retained[i % SOAK_RETAINED];
+    xai_response_free(slot);
+    return xai_json_parse_chat_response(SOAK_RESPONSE, slot);
+}
+
+static xai_err_t soak_phase(xai_arena_t *arena, uint32_t iterations, char *request,
+                            size_t request_size, xai_response_t *retained,
+                            size_t *largest_free, size_t *min_largest_free) {
+    *min_largest_free = SIZE_MAX;
+    for (uint32_t i = 0; i < iterations; i++) {
+        xai_arena_begin(arena);
+        xai_err_t err = soak_request(request, request_size, retained, i);
+        xai_arena_end(arena);
+        if (err != XAI_OK) {
+            return err;
+        }
+
+        size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (largest < *min_largest_free) {
+            *min_largest_free = largest;
+        }
+    }
+
+    for (size_t i = 0; i < SOAK_RETAINED; i++) {
+        xai_response_free(&retained[i]);
+    }
+    *largest_free = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    return XAI_OK;
+}
+
+xai_err_t xai_json_arena_benchmark(uint32_t iterations, xai_json_arena_bench_t *result) {
+    if (iterations == 0 || !result) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    const size_t request_size = 4096;
+    char *request = xai_malloc(request_size);
+    xai_response_t *retained = xai_calloc(SOAK_RETAINED, sizeof(xai_response_t));
+    xai_arena_t *arena = xai_arena_create(CONFIG_XAI_JSON_ARENA_SIZE);
+    xai_err_t err = XAI_ERR_NO_MEMORY;
+
+    if (request && retained && arena) {
+        memset(result, 0, sizeof(*result));
+        result->iterations = iterations;
+        result->largest_free_start =
+            heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+
+        int64_t start = esp_timer_get_time();
+        err = soak_phase(NULL, iterations, request, request_size, retained,
+                         &result->largest_free_heap, &result->min_largest_free_heap);
+        result->heap_us = (uint32_t)(esp_timer_get_time() - start);
+
+        if (err == XAI_OK) {
+            start = esp_timer_get_time();
+            err = soak_phase(arena, iterations, request, request_size, retained,
+                             &result->largest_free_arena, &result->min_largest_free_arena);
+            result->arena_us = (uint32_t)(esp_timer_get_time() - start);
+            result->arena_high_water = arena->high_water;
+        }
+    }
+
+    if (err == XAI_OK) {
+        ESP_LOGI(TAG, "Arena soak (%" PRIu32 " requests): largest free block %zu -> "
+                 "heap %zu (min %zu, %" PRIu32 " us), arena %zu (min %zu, %" PRIu32 " us), "
+                 "arena high water %zu bytes",
+                 iterations, result->largest_free_start,
+                 result->largest_free_heap, result->min_largest_free_heap, result->heap_us,
+                 result->largest_free_arena, result->min_largest_free_arena, result->arena_us,
+                 result->arena_high_water);
+    }
+
+    xai_arena_destroy(arena);
+    free(retained);
+    free(request);
+    return err;
+}
+
+#else // !CONFIG_XAI_JSON_ARENA
+
+xai_arena_t* xai_arena_create(size_t block_size) {
+    return NULL;
+}
+
+void xai_arena_destroy(xai_arena_t *arena) {
+}
+
+void xai_arena_begin(xai_arena_t *arena) {
+}
+
+void xai_arena_end(xai_arena_t *arena) {
+}
+
+xai_arena_t* xai_arena_suspend(void) {
+    return NULL;
+}
+
+void xai_arena_resume(xai_arena_t *arena) {
+}
+
+size_t xai_arena_static_size(size_t block_size) {
+    return 0;
+}
+
+xai_arena_t* xai_arena_create_static(xai_static_region_t *region, size_t block_size) {
+    return NULL;
+}
+
+xai_arena_t* xai_response_storage_begin(xai_arena_t *storage) {
+    return NULL;
+}
+
+void xai_response_storage_end(xai_arena_t *outer) {
+}
+
+xai_arena_t* xai_response_storage(void) {
+    return NULL;
+}
+
+void *xai_response_calloc(size_t count, size_t size) {
+    return xai_calloc(count, size);
+}
+
+char *xai_response_strdup(const char *str) {
+    return xai_strdup(str);
+}
+
+xai_err_t xai_json_arena_benchmark(uint32_t iterations, xai_json_arena_bench_t *result) {
+    return XAI_ERR_NOT_SUPPORTED;
+}
+
+#endif // CONFIG_XAI_JSON_ARENA
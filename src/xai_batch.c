@@ -0,0 +1,450 @@
+/**
+ * @file xai_batch.c
+ * @brief Concurrent batch chat completions
+ *
+ * A client has one connection, so a loop of xai_chat_completion() calls
+ * pays every round trip in turn. A batch opens extra connections - each a
+ * short-lived client of its own, served by its own task - and all of them
+ * pull the next request from a shared index until the batch is drained.
+ * Results are written by index, so completion order does not matter.
+ *
+ * The cache and router stay the client's own. Every request is routed and
+ * looked up in the cache before any is sent, and the outcomes are stored
+ * and recorded in request order once all have returned, so the extra
+ * connections run without a router or cache and never wait on the
+ * client's lock while its own connection is busy.
+ */
+
+#include "sdkconfig.h"
+#include "xai_internal.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+static const char *TAG = "xai_batch";
+
+#ifndef CONFIG_XAI_BATCH_CONCURRENCY
+#define CONFIG_XAI_BATCH_CONCURRENCY 2
+#endif
+
+#ifndef CONFIG_XAI_BATCH_TASK_STACK
+#define CONFIG_XAI_BATCH_TASK_STACK 8192
+#endif
+
+/** Upper bound on connections per batch */
+#define BATCH_MAX_CONNECTIONS 8
+
+/**
+ * @brief What a request carries from the lookup to the recording pass
+ */
+typedef struct {
+    const xai_options_t *options;   /**< As sent: routed or the request's own */
+    xai_options_t routed;
+    xai_route_decision_t route;
+    bool cacheable;
+    bool done;                      /**< Answered from the cache or rejected */
+    uint64_t cache_key;
+    char *body;                     /**< Copy of the response body, for the cache */
+    size_t body_len;
+    xai_request_outcome_t outcome;
+} batch_slot_t;
+
+typedef struct {
+    const xai_batch_request_t *requests;
+    batch_slot_t *slots;
+    xai_batch_result_t *results;
+    size_t count;
+    const xai_options_t *options;   /**< Batch default options */
+    atomic_size_t next;             /**< Next request to hand out */
+    SemaphoreHandle_t done;         /**< Given by each extra connection's task */
+    StaticSemaphore_t done_buf;
+} batch_job_t;
+
+typedef struct {
+    batch_job_t *job;
+    xai_client_t client;
+    uint8_t connection;
+} batch_worker_t;
+
+/**
+ * @brief Route every request and answer what the cache can, on the client
+ */
+static void batch_lookup(struct xai_client_s *client, batch_job_t *job) {
+    for (size_t i = 0; i < job->count; i++) {
+        const xai_batch_request_t *request = &job->requests[i];
+        batch_slot_t *slot = &job->slots[i];
+        slot->options = xai_router_route(client, request->messages, request->message_count,
+                                         request->options ? request->options : job->options,
+                                         &slot->routed, &slot->route);
+#ifdef CONFIG_XAI_VALIDATE_OPTIONS
+        const char *model = (slot->options && slot->options->model) ? slot->options->model
+                                                                    : client->default_model;
+        xai_err_t err = xai_validate_options(model, request->messages, request->message_count,
+                                             slot->options);
+        if (err != XAI_OK) {
+            job->results[i].err = err;
+            slot->done = true;
+        }
+#endif
+    }
+    if (!client->cache) {
+        return;
+    }
+
+    if (xai_client_lock(client, XAI_ENDPOINT_CHAT, XAI_PRIORITY_NORMAL) != XAI_OK) {
+        ESP_LOGW(TAG, "Client busy; batch skips the cache");
+        return;
+    }
+    xai_buffer_t *buffer = xai_buffer_pool_acquire(client->buffer_pool,
+                                                   XAI_POOL_ACQUIRE_TIMEOUT_MS);
+    for (size_t i = 0; buffer && i < job->count; i++) {
+        const xai_batch_request_t *request = &job->requests[i];
+        batch_slot_t *slot = &job->slots[i];
+        if (slot->done || !xai_cache_usable(client->cache, slot->options)) {
+            continue;
+        }
+        int64_t start = esp_timer_get_time();
+        size_t len = 0;
+        if (xai_json_build_chat_request(buffer->data, buffer->capacity, &len,
+                                        request->messages, request->message_count,
+                                        slot->options, client->default_model) != XAI_OK) {
+            continue;
+        }
+        slot->cacheable = true;
+        slot->cache_key = xai_cache_key(buffer->data, len);
+        if (slot->options && slot->options->cache == XAI_CACHE_REFRESH) {
+            continue;
+        }
+        const char *cached = xai_cache_get(client->cache, slot->cache_key, buffer);
+        if (cached) {
+            xai_batch_result_t *result = &job->results[i];
+            result->err = xai_json_parse_chat_response(cached, &result->response);
+            result->latency_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+            xai_cache_record_latency(client->cache, true, esp_timer_get_time() - start);
+            slot->done = true;
+        }
+    }
+    if (buffer) {
+        xai_buffer_pool_release(client->buffer_pool, buffer);
+    }
+    xai_client_unlock(client);
+}
+
+/**
+ * @brief Send one request on a connection; neither its router nor its
+ *        cache is used
+ */
+static xai_err_t batch_send(struct xai_client_s *conn, const xai_batch_request_t *request,
+                            batch_slot_t *slot, xai_response_t *response) {
+    const xai_options_t *options = slot->options;
+    xai_err_t err = xai_client_lock(conn, XAI_ENDPOINT_CHAT,
+                                    options ? options->priority : XAI_PRIORITY_NORMAL);
+    if (err != XAI_OK) {
+        return err;
+    }
+    xai_buffer_t *request_buffer = xai_buffer_pool_acquire(conn->buffer_pool,
+                                                           XAI_POOL_ACQUIRE_TIMEOUT_MS);
+    if (!request_buffer) {
+        xai_client_unlock(conn);
+        return XAI_ERR_NO_MEMORY;
+    }
+    size_t request_len = 0;
+    err = xai_json_build_chat_request(request_buffer->data, request_buffer->capacity,
+                                      &request_len, request->messages, request->message_count,
+                                      options, conn->default_model);
+    slot->outcome.model = (options && options->model) ? options->model : conn->default_model;
+
+    if (err == XAI_OK && options && options->hedge.enabled) {
+        // Not stored: the backup may have answered from another model
+        slot->cacheable = false;
+        err = xai_hedge_chat(conn, request->messages, request->message_count, options,
+                             request_buffer->data, request_len, response, &slot->outcome);
+        xai_buffer_pool_release(conn->buffer_pool, request_buffer);
+        xai_client_unlock(conn);
+        return err;
+    }
+
+    xai_buffer_t *response_data = NULL;
+    size_t response_len = 0;
+    if (err == XAI_OK) {
+        err = xai_http_post(conn->http_client, "/chat/completions", request_buffer->data,
+                            request_len, &response_data, &response_len);
+    }
+    xai_buffer_pool_release(conn->buffer_pool, request_buffer);
+    slot->outcome.start_us = conn->http_client->request_start_us;
+    slot->outcome.first_byte_us = conn->http_client->first_byte_us;
+    slot->outcome.end_us = esp_timer_get_time();
+
+    if (err == XAI_OK) {
+        err = xai_json_parse_chat_response(response_data->data, response);
+        if (err == XAI_OK && slot->cacheable) {
+            slot->body = xai_malloc(response_len);
+            if (slot->body) {
+                memcpy(slot->body, response_data->data, response_len);
+                slot->body_len = response_len;
+            }
+        }
+        xai_buffer_pool_release(conn->buffer_pool, response_data);
+    }
+    xai_client_unlock(conn);
+    return err;
+}
+
+/**
+ * @brief Serve requests on one connection until none are left
+ */
+static void batch_run(batch_job_t *job, struct xai_client_s *conn, uint8_t connection) {
+    for (;;) {
+        size_t i = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed);
+        if (i >= job->count) {
+            return;
+        }
+        if (job->slots[i].done) {
+            continue;
+        }
+
+        xai_batch_result_t *result = &job->results[i];
+        int64_t start = esp_timer_get_time();
+        result->err = batch_send(conn, &job->requests[i], &job->slots[i], &result->response);
+        result->latency_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+        result->connection = connection;
+    }
+}
+
+/**
+ * @brief Store the fresh responses and feed the router, in request order
+ */
+static void batch_record(struct xai_client_s *client, batch_job_t *job) {
+    bool locked = xai_client_lock(client, XAI_ENDPOINT_CHAT, XAI_PRIORITY_NORMAL) == XAI_OK;
+    if (!locked) {
+        ESP_LOGW(TAG, "Client busy; batch outcomes not recorded");
+    }
+    for (size_t i = 0; i < job->count; i++) {
+        batch_slot_t *slot = &job->slots[i];
+        const xai_batch_result_t *result = &job->results[i];
+        if (locked && !slot->done) {
+            xai_router_record_outcome(client, &slot->route, result->err, &slot->outcome,
+                                      result->err == XAI_OK ? result->response.completion_tokens
+                                                            : 0);
+            if (slot->body) {
+                xai_cache_put(client->cache, slot->cache_key, slot->body, slot->body_len);
+            }
+            if (slot->cacheable) {
+                xai_cache_record_latency(client->cache, false,
+                                         (int64_t)result->latency_ms * 1000);
+            }
+        }
+        free(slot->body);
+    }
+    if (locked) {
+        xai_client_unlock(client);
+    }
+}
+
+static void batch_task(void *arg) {
+    batch_worker_t *worker = (batch_worker_t *)arg;
+    batch_run(worker->job, (struct xai_client_s *)worker->client, worker->connection);
+    xSemaphoreGive(worker->job->done);
+    vTaskDelete(NULL);
+}
+
+xai_err_t xai_chat_completion_batch(
+    xai_client_t client,
+    const xai_batch_request_t *requests,
+    size_t count,
+    xai_batch_result_t *results,
+    const xai_batch_options_t *opts
+) {
+    if (!client || !requests || count == 0 || !results) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    struct xai_client_s *client_impl = (struct xai_client_s *)client;
+    if (client_impl->static_storage) {
+        // Each response points into the client's storage, which the next
+        // request of the batch would overwrite
+        ESP_LOGE(TAG, "Batches need a heap client");
+        return XAI_ERR_NOT_SUPPORTED;
+    }
+    memset(results, 0, count * sizeof(xai_batch_result_t));
+    batch_slot_t *slots = xai_calloc(count, sizeof(batch_slot_t));
+    if (!slots) {
+        return XAI_ERR_NO_MEMORY;
+    }
+
+    size_t concurrency = (opts && opts->concurrency) ? opts->concurrency
+                                                     : CONFIG_XAI_BATCH_CONCURRENCY;
+    if (concurrency > BATCH_MAX_CONNECTIONS) {
+        concurrency = BATCH_MAX_CONNECTIONS;
+    }
+
+    batch_job_t job = {
+        .requests = requests,
+        .slots = slots,
+        .results = results,
+        .count = count,
+        .options = opts ? opts->options : NULL,
+    };
+    atomic_init(&job.next, 0);
+    job.done = xSemaphoreCreateCountingStatic(BATCH_MAX_CONNECTIONS, 0, &job.done_buf);
+
+    int64_t start = esp_timer_get_time();
+    batch_lookup(client_impl, &job);
+    size_t pending = 0;
+    for (size_t i = 0; i < count; i++) {
+        pending += slots[i].done ? 0 : 1;
+    }
+    if (concurrency > pending) {
+        concurrency = pending;
+    }
+
+    // Extra connections; the batch goes ahead with however many open
+    batch_worker_t workers[BATCH_MAX_CONNECTIONS];
+    size_t started = 0;
+    if (concurrency > 1) {
+        // Routing and caching stay with the client
+        xai_config_t config = xai_client_config(client_impl);
+        config.cache.enabled = false;
+        config.router.enabled = false;
+        while (started + 1 < concurrency) {
+            batch_worker_t *worker = &workers[started];
+            worker->job = &job;
+            worker->connection = (uint8_t)(started + 1);
+            worker->client = xai_create_config(&config);
+            if (!worker->client) {
+                ESP_LOGW(TAG, "Opened %zu of %zu extra connections", started, concurrency - 1);
+                break;
+            }
+            if (xTaskCreate(batch_task, "xai_batch", CONFIG_XAI_BATCH_TASK_STACK, worker,
+                            uxTaskPriorityGet(NULL), NULL) != pdPASS) {
+                ESP_LOGW(TAG, "Failed to start batch task");
+                xai_destroy(worker->client);
+                break;
+            }
+            started++;
+        }
+    }
+
+    ESP_LOGI(TAG, "Running %zu requests over %zu connections", count, started + 1);
+    batch_run(&job, client_impl, 0);
+
+    for (size_t i = 0; i < started; i++) {
+        xSemaphoreTake(job.done, portMAX_DELAY);
+    }
+    for (size_t i = 0; i < started; i++) {
+        xai_destroy(workers[i].client);
+    }
+    vSemaphoreDelete(job.done);
+    batch_record(client_impl, &job);
+    free(slots);
+
+    xai_batch_stats_t stats = {
+        .connections = (uint32_t)(started + 1),
+        .elapsed_ms = (uint32_t)((esp_timer_get_time() - start) / 1000),
+    };
+    xai_err_t first_err = XAI_OK;
+    for (size_t i = 0; i < count; i++) {
+        if (results[i].err == XAI_OK) {
+            stats.succeeded++;
+        } else {
+            stats.failed++;
+            if (first_err == XAI_OK) {
+                first_err = results[i].err;
+            }
+        }
+        stats.total_latency_ms += results[i].latency_ms;
+        if (results[i].latency_ms > stats.max_latency_ms) {
+            stats.max_latency_ms = results[i].latency_ms;
+        }
+    }
+    if (opts && opts->stats) {
+        *opts->stats = stats;
+    }
+
+    ESP_LOGI(TAG, "Batch done: %" PRIu32 " ok, %" PRIu32 " failed in %" PRIu32 " ms "
+             "(%" PRIu32 " ms sequential)",
+             stats.succeeded, stats.failed, stats.elapsed_ms, stats.total_latency_ms);
+    return first_err;
+}
+
+#define BENCH_PROMPT_SIZE 48
+
+xai_err_t xai_batch_benchmark(const char *api_key, const char *base_url, uint32_t requests,
+                              uint8_t concurrency, xai_batch_bench_t *result) {
+    if (!api_key || requests == 0 || !result) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    // Own client, without cache or router: both passes send every request
+    xai_config_t config = xai_config_default();
+    config.api_key = api_key;
+    if (base_url) {
+        config.base_url = base_url;
+    }
+    xai_client_t client = xai_create_config(&config);
+    xai_message_t *messages = xai_calloc(requests, sizeof(xai_message_t));
+    char (*prompts)[BENCH_PROMPT_SIZE] = xai_calloc(requests, BENCH_PROMPT_SIZE);
+    xai_batch_request_t *batch = xai_calloc(requests, sizeof(xai_batch_request_t));
+    xai_batch_result_t *results = xai_calloc(requests, sizeof(xai_batch_result_t));
+    xai_err_t err = XAI_OK;
+    if (!client || !messages || !prompts || !batch || !results) {
+        err = XAI_ERR_NO_MEMORY;
+        goto cleanup;
+    }
+
+    xai_options_t options = xai_options_default();
+    options.max_tokens = 8;
+    for (uint32_t i = 0; i < requests; i++) {
+        snprintf(prompts[i], BENCH_PROMPT_SIZE, "Reply with the number %" PRIu32 ".", i);
+        messages[i] = (xai_message_t){ .role = XAI_ROLE_USER, .content = prompts[i] };
+        batch[i] = (xai_batch_request_t){ .messages = &messages[i], .message_count = 1 };
+    }
+    memset(result, 0, sizeof(*result));
+    result->requests = requests;
+
+    // The same requests one after another on the client's connection
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < requests; i++) {
+        xai_response_t response;
+        xai_err_t one = xai_chat_completion(client, &messages[i], 1, &options, &response);
+        if (one == XAI_OK) {
+            xai_response_free(&response);
+        } else {
+            result->failed++;
+            err = err == XAI_OK ? one : err;
+        }
+    }
+    result->sequential_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+
+    xai_batch_stats_t stats;
+    xai_batch_options_t opts = { .concurrency = concurrency, .options = &options, .stats = &stats };
+    xai_err_t batch_err = xai_chat_completion_batch(client, batch, requests, results, &opts);
+    for (uint32_t i = 0; i < requests; i++) {
+        if (results[i].err == XAI_OK) {
+            xai_response_free(&results[i].response);
+        }
+    }
+    result->batch_ms = stats.elapsed_ms;
+    result->connections = stats.connections;
+    result->failed += stats.failed;
+    err = err == XAI_OK ? batch_err : err;
+
+    ESP_LOGI(TAG, "Batch benchmark: %" PRIu32 " requests, %" PRIu32 " ms sequential, %" PRIu32
+             " ms over %" PRIu32 " connections", requests, result->sequential_ms,
+             result->batch_ms, result->connections);
+
+cleanup:
+    free(results);
+    free(batch);
+    free(prompts);
+    free(messages);
+    if (client) {
+        xai_destroy(client);
+    }
+    return err;
+}
@@ -0,0 +1,474 @@
+/**
+ * @file xai_buffer_pool.c
+ * @brief Lock-free buffer pool with size classes
+ *
+ * Each size class tracks its free buffers in a 32-bit atomic mask. Acquire
+ * claims the lowest set bit with compare-and-swap; release sets the bit of
+ * the buffer's own index. Neither takes a lock, so tasks on both cores can
+ * acquire and release concurrently in O(1).
+ *
+ * Blocking acquires park on a counting semaphore. Releasers only give it
+ * while someone waits, and a woken acquirer simply retries the masks, so a
+ * stale or extra give costs one spurious retry, never a lost buffer.
+ */
+
+#include "xai_internal.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/task.h"
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+static const char *TAG = "xai_pool";
+
+/**
+ * @brief Sort and check the class configuration into pool->classes
+ */
+static bool pool_set_classes(
+    xai_buffer_pool_t *pool,
+    const xai_buffer_class_config_t *classes,
+    size_t class_count
+) {
+    // Keep classes sorted by size so the first fit is the best fit
+    for (size_t i = 0; i < class_count; i++) {
+        size_t pos = pool->class_count;
+        while (pos > 0 && pool->classes[pos - 1].buffer_size > classes[i].buffer_size) {
+            pool->classes[pos] = pool->classes[pos - 1];
+            pos--;
+        }
+        pool->classes[pos].buffer_size = classes[i].buffer_size;
+        pool->classes[pos].count = classes[i].buffer_count;
+        pool->class_count++;
+    }
+
+    for (size_t c = 0; c < pool->class_count; c++) {
+        xai_buffer_class_t *cls = &pool->classes[c];
+        if (cls->count == 0 || cls->count > XAI_POOL_CLASS_MAX_BUFFERS || cls->buffer_size == 0) {
+            ESP_LOGE(TAG, "Invalid size class: %zu x %zu bytes", cls->count, cls->buffer_size);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Number the buffers of a class and mark them all free
+ */
+static void pool_init_class(xai_buffer_pool_t *pool, size_t c) {
+    xai_buffer_class_t *cls = &pool->classes[c];
+    for (size_t i = 0; i < cls->count; i++) {
+        cls->buffers[i].capacity = cls->buffer_size;
+        cls->buffers[i].size_class = (uint8_t)c;
+        cls->buffers[i].index = (uint8_t)i;
+    }
+
+    uint32_t all = cls->count == 32 ? UINT32_MAX : ((1u << cls->count) - 1);
+    atomic_init(&cls->free_mask, all);
+    pool->buffer_count += cls->count;
+}
+
+static void pool_log_classes(const xai_buffer_pool_t *pool) {
+    for (size_t c = 0; c < pool->class_count; c++) {
+        ESP_LOGI(TAG, "Buffer pool class %zu: %zu buffers of %zu bytes",
+                 c, pool->classes[c].count, pool->classes[c].buffer_size);
+    }
+}
+
+xai_buffer_pool_t* xai_buffer_pool_create_classes(
+    const xai_buffer_class_config_t *classes,
+    size_t class_count
+) {
+    if (!classes || class_count == 0 || class_count > XAI_POOL_MAX_CLASSES) {
+        ESP_LOGE(TAG, "Invalid size class configuration");
+        return NULL;
+    }
+
+    xai_buffer_pool_t *pool = xai_calloc(1, sizeof(xai_buffer_pool_t));
+    if (!pool) {
+        ESP_LOGE(TAG, "Failed to allocate buffer pool");
+        return NULL;
+    }
+
+    if (!pool_set_classes(pool, classes, class_count)) {
+        xai_buffer_pool_destroy(pool);
+        return NULL;
+    }
+
+    for (size_t c = 0; c < pool->class_count; c++) {
+        xai_buffer_class_t *cls = &pool->classes[c];
+        cls->buffers = xai_calloc(cls->count, sizeof(xai_buffer_t));
+        if (!cls->buffers) {
+            ESP_LOGE(TAG, "Failed to allocate buffers");
+            xai_buffer_pool_destroy(pool);
+            return NULL;
+        }
+
+        for (size_t i = 0; i < cls->count; i++) {
+            cls->buffers[i].data = xai_malloc_bulk(cls->buffer_size);
+            if (!cls->buffers[i].data) {
+                ESP_LOGE(TAG, "Failed to allocate buffer %zu (%zu bytes)", i, cls->buffer_size);
+                xai_buffer_pool_destroy(pool);
+                return NULL;
+            }
+        }
+        pool_init_class(pool, c);
+    }
+
+    pool->available = xSemaphoreCreateCounting(pool->buffer_count, 0);
+    if (!pool->available) {
+        ESP_LOGE(TAG, "Failed to create pool semaphore");
+        xai_buffer_pool_destroy(pool);
+        return NULL;
+    }
+
+    pool_log_classes(pool);
+    return pool;
+}
+
+size_t xai_buffer_pool_static_size(const xai_buffer_class_config_t *classes, size_t class_count) {
+    size_t size = XAI_STATIC_SIZE(sizeof(xai_buffer_pool_t));
+    for (size_t i = 0; i < class_count; i++) {
+        size += XAI_STATIC_SIZE(classes[i].buffer_count * sizeof(xai_buffer_t));
+        size += classes[i].buffer_count * XAI_STATIC_SIZE(classes[i].buffer_size);
+    }
+    return size;
+}
+
+xai_buffer_pool_t* xai_buffer_pool_create_static(
+    xai_static_region_t *region,
+    const xai_buffer_class_config_t *classes,
+    size_t class_count
+) {
+    if (!region || !classes || class_count == 0 || class_count > XAI_POOL_MAX_CLASSES) {
+        ESP_LOGE(TAG, "Invalid size class configuration");
+        return NULL;
+    }
+
+    xai_buffer_pool_t *pool = xai_static_take(region, sizeof(xai_buffer_pool_t));
+    if (!pool) {
+        ESP_LOGE(TAG, "No static memory for buffer pool");
+        return NULL;
+    }
+    pool->static_storage = true;
+
+    if (!pool_set_classes(pool, classes, class_count)) {
+        return NULL;
+    }
+
+    for (size_t c = 0; c < pool->class_count; c++) {
+        xai_buffer_class_t *cls = &pool->classes[c];
+        cls->buffers = xai_static_take(region, cls->count * sizeof(xai_buffer_t));
+        if (!cls->buffers) {
+            ESP_LOGE(TAG, "No static memory for buffers");
+            return NULL;
+        }
+        for (size_t i = 0; i < cls->count; i++) {
+            cls->buffers[i].data = xai_static_take(region, cls->buffer_size);
+            if (!cls->buffers[i].data) {
+                ESP_LOGE(TAG, "No static memory for buffer %zu (%zu bytes)", i, cls->buffer_size);
+                return NULL;
+            }
+        }
+        pool_init_class(pool, c);
+    }
+
+    pool->available = xSemaphoreCreateCountingStatic(pool->buffer_count, 0, &pool->available_buf);
+    pool_log_classes(pool);
+    return pool;
+}
+
+xai_buffer_pool_t* xai_buffer_pool_create(size_t buffer_count, size_t buffer_size) {
+    xai_buffer_class_config_t cls = {
+        .buffer_size = buffer_size,
+        .buffer_count = buffer_count,
+    };
+    return xai_buffer_pool_create_classes(&cls, 1);
+}
+
+/**
+ * @brief Claim a free buffer of at least min_size bytes, smallest class first
+ */
+static xai_buffer_t* pool_claim(xai_buffer_pool_t *pool, size_t min_size) {
+    for (size_t c = 0; c < pool->class_count; c++) {
+        xai_buffer_class_t *cls = &pool->classes[c];
+        if (cls->buffer_size < min_size) {
+            continue;
+        }
+
+        uint_fast32_t mask = atomic_load_explicit(&cls->free_mask, memory_order_relaxed);
+        while (mask) {
+            uint_fast32_t bit = mask & (~mask + 1);
+            // On failure mask is reloaded and the lowest free bit recomputed
+            if (atomic_compare_exchange_weak_explicit(&cls->free_mask, &mask, mask & ~bit,
+                                                      memory_order_acquire,
+                                                      memory_order_relaxed)) {
+                xai_buffer_t *buffer = &cls->buffers[__builtin_ctz((unsigned)bit)];
+                buffer->used = 0;
+                return buffer;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Account for a successful claim
+ */
+static void pool_note_acquired(xai_buffer_pool_t *pool) {
+    unsigned in_use = atomic_fetch_add_explicit(&pool->in_use, 1, memory_order_relaxed) + 1;
+    unsigned peak = atomic_load_explicit(&pool->peak_in_use, memory_order_relaxed);
+    while (in_use > peak &&
+           !atomic_compare_exchange_weak_explicit(&pool->peak_in_use, &peak, in_use,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+xai_buffer_t* xai_buffer_pool_acquire_size(
+    xai_buffer_pool_t *pool,
+    size_t min_size,
+    uint32_t timeout_ms
+) {
+    if (!pool) return NULL;
+
+    if (min_size > pool->classes[pool->class_count - 1].buffer_size) {
+        ESP_LOGE(TAG, "No size class holds %zu bytes", min_size);
+        return NULL;
+    }
+
+    // Fast path: lock-free claim
+    xai_buffer_t *buffer = pool_claim(pool, min_size);
+    if (buffer) {
+        atomic_fetch_add_explicit(&pool->hits, 1, memory_order_relaxed);
+        pool_note_acquired(pool);
+        return buffer;
+    }
+
+    if (timeout_ms == 0) {
+        atomic_fetch_add_explicit(&pool->misses, 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    // Slow path: register as a waiter first, so a release that lands after
+    // the retry below is guaranteed to give the semaphore
+    int64_t wait_start = esp_timer_get_time();
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+    atomic_fetch_add_explicit(&pool->waiters, 1, memory_order_seq_cst);
+
+    for (;;) {
+        buffer = pool_claim(pool, min_size);
+        if (buffer) {
+            break;
+        }
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout ||
+            xSemaphoreTake(pool->available, timeout - elapsed) != pdTRUE) {
+            // One last try: a release may have raced the timeout
+            buffer = pool_claim(pool, min_size);
+            break;
+        }
+    }
+
+    atomic_fetch_sub_explicit(&pool->waiters, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pool->wait_ms,
+                              (unsigned)((esp_timer_get_time() - wait_start) / 1000),
+                              memory_order_relaxed);
+
+    if (!buffer) {
+        atomic_fetch_add_explicit(&pool->misses, 1, memory_order_relaxed);
+        ESP_LOGW(TAG, "No available buffers in pool (waited %" PRIu32 " ms)", timeout_ms);
+        return NULL;
+    }
+
+    atomic_fetch_add_explicit(&pool->waits, 1, memory_order_relaxed);
+    pool_note_acquired(pool);
+    return buffer;
+}
+
+xai_buffer_t* xai_buffer_pool_acquire(xai_buffer_pool_t *pool, uint32_t timeout_ms) {
+    if (!pool) return NULL;
+    return xai_buffer_pool_acquire_size(pool, pool->classes[pool->class_count - 1].buffer_size,
+                                        timeout_ms);
+}
+
+void xai_buffer_pool_release(xai_buffer_pool_t *pool, xai_buffer_t *buffer) {
+    if (!pool || !buffer) return;
+
+    // The buffer carries its own position: no search
+    xai_buffer_class_t *cls = buffer->size_class < pool->class_count
+        ? &pool->classes[buffer->size_class] : NULL;
+    if (!cls || buffer->index >= cls->count || &cls->buffers[buffer->index] != buffer) {
+        ESP_LOGE(TAG, "Release of a buffer not owned by this pool");
+        return;
+    }
+
+    buffer->used = 0;
+
+    // Count down before the bit frees, so in_use never exceeds the pool size
+    atomic_fetch_sub_explicit(&pool->in_use, 1, memory_order_relaxed);
+    uint_fast32_t bit = (uint_fast32_t)1 << buffer->index;
+    uint_fast32_t prev = atomic_fetch_or_explicit(&cls->free_mask, bit, memory_order_release);
+    if (prev & bit) {
+        atomic_fetch_add_explicit(&pool->in_use, 1, memory_order_relaxed);
+        ESP_LOGW(TAG, "Buffer released twice");
+        return;
+    }
+
+    // Pairs with the waiter registration in acquire
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&pool->waiters, memory_order_relaxed) > 0) {
+        xSemaphoreGive(pool->available);
+    }
+}
+
+void xai_buffer_pool_destroy(xai_buffer_pool_t *pool) {
+    if (!pool) return;
+
+    if (pool->static_storage) {
+        // Buffers belong to the caller's memory
+        if (pool->available) {
+            vSemaphoreDelete(pool->available);
+        }
+        return;
+    }
+
+    for (size_t c = 0; c < pool->class_count; c++) {
+        xai_buffer_class_t *cls = &pool->classes[c];
+        if (cls->buffers) {
+            for (size_t i = 0; i < cls->count; i++) {
+                heap_caps_free(cls->buffers[i].data);
+            }
+            free(cls->buffers);
+        }
+    }
+
+    if (pool->available) {
+        vSemaphoreDelete(pool->available);
+    }
+
+    free(pool);
+}
+
+xai_err_t xai_get_buffer_pool_stats(xai_client_t client, xai_buffer_pool_stats_t *stats) {
+    if (!client || !stats) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    xai_buffer_pool_t *pool = ((struct xai_client_s *)client)->buffer_pool;
+    stats->buffer_count = pool->buffer_count;
+    stats->buffer_size = pool->classes[pool->class_count - 1].buffer_size;
+    stats->in_use = atomic_load(&pool->in_use);
+    stats->peak_in_use = atomic_load(&pool->peak_in_use);
+    stats->hits = atomic_load(&pool->hits);
+    stats->waits = atomic_load(&pool->waits);
+    stats->misses = atomic_load(&pool->misses);
+    stats->wait_ms = atomic_load(&pool->wait_ms);
+    return XAI_OK;
+}
+
+// ============================================================================
+// Benchmark
+// ============================================================================
+
+#define BENCH_BUFFERS       2
+#define BENCH_BUFFER_SIZE   256
+#define BENCH_TASKS_PER_CORE 2
+
+typedef struct {
+    xai_buffer_pool_t *pool;
+    SemaphoreHandle_t done;
+    uint32_t iterations;
+    uint32_t ops;
+    int64_t elapsed_us;
+    int64_t max_us;
+} pool_bench_task_t;
+
+static void pool_bench_task(void *arg) {
+    pool_bench_task_t *t = (pool_bench_task_t *)arg;
+
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < t->iterations; i++) {
+        int64_t t0 = esp_timer_get_time();
+        xai_buffer_t *buffer = xai_buffer_pool_acquire(t->pool, 1000);
+        if (buffer) {
+            buffer->data[0] = (char)i;
+            xai_buffer_pool_release(t->pool, buffer);
+            t->ops++;
+        }
+        int64_t dt = esp_timer_get_time() - t0;
+        if (dt > t->max_us) {
+            t->max_us = dt;
+        }
+    }
+    t->elapsed_us = esp_timer_get_time() - start;
+
+    xSemaphoreGive(t->done);
+    vTaskDelete(NULL);
+}
+
+xai_err_t xai_buffer_pool_benchmark(uint32_t iterations, xai_buffer_pool_bench_t *result) {
+    if (iterations == 0 || !result) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    const uint32_t task_count = BENCH_TASKS_PER_CORE * portNUM_PROCESSORS;
+    xai_buffer_pool_t *pool = xai_buffer_pool_create(BENCH_BUFFERS, BENCH_BUFFER_SIZE);
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(task_count, 0);
+    pool_bench_task_t *tasks = xai_calloc(task_count, sizeof(pool_bench_task_t));
+    xai_err_t err = XAI_OK;
+    uint32_t started = 0;
+
+    if (!pool || !done || !tasks) {
+        err = XAI_ERR_NO_MEMORY;
+        goto cleanup;
+    }
+
+    for (uint32_t i = 0; i < task_count; i++) {
+        tasks[i].pool = pool;
+        tasks[i].done = done;
+        tasks[i].iterations = iterations;
+        if (xTaskCreatePinnedToCore(pool_bench_task, "xai_pool_bench", 3072, &tasks[i],
+                                    tskIDLE_PRIORITY + 5, NULL,
+                                    i % portNUM_PROCESSORS) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to start benchmark task %" PRIu32, i);
+            err = XAI_ERR_NO_MEMORY;
+            break;
+        }
+        started++;
+    }
+
+    for (uint32_t i = 0; i < started; i++) {
+        xSemaphoreTake(done, portMAX_DELAY);
+    }
+    if (err != XAI_OK) {
+        goto cleanup;
+    }
+
+    memset(result, 0, sizeof(*result));
+    result->tasks = task_count;
+    int64_t total_us = 0;
+    for (uint32_t i = 0; i < task_count; i++) {
+        result->ops += tasks[i].ops;
+        total_us += tasks[i].elapsed_us;
+        if (tasks[i].max_us > result->max_us) {
+            result->max_us = (uint32_t)tasks[i].max_us;
+        }
+    }
+    result->avg_ns = (uint32_t)(total_us * 1000 / ((int64_t)iterations * task_count));
+    result->waits = atomic_load(&pool->waits);
+    result->misses = atomic_load(&pool->misses);
+
+    ESP_LOGI(TAG, "Pool benchmark: %" PRIu32 " tasks, %" PRIu32 " ops, avg %" PRIu32
+             " ns, max %" PRIu32 " us, %" PRIu32 " waits, %" PRIu32 " misses",
+             result->tasks, result->ops, result->avg_ns, result->max_us,
+             result->waits, result->misses);
+
+cleanup:
+    free(tasks);
+    if (done) {
+        vSemaphoreDelete(done);
+    }
+    xai_buffer_pool_destroy(pool);
+    return err;
+}
@@ -0,0 +1,473 @@
+/**
+ * @file xai_cache.c
+ * @brief Response cache for deterministic chat requests
+ *
+ * Fixed prompts at temperature 0 - help text, canned explanations,
+ * classification of recurring inputs - get the same answer every time,
+ * yet each one cost a full round trip. The cache keys a response by a
+ * hash of the request body as sent, which already holds the resolved
+ * model, every message and every option in a fixed field order. Bodies
+ * live in an LRU RAM tier and, optionally, as files on a mounted
+ * LittleFS/FAT volume so they survive a reboot; a file hit is promoted to
+ * RAM. Both tiers have a byte cap and share one TTL.
+ */
+
+#include "sdkconfig.h"
+#include "xai_internal.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+static const char *TAG = "xai_cache";
+
+#ifndef CONFIG_XAI_CACHE_RAM_SIZE
+#define CONFIG_XAI_CACHE_RAM_SIZE 16384
+#endif
+
+#ifndef CONFIG_XAI_CACHE_TTL_S
+#define CONFIG_XAI_CACHE_TTL_S 3600
+#endif
+
+#ifndef CONFIG_XAI_CACHE_FS_SIZE
+#define CONFIG_XAI_CACHE_FS_SIZE 262144
+#endif
+
+#define CACHE_FILE_MAGIC  0x31435258    /* "XRC1" */
+#define CACHE_FILE_EXT    ".xrc"
+#define CACHE_PATH_MAX    128
+
+/**
+ * @brief Header of a file tier entry, followed by the body
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t len;                   /**< Body bytes */
+    uint64_t key;                   /**< Full key; the file name only holds 32 bits */
+    int64_t written;                /**< Wall-clock seconds (time()) */
+} cache_file_header_t;
+
+uint64_t xai_cache_key(const char *body, size_t len) {
+    // FNV-1a, 64 bit
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)body[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// ============================================================================
+// RAM tier
+// ============================================================================
+
+static size_t cache_entry_size(size_t len) {
+    return sizeof(xai_cache_entry_t) + len + 1;
+}
+
+static void cache_unlink(xai_cache_t *cache, xai_cache_entry_t *entry) {
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        cache->head = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        cache->tail = entry->prev;
+    }
+    entry->prev = entry->next = NULL;
+}
+
+static void cache_push_front(xai_cache_t *cache, xai_cache_entry_t *entry) {
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head) {
+        cache->head->prev = entry;
+    } else {
+        cache->tail = entry;
+    }
+    cache->head = entry;
+}
+
+static void cache_ram_drop(xai_cache_t *cache, xai_cache_entry_t *entry) {
+    cache_unlink(cache, entry);
+    cache->stats.ram_bytes -= cache_entry_size(entry->len);
+    cache->stats.ram_entries--;
+    heap_caps_free(entry);
+}
+
+static xai_cache_entry_t* cache_ram_find(xai_cache_t *cache, uint64_t key) {
+    for (xai_cache_entry_t *entry = cache->head; entry; entry = entry->next) {
+        if (entry->key == key) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static xai_cache_entry_t* cache_ram_put(xai_cache_t *cache, uint64_t key, const char *body,
+                                        size_t len, int64_t expires_us) {
+    xai_cache_entry_t *old = cache_ram_find(cache, key);
+    if (old) {
+        cache_ram_drop(cache, old);
+    }
+
+    size_t size = cache_entry_size(len);
+    if (size > cache->ram_capacity) {
+        return NULL;
+    }
+    while (cache->tail && cache->stats.ram_bytes + size > cache->ram_capacity) {
+        cache_ram_drop(cache, cache->tail);
+        cache->stats.evictions++;
+    }
+
+    xai_cache_entry_t *entry = xai_malloc_bulk(size);
+    if (!entry) {
+        ESP_LOGW(TAG, "No memory to cache a %zu byte response", len);
+        return NULL;
+    }
+    entry->key = key;
+    entry->expires_us = expires_us;
+    entry->len = len;
+    memcpy(entry->data, body, len);
+    entry->data[len] = '\0';
+
+    cache_push_front(cache, entry);
+    cache->stats.ram_bytes += size;
+    cache->stats.ram_entries++;
+    return entry;
+}
+
+// ============================================================================
+// File tier
+// ============================================================================
+
+static void cache_file_path(const xai_cache_t *cache, uint64_t key, char *path, size_t size) {
+    // 8.3 name: FAT volumes without long file name support
+    snprintf(path, size, "%s/%08" PRIx32 CACHE_FILE_EXT, cache->fs_path, (uint32_t)key);
+}
+
+static bool cache_is_entry_file(const char *name) {
+    size_t len = strlen(name);
+    size_t ext = strlen(CACHE_FILE_EXT);
+    return len > ext && strcasecmp(name + len - ext, CACHE_FILE_EXT) == 0;
+}
+
+static size_t cache_file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+static void cache_file_remove(xai_cache_t *cache, const char *path) {
+    size_t size = cache_file_size(path);
+    if (remove(path) == 0) {
+        cache->stats.fs_bytes -= size < cache->stats.fs_bytes ? size : cache->stats.fs_bytes;
+    }
+}
+
+/**
+ * @brief Visit every entry file in the cache directory
+ *
+ * @return false if the directory could not be read
+ */
+static bool cache_fs_walk(xai_cache_t *cache, void (*visit)(xai_cache_t *, const char *, void *),
+                          void *ctx) {
+    DIR *dir = opendir(cache->fs_path);
+    if (!dir) {
+        return false;
+    }
+    char path[CACHE_PATH_MAX];
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        if (cache_is_entry_file(de->d_name)) {
+            snprintf(path, sizeof(path), "%s/%s", cache->fs_path, de->d_name);
+            visit(cache, path, ctx);
+        }
+    }
+    closedir(dir);
+    return true;
+}
+
+static void cache_fs_count(xai_cache_t *cache, const char *path, void *ctx) {
+    cache->stats.fs_bytes += cache_file_size(path);
+}
+
+typedef struct {
+    char path[CACHE_PATH_MAX];
+    time_t mtime;
+    bool found;
+} cache_oldest_t;
+
+static void cache_fs_find_oldest(xai_cache_t *cache, const char *path, void *ctx) {
+    cache_oldest_t *oldest = (cache_oldest_t *)ctx;
+    struct stat st;
+    if (stat(path, &st) == 0 && (!oldest->found || st.st_mtime < oldest->mtime)) {
+        snprintf(oldest->path, sizeof(oldest->path), "%s", path);
+        oldest->mtime = st.st_mtime;
+        oldest->found = true;
+    }
+}
+
+static void cache_fs_remove_visit(xai_cache_t *cache, const char *path, void *ctx) {
+    cache_file_remove(cache, path);
+}
+
+/**
+ * @brief Read a file tier entry into scratch
+ *
+ * @param remaining_s Output: seconds the entry still has to live
+ */
+static const char* cache_fs_get(xai_cache_t *cache, uint64_t key, xai_buffer_t *scratch,
+                                int64_t *remaining_s) {
+    char path[CACHE_PATH_MAX];
+    cache_file_path(cache, key, path, sizeof(path));
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+
+    cache_file_header_t header;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+              header.magic == CACHE_FILE_MAGIC && header.key == key &&
+              header.len < scratch->capacity;
+    if (ok) {
+        // A clock that went backwards makes the entry stale too
+        int64_t age = (int64_t)time(NULL) - header.written;
+        int64_t ttl_s = cache->ttl_us / 1000000;
+        if (age < 0 || age >= ttl_s) {
+            fclose(f);
+            cache_file_remove(cache, path);
+            cache->stats.expired++;
+            return NULL;
+        }
+        *remaining_s = ttl_s - age;
+        ok = fread(scratch->data, 1, header.len, f) == header.len;
+    }
+    fclose(f);
+
+    if (!ok) {
+        // Another key's file under the same name, or a torn write
+        return NULL;
+    }
+    scratch->data[header.len] = '\0';
+    scratch->used = header.len;
+    return scratch->data;
+}
+
+static void cache_fs_put(xai_cache_t *cache, uint64_t key, const char *body, size_t len) {
+    size_t size = sizeof(cache_file_header_t) + len;
+    if (size > cache->fs_capacity) {
+        return;
+    }
+
+    char path[CACHE_PATH_MAX];
+    cache_file_path(cache, key, path, sizeof(path));
+    cache_file_remove(cache, path);
+
+    while (cache->stats.fs_bytes + size > cache->fs_capacity) {
+        cache_oldest_t oldest = { .found = false };
+        cache_fs_walk(cache, cache_fs_find_oldest, &oldest);
+        if (!oldest.found) {
+            break;
+        }
+        cache_file_remove(cache, oldest.path);
+        cache->stats.evictions++;
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        ESP_LOGW(TAG, "Cannot write %s (errno %d)", path, errno);
+        return;
+    }
+    cache_file_header_t header = {
+        .magic = CACHE_FILE_MAGIC,
+        .len = (uint32_t)len,
+        .key = key,
+        .written = (int64_t)time(NULL),
+    };
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(body, 1, len, f) == len;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        ESP_LOGW(TAG, "Failed to write %s", path);
+        remove(path);
+        return;
+    }
+    cache->stats.fs_bytes += size;
+}
+
+// ============================================================================
+// Cache API
+// ============================================================================
+
+xai_cache_t* xai_cache_create(const xai_cache_config_t *config) {
+    xai_cache_t *cache = xai_calloc(1, sizeof(xai_cache_t));
+    if (!cache) {
+        ESP_LOGE(TAG, "Failed to allocate cache");
+        return NULL;
+    }
+
+    cache->ram_capacity = config->ram_bytes ? config->ram_bytes : CONFIG_XAI_CACHE_RAM_SIZE;
+    uint32_t ttl_s = config->ttl_s ? config->ttl_s : CONFIG_XAI_CACHE_TTL_S;
+    cache->ttl_us = (int64_t)ttl_s * 1000000;
+    cache->allow_sampled = config->allow_sampled;
+
+    if (config->fs_path) {
+        cache->fs_path = xai_strdup(config->fs_path);
+        if (!cache->fs_path) {
+            ESP_LOGE(TAG, "Failed to copy cache path");
+            free(cache);
+            return NULL;
+        }
+        cache->fs_capacity = config->fs_bytes ? config->fs_bytes : CONFIG_XAI_CACHE_FS_SIZE;
+        if (mkdir(cache->fs_path, 0775) != 0 && errno != EEXIST) {
+            ESP_LOGW(TAG, "Cannot create %s (errno %d)", cache->fs_path, errno);
+        }
+        // Entries left by an earlier boot count towards the cap
+        if (!cache_fs_walk(cache, cache_fs_count, NULL)) {
+            ESP_LOGW(TAG, "Cannot read %s; file tier disabled", cache->fs_path);
+            free(cache->fs_path);
+            cache->fs_path = NULL;
+        }
+    }
+
+    ESP_LOGI(TAG, "Response cache: %zu bytes RAM, %zu bytes in %s, TTL %" PRIu32 " s",
+             cache->ram_capacity, cache->fs_capacity,
+             cache->fs_path ? cache->fs_path : "(no file tier)", ttl_s);
+    return cache;
+}
+
+xai_cache_config_t xai_cache_config(const xai_cache_t *cache) {
+    xai_cache_config_t config = {0};
+    if (!cache) {
+        return config;
+    }
+
+    config.enabled = true;
+    config.ram_bytes = cache->ram_capacity;
+    config.ttl_s = (uint32_t)(cache->ttl_us / 1000000);
+    config.fs_path = cache->fs_path;
+    config.fs_bytes = cache->fs_capacity;
+    config.allow_sampled = cache->allow_sampled;
+    return config;
+}
+
+void xai_cache_destroy(xai_cache_t *cache) {
+    if (!cache) {
+        return;
+    }
+
+    while (cache->head) {
+        cache_ram_drop(cache, cache->head);
+    }
+    free(cache->fs_path);
+    free(cache);
+}
+
+bool xai_cache_usable(xai_cache_t *cache, const xai_options_t *options) {
+    if (!cache) {
+        return false;
+    }
+
+    xai_cache_mode_t mode = options ? options->cache : XAI_CACHE_DEFAULT;
+    // An omitted temperature means the server's default, which samples
+    bool deterministic = options && options->temperature == 0.0f;
+    if (mode == XAI_CACHE_BYPASS ||
+        (!deterministic && !cache->allow_sampled && mode != XAI_CACHE_SAMPLED)) {
+        cache->stats.skipped++;
+        return false;
+    }
+    return true;
+}
+
+const char* xai_cache_get(xai_cache_t *cache, uint64_t key, xai_buffer_t *scratch) {
+    int64_t now = esp_timer_get_time();
+
+    xai_cache_entry_t *entry = cache_ram_find(cache, key);
+    if (entry && now >= entry->expires_us) {
+        cache_ram_drop(cache, entry);
+        cache->stats.expired++;
+        entry = NULL;
+    }
+    if (entry) {
+        cache_unlink(cache, entry);
+        cache_push_front(cache, entry);
+        cache->stats.ram_hits++;
+        return entry->data;
+    }
+
+    int64_t remaining_s = 0;
+    const char *body = cache->fs_path ? cache_fs_get(cache, key, scratch, &remaining_s) : NULL;
+    if (body) {
+        cache->stats.fs_hits++;
+        cache_ram_put(cache, key, body, scratch->used, now + remaining_s * 1000000);
+        return body;
+    }
+
+    cache->stats.misses++;
+    return NULL;
+}
+
+void xai_cache_put(xai_cache_t *cache, uint64_t key, const char *body, size_t len) {
+    cache_ram_put(cache, key, body, len, esp_timer_get_time() + cache->ttl_us);
+    if (cache->fs_path) {
+        cache_fs_put(cache, key, body, len);
+    }
+    cache->stats.stores++;
+}
+
+void xai_cache_record_latency(xai_cache_t *cache, bool hit, int64_t us) {
+    if (hit) {
+        cache->stats.hit_us += us;
+    } else {
+        cache->stats.miss_us += us;
+    }
+}
+
+xai_err_t xai_get_cache_stats(xai_client_t client, xai_cache_stats_t *stats) {
+    if (!client || !stats) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    struct xai_client_s *impl = (struct xai_client_s *)client;
+    if (!impl->cache) {
+        return XAI_ERR_NOT_SUPPORTED;
+    }
+    if (xSemaphoreTake(impl->mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        return XAI_ERR_TIMEOUT;
+    }
+    *stats = impl->cache->stats;
+    xSemaphoreGive(impl->mutex);
+    return XAI_OK;
+}
+
+xai_err_t xai_cache_clear(xai_client_t client) {
+    if (!client) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    struct xai_client_s *impl = (struct xai_client_s *)client;
+    xai_cache_t *cache = impl->cache;
+    if (!cache) {
+        return XAI_ERR_NOT_SUPPORTED;
+    }
+    if (xSemaphoreTake(impl->mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        return XAI_ERR_TIMEOUT;
+    }
+    while (cache->head) {
+        cache_ram_drop(cache, cache->head);
+    }
+    if (cache->fs_path) {
+        cache_fs_walk(cache, cache_fs_remove_visit, NULL);
+    }
+    xSemaphoreGive(impl->mutex);
+    return XAI_OK;
+}
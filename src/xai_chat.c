@@ -14,6 +14,28 @@
 
 static const char *TAG = "xai_chat";
 
+/**
+ * @brief Reject a request its model cannot serve before queueing for the
+ *        connection
+ */
+static xai_err_t chat_validate(
+    struct xai_client_s *client_impl,
+    const xai_message_t *messages,
+    size_t message_count,
+    const xai_options_t *options
+) {
+#ifdef CONFIG_XAI_VALIDATE_OPTIONS
+    const char *model = (options && options->model) ? options->model : client_impl->default_model;
+    return xai_validate_options(model, messages, message_count, options);
+#else
+    (void)client_impl;
+    (void)messages;
+    (void)message_count;
+    (void)options;
+    return XAI_OK;
+#endif
+}
+
 /* ========================================================================
  * Synchronous Chat Completion
  * ======================================================================== */
@@ -31,27 +53,38 @@ xai_err_t xai_chat_completion(
     }
 
     struct xai_client_s *client_impl = (struct xai_client_s *)client;
-    xai_err_t err = XAI_OK;
+    xai_options_t routed_options;
+    xai_route_decision_t route;
+    options = xai_router_route(client_impl, messages, message_count, options,
+                               &routed_options, &route);
+    xai_err_t err = chat_validate(client_impl, messages, message_count, options);
+    if (err != XAI_OK) {
+        return err;
+    }
+    int64_t start_us = esp_timer_get_time();
 
     // Acquire client mutex
-    if (xSemaphoreTake(client_impl->mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
-        ESP_LOGE(TAG, "Failed to acquire mutex");
-        return XAI_ERR_TIMEOUT;
+    err = xai_client_lock(client_impl, XAI_ENDPOINT_CHAT,
+                          options ? options->priority : XAI_PRIORITY_NORMAL);
+    if (err != XAI_OK) {
+        ESP_LOGE(TAG, "Failed to start request: %s", xai_err_to_string(err));
+        return err;
     }
 
-    // Allocate request buffer (16KB should be enough for most requests)
-    char *request_buffer = malloc(16384);
+    // Request body goes into a pool buffer (CONFIG_XAI_MAX_RESPONSE_SIZE bytes)
+    xai_buffer_t *request_buffer = xai_buffer_pool_acquire(client_impl->buffer_pool,
+                                                           XAI_POOL_ACQUIRE_TIMEOUT_MS);
     if (!request_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate request buffer");
-        xSemaphoreGive(client_impl->mutex);
+        ESP_LOGE(TAG, "No request buffer available");
+        xai_client_unlock(client_impl);
         return XAI_ERR_NO_MEMORY;
     }
 
     // Build JSON request
     size_t request_len = 0;
     err = xai_json_build_chat_request(
-        request_buffer,
-        16384,
+        request_buffer->data,
+        request_buffer->capacity,
         &request_len,
         messages,
         message_count,
@@ -61,44 +94,87 @@ xai_err_t xai_chat_completion(
 
     if (err != XAI_OK) {
         ESP_LOGE(TAG, "Failed to build request: %d", err);
-        free(request_buffer);
-        xSemaphoreGive(client_impl->mutex);
+        xai_buffer_pool_release(client_impl->buffer_pool, request_buffer);
+        xai_client_unlock(client_impl);
         return err;
     }
 
+    // The body as sent is the canonical form of the request
+    bool cacheable = xai_cache_usable(client_impl->cache, options);
+    uint64_t cache_key = cacheable ? xai_cache_key(request_buffer->data, request_len) : 0;
+    if (cacheable && (!options || options->cache != XAI_CACHE_REFRESH)) {
+        // A file hit is read over the request body, which is no longer needed
+        const char *cached = xai_cache_get(client_impl->cache, cache_key, request_buffer);
+        if (cached) {
+            err = xai_json_parse_chat_response(cached, response);
+            xai_buffer_pool_release(client_impl->buffer_pool, request_buffer);
+            xai_cache_record_latency(client_impl->cache, true, esp_timer_get_time() - start_us);
+            xai_client_unlock(client_impl);
+            ESP_LOGI(TAG, "Chat completion answered from cache");
+            return err;
+        }
+    }
+
     ESP_LOGI(TAG, "Sending chat completion request (%zu bytes)", request_len);
-    ESP_LOGD(TAG, "Request JSON: %.*s", (int)request_len, request_buffer);
+    ESP_LOGD(TAG, "Request JSON: %.*s", (int)request_len, request_buffer->data);
+
+    // Hedged: a backup may answer instead; needs heap for its connection
+    if (options && options->hedge.enabled && !client_impl->static_storage) {
+        xai_request_outcome_t outcome;
+        err = xai_hedge_chat(client_impl, messages, message_count, options,
+                             request_buffer->data, request_len, response, &outcome);
+        xai_buffer_pool_release(client_impl->buffer_pool, request_buffer);
+        if (cacheable) {
+            // Not stored: the backup may have answered from another model
+            xai_cache_record_latency(client_impl->cache, false, esp_timer_get_time() - start_us);
+        }
+        xai_router_record_outcome(client_impl, &route, err, &outcome,
+                                err == XAI_OK ? response->completion_tokens : 0);
+        xai_client_unlock(client_impl);
+        if (err != XAI_OK) {
+            ESP_LOGE(TAG, "Hedged chat completion failed: %d", err);
+        }
+        return err;
+    }
 
     // Send HTTP POST request
-    char *response_data = NULL;
+    xai_buffer_t *response_data = NULL;
     size_t response_len = 0;
     err = xai_http_post(
         client_impl->http_client,
         "/chat/completions",
-        request_buffer,
+        request_buffer->data,
         request_len,
         &response_data,
         &response_len
     );
 
-    free(request_buffer);
+    xai_buffer_pool_release(client_impl->buffer_pool, request_buffer);
+    xai_hedge_record_ttfb(client_impl);
 
     if (err != XAI_OK) {
         ESP_LOGE(TAG, "HTTP request failed: %d", err);
-        xSemaphoreGive(client_impl->mutex);
+        xai_router_record(client_impl, &route, err, false, 0);
+        xai_client_unlock(client_impl);
         return err;
     }
 
     ESP_LOGI(TAG, "Received response (%zu bytes)", response_len);
-    ESP_LOGD(TAG, "Response JSON: %.*s", (int)response_len, response_data);
+    ESP_LOGD(TAG, "Response JSON: %.*s", (int)response_len, response_data->data);
 
     // Parse JSON response
-    err = xai_json_parse_chat_response(response_data, response);
+    err = xai_json_parse_chat_response(response_data->data, response);
+    if (cacheable && err == XAI_OK) {
+        xai_cache_put(client_impl->cache, cache_key, response_data->data, response_len);
+        xai_cache_record_latency(client_impl->cache, false, esp_timer_get_time() - start_us);
+    }
 
-    // Free response buffer (parser makes copies of needed data)
-    free(response_data);
+    // Return response buffer (parser makes copies of needed data)
+    xai_buffer_pool_release(client_impl->buffer_pool, response_data);
 
-    xSemaphoreGive(client_impl->mutex);
+    xai_router_record(client_impl, &route, err, false,
+                      err == XAI_OK ? response->completion_tokens : 0);
+    xai_client_unlock(client_impl);
 
     if (err != XAI_OK) {
         ESP_LOGE(TAG, "Failed to parse response: %d", err);
@@ -115,6 +191,62 @@ xai_err_t xai_chat_completion(
  * Streaming Chat Completion
  * ======================================================================== */
 
+/**
+ * @brief Build a chat request body with stream=true into a pool buffer
+ *
+ * The caller returns *out_buffer to client_impl->buffer_pool.
+ */
+static xai_err_t chat_build_stream_request(
+    struct xai_client_s *client_impl,
+    const xai_message_t *messages,
+    size_t message_count,
+    const xai_options_t *options,
+    xai_options_t *stream_options,
+    xai_buffer_t **out_buffer,
+    size_t *out_len
+) {
+    // Create modified options with stream=true
+    if (options) {
+        memcpy(stream_options, options, sizeof(xai_options_t));
+    } else {
+        memset(stream_options, 0, sizeof(xai_options_t));
+    }
+    stream_options->stream = true;
+
+    xai_buffer_t *request_buffer = xai_buffer_pool_acquire(client_impl->buffer_pool,
+                                                           XAI_POOL_ACQUIRE_TIMEOUT_MS);
+    if (!request_buffer) {
+        ESP_LOGE(TAG, "No request buffer available");
+        return XAI_ERR_NO_MEMORY;
+    }
+
+    // Build JSON request
+    size_t request_len = 0;
+    xai_err_t err = xai_json_build_chat_request(
+        request_buffer->data,
+        request_buffer->capacity,
+        &request_len,
+        messages,
+        message_count,
+        stream_options,
+        client_impl->default_model
+    );
+
+    if (err != XAI_OK) {
+        ESP_LOGE(TAG, "Failed to build request: %d", err);
+        xai_buffer_pool_release(client_impl->buffer_pool, request_buffer);
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Sending streaming chat completion request (%zu bytes)", request_len);
+    ESP_LOGI(TAG, "Request body: %.*s", (int)request_len, request_buffer->data);  // Temporarily INFO for debugging
+
+    client_impl->http_client->pipeline_mode = stream_options->stream_pipeline;
+    *out_buffer = request_buffer;
+    *out_len = request_len;
+    return XAI_OK;
+}
+
 xai_err_t xai_chat_completion_stream(
     xai_client_t client,
     const xai_message_t *messages,
@@ -129,65 +261,146 @@ xai_err_t xai_chat_completion_stream(
     }
 
     struct xai_client_s *client_impl = (struct xai_client_s *)client;
-    xai_err_t err = XAI_OK;
+    xai_options_t routed_options;
+    xai_route_decision_t route;
+    options = xai_router_route(client_impl, messages, message_count, options,
+                               &routed_options, &route);
+    xai_err_t err = chat_validate(client_impl, messages, message_count, options);
+    if (err != XAI_OK) {
+        return err;
+    }
 
     // Acquire client mutex
-    if (xSemaphoreTake(client_impl->mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
-        ESP_LOGE(TAG, "Failed to acquire mutex");
-        return XAI_ERR_TIMEOUT;
+    err = xai_client_lock(client_impl, XAI_ENDPOINT_CHAT_STREAM,
+                          options ? options->priority : XAI_PRIORITY_NORMAL);
+    if (err != XAI_OK) {
+        ESP_LOGE(TAG, "Failed to start request: %s", xai_err_to_string(err));
+        return err;
     }
 
-    // Create modified options with stream=true
     xai_options_t stream_options;
-    if (options) {
-        memcpy(&stream_options, options, sizeof(xai_options_t));
-    } else {
-        memset(&stream_options, 0, sizeof(xai_options_t));
+    xai_buffer_t *request_buffer = NULL;
+    size_t request_len = 0;
+    err = chat_build_stream_request(client_impl, messages, message_count, options,
+                                    &stream_options, &request_buffer, &request_len);
+    if (err != XAI_OK) {
+        xai_client_unlock(client_impl);
+        return err;
     }
-    stream_options.stream = true;
 
-    // Allocate request buffer
-    char *request_buffer = malloc(16384);
-    if (!request_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate request buffer");
-        xSemaphoreGive(client_impl->mutex);
-        return XAI_ERR_NO_MEMORY;
+    // Optional coalescing stage between the SSE parser and the callback
+    xai_stream_callback_t deliver_cb = callback;
+    void *deliver_data = user_data;
+    bool coalescing = false;
+#ifdef CONFIG_XAI_ENABLE_STREAMING
+    if (xai_stream_coalesce_enabled(&stream_options.stream_coalesce)) {
+        if (client_impl->static_storage) {
+            // The coalescer's timer and buffer would be heap allocations
+            ESP_LOGE(TAG, "Stream coalescing is not available on static clients");
+            xai_buffer_pool_release(client_impl->buffer_pool, request_buffer);
+            xai_client_unlock(client_impl);
+            return XAI_ERR_NOT_SUPPORTED;
+        }
+        if (!client_impl->coalescer) {
+            client_impl->coalescer = xai_stream_coalescer_create();
+        }
+        if (!client_impl->coalescer ||
+            xai_stream_coalescer_begin(client_impl->coalescer, &stream_options.stream_coalesce,
+                                       callback, user_data) != XAI_OK) {
+            ESP_LOGE(TAG, "Failed to set up stream coalescing");
+            xai_buffer_pool_release(client_impl->buffer_pool, request_buffer);
+            xai_client_unlock(client_impl);
+            return XAI_ERR_NO_MEMORY;
+        }
+        deliver_cb = xai_stream_coalescer_feed;
+        deliver_data = client_impl->coalescer;
+        coalescing = true;
     }
+#endif
 
-    // Build JSON request
-    size_t request_len = 0;
-    err = xai_json_build_chat_request(
-        request_buffer,
-        16384,
-        &request_len,
-        messages,
-        message_count,
-        &stream_options,
-        client_impl->default_model
+    // Send streaming HTTP POST request
+    err = xai_http_post_stream(
+        client_impl->http_client,
+        "/chat/completions",
+        request_buffer->data,
+        request_len,
+        deliver_cb,
+        deliver_data
     );
 
+#ifdef CONFIG_XAI_ENABLE_STREAMING
+    if (coalescing) {
+        xai_stream_coalescer_end(client_impl->coalescer);
+    }
+#endif
+
+    xai_buffer_pool_release(client_impl->buffer_pool, request_buffer);
+    xai_router_record(client_impl, &route, err, true, 0);
+    xai_client_unlock(client_impl);
+
     if (err != XAI_OK) {
-        ESP_LOGE(TAG, "Failed to build request: %d", err);
-        free(request_buffer);
-        xSemaphoreGive(client_impl->mutex);
+        ESP_LOGE(TAG, "Streaming request failed: %d", err);
         return err;
     }
 
-    ESP_LOGI(TAG, "Sending streaming chat completion request (%zu bytes)", request_len);
-    ESP_LOGI(TAG, "Request body: %.*s", (int)request_len, request_buffer);  // Temporarily INFO for debugging
+    ESP_LOGI(TAG, "Streaming chat completion completed");
+    return XAI_OK;
+}
+
+xai_err_t xai_chat_completion_stream_events(
+    xai_client_t client,
+    const xai_message_t *messages,
+    size_t message_count,
+    const xai_options_t *options,
+    xai_stream_event_callback_t callback,
+    void *user_data
+) {
+    if (!client || !messages || message_count == 0 || !callback) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    struct xai_client_s *client_impl = (struct xai_client_s *)client;
+    xai_options_t routed_options;
+    xai_route_decision_t route;
+    options = xai_router_route(client_impl, messages, message_count, options,
+                               &routed_options, &route);
+    xai_err_t err = chat_validate(client_impl, messages, message_count, options);
+    if (err != XAI_OK) {
+        return err;
+    }
+
+    // Acquire client mutex
+    err = xai_client_lock(client_impl, XAI_ENDPOINT_CHAT_STREAM,
+                          options ? options->priority : XAI_PRIORITY_NORMAL);
+    if (err != XAI_OK) {
+        ESP_LOGE(TAG, "Failed to start request: %s", xai_err_to_string(err));
+        return err;
+    }
+
+    xai_options_t stream_options;
+    xai_buffer_t *request_buffer = NULL;
+    size_t request_len = 0;
+    err = chat_build_stream_request(client_impl, messages, message_count, options,
+                                    &stream_options, &request_buffer, &request_len);
+    if (err != XAI_OK) {
+        xai_client_unlock(client_impl);
+        return err;
+    }
 
     // Send streaming HTTP POST request
-    err = xai_http_post_stream(
+    err = xai_http_post_stream_events(
         client_impl->http_client,
         "/chat/completions",
-        request_buffer,
+        request_buffer->data,
         request_len,
         callback,
         user_data
     );
 
-    free(request_buffer);
-    xSemaphoreGive(client_impl->mutex);
+    xai_buffer_pool_release(client_impl->buffer_pool, request_buffer);
+    xai_router_record(client_impl, &route, err, true, 0);
+    xai_client_unlock(client_impl);
 
     if (err != XAI_OK) {
         ESP_LOGE(TAG, "Streaming request failed: %d", err);
@@ -234,9 +447,18 @@ xai_err_t xai_text_completion(
 
     // Extract content
     if (response.content) {
-        *response_text = response.content;
+        if (response._internal) {
+            // Static client storage is reused by the next call: hand out a copy
+            *response_text = xai_strdup(response.content);
+            if (!*response_text) {
+                xai_response_free(&response);
+                return XAI_ERR_NO_MEMORY;
+            }
+        } else {
+            *response_text = response.content;
+        }
         if (response_len) {
-            *response_len = strlen(response.content);
+            *response_len = strlen(*response_text);
         }
         
         // Transfer ownership of content string to caller
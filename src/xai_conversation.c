@@ -4,6 +4,17 @@
  * 
  * Provides a convenient API for managing multi-turn conversations
  * with automatic message history management.
+ *
+ * Each message carries its cost in prompt tokens and request bytes, and
+ * the conversation keeps the running sums, so fitting the history to the
+ * model's context and the request buffer costs O(1) per turn. Token costs
+ * are estimated on the way in (local tokenizer, else four bytes a token)
+ * and corrected by the usage the server reports.
+ *
+ * Message text is copied into one arena per conversation and messages
+ * refer to it by offset, so a turn costs its bytes and no allocation of
+ * its own. Evicted text is reclaimed by sliding the live text down when
+ * the arena runs short, and clearing only resets the fill mark.
  */
 
 #include "sdkconfig.h"
@@ -12,61 +23,457 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <inttypes.h>
 #include "xai.h"
 #include "xai_internal.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 static const char *TAG = "xai_conversation";
 
+#ifndef CONFIG_XAI_MAX_RESPONSE_SIZE
+#define CONFIG_XAI_MAX_RESPONSE_SIZE 16384
+#endif
+
+#ifndef CONFIG_XAI_TOOL_WORKERS
+#define CONFIG_XAI_TOOL_WORKERS 4
+#endif
+
+#ifndef CONFIG_XAI_TOOL_MAX_ROUNDS
+#define CONFIG_XAI_TOOL_MAX_ROUNDS 4
+#endif
+
 #define CONVERSATION_INITIAL_CAPACITY 8
 
+/** Initial text arena of a heap conversation, doubled as needed */
+#define CONVERSATION_INITIAL_TEXT 1024
+
+/** Request body around each message: {"role":"assistant","content":""}, */
+#define CONV_MESSAGE_BYTES 40
+
+/** Prompt tokens around each message (role and separators) */
+#define CONV_MESSAGE_TOKENS 4
+
+/** Request body outside the messages: model and sampling options */
+#define CONV_REQUEST_BYTES 256
+
+/** Request body around each tool call and tool result, beyond its strings */
+#define CONV_TOOL_CALL_BYTES 64
+#define CONV_TOOL_RESULT_BYTES 32
+
+/** Text moves by multiples of this, keeping tool call arrays aligned */
+#define CONV_ALIGN sizeof(void *)
+
+/** Reply budget of a summary */
+#define CONV_SUMMARY_TOKENS 256
+
+static const char *CONV_SUMMARY_PROMPT =
+    "Summarize the conversation above for your own later reference. Keep names, "
+    "numbers, decisions and open questions. Reply with the summary only.";
+
+static const char *CONV_SUMMARY_PREFIX = "Summary of the earlier conversation: ";
+
+/**
+ * @brief First message of the history
+ */
+static xai_message_t *conv_history(struct xai_conversation_s *conv) {
+    return conv->messages + conv->first;
+}
+
+/**
+ * @brief Serialized size of text inside a JSON string
+ */
+static size_t conv_json_len(const char *text) {
+    // JSON escaping: quotes, backslashes and control characters grow
+    size_t bytes = 0;
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        if (*p == '"' || *p == '\\' || *p == '\n' || *p == '\r' || *p == '\t' ||
+            *p == '\b' || *p == '\f') {
+            bytes += 2;
+        } else {
+            bytes += *p < 0x20 ? 6 : 1;
+        }
+    }
+    return bytes;
+}
+
+/**
+ * @brief Estimated prompt tokens of text
+ */
+static uint32_t conv_tokens(const char *text) {
+    uint32_t tokens = 0;
+    if (xai_count_tokens_local(text, &tokens) != XAI_OK) {
+        tokens = (uint32_t)(strlen(text) / 4);
+    }
+    return tokens;
+}
+
+/**
+ * @brief Estimated cost of a message; tokens as given if the server
+ *        reported them
+ */
+static xai_conv_meta_t conv_cost(const char *text, uint32_t tokens) {
+    return (xai_conv_meta_t){
+        .tokens = (tokens ? tokens : conv_tokens(text)) + CONV_MESSAGE_TOKENS,
+        .bytes = (uint32_t)(CONV_MESSAGE_BYTES + conv_json_len(text)),
+    };
+}
+
+/**
+ * @brief Round an arena offset up to the record alignment
+ */
+static size_t conv_align(size_t offset) {
+    return (offset + CONV_ALIGN - 1) & ~(size_t)(CONV_ALIGN - 1);
+}
+
+/**
+ * @brief Point history slot idx at its record in the arena
+ */
+static void conv_point(struct xai_conversation_s *conv, size_t idx) {
+    xai_message_t *msg = &conv_history(conv)[idx];
+    const xai_conv_meta_t *meta = &conv->meta[conv->first + idx];
+    char *p = conv->text + meta->offset;
+    msg->content = p;
+    if (msg->role == XAI_ROLE_TOOL) {
+        p += strlen(p) + 1;
+        msg->name = p;
+        msg->tool_call_id = p + strlen(p) + 1;
+    } else if (meta->tool_calls) {
+        size_t at = conv_align(meta->offset + strlen(p) + 1);
+        xai_tool_call_t *calls = (xai_tool_call_t *)(conv->text + at);
+        p = (char *)(calls + meta->tool_calls);
+        for (size_t i = 0; i < meta->tool_calls; i++) {
+            calls[i].id = p;
+            p += strlen(p) + 1;
+            calls[i].name = p;
+            p += strlen(p) + 1;
+            calls[i].arguments = p;
+            p += strlen(p) + 1;
+        }
+        msg->tool_calls = calls;
+        msg->tool_call_count = meta->tool_calls;
+    }
+}
+
+/**
+ * @brief Fill history slot idx with the record at offset and count its cost
+ */
+static void conv_set(struct xai_conversation_s *conv, size_t idx, xai_message_role_t role,
+                     size_t offset, xai_conv_meta_t meta) {
+    xai_message_t *msg = &conv_history(conv)[idx];
+    memset(msg, 0, sizeof(*msg));
+    msg->role = role;
+    meta.offset = (uint32_t)offset;
+    conv->meta[conv->first + idx] = meta;
+    conv_point(conv, idx);
+    conv->tokens += meta.tokens;
+    conv->bytes += meta.bytes;
+}
+
+/**
+ * @brief Point the history and the system prompt back into the arena after
+ *        it moved or its offsets changed
+ */
+static void conv_rebase(struct xai_conversation_s *conv) {
+    for (size_t i = 0; i < conv->message_count; i++) {
+        conv_point(conv, i);
+    }
+    if (conv->system_prompt) {
+        conv->system_prompt = conv->text;
+    }
+}
+
+/**
+ * @brief Move the live text down over text dropped with the oldest turns
+ *
+ * @return true if any text was reclaimed
+ */
+static bool conv_compact(struct xai_conversation_s *conv) {
+    size_t start = conv->system_prompt ? 1 : 0;
+    size_t live = start < conv->message_count ? conv->meta[conv->first + start].offset
+                : conv->streaming ? conv->stream_offset : conv->text_used;
+    size_t dead = (live - conv->text_base) & ~(size_t)(CONV_ALIGN - 1);
+    if (dead == 0) {
+        return false;
+    }
+    memmove(conv->text + live - dead, conv->text + live, conv->text_used - live);
+    for (size_t i = start; i < conv->message_count; i++) {
+        conv->meta[conv->first + i].offset -= (uint32_t)dead;
+    }
+    conv->text_used -= dead;
+    if (conv->streaming) {
+        conv->stream_offset -= dead;
+    }
+    conv->compactions++;
+    conv_rebase(conv);
+    ESP_LOGD(TAG, "Reclaimed %zu text bytes", dead);
+    return true;
+}
+
 /**
  * @brief Create conversation context
  */
 xai_conversation_t xai_conversation_create(const char *system_prompt) {
-    struct xai_conversation_s *conv = calloc(1, sizeof(struct xai_conversation_s));
+    struct xai_conversation_s *conv = xai_calloc(1, sizeof(struct xai_conversation_s));
     if (!conv) {
         ESP_LOGE(TAG, "Failed to allocate conversation");
         return NULL;
     }
 
-    // Allocate message array
+    // Allocate message array and text arena
+    size_t prompt_size = system_prompt ? strlen(system_prompt) + 1 : 0;
     conv->message_capacity = CONVERSATION_INITIAL_CAPACITY;
-    conv->messages = calloc(conv->message_capacity, sizeof(xai_message_t));
-    if (!conv->messages) {
-        ESP_LOGE(TAG, "Failed to allocate message array");
+    conv->messages = xai_calloc(conv->message_capacity, sizeof(xai_message_t));
+    conv->meta = xai_calloc(conv->message_capacity, sizeof(xai_conv_meta_t));
+    conv->text_size = CONVERSATION_INITIAL_TEXT;
+    while (conv->text_size < prompt_size + CONVERSATION_INITIAL_TEXT / 2) {
+        conv->text_size *= 2;
+    }
+    conv->text = xai_malloc_bulk(conv->text_size);
+    if (!conv->messages || !conv->meta || !conv->text) {
+        ESP_LOGE(TAG, "Failed to allocate conversation storage");
+        free(conv->messages);
+        free(conv->meta);
+        free(conv->text);
         free(conv);
         return NULL;
     }
 
     conv->message_count = 0;
 
-    // Add system prompt if provided
+    // Add system prompt if provided, at the start of the arena
     if (system_prompt) {
-        conv->system_prompt = strdup(system_prompt);
-        if (!conv->system_prompt) {
-            ESP_LOGE(TAG, "Failed to allocate system prompt");
-            free(conv->messages);
-            free(conv);
-            return NULL;
-        }
-
-        // Add as first message
-        conv->messages[0].role = XAI_ROLE_SYSTEM;
-        conv->messages[0].content = conv->system_prompt;
-        conv->messages[0].name = NULL;
-        conv->messages[0].tool_call_id = NULL;
-        conv->messages[0].tool_calls = NULL;
-        conv->messages[0].tool_call_count = 0;
-        conv->messages[0].images = NULL;
-        conv->messages[0].image_count = 0;
+        memcpy(conv->text, system_prompt, prompt_size);
+        conv->system_prompt = conv->text;
+        conv->text_used = prompt_size;
+        conv_set(conv, 0, XAI_ROLE_SYSTEM, 0, conv_cost(conv->system_prompt, 0));
         conv->message_count = 1;
     }
+    conv->text_base = conv->text_used;
 
     ESP_LOGD(TAG, "Created conversation (system_prompt=%s)", system_prompt ? "yes" : "no");
     return (xai_conversation_t)conv;
 }
 
+size_t xai_conversation_static_size(size_t max_messages, size_t text_size) {
+    return XAI_STATIC_SIZE(sizeof(struct xai_conversation_s)) +
+           XAI_STATIC_SIZE(max_messages * sizeof(xai_message_t)) +
+           XAI_STATIC_SIZE(max_messages * sizeof(xai_conv_meta_t)) +
+           text_size + (XAI_STATIC_ALIGN - 1);
+}
+
+/**
+ * @brief Create conversation with all storage in caller memory
+ */
+xai_conversation_t xai_conversation_create_static(
+    const char *system_prompt,
+    void *memory,
+    size_t memory_size,
+    size_t max_messages
+) {
+    if (!memory || max_messages == 0) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return NULL;
+    }
+
+    uintptr_t start = XAI_STATIC_SIZE((uintptr_t)memory);
+    size_t skip = start - (uintptr_t)memory;
+    xai_static_region_t region = {
+        .base = (uint8_t *)start,
+        .size = memory_size > skip ? memory_size - skip : 0,
+        .used = 0,
+    };
+
+    struct xai_conversation_s *conv = xai_static_take(&region, sizeof(struct xai_conversation_s));
+    xai_message_t *messages = xai_static_take(&region, max_messages * sizeof(xai_message_t));
+    xai_conv_meta_t *meta = xai_static_take(&region, max_messages * sizeof(xai_conv_meta_t));
+    size_t prompt_size = system_prompt ? strlen(system_prompt) + 1 : 0;
+    if (!conv || !messages || !meta || region.size - region.used < prompt_size) {
+        ESP_LOGE(TAG, "Static memory too small (%zu bytes)", memory_size);
+        return NULL;
+    }
+
+    conv->static_storage = true;
+    conv->messages = messages;
+    conv->meta = meta;
+    conv->message_capacity = max_messages;
+    conv->text = (char *)region.base + region.used;
+    conv->text_size = region.size - region.used;
+
+    if (system_prompt) {
+        memcpy(conv->text, system_prompt, prompt_size);
+        conv->system_prompt = conv->text;
+        conv->text_used = prompt_size;
+        conv_set(conv, 0, XAI_ROLE_SYSTEM, 0, conv_cost(conv->system_prompt, 0));
+        conv->message_count = 1;
+    }
+    conv->text_base = conv->text_used;
+
+    ESP_LOGD(TAG, "Created static conversation (%zu messages, %zu text bytes)",
+             max_messages, conv->text_size);
+    return (xai_conversation_t)conv;
+}
+
+/**
+ * @brief Drop n messages following the system prompt
+ *
+ * The system prompt moves up into the last dropped slot. Their text is
+ * reclaimed by the next compaction.
+ */
+static void conv_drop(struct xai_conversation_s *conv, size_t n) {
+    size_t start = conv->system_prompt ? 1 : 0;
+    xai_message_t *history = conv_history(conv);
+    for (size_t i = start; i < start + n; i++) {
+        xai_conv_meta_t *meta = &conv->meta[conv->first + i];
+        conv->tokens -= meta->tokens;
+        conv->bytes -= meta->bytes;
+    }
+    if (conv->system_prompt) {
+        history[n] = history[0];
+        conv->meta[conv->first + n] = conv->meta[conv->first];
+    }
+    conv->first += n;
+    conv->message_count -= n;
+}
+
+/**
+ * @brief Messages in the turn starting at history index at: a message and
+ *        everything up to the next user message
+ */
+static size_t conv_turn_len(struct xai_conversation_s *conv, size_t at) {
+    const xai_message_t *history = conv_history(conv);
+    size_t end = at + 1;
+    while (end < conv->message_count && history[end].role != XAI_ROLE_USER) {
+        end++;
+    }
+    return end - at;
+}
+
+/**
+ * @brief Drop the oldest turn of a static conversation, unless it is the
+ *        latest
+ */
+static bool conv_evict_oldest(struct xai_conversation_s *conv) {
+    size_t start = conv->system_prompt ? 1 : 0;
+    size_t len = start < conv->message_count ? conv_turn_len(conv, start) : 0;
+    if (len == 0 || start + len >= conv->message_count) {
+        return false;
+    }
+    conv_drop(conv, len);
+    conv->evicted_turns++;
+    return true;
+}
+
+/**
+ * @brief Make room for one more message: compact a history that has moved
+ *        up, else grow the arrays of a heap conversation
+ */
+static bool conv_reserve(struct xai_conversation_s *conv) {
+    if (conv->first + conv->message_count < conv->message_capacity) {
+        return true;
+    }
+    if (conv->first > 0) {
+        memmove(conv->messages, conv_history(conv), conv->message_count * sizeof(xai_message_t));
+        memmove(conv->meta, conv->meta + conv->first, conv->message_count * sizeof(xai_conv_meta_t));
+        conv->first = 0;
+        return true;
+    }
+    if (conv->static_storage) {
+        // Fixed capacity: the oldest turn makes way
+        if (!conv_evict_oldest(conv)) {
+            ESP_LOGE(TAG, "Conversation full (%zu messages)", conv->message_capacity);
+            return false;
+        }
+        return conv_reserve(conv);
+    }
+
+    size_t new_capacity = conv->message_capacity * 2;
+    xai_message_t *new_messages = xai_realloc(conv->messages, new_capacity * sizeof(xai_message_t));
+    if (!new_messages) {
+        ESP_LOGE(TAG, "Failed to resize message array");
+        return false;
+    }
+    conv->messages = new_messages;
+    xai_conv_meta_t *new_meta = xai_realloc(conv->meta, new_capacity * sizeof(xai_conv_meta_t));
+    if (!new_meta) {
+        ESP_LOGE(TAG, "Failed to resize message array");
+        return false;
+    }
+    conv->meta = new_meta;
+    conv->message_capacity = new_capacity;
+    return true;
+}
+
+/**
+ * @brief Make room for len more text bytes: reclaim dropped text, then
+ *        double the arena of a heap conversation or evict the oldest turns
+ *        of a static one (never while a reply streams in: a discarded
+ *        reply must leave the history as it was)
+ */
+static bool conv_reserve_text(struct xai_conversation_s *conv, size_t len) {
+    while (conv->text_size - conv->text_used < len) {
+        if (conv_compact(conv)) {
+            continue;
+        }
+        if (conv->static_storage) {
+            if (conv->streaming || !conv_evict_oldest(conv)) {
+                ESP_LOGE(TAG, "Conversation text full (%zu bytes)", conv->text_size);
+                return false;
+            }
+            continue;
+        }
+
+        size_t new_size = conv->text_size * 2;
+        while (new_size - conv->text_used < len) {
+            new_size *= 2;
+        }
+        char *new_text = xai_realloc_bulk(conv->text, new_size);
+        if (!new_text) {
+            ESP_LOGE(TAG, "Failed to grow text arena to %zu bytes", new_size);
+            return false;
+        }
+        conv->text = new_text;
+        conv->text_size = new_size;
+        conv_rebase(conv);
+    }
+    return true;
+}
+
+/**
+ * @brief Append a message, copying its text into the arena
+ *
+ * @param tokens Server-reported token count (0 = estimate)
+ */
+static bool conv_append(struct xai_conversation_s *conv_impl, xai_message_role_t role,
+                        const char *message, uint32_t tokens) {
+    // Text already in the arena (a message added again) may move below
+    if (message >= conv_impl->text && message < conv_impl->text + conv_impl->text_size) {
+        char *copy = xai_strdup(message);
+        if (!copy) {
+            ESP_LOGE(TAG, "Failed to store message (%zu bytes)", strlen(message) + 1);
+            return false;
+        }
+        bool stored = conv_append(conv_impl, role, copy, tokens);
+        free(copy);
+        return stored;
+    }
+
+    size_t len = strlen(message) + 1;
+    if (!conv_reserve(conv_impl) || !conv_reserve_text(conv_impl, len)) {
+        ESP_LOGE(TAG, "Failed to store message (%zu bytes)", len);
+        return false;
+    }
+
+    size_t offset = conv_impl->text_used;
+    memcpy(conv_impl->text + offset, message, len);
+    conv_impl->text_used += len;
+    conv_set(conv_impl, conv_impl->message_count++, role, offset,
+             conv_cost(conv_impl->text + offset, tokens));
+    return true;
+}
+
 /**
  * @brief Add user message to conversation
  */
@@ -77,32 +484,7 @@ void xai_conversation_add_user(xai_conversation_t conv, const char *message) {
     }
 
     struct xai_conversation_s *conv_impl = (struct xai_conversation_s *)conv;
-
-    // Check if we need to resize message array
-    if (conv_impl->message_count >= conv_impl->message_capacity) {
-        size_t new_capacity = conv_impl->message_capacity * 2;
-        xai_message_t *new_messages = realloc(
-            conv_impl->messages,
-            new_capacity * sizeof(xai_message_t)
-        );
-        if (!new_messages) {
-            ESP_LOGE(TAG, "Failed to resize message array");
-            return;
-        }
-        conv_impl->messages = new_messages;
-        conv_impl->message_capacity = new_capacity;
-    }
-
-    // Add user message
-    size_t idx = conv_impl->message_count++;
-    conv_impl->messages[idx].role = XAI_ROLE_USER;
-    conv_impl->messages[idx].content = strdup(message);
-    conv_impl->messages[idx].name = NULL;
-    conv_impl->messages[idx].tool_call_id = NULL;
-    conv_impl->messages[idx].tool_calls = NULL;
-    conv_impl->messages[idx].tool_call_count = 0;
-    conv_impl->messages[idx].images = NULL;
-    conv_impl->messages[idx].image_count = 0;
+    conv_append(conv_impl, XAI_ROLE_USER, message, 0);
 
     ESP_LOGD(TAG, "Added user message (%zu total)", conv_impl->message_count);
 }
@@ -117,34 +499,136 @@ void xai_conversation_add_assistant(xai_conversation_t conv, const char *message
     }
 
     struct xai_conversation_s *conv_impl = (struct xai_conversation_s *)conv;
+    conv_append(conv_impl, XAI_ROLE_ASSISTANT, message, 0);
 
-    // Check if we need to resize message array
-    if (conv_impl->message_count >= conv_impl->message_capacity) {
-        size_t new_capacity = conv_impl->message_capacity * 2;
-        xai_message_t *new_messages = realloc(
-            conv_impl->messages,
-            new_capacity * sizeof(xai_message_t)
-        );
-        if (!new_messages) {
-            ESP_LOGE(TAG, "Failed to resize message array");
-            return;
-        }
-        conv_impl->messages = new_messages;
-        conv_impl->message_capacity = new_capacity;
+    ESP_LOGD(TAG, "Added assistant message (%zu total)", conv_impl->message_count);
+}
+
+/* ========================================================================
+ * History Window
+ * ======================================================================== */
+
+/**
+ * @brief Replace the n messages after the system prompt with a summary
+ *        the model writes of them
+ */
+static xai_err_t conv_summarize(xai_client_t client, struct xai_conversation_s *conv, size_t n) {
+    size_t start = conv->system_prompt ? 1 : 0;
+    xai_message_t *request = xai_malloc((n + 1) * sizeof(xai_message_t));
+    if (!request) {
+        return XAI_ERR_NO_MEMORY;
+    }
+    memcpy(request, conv_history(conv) + start, n * sizeof(xai_message_t));
+    memset(&request[n], 0, sizeof(xai_message_t));
+    request[n].role = XAI_ROLE_USER;
+    request[n].content = CONV_SUMMARY_PROMPT;
+
+    xai_options_t options = xai_options_default();
+    options.max_tokens = CONV_SUMMARY_TOKENS;
+    xai_response_t response;
+    xai_err_t err = xai_chat_completion(client, request, n + 1, &options, &response);
+    free(request);
+    if (err != XAI_OK) {
+        return err;
     }
 
-    // Add assistant message
-    size_t idx = conv_impl->message_count++;
-    conv_impl->messages[idx].role = XAI_ROLE_ASSISTANT;
-    conv_impl->messages[idx].content = strdup(message);
-    conv_impl->messages[idx].name = NULL;
-    conv_impl->messages[idx].tool_call_id = NULL;
-    conv_impl->messages[idx].tool_calls = NULL;
-    conv_impl->messages[idx].tool_call_count = 0;
-    conv_impl->messages[idx].images = NULL;
-    conv_impl->messages[idx].image_count = 0;
+    size_t prefix_len = strlen(CONV_SUMMARY_PREFIX);
+    size_t content_len = response.content ? strlen(response.content) : 0;
+    size_t size = prefix_len + content_len + 1;
+    size_t shift = conv_align(size);
+    uint32_t summary_tokens = response.completion_tokens;
+    if (!response.content || !conv_reserve_text(conv, shift)) {
+        err = response.content ? XAI_ERR_NO_MEMORY : XAI_ERR_PARSE_FAILED;
+        xai_response_free(&response);
+        return err;
+    }
 
-    ESP_LOGD(TAG, "Added assistant message (%zu total)", conv_impl->message_count);
+    // Dropping leaves at least one free slot in front of the history; the
+    // summary goes in front of the remaining text, which moves up for it
+    conv_drop(conv, n);
+    conv_compact(conv);
+    memmove(conv->text + conv->text_base + shift, conv->text + conv->text_base,
+            conv->text_used - conv->text_base);
+    for (size_t i = start; i < conv->message_count; i++) {
+        conv->meta[conv->first + i].offset += (uint32_t)shift;
+    }
+    conv->text_used += shift;
+    char *summary = conv->text + conv->text_base;
+    memcpy(summary, CONV_SUMMARY_PREFIX, prefix_len);
+    memcpy(summary + prefix_len, response.content, content_len);
+    summary[size - 1] = '\0';
+    xai_response_free(&response);
+
+    conv->first--;
+    if (conv->system_prompt) {
+        conv->messages[conv->first] = conv->messages[conv->first + 1];
+        conv->meta[conv->first] = conv->meta[conv->first + 1];
+    }
+    conv->message_count++;
+    conv_rebase(conv);
+    conv_set(conv, start, XAI_ROLE_SYSTEM, conv->text_base, conv_cost(summary, summary_tokens));
+    conv->summaries++;
+    return XAI_OK;
+}
+
+/**
+ * @brief Drop or summarize the oldest turns until the history fits the
+ *        window; the latest turn is never touched
+ *
+ * @param extra_bytes Request body beyond the messages and options (tool
+ *                    definitions)
+ */
+static xai_err_t conv_fit(xai_client_t client, struct xai_conversation_s *conv,
+                          size_t extra_bytes) {
+    struct xai_client_s *client_impl = (struct xai_client_s *)client;
+    const xai_conversation_window_t *window = &conv->window;
+
+    uint32_t reply = window->reply_tokens ? window->reply_tokens
+                                          : (uint32_t)client_impl->default_max_tokens;
+    uint32_t context = xai_model_context_tokens(client_impl->default_model);
+    uint32_t max_tokens = window->max_tokens ? window->max_tokens
+                                             : (context > reply ? context - reply : 0);
+    size_t max_bytes = window->max_bytes ? window->max_bytes : CONFIG_XAI_MAX_RESPONSE_SIZE;
+    extra_bytes += CONV_REQUEST_BYTES;
+    max_bytes = max_bytes > extra_bytes ? max_bytes - extra_bytes : 0;
+
+    // The server's count of the last prompt corrects the estimate
+    int64_t tokens = (int64_t)conv->tokens + conv->token_bias;
+    size_t bytes = conv->bytes;
+    size_t start = conv->system_prompt ? 1 : 0;
+    size_t drop = 0;
+    uint32_t turns = 0;
+    while ((max_tokens && tokens > max_tokens) || bytes > max_bytes) {
+        size_t at = start + drop;
+        size_t len = at < conv->message_count ? conv_turn_len(conv, at) : 0;
+        if (len == 0 || at + len >= conv->message_count) {
+            ESP_LOGE(TAG, "Latest turn alone exceeds the budget (%" PRId64 " tokens, %zu bytes)",
+                     tokens, bytes);
+            return XAI_ERR_INVALID_ARG;
+        }
+        for (size_t i = at; i < at + len; i++) {
+            tokens -= conv->meta[conv->first + i].tokens;
+            bytes -= conv->meta[conv->first + i].bytes;
+        }
+        drop += len;
+        turns++;
+    }
+    if (drop == 0) {
+        return XAI_OK;
+    }
+
+    conv->evicted_turns += turns;
+    if (conv->window.policy == XAI_WINDOW_SUMMARIZE && !conv->static_storage) {
+        xai_err_t err = conv_summarize(client, conv, drop);
+        if (err == XAI_OK) {
+            ESP_LOGI(TAG, "Summarized %" PRIu32 " turns to fit the window", turns);
+            return XAI_OK;
+        }
+        ESP_LOGW(TAG, "Summary failed (%s); dropping the turns", xai_err_to_string(err));
+    }
+    conv_drop(conv, drop);
+    ESP_LOGI(TAG, "Dropped %" PRIu32 " turns to fit the window", turns);
+    return XAI_OK;
 }
 
 /**
@@ -167,10 +651,15 @@ xai_err_t xai_conversation_complete(
         return XAI_ERR_INVALID_ARG;
     }
 
+    xai_err_t err = conv_fit(client, conv_impl, 0);
+    if (err != XAI_OK) {
+        return err;
+    }
+
     // Call chat completion
-    xai_err_t err = xai_chat_completion(
+    err = xai_chat_completion(
         client,
-        conv_impl->messages,
+        conv_history(conv_impl),
         conv_impl->message_count,
         NULL,
         response
@@ -180,9 +669,13 @@ xai_err_t xai_conversation_complete(
         return err;
     }
 
+    if (response->prompt_tokens) {
+        conv_impl->token_bias = (int32_t)response->prompt_tokens - (int32_t)conv_impl->tokens;
+    }
+
     // Add assistant response to conversation history
     if (response->content) {
-        xai_conversation_add_assistant(conv, response->content);
+        conv_append(conv_impl, XAI_ROLE_ASSISTANT, response->content, response->completion_tokens);
     }
 
     ESP_LOGD(TAG, "Conversation completed (%zu messages)", conv_impl->message_count);
@@ -190,38 +683,474 @@ xai_err_t xai_conversation_complete(
 }
 
 /**
- * @brief Clear conversation history
+ * @brief State of a streamed conversation reply
  */
-void xai_conversation_clear(xai_conversation_t conv) {
-    if (!conv) {
+typedef struct {
+    struct xai_conversation_s *conv;
+    xai_http_client_t *http;
+    xai_conversation_stream_callback_t callback;
+    void *user_data;
+    xai_err_t err;                  /**< Why the reply is discarded, XAI_OK otherwise */
+    uint32_t prompt_tokens;
+    uint32_t completion_tokens;
+} conv_stream_t;
+
+/**
+ * @brief Append content deltas to the partial reply at the end of the arena
+ */
+static void conv_stream_event(const xai_stream_event_t *event, void *user_data) {
+    conv_stream_t *stream = (conv_stream_t *)user_data;
+    struct xai_conversation_s *conv = stream->conv;
+    if (stream->err != XAI_OK) {
         return;
     }
 
+    switch (event->type) {
+        case XAI_STREAM_EVENT_CONTENT:
+            // One byte more keeps room for the terminator
+            if (!conv_reserve_text(conv, event->length + 1)) {
+                stream->err = XAI_ERR_NO_MEMORY;
+                xai_http_abort(stream->http);
+                return;
+            }
+            memcpy(conv->text + conv->text_used, event->text, event->length);
+            conv->text_used += event->length;
+            if (stream->callback &&
+                !stream->callback(event->text, event->length, stream->user_data)) {
+                stream->err = XAI_ERR_CANCELLED;
+                xai_http_abort(stream->http);
+            }
+            break;
+        case XAI_STREAM_EVENT_USAGE:
+            stream->prompt_tokens = event->prompt_tokens;
+            stream->completion_tokens = event->completion_tokens;
+            break;
+        case XAI_STREAM_EVENT_ERROR:
+            stream->err = event->error != XAI_OK ? event->error : XAI_ERR_API_ERROR;
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Complete conversation, streaming the reply into the history
+ */
+xai_err_t xai_conversation_complete_stream(
+    xai_client_t client,
+    xai_conversation_t conv,
+    xai_conversation_stream_callback_t callback,
+    void *user_data
+) {
+    if (!client || !conv) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    struct xai_client_s *client_impl = (struct xai_client_s *)client;
+    struct xai_conversation_s *conv_impl = (struct xai_conversation_s *)conv;
+
+    if (conv_impl->message_count == 0) {
+        ESP_LOGE(TAG, "No messages in conversation");
+        return XAI_ERR_INVALID_ARG;
+    }
+    if (conv_impl->streaming) {
+        return XAI_ERR_BUSY;
+    }
+
+    xai_err_t err = conv_fit(client, conv_impl, 0);
+    if (err != XAI_OK) {
+        return err;
+    }
+
+    // The reply's slot is taken up front; its text follows the deltas
+    if (!conv_reserve(conv_impl)) {
+        return XAI_ERR_NO_MEMORY;
+    }
+    uint32_t sent_tokens = conv_impl->tokens;
+    conv_impl->streaming = true;
+    conv_impl->stream_offset = conv_impl->text_used;
+
+    conv_stream_t stream = {
+        .conv = conv_impl,
+        .http = client_impl->http_client,
+        .callback = callback,
+        .user_data = user_data,
+        .err = XAI_OK,
+    };
+    err = xai_chat_completion_stream_events(
+        client,
+        conv_history(conv_impl),
+        conv_impl->message_count,
+        NULL,
+        conv_stream_event,
+        &stream
+    );
+    if (stream.err != XAI_OK) {
+        err = stream.err;
+    }
+
+    size_t offset = conv_impl->stream_offset;
+    conv_impl->streaming = false;
+    if (err != XAI_OK || conv_impl->text_used == offset) {
+        // Nothing of a failed or cancelled reply stays behind
+        conv_impl->text_used = offset;
+        if (err != XAI_OK) {
+            ESP_LOGW(TAG, "Streamed reply discarded: %s", xai_err_to_string(err));
+        }
+        return err;
+    }
+
+    conv_impl->text[conv_impl->text_used++] = '\0';
+    if (stream.prompt_tokens) {
+        conv_impl->token_bias = (int32_t)stream.prompt_tokens - (int32_t)sent_tokens;
+    }
+    conv_set(conv_impl, conv_impl->message_count++, XAI_ROLE_ASSISTANT, offset,
+             conv_cost(conv_impl->text + offset, stream.completion_tokens));
+
+    ESP_LOGD(TAG, "Conversation streamed (%zu messages)", conv_impl->message_count);
+    return XAI_OK;
+}
+
+#ifdef CONFIG_XAI_ENABLE_TOOLS
+
+/* ========================================================================
+ * Tool Loop
+ * ======================================================================== */
+
+/**
+ * @brief Append the assistant message asking for the response's tool calls
+ */
+static bool conv_append_tool_calls(struct xai_conversation_s *conv, const xai_response_t *response) {
+    const char *content = response->content ? response->content : "";
+    size_t count = response->tool_call_count;
+    size_t len = strlen(content) + 1;
+    size_t size = len + (CONV_ALIGN - 1) + count * sizeof(xai_tool_call_t);
+    for (size_t i = 0; i < count; i++) {
+        const xai_tool_call_t *call = &response->tool_calls[i];
+        size += strlen(call->id ? call->id : "") + strlen(call->name ? call->name : "") +
+                strlen(call->arguments ? call->arguments : "{}") + 3;
+    }
+    if (count > UINT16_MAX || !conv_reserve(conv) || !conv_reserve_text(conv, size)) {
+        ESP_LOGE(TAG, "Failed to store %zu tool calls (%zu bytes)", count, size);
+        return false;
+    }
+
+    size_t offset = conv->text_used;
+    memcpy(conv->text + offset, content, len);
+    xai_conv_meta_t meta = conv_cost(content, response->completion_tokens);
+    char *p = conv->text + conv_align(offset + len) + count * sizeof(xai_tool_call_t);
+    for (size_t i = 0; i < count; i++) {
+        const xai_tool_call_t *call = &response->tool_calls[i];
+        const char *fields[3] = {
+            call->id ? call->id : "",
+            call->name ? call->name : "",
+            call->arguments ? call->arguments : "{}",
+        };
+        for (size_t f = 0; f < 3; f++) {
+            size_t n = strlen(fields[f]) + 1;
+            memcpy(p, fields[f], n);
+            p += n;
+            meta.bytes += (uint32_t)conv_json_len(fields[f]);
+        }
+        meta.bytes += CONV_TOOL_CALL_BYTES;
+        if (!response->completion_tokens) {
+            meta.tokens += conv_tokens(fields[1]) + conv_tokens(fields[2]) + CONV_MESSAGE_TOKENS;
+        }
+    }
+    conv->text_used = (size_t)(p - conv->text);
+    meta.tool_calls = (uint16_t)count;
+    conv_set(conv, conv->message_count++, XAI_ROLE_ASSISTANT, offset, meta);
+    return true;
+}
+
+/**
+ * @brief Append the result of a tool call
+ */
+static bool conv_append_tool_result(struct xai_conversation_s *conv, const xai_tool_call_t *call,
+                                    const char *content) {
+    const char *parts[3] = { content, call->name ? call->name : "", call->id ? call->id : "" };
+    size_t lens[3];
+    size_t size = 0;
+    for (size_t i = 0; i < 3; i++) {
+        lens[i] = strlen(parts[i]) + 1;
+        size += lens[i];
+    }
+    if (!conv_reserve(conv) || !conv_reserve_text(conv, size)) {
+        ESP_LOGE(TAG, "Failed to store tool result (%zu bytes)", size);
+        return false;
+    }
+
+    size_t offset = conv->text_used;
+    for (size_t i = 0; i < 3; i++) {
+        memcpy(conv->text + conv->text_used, parts[i], lens[i]);
+        conv->text_used += lens[i];
+    }
+    xai_conv_meta_t meta = conv_cost(content, 0);
+    meta.bytes += (uint32_t)(conv_json_len(parts[1]) + conv_json_len(parts[2]) +
+                             CONV_TOOL_RESULT_BYTES);
+    conv_set(conv, conv->message_count++, XAI_ROLE_TOOL, offset, meta);
+    return true;
+}
+
+/**
+ * @brief Remove the last n messages and their text
+ */
+static void conv_truncate(struct xai_conversation_s *conv, size_t n) {
+    size_t keep = conv->message_count - n;
+    for (size_t i = keep; i < conv->message_count; i++) {
+        conv->tokens -= conv->meta[conv->first + i].tokens;
+        conv->bytes -= conv->meta[conv->first + i].bytes;
+    }
+    conv->text_used = conv->meta[conv->first + keep].offset;
+    conv->message_count = keep;
+}
+
+/**
+ * @brief What the model is told about a call that produced no result
+ */
+static const char *conv_tool_error(xai_err_t err) {
+    switch (err) {
+        case XAI_ERR_TIMEOUT:       return "{\"error\":\"tool timed out\"}";
+        case XAI_ERR_NOT_SUPPORTED: return "{\"error\":\"unknown tool\"}";
+        default:                    return "{\"error\":\"tool failed\"}";
+    }
+}
+
+/**
+ * @brief Dispatch the response's tool calls and add them and their results
+ *        to the history; nothing is added unless everything is
+ */
+static xai_err_t conv_run_tools(
+    struct xai_conversation_s *conv,
+    const xai_response_t *response,
+    const xai_tool_binding_t *tools,
+    size_t tool_count,
+    size_t workers,
+    xai_tool_run_stats_t *stats,
+    xai_tool_stats_t *tool_stats
+) {
+    size_t count = response->tool_call_count;
+    xai_tool_outcome_t *outcomes = xai_calloc(count, sizeof(xai_tool_outcome_t));
+    if (!outcomes) {
+        return XAI_ERR_NO_MEMORY;
+    }
+    if (!conv_append_tool_calls(conv, response)) {
+        free(outcomes);
+        return XAI_ERR_NO_MEMORY;
+    }
+
+    int64_t start = esp_timer_get_time();
+    xai_tools_run(response->tool_calls, count, tools, tool_count, workers, outcomes);
+    stats->tools_ms += (uint32_t)((esp_timer_get_time() - start) / 1000);
+
+    size_t appended = 1;
+    xai_err_t err = XAI_OK;
+    for (size_t i = 0; i < count; i++) {
+        xai_tool_outcome_t *outcome = &outcomes[i];
+        stats->tool_calls++;
+        stats->tools_serial_ms += outcome->latency_ms;
+        if (outcome->err == XAI_ERR_TIMEOUT) {
+            stats->timeouts++;
+        } else if (outcome->err != XAI_OK) {
+            stats->failures++;
+        }
+        if (tool_stats && outcome->tool >= 0) {
+            xai_tool_stats_t *ts = &tool_stats[outcome->tool];
+            ts->calls++;
+            ts->timeouts += outcome->err == XAI_ERR_TIMEOUT;
+            ts->failures += outcome->err != XAI_OK && outcome->err != XAI_ERR_TIMEOUT;
+            ts->total_ms += outcome->latency_ms;
+            if (outcome->latency_ms > ts->max_ms) {
+                ts->max_ms = outcome->latency_ms;
+            }
+        }
+
+        const char *content = outcome->err == XAI_OK ? outcome->result
+                                                     : conv_tool_error(outcome->err);
+        if (err == XAI_OK) {
+            if (conv_append_tool_result(conv, &response->tool_calls[i], content)) {
+                appended++;
+            } else {
+                err = XAI_ERR_NO_MEMORY;
+            }
+        }
+        free(outcome->result);
+    }
+    free(outcomes);
+
+    if (err != XAI_OK) {
+        // Calls without all their results would be rejected by the API
+        conv_truncate(conv, appended);
+    }
+    return err;
+}
+
+xai_err_t xai_run_with_tools(
+    xai_client_t client,
+    xai_conversation_t conv,
+    const xai_tool_binding_t *tools,
+    size_t tool_count,
+    const xai_tool_run_options_t *run_options,
+    xai_response_t *response
+) {
+    if (!client || !conv || !tools || tool_count == 0 || !response) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return XAI_ERR_INVALID_ARG;
+    }
+
     struct xai_conversation_s *conv_impl = (struct xai_conversation_s *)conv;
+    if (conv_impl->message_count == 0) {
+        ESP_LOGE(TAG, "No messages in conversation");
+        return XAI_ERR_INVALID_ARG;
+    }
+    if (conv_impl->streaming) {
+        return XAI_ERR_BUSY;
+    }
+
+    // Tool definitions go out with every request
+    xai_tool_t *defs = xai_malloc(tool_count * sizeof(xai_tool_t));
+    if (!defs) {
+        return XAI_ERR_NO_MEMORY;
+    }
+    size_t defs_bytes = 0;
+    for (size_t i = 0; i < tool_count; i++) {
+        defs[i] = tools[i].tool;
+        defs_bytes += CONV_TOOL_CALL_BYTES + strlen(defs[i].name) +
+                      (defs[i].description ? conv_json_len(defs[i].description) : 0) +
+                      (defs[i].parameters_json ? strlen(defs[i].parameters_json) : 0);
+    }
+
+    xai_options_t options = (run_options && run_options->options) ? *run_options->options
+                                                                   : xai_options_default();
+    options.tools = defs;
+    options.tool_count = tool_count;
+    if (!options.tool_choice) {
+        options.tool_choice = "auto";
+    }
+    size_t max_rounds = (run_options && run_options->max_rounds) ? run_options->max_rounds
+                                                                 : CONFIG_XAI_TOOL_MAX_ROUNDS;
+#ifdef CONFIG_XAI_ENABLE_PARALLEL_TOOLS
+    options.parallel_function_calling = true;
+    size_t workers = (run_options && run_options->workers) ? run_options->workers
+                                                           : CONFIG_XAI_TOOL_WORKERS;
+#else
+    options.parallel_function_calling = false;
+    size_t workers = 1;
+#endif
+    xai_tool_stats_t *tool_stats = run_options ? run_options->tool_stats : NULL;
+
+    xai_tool_run_stats_t stats = {0};
+    xai_err_t err;
+    for (;;) {
+        err = conv_fit(client, conv_impl, defs_bytes);
+        if (err != XAI_OK) {
+            break;
+        }
+
+        uint32_t sent_tokens = conv_impl->tokens;
+        int64_t start = esp_timer_get_time();
+        err = xai_chat_completion(client, conv_history(conv_impl), conv_impl->message_count,
+                                  &options, response);
+        stats.model_ms += (uint32_t)((esp_timer_get_time() - start) / 1000);
+        stats.requests++;
+        if (err != XAI_OK) {
+            break;
+        }
+        if (response->prompt_tokens) {
+            conv_impl->token_bias = (int32_t)response->prompt_tokens - (int32_t)sent_tokens;
+        }
 
-    // Free all message contents (except system prompt)
-    for (size_t i = 0; i < conv_impl->message_count; i++) {
-        if (conv_impl->messages[i].role != XAI_ROLE_SYSTEM) {
-            if (conv_impl->messages[i].content) {
-                free((void*)conv_impl->messages[i].content);
+        if (response->tool_call_count == 0) {
+            if (response->content) {
+                conv_append(conv_impl, XAI_ROLE_ASSISTANT, response->content,
+                            response->completion_tokens);
             }
+            break;
         }
+        if (stats.tool_rounds == max_rounds) {
+            ESP_LOGE(TAG, "Model still calling tools after %zu rounds", max_rounds);
+            xai_response_free(response);
+            err = XAI_ERR_API_ERROR;
+            break;
+        }
+
+        stats.tool_rounds++;
+        err = conv_run_tools(conv_impl, response, tools, tool_count, workers, &stats, tool_stats);
+        xai_response_free(response);
+        if (err != XAI_OK) {
+            break;
+        }
+
+        // A forced choice applies to the first request; the last must answer
+        options.tool_choice = stats.tool_rounds == max_rounds ? "none" : "auto";
     }
 
-    // Reset to just system prompt if it exists
+    free(defs);
+    ESP_LOGI(TAG, "Tool loop: %" PRIu32 " requests, %" PRIu32 " calls in %" PRIu32
+             " ms (%" PRIu32 " ms in turn)", stats.requests, stats.tool_calls,
+             stats.tools_ms, stats.tools_serial_ms);
+    if (run_options && run_options->stats) {
+        *run_options->stats = stats;
+    }
+    return err;
+}
+
+#endif // CONFIG_XAI_ENABLE_TOOLS
+
+void xai_conversation_set_window(xai_conversation_t conv, const xai_conversation_window_t *window) {
+    if (!conv) {
+        return;
+    }
+    struct xai_conversation_s *conv_impl = (struct xai_conversation_s *)conv;
+    if (window) {
+        conv_impl->window = *window;
+    } else {
+        memset(&conv_impl->window, 0, sizeof(conv_impl->window));
+    }
+}
+
+xai_err_t xai_conversation_get_stats(xai_conversation_t conv, xai_conversation_stats_t *stats) {
+    if (!conv || !stats) {
+        return XAI_ERR_INVALID_ARG;
+    }
+    struct xai_conversation_s *conv_impl = (struct xai_conversation_s *)conv;
+    int64_t tokens = (int64_t)conv_impl->tokens + conv_impl->token_bias;
+    stats->messages = conv_impl->message_count;
+    stats->tokens = tokens > 0 ? (uint32_t)tokens : 0;
+    stats->bytes = conv_impl->bytes;
+    stats->evicted_turns = conv_impl->evicted_turns;
+    stats->summaries = conv_impl->summaries;
+    stats->text_used = conv_impl->text_used;
+    stats->text_size = conv_impl->text_size;
+    stats->compactions = conv_impl->compactions;
+    return XAI_OK;
+}
+
+/**
+ * @brief Clear conversation history
+ */
+void xai_conversation_clear(xai_conversation_t conv) {
+    if (!conv) {
+        return;
+    }
+
+    struct xai_conversation_s *conv_impl = (struct xai_conversation_s *)conv;
+
+    // Reset to just system prompt if it exists; the text goes with the
+    // arena's fill mark
+    xai_conv_meta_t prompt = conv_impl->system_prompt ? conv_impl->meta[conv_impl->first]
+                                                      : (xai_conv_meta_t){ 0 };
+    conv_impl->first = 0;
+    conv_impl->message_count = 0;
+    conv_impl->tokens = 0;
+    conv_impl->bytes = 0;
+    conv_impl->token_bias = 0;
     if (conv_impl->system_prompt) {
-        conv_impl->messages[0].role = XAI_ROLE_SYSTEM;
-        conv_impl->messages[0].content = conv_impl->system_prompt;
-        conv_impl->messages[0].name = NULL;
-        conv_impl->messages[0].tool_call_id = NULL;
-        conv_impl->messages[0].tool_calls = NULL;
-        conv_impl->messages[0].tool_call_count = 0;
-        conv_impl->messages[0].images = NULL;
-        conv_impl->messages[0].image_count = 0;
+        conv_set(conv_impl, 0, XAI_ROLE_SYSTEM, 0, prompt);
         conv_impl->message_count = 1;
-    } else {
-        conv_impl->message_count = 0;
     }
+    conv_impl->text_used = conv_impl->text_base;
 
     ESP_LOGD(TAG, "Cleared conversation");
 }
@@ -236,29 +1165,18 @@ void xai_conversation_destroy(xai_conversation_t conv) {
 
     struct xai_conversation_s *conv_impl = (struct xai_conversation_s *)conv;
 
-    // Free all message contents
-    for (size_t i = 0; i < conv_impl->message_count; i++) {
-        if (conv_impl->messages[i].role != XAI_ROLE_SYSTEM ||
-            !conv_impl->system_prompt) {
-            if (conv_impl->messages[i].content) {
-                free((void*)conv_impl->messages[i].content);
-            }
-        }
-    }
-
-    // Free system prompt
-    if (conv_impl->system_prompt) {
-        free(conv_impl->system_prompt);
+    // Everything lives in the caller's memory
+    if (conv_impl->static_storage) {
+        ESP_LOGD(TAG, "Destroyed static conversation");
+        return;
     }
 
-    // Free message array
-    if (conv_impl->messages) {
-        free(conv_impl->messages);
-    }
+    free(conv_impl->text);
+    free(conv_impl->messages);
+    free(conv_impl->meta);
 
     free(conv_impl);
     ESP_LOGD(TAG, "Destroyed conversation");
 }
 
 #endif // CONFIG_XAI_ENABLE_CONVERSATION_HELPER
-
@@ -39,6 +39,8 @@ const char* xai_err_to_string(xai_err_t err) {
             return "WebSocket operation failed";
         case XAI_ERR_BUSY:
             return "Busy";
+        case XAI_ERR_CANCELLED:
+            return "Cancelled";
         default:
             return "Unknown error";
     }
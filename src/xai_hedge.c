@@ -0,0 +1,560 @@
+/**
+ * @file xai_hedge.c
+ * @brief Hedged chat requests
+ *
+ * Tail latency comes from the occasional slow upstream response, not from
+ * typical ones. A hedged call sends its request from a task and waits up
+ * to the p95 of recent times to first byte; if the response has not
+ * started by then, it opens a second connection and sends a backup
+ * (optionally to a faster model). The first request to receive a byte
+ * wins, and the call returns as soon as the winner has its answer.
+ *
+ * The loser is cancelled at its first byte, on its own task: neither task
+ * touches the other's transport. Until then it keeps running after the
+ * call has returned, so the race state is reference counted. A losing
+ * primary takes the client's connection with it, and the client opens a
+ * new one; its response buffer comes from the race, not the client's pool.
+ */
+
+#include "sdkconfig.h"
+#include "xai_internal.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+static const char *TAG = "xai_hedge";
+
+#ifndef CONFIG_XAI_HEDGE_DELAY_MS
+#define CONFIG_XAI_HEDGE_DELAY_MS 2000
+#endif
+
+#ifndef CONFIG_XAI_HEDGE_MIN_SAMPLES
+#define CONFIG_XAI_HEDGE_MIN_SAMPLES 8
+#endif
+
+#ifndef CONFIG_XAI_BATCH_TASK_STACK
+#define CONFIG_XAI_BATCH_TASK_STACK 8192
+#endif
+
+#ifndef CONFIG_XAI_MAX_RESPONSE_SIZE
+#define CONFIG_XAI_MAX_RESPONSE_SIZE 16384
+#endif
+
+/**
+ * @brief p95 of the recorded times to first byte (mutex held)
+ */
+static uint32_t hedge_ttfb_p95(const struct xai_client_s *client) {
+    uint32_t sorted[XAI_TTFB_WINDOW];
+    uint32_t n = client->ttfb_count;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t v = client->ttfb_ms[i];
+        uint32_t j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+    return n ? sorted[(n * 95 + 99) / 100 - 1] : 0;
+}
+
+static void hedge_ttfb_add(struct xai_client_s *client, uint32_t ms) {
+    client->ttfb_ms[client->ttfb_next] = ms;
+    client->ttfb_next = (client->ttfb_next + 1) % XAI_TTFB_WINDOW;
+    if (client->ttfb_count < XAI_TTFB_WINDOW) {
+        client->ttfb_count++;
+    }
+    client->hedge_stats.ttfb_samples = client->ttfb_count;
+    client->hedge_stats.ttfb_p95_ms = hedge_ttfb_p95(client);
+}
+
+void xai_hedge_record_ttfb(struct xai_client_s *client) {
+    xai_http_client_t *http = client->http_client;
+    if (http->first_byte_us != 0) {
+        hedge_ttfb_add(client, (uint32_t)((http->first_byte_us - http->request_start_us) / 1000));
+    }
+}
+
+typedef enum {
+    HEDGE_UNDECIDED,
+    HEDGE_PRIMARY,
+    HEDGE_BACKUP,
+} hedge_winner_t;
+
+struct hedge_race_s;
+
+/**
+ * @brief One request of a hedged call, run by its own task
+ */
+typedef struct {
+    struct hedge_race_s *race;
+    hedge_winner_t self;
+    xai_http_client_t *http;
+    xai_client_t owner;             /**< Backup: client of the connection, destroyed by the task */
+    char *body;                     /**< Own copy: the request may outlive the call */
+    size_t body_len;
+    bool launched;                  /**< Task started (guarded by the race lock) */
+    bool finished;                  /**< Guarded by the race lock */
+    bool detached;                  /**< Primary: the client moved on to a new connection */
+    xai_err_t err;
+    xai_response_t response;        /**< The winner's goes to the caller */
+    xai_request_outcome_t outcome;
+} hedge_request_t;
+
+/**
+ * @brief One hedged call; freed by whichever of the caller and the
+ *        request tasks lets go of it last
+ */
+typedef struct hedge_race_s {
+    atomic_int refs;                /**< Caller plus running requests */
+    SemaphoreHandle_t lock;         /**< Guards the race and request states */
+    SemaphoreHandle_t decided;      /**< Given when the caller may go on */
+    hedge_winner_t winner;
+    bool await_primary;             /**< Caller also waits for a losing primary */
+    uint32_t hold_ms;               /**< xai_hedge_check(): primary waits before sending */
+    xai_buffer_pool_t *pool;        /**< Lent to the primary's connection for the race */
+    xai_placement_t placement;      /**< The client's, for parsing on the request tasks */
+    hedge_request_t request[2];     /**< Primary, backup */
+} hedge_race_t;
+
+static hedge_race_t* hedge_race_create(struct xai_client_s *client, const char *body,
+                                       size_t body_len) {
+    hedge_race_t *race = xai_calloc(1, sizeof(hedge_race_t));
+    if (!race) {
+        return NULL;
+    }
+    race->lock = xSemaphoreCreateMutex();
+    race->decided = xSemaphoreCreateBinary();
+    race->request[0].body = xai_malloc(body_len);
+    race->pool = xai_buffer_pool_create(1, CONFIG_XAI_MAX_RESPONSE_SIZE);
+    if (!race->lock || !race->decided || !race->request[0].body || !race->pool) {
+        if (race->pool) {
+            xai_buffer_pool_destroy(race->pool);
+        }
+        if (race->lock) {
+            vSemaphoreDelete(race->lock);
+        }
+        if (race->decided) {
+            vSemaphoreDelete(race->decided);
+        }
+        free(race->request[0].body);
+        free(race);
+        return NULL;
+    }
+
+    atomic_init(&race->refs, 1);
+    race->winner = HEDGE_UNDECIDED;
+    race->placement = client->placement;
+    for (int i = 0; i < 2; i++) {
+        race->request[i].race = race;
+        race->request[i].self = i == 0 ? HEDGE_PRIMARY : HEDGE_BACKUP;
+    }
+    memcpy(race->request[0].body, body, body_len);
+    race->request[0].body_len = body_len;
+    race->request[0].http = client->http_client;
+    return race;
+}
+
+static void hedge_race_release(hedge_race_t *race) {
+    if (atomic_fetch_sub_explicit(&race->refs, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+    free(race->request[0].body);
+    free(race->request[1].body);
+    xai_buffer_pool_destroy(race->pool);
+    vSemaphoreDelete(race->decided);
+    vSemaphoreDelete(race->lock);
+    free(race);
+}
+
+/**
+ * @brief Decide the race on a first byte; a request that lost aborts
+ *        itself (runs on the task of the request that received it)
+ */
+static void hedge_first_byte(xai_http_client_t *http, void *ctx) {
+    hedge_request_t *request = (hedge_request_t *)ctx;
+    hedge_race_t *race = request->race;
+    xSemaphoreTake(race->lock, portMAX_DELAY);
+    if (race->winner == HEDGE_UNDECIDED) {
+        race->winner = request->self;
+    }
+    bool lost = race->winner != request->self;
+    xSemaphoreGive(race->lock);
+
+    if (lost) {
+        xai_http_abort(http);
+    }
+}
+
+static void hedge_request_task(void *arg) {
+    hedge_request_t *request = (hedge_request_t *)arg;
+    hedge_race_t *race = request->race;
+    xai_http_client_t *http = request->http;
+
+    if (request->self == HEDGE_PRIMARY && race->hold_ms) {
+        vTaskDelay(pdMS_TO_TICKS(race->hold_ms));
+    }
+    http->first_byte_cb = hedge_first_byte;
+    http->first_byte_ctx = request;
+    xai_buffer_t *response_data = NULL;
+    xai_err_t err = xai_http_post(http, "/chat/completions", request->body, request->body_len,
+                                  &response_data, NULL);
+    http->first_byte_cb = NULL;
+    http->first_byte_ctx = NULL;
+    if (err == XAI_OK) {
+        const xai_placement_t *outer = xai_placement_begin(&race->placement);
+        err = xai_json_parse_chat_response(response_data->data, &request->response);
+        xai_placement_end(outer);
+        xai_buffer_pool_release(http->pool, response_data);
+    }
+
+    hedge_request_t *other = &race->request[request->self == HEDGE_PRIMARY ? 1 : 0];
+    xSemaphoreTake(race->lock, portMAX_DELAY);
+    request->err = err;
+    request->finished = true;
+    request->outcome.start_us = http->request_start_us;
+    request->outcome.first_byte_us = http->first_byte_us;
+    request->outcome.end_us = esp_timer_get_time();
+    if (race->winner == HEDGE_UNDECIDED) {
+        // No byte from either: a failed request leaves a running one to answer
+        race->winner = (err != XAI_OK && other->launched && !other->finished)
+                       ? other->self : request->self;
+    }
+    bool won = race->winner == request->self;
+    bool wake = won || (request->self == HEDGE_PRIMARY && race->await_primary);
+    bool detached = request->detached;
+    xSemaphoreGive(race->lock);
+
+    if (!won && err == XAI_OK) {
+        xai_response_free(&request->response);
+    }
+    if (wake) {
+        xSemaphoreGive(race->decided);
+    }
+    if (request->owner) {
+        xai_destroy(request->owner);
+    } else if (detached) {
+        // The client has let go of this connection
+        xai_http_client_destroy(http);
+    }
+    hedge_race_release(race);
+    vTaskDelete(NULL);
+}
+
+static bool hedge_start(hedge_race_t *race, hedge_request_t *request) {
+    atomic_fetch_add(&race->refs, 1);
+    request->launched = xTaskCreate(hedge_request_task, "xai_hedge", CONFIG_XAI_BATCH_TASK_STACK,
+                                    request, uxTaskPriorityGet(NULL), NULL) == pdPASS;
+    if (!request->launched) {
+        atomic_fetch_sub(&race->refs, 1);
+    }
+    return request->launched;
+}
+
+/**
+ * @brief Hedge delay expired: send the backup unless the race is over
+ */
+static void hedge_launch_backup(
+    struct xai_client_s *client,
+    hedge_race_t *race,
+    const xai_message_t *messages,
+    size_t message_count,
+    const xai_options_t *options
+) {
+    hedge_request_t *primary = &race->request[0];
+    hedge_request_t *backup = &race->request[1];
+    xSemaphoreTake(race->lock, portMAX_DELAY);
+    bool go = race->winner == HEDGE_UNDECIDED && !primary->finished;
+    xSemaphoreGive(race->lock);
+    if (!go) {
+        return;
+    }
+
+    // Built here, while the caller's messages are sure to be alive
+    xai_options_t backup_options = *options;
+    backup_options.hedge.enabled = false;
+    if (options->hedge.model) {
+        backup_options.model = options->hedge.model;
+        size_t capacity = primary->body_len + strlen(options->hedge.model) + 1;
+        backup->body = xai_malloc(capacity);
+        if (backup->body &&
+            xai_json_build_chat_request(backup->body, capacity, &backup->body_len, messages,
+                                        message_count, &backup_options,
+                                        client->default_model) != XAI_OK) {
+            free(backup->body);
+            backup->body = NULL;
+        }
+    } else {
+        backup->body = xai_malloc(primary->body_len);
+        if (backup->body) {
+            memcpy(backup->body, primary->body, primary->body_len);
+            backup->body_len = primary->body_len;
+        }
+    }
+    backup->outcome.model = backup_options.model ? backup_options.model : client->default_model;
+
+    // The primary has already routed the request and missed its cache
+    xai_config_t config = xai_client_config(client);
+    config.cache.enabled = false;
+    config.router.enabled = false;
+    backup->owner = backup->body ? xai_create_config(&config) : NULL;
+    if (!backup->owner) {
+        ESP_LOGW(TAG, "No memory for a backup connection");
+        return;
+    }
+    backup->http = ((struct xai_client_s *)backup->owner)->http_client;
+
+    xSemaphoreTake(race->lock, portMAX_DELAY);
+    if (race->winner == HEDGE_UNDECIDED && !primary->finished) {
+        hedge_start(race, backup);
+    }
+    xSemaphoreGive(race->lock);
+
+    if (!backup->launched) {
+        xai_destroy(backup->owner);
+        backup->owner = NULL;
+        return;
+    }
+    client->hedge_stats.hedged++;
+}
+
+/**
+ * @brief Let a primary that lost but is still waiting keep the client's
+ *        connection, and give the client a new one
+ */
+static void hedge_detach_primary(struct xai_client_s *client, hedge_race_t *race) {
+    hedge_request_t *primary = &race->request[0];
+    xai_http_client_t *fresh = xai_http_client_create(client->base_url, client->api_key,
+                                                      client->timeout_ms, client->buffer_pool);
+    xSemaphoreTake(race->lock, portMAX_DELAY);
+    bool running = !primary->finished;
+    if (running && fresh) {
+        primary->detached = true;
+    } else if (running) {
+        race->await_primary = true;
+    }
+    xSemaphoreGive(race->lock);
+
+    if (primary->detached) {
+        fresh->stream_stats = client->http_client->stream_stats;
+        client->http_client = fresh;
+        client->hedge_stats.detached++;
+        return;
+    }
+    xai_http_client_destroy(fresh);
+    if (running) {
+        // No memory for another connection: this one is needed back
+        ESP_LOGW(TAG, "Waiting for the losing request to close");
+        xSemaphoreTake(race->decided, portMAX_DELAY);
+    }
+}
+
+/**
+ * @brief The request without a hedge, when the race cannot be set up
+ */
+static xai_err_t hedge_unhedged(
+    struct xai_client_s *client,
+    const xai_options_t *options,
+    const char *body,
+    size_t body_len,
+    xai_response_t *response,
+    xai_request_outcome_t *outcome
+) {
+    xai_http_client_t *http = client->http_client;
+    xai_buffer_t *response_data = NULL;
+    xai_err_t err = xai_http_post(http, "/chat/completions", body, body_len,
+                                  &response_data, NULL);
+    xai_hedge_record_ttfb(client);
+    *outcome = (xai_request_outcome_t){
+        .model = options->model ? options->model : client->default_model,
+        .start_us = http->request_start_us,
+        .first_byte_us = http->first_byte_us,
+        .end_us = esp_timer_get_time(),
+    };
+    if (err != XAI_OK) {
+        return err;
+    }
+    err = xai_json_parse_chat_response(response_data->data, response);
+    xai_buffer_pool_release(client->buffer_pool, response_data);
+    return err;
+}
+
+/**
+ * @brief A hedged call; hold_ms delays the primary's send (0 outside
+ *        xai_hedge_check())
+ */
+static xai_err_t hedge_run(
+    struct xai_client_s *client,
+    const xai_message_t *messages,
+    size_t message_count,
+    const xai_options_t *options,
+    const char *body,
+    size_t body_len,
+    uint32_t hold_ms,
+    xai_response_t *response,
+    xai_request_outcome_t *outcome,
+    bool *backup_won
+) {
+    client->hedge_stats.calls++;
+    *backup_won = false;
+
+    hedge_race_t *race = hedge_race_create(client, body, body_len);
+    if (!race) {
+        ESP_LOGW(TAG, "No memory to hedge; sending without a backup");
+        return hedge_unhedged(client, options, body, body_len, response, outcome);
+    }
+    race->hold_ms = hold_ms;
+    hedge_request_t *primary = &race->request[0];
+    hedge_request_t *backup = &race->request[1];
+    primary->outcome.model = options->model ? options->model : client->default_model;
+
+    uint32_t delay_ms = options->hedge.delay_ms;
+    if (delay_ms == 0) {
+        delay_ms = client->ttfb_count >= CONFIG_XAI_HEDGE_MIN_SAMPLES
+            ? hedge_ttfb_p95(client) : CONFIG_XAI_HEDGE_DELAY_MS;
+    }
+
+    // A primary that loses may still be receiving after the call returns
+    primary->http->pool = race->pool;
+    int64_t start_us = esp_timer_get_time();
+    if (!hedge_start(race, primary)) {
+        ESP_LOGW(TAG, "Failed to start hedge task; sending without a backup");
+        primary->http->pool = client->buffer_pool;
+        hedge_race_release(race);
+        return hedge_unhedged(client, options, body, body_len, response, outcome);
+    }
+    if (xSemaphoreTake(race->decided, pdMS_TO_TICKS(delay_ms)) != pdTRUE) {
+        hedge_launch_backup(client, race, messages, message_count, options);
+        xSemaphoreTake(race->decided, portMAX_DELAY);
+    }
+
+    xSemaphoreTake(race->lock, portMAX_DELAY);
+    hedge_winner_t winner = race->winner;
+    bool primary_running = !primary->finished;
+    xSemaphoreGive(race->lock);
+    if (primary_running) {
+        hedge_detach_primary(client, race);
+    }
+    if (!primary->detached) {
+        primary->http->pool = client->buffer_pool;
+    }
+
+    // A primary that lost still tells us its first byte was at least this late
+    xSemaphoreTake(race->lock, portMAX_DELAY);
+    xai_request_outcome_t timing = primary->outcome;
+    bool primary_finished = primary->finished;
+    xSemaphoreGive(race->lock);
+    if (primary_finished && timing.first_byte_us != 0) {
+        hedge_ttfb_add(client, (uint32_t)((timing.first_byte_us - timing.start_us) / 1000));
+    } else if (winner == HEDGE_BACKUP) {
+        hedge_ttfb_add(client, (uint32_t)((esp_timer_get_time() - start_us) / 1000));
+    }
+
+    hedge_request_t *won = winner == HEDGE_BACKUP ? backup : primary;
+    if (winner == HEDGE_BACKUP) {
+        *backup_won = true;
+        client->hedge_stats.backup_wins++;
+        ESP_LOGI(TAG, "Backup answered first (hedge delay %" PRIu32 " ms)", delay_ms);
+    }
+    *outcome = won->outcome;
+    xai_err_t err = won->err;
+    if (err == XAI_OK) {
+        *response = won->response;
+    }
+    hedge_race_release(race);
+    return err;
+}
+
+xai_err_t xai_hedge_chat(
+    struct xai_client_s *client,
+    const xai_message_t *messages,
+    size_t message_count,
+    const xai_options_t *options,
+    const char *body,
+    size_t body_len,
+    xai_response_t *response,
+    xai_request_outcome_t *outcome
+) {
+    bool backup_won;
+    return hedge_run(client, messages, message_count, options, body, body_len, 0,
+                     response, outcome, &backup_won);
+}
+
+xai_err_t xai_hedge_check(xai_client_t client, uint32_t primary_delay_ms,
+                          xai_hedge_check_t *result) {
+    if (!client || primary_delay_ms == 0 || !result) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    struct xai_client_s *impl = (struct xai_client_s *)client;
+    if (impl->static_storage) {
+        return XAI_ERR_NOT_SUPPORTED;
+    }
+    memset(result, 0, sizeof(*result));
+
+    xai_message_t message = { .role = XAI_ROLE_USER, .content = "Reply with OK." };
+    xai_options_t options = xai_options_default();
+    options.max_tokens = 8;
+    options.hedge.enabled = true;
+    options.hedge.delay_ms = primary_delay_ms / 4;
+    result->hedge_delay_ms = options.hedge.delay_ms;
+
+    xai_err_t err = xai_client_lock(impl, XAI_ENDPOINT_CHAT, XAI_PRIORITY_NORMAL);
+    if (err != XAI_OK) {
+        return err;
+    }
+    xai_buffer_t *request_buffer = xai_buffer_pool_acquire(impl->buffer_pool,
+                                                           XAI_POOL_ACQUIRE_TIMEOUT_MS);
+    if (!request_buffer) {
+        xai_client_unlock(impl);
+        return XAI_ERR_NO_MEMORY;
+    }
+    size_t request_len = 0;
+    err = xai_json_build_chat_request(request_buffer->data, request_buffer->capacity,
+                                      &request_len, &message, 1, &options,
+                                      impl->default_model);
+    xai_response_t response;
+    xai_request_outcome_t outcome;
+    int64_t start_us = esp_timer_get_time();
+    if (err == XAI_OK) {
+        err = hedge_run(impl, &message, 1, &options, request_buffer->data, request_len,
+                        primary_delay_ms, &response, &outcome, &result->backup_won);
+    }
+    result->elapsed_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    xai_buffer_pool_release(impl->buffer_pool, request_buffer);
+    xai_client_unlock(impl);
+
+    if (err != XAI_OK) {
+        ESP_LOGE(TAG, "Hedge check failed: %d", err);
+        return err;
+    }
+    xai_response_free(&response);
+
+    // The held primary cannot have a first byte before its hold ends
+    if (!result->backup_won || result->elapsed_ms >= primary_delay_ms) {
+        ESP_LOGE(TAG, "Hedge check: returned after %" PRIu32 " ms, primary held %" PRIu32
+                 " ms, backup %s", result->elapsed_ms, primary_delay_ms,
+                 result->backup_won ? "won" : "lost");
+        return XAI_ERR_TIMEOUT;
+    }
+    ESP_LOGI(TAG, "Hedge check: backup answered in %" PRIu32 " ms, primary held %" PRIu32 " ms",
+             result->elapsed_ms, primary_delay_ms);
+    return XAI_OK;
+}
+
+xai_err_t xai_get_hedge_stats(xai_client_t client, xai_hedge_stats_t *stats) {
+    if (!client || !stats) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    struct xai_client_s *impl = (struct xai_client_s *)client;
+    if (xSemaphoreTake(impl->mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        return XAI_ERR_TIMEOUT;
+    }
+    *stats = impl->hedge_stats;
+    xSemaphoreGive(impl->mutex);
+    return XAI_OK;
+}
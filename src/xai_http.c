@@ -6,47 +6,100 @@
  * @license Apache-2.0
  */
 
+#include "sdkconfig.h"
 #include "xai_internal.h"
 #include "esp_log.h"
 #include "esp_http_client.h"
 #include "esp_tls.h"
 #include "esp_crt_bundle.h"
+#include "esp_idf_version.h"
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 
 static const char *TAG = "xai_http";
 
+/**
+ * @brief Close an aborted transfer from the task running it
+ *
+ * xai_http_abort() only raises the flag: cancelling a request while
+ * another task is inside esp_http_client_perform() on it races with the
+ * transfer. The transfer task acts on the flag at its next receive event.
+ */
+static void http_cancel_aborted(xai_http_client_t *client, esp_http_client_handle_t handle) {
+    if (client->abort_closed) {
+        return;
+    }
+    client->abort_closed = true;
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0)
+    // Close the connection so the server stops generating. Older IDF
+    // versions drain the remaining body without delivering it.
+    esp_http_client_cancel_request(handle);
+#endif
+}
+
 // HTTP event handler
 static esp_err_t http_event_handler(esp_http_client_event_t *evt) {
     xai_http_client_t *client = (xai_http_client_t*)evt->user_data;
+
+    // TLS and connection buffers come and go between these events
+    xai_mem_sample();
+
+    if ((evt->event_id == HTTP_EVENT_ON_HEADER || evt->event_id == HTTP_EVENT_ON_DATA) &&
+        client->first_byte_us == 0) {
+        client->first_byte_us = esp_timer_get_time();
+        if (client->first_byte_cb) {
+            client->first_byte_cb(client, client->first_byte_ctx);
+        }
+    }
+
+    if ((evt->event_id == HTTP_EVENT_ON_HEADER || evt->event_id == HTTP_EVENT_ON_DATA) &&
+        client->abort_requested) {
+        http_cancel_aborted(client, evt->client);
+    }
     
     switch (evt->event_id) {
-        case HTTP_EVENT_ON_DATA:
-            if (!esp_http_client_is_chunked_response(evt->client)) {
-                // Non-chunked response
-                if (client->response_buffer) {
-                    size_t new_size = client->response_size + evt->data_len;
-                    if (new_size > client->response_capacity) {
-                        ESP_LOGE(TAG, "Response too large: %zu > %zu", 
-                                 new_size, client->response_capacity);
-                        return ESP_FAIL;
-                    }
-                    memcpy(client->response_buffer + client->response_size,
-                           evt->data, evt->data_len);
-                    client->response_size += evt->data_len;
+        case HTTP_EVENT_ON_HEADER:
+            if (client->validators) {
+                if (strcasecmp(evt->header_key, "ETag") == 0) {
+                    snprintf(client->validators->etag, sizeof(client->validators->etag),
+                             "%s", evt->header_value);
+                } else if (strcasecmp(evt->header_key, "Last-Modified") == 0) {
+                    snprintf(client->validators->last_modified,
+                             sizeof(client->validators->last_modified), "%s", evt->header_value);
                 }
-            } else {
-                // Streaming response (SSE text)
-                if (client->stream_callback) {
+            }
+            break;
+
+        case HTTP_EVENT_ON_DATA:
+            if (client->stream_callback && esp_http_client_is_chunked_response(evt->client)) {
+                // Streaming response (SSE text); skipped once aborted
+                if (!client->abort_requested) {
                     client->stream_callback(evt->data, evt->data_len,
                                           client->stream_user_data);
                 }
+            } else if (client->response) {
+                if (client->abort_requested) {
+                    return ESP_FAIL;
+                }
+                // Buffered response; keep one byte for the terminator
+                xai_buffer_t *buf = client->response;
+                if (buf->used + evt->data_len >= buf->capacity) {
+                    if (!client->response_overflow) {
+                        ESP_LOGE(TAG, "Response too large: > %zu bytes (CONFIG_XAI_MAX_RESPONSE_SIZE)",
+                                 buf->capacity - 1);
+                    }
+                    client->response_overflow = true;
+                    return ESP_FAIL;
+                }
+                memcpy(buf->data + buf->used, evt->data, evt->data_len);
+                buf->used += evt->data_len;
             }
             break;
 
         case HTTP_EVENT_ON_FINISH:
-            if (client->response_buffer) {
-                client->response_buffer[client->response_size] = '\0';
+            if (client->response) {
+                client->response->data[client->response->used] = '\0';
             }
             break;
 
@@ -65,40 +118,15 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt) {
     return ESP_OK;
 }
 
-xai_http_client_t* xai_http_client_create(
+/**
+ * @brief Attach the esp_http_client and default headers to a new handle
+ */
+static xai_err_t http_client_setup(
+    xai_http_client_t *client,
     const char *base_url,
     const char *api_key,
     uint32_t timeout_ms
 ) {
-    if (!base_url || !api_key) {
-        ESP_LOGE(TAG, "Invalid parameters");
-        return NULL;
-    }
-
-    xai_http_client_t *client = calloc(1, sizeof(xai_http_client_t));
-    if (!client) {
-        ESP_LOGE(TAG, "Failed to allocate HTTP client");
-        return NULL;
-    }
-
-    // Store base URL for proper path reconstruction
-    client->base_url = strdup(base_url);
-    if (!client->base_url) {
-        ESP_LOGE(TAG, "Failed to allocate base URL");
-        free(client);
-        return NULL;
-    }
-
-    // Allocate response buffer
-    client->response_capacity = 16384; // 16KB initial buffer
-    client->response_buffer = malloc(client->response_capacity);
-    if (!client->response_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate response buffer");
-        free(client->base_url);
-        free(client);
-        return NULL;
-    }
-
     // Prepare authorization header
     char auth_header[256];
     snprintf(auth_header, sizeof(auth_header), "Bearer %s", api_key);
@@ -118,21 +146,89 @@ xai_http_client_t* xai_http_client_create(
     client->client = esp_http_client_init(&config);
     if (!client->client) {
         ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        free(client->response_buffer);
-        free(client->base_url);
-        free(client);
-        return NULL;
+        return XAI_ERR_NO_MEMORY;
     }
 
     // Set default headers
     esp_http_client_set_header(client->client, "Authorization", auth_header);
     esp_http_client_set_header(client->client, "Content-Type", "application/json");
     esp_http_client_set_header(client->client, "User-Agent", "xai-esp-idf/1.0");
+    return XAI_OK;
+}
+
+xai_http_client_t* xai_http_client_create(
+    const char *base_url,
+    const char *api_key,
+    uint32_t timeout_ms,
+    xai_buffer_pool_t *pool
+) {
+    if (!base_url || !api_key || !pool) {
+        ESP_LOGE(TAG, "Invalid parameters");
+        return NULL;
+    }
+
+    xai_http_client_t *client = xai_calloc(1, sizeof(xai_http_client_t));
+    if (!client) {
+        ESP_LOGE(TAG, "Failed to allocate HTTP client");
+        return NULL;
+    }
+
+    // Store base URL for proper path reconstruction
+    client->base_url = xai_strdup(base_url);
+    if (!client->base_url) {
+        ESP_LOGE(TAG, "Failed to allocate base URL");
+        free(client);
+        return NULL;
+    }
+
+    // Response bodies are stored in buffers borrowed from the pool
+    client->pool = pool;
+
+    if (http_client_setup(client, base_url, api_key, timeout_ms) != XAI_OK) {
+        free(client->base_url);
+        free(client);
+        return NULL;
+    }
 
     ESP_LOGI(TAG, "HTTP client created");
     return client;
 }
 
+xai_http_client_t* xai_http_client_create_static(
+    xai_static_region_t *region,
+    const char *base_url,
+    const char *api_key,
+    uint32_t timeout_ms,
+    xai_buffer_pool_t *pool
+) {
+    if (!region || !base_url || !api_key || !pool) {
+        ESP_LOGE(TAG, "Invalid parameters");
+        return NULL;
+    }
+
+    xai_http_client_t *client = xai_static_take(region, sizeof(xai_http_client_t));
+    if (!client) {
+        ESP_LOGE(TAG, "No static memory for HTTP client");
+        return NULL;
+    }
+    client->static_storage = true;
+    client->base_url = (char *)base_url;
+    client->pool = pool;
+
+    // Created up front: a stream must not allocate its parser
+    client->stream_parser = xai_stream_parser_create_static(region);
+    if (!client->stream_parser) {
+        return NULL;
+    }
+
+    if (http_client_setup(client, base_url, api_key, timeout_ms) != XAI_OK) {
+        return NULL;
+    }
+
+    ESP_LOGI(TAG, "HTTP client created (static)");
+    return client;
+}
+
 void xai_http_client_destroy(xai_http_client_t *client) {
     if (!client) return;
 
@@ -140,19 +236,103 @@ void xai_http_client_destroy(xai_http_client_t *client) {
         esp_http_client_cleanup(client->client);
     }
 
-    free(client->base_url);
-    free(client->response_buffer);
-    free(client);
+    xai_stream_parser_destroy(client->stream_parser);
+#ifdef CONFIG_XAI_STREAM_PIPELINE
+    xai_stream_pipeline_destroy(client->pipeline);
+#endif
+    if (!client->static_storage) {
+        free(client->base_url);
+        free(client);
+    }
 
     ESP_LOGI(TAG, "HTTP client destroyed");
 }
 
+/**
+ * @brief Borrow a pool buffer to receive the next response body
+ */
+static xai_err_t http_begin_response(xai_http_client_t *client) {
+    xai_mem_phase(XAI_MEM_PHASE_TRANSFER);
+    client->response = xai_buffer_pool_acquire(client->pool, XAI_POOL_ACQUIRE_TIMEOUT_MS);
+    if (!client->response) {
+        ESP_LOGE(TAG, "No response buffer available");
+        return XAI_ERR_NO_MEMORY;
+    }
+    client->response_overflow = false;
+    client->abort_requested = false;
+    client->abort_closed = false;
+    client->stream_callback = NULL;
+    client->stream_user_data = NULL;
+    client->request_start_us = esp_timer_get_time();
+    client->first_byte_us = 0;
+    return XAI_OK;
+}
+
+/**
+ * @brief Check the outcome of a buffered request and hand the body over
+ */
+static xai_err_t http_end_response(
+    xai_http_client_t *client,
+    esp_err_t perform_err,
+    xai_buffer_t **response,
+    size_t *response_len
+) {
+    xai_buffer_t *buf = client->response;
+    client->response = NULL;
+    xai_mem_phase(XAI_MEM_PHASE_PARSE);
+
+    xai_err_t err = XAI_OK;
+    if (client->abort_requested) {
+        client->abort_requested = false;
+        err = XAI_ERR_CANCELLED;
+    } else if (client->response_overflow) {
+        err = XAI_ERR_NO_MEMORY;
+    } else if (perform_err != ESP_OK) {
+        ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(perform_err));
+        err = XAI_ERR_HTTP_FAILED;
+    } else {
+        // Check status code
+        int status_code = esp_http_client_get_status_code(client->client);
+        ESP_LOGI(TAG, "HTTP Status: %d, Response: %zu bytes", status_code, buf->used);
+
+        if (status_code < 200 || status_code >= 300) {
+            ESP_LOGW(TAG, "HTTP error status: %d", status_code);
+
+            // Log error response if available
+            if (buf->used > 0) {
+                buf->data[buf->used] = '\0';
+                ESP_LOGW(TAG, "Error response: %s", buf->data);
+            }
+
+            if (status_code == 401) {
+                err = XAI_ERR_AUTH_FAILED;
+            } else if (status_code == 429) {
+                err = XAI_ERR_RATE_LIMIT;
+            } else {
+                err = XAI_ERR_API_ERROR;
+            }
+        }
+    }
+
+    if (err != XAI_OK) {
+        xai_buffer_pool_release(client->pool, buf);
+        return err;
+    }
+
+    buf->data[buf->used] = '\0';
+    *response = buf;
+    if (response_len) {
+        *response_len = buf->used;
+    }
+    return XAI_OK;
+}
+
 xai_err_t xai_http_post(
     xai_http_client_t *client,
     const char *path,
     const char *body,
     size_t body_len,
-    char **response,
+    xai_buffer_t **response,
     size_t *response_len
 ) {
     if (!client || !path || !body || !response) {
@@ -162,10 +342,10 @@ xai_err_t xai_http_post(
 
     ESP_LOGD(TAG, "POST %s (%zu bytes)", path, body_len);
 
-    // Reset response buffer
-    client->response_size = 0;
-    client->stream_callback = NULL;
-    client->stream_user_data = NULL;
+    xai_err_t err = http_begin_response(client);
+    if (err != XAI_OK) {
+        return err;
+    }
 
     // Construct full URL from base URL + path
     char full_url[512];
@@ -177,76 +357,101 @@ xai_err_t xai_http_post(
     esp_http_client_set_post_field(client->client, body, body_len);
 
     // Perform request
-    esp_err_t err = esp_http_client_perform(client->client);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
-        return XAI_ERR_HTTP_FAILED;
+    esp_err_t perform_err = esp_http_client_perform(client->client);
+    return http_end_response(client, perform_err, response, response_len);
+}
+
+/**
+ * @brief Re-arm the client's SSE parser over storage, creating it on first use
+ */
+static xai_stream_parser_t* http_stream_parser(
+    xai_http_client_t *client,
+    xai_stream_callback_t callback,
+    xai_stream_event_callback_t event_callback,
+    void *user_data,
+    xai_buffer_t *storage
+) {
+    if (!client->stream_parser) {
+        client->stream_parser = event_callback
+            ? xai_stream_parser_create_events(event_callback, user_data)
+            : xai_stream_parser_create(callback, user_data);
     }
 
-    // Check status code
-    int status_code = esp_http_client_get_status_code(client->client);
-    ESP_LOGI(TAG, "HTTP Status: %d, Response: %zu bytes", status_code, client->response_size);
+    if (!client->stream_parser ||
+        xai_stream_parser_reset(client->stream_parser, callback, event_callback,
+                                user_data, storage) != XAI_OK) {
+        ESP_LOGE(TAG, "Failed to create SSE parser");
+        return NULL;
+    }
+    return client->stream_parser;
+}
 
-    if (status_code < 200 || status_code >= 300) {
-        ESP_LOGW(TAG, "HTTP error status: %d", status_code);
-        
-        // Parse error response if available
-        if (client->response_size > 0) {
-            ESP_LOGW(TAG, "Error response: %s", client->response_buffer);
-        }
-        
-        if (status_code == 401) {
-            return XAI_ERR_AUTH_FAILED;
-        } else if (status_code == 429) {
-            return XAI_ERR_RATE_LIMIT;
-        } else {
-            return XAI_ERR_API_ERROR;
+/**
+ * @brief Whether this stream goes through the pipeline, creating it on
+ *        first use; the per-call mode falls back to AUTO afterwards
+ */
+static bool http_stream_pipelined(xai_http_client_t *client) {
+    xai_stream_pipeline_mode_t mode = client->pipeline_mode;
+    client->pipeline_mode = XAI_STREAM_PIPELINE_AUTO;
+
+#ifdef CONFIG_XAI_STREAM_PIPELINE
+    // The queue and worker would be heap allocations
+    if (mode == XAI_STREAM_PIPELINE_OFF || client->static_storage) {
+        return false;
+    }
+    if (!client->pipeline) {
+        client->pipeline = xai_stream_pipeline_create();
+        if (!client->pipeline) {
+            ESP_LOGW(TAG, "No stream pipeline; parsing on the receiving task");
         }
     }
-
-    // Copy response
-    *response = malloc(client->response_size + 1);
-    if (!*response) {
-        ESP_LOGE(TAG, "Failed to allocate response");
-        return XAI_ERR_NO_MEMORY;
+    return client->pipeline != NULL;
+#else
+    if (mode == XAI_STREAM_PIPELINE_ON) {
+        ESP_LOGD(TAG, "Stream pipeline not built in (CONFIG_XAI_STREAM_PIPELINE)");
     }
+    return false;
+#endif
+}
 
-    memcpy(*response, client->response_buffer, client->response_size);
-    (*response)[client->response_size] = '\0';
-    
-    if (response_len) {
-        *response_len = client->response_size;
+static void http_stream_latency_add(xai_stream_latency_t *total, const xai_stream_latency_t *stream) {
+    total->streams += stream->streams;
+    total->deltas += stream->deltas;
+    total->gaps += stream->gaps;
+    total->gap_us += stream->gap_us;
+    if (stream->max_gap_us > total->max_gap_us) {
+        total->max_gap_us = stream->max_gap_us;
     }
-
-    return XAI_OK;
 }
 
-xai_err_t xai_http_post_stream(
+/**
+ * @brief Perform a streaming POST through the client's SSE parser
+ */
+static xai_err_t http_post_stream_parser(
     xai_http_client_t *client,
     const char *path,
     const char *body,
     size_t body_len,
-    xai_stream_callback_t callback,
-    void *user_data
+    xai_stream_parser_t *parser
 ) {
-    if (!client || !path || !body || !callback) {
-        ESP_LOGE(TAG, "Invalid parameters");
-        return XAI_ERR_INVALID_ARG;
-    }
-
     ESP_LOGD(TAG, "POST (stream) %s (%zu bytes)", path, body_len);
 
-    // Create SSE parser
-    xai_stream_parser_t *parser = xai_stream_parser_create(callback, user_data);
-    if (!parser) {
-        ESP_LOGE(TAG, "Failed to create SSE parser");
-        return XAI_ERR_NO_MEMORY;
-    }
-
-    // Set streaming mode with SSE parsing
-    client->response_size = 0;
+    // Set streaming mode with SSE parsing, here or on the pipeline worker
+    bool pipelined = http_stream_pipelined(client);
+    client->response = NULL;
+    client->abort_requested = false;
+    client->abort_closed = false;
     client->stream_callback = xai_stream_parser_feed;
     client->stream_user_data = parser;
+    client->request_start_us = esp_timer_get_time();
+    client->first_byte_us = 0;
+#ifdef CONFIG_XAI_STREAM_PIPELINE
+    if (pipelined) {
+        client->stream_callback = xai_stream_pipeline_feed;
+        client->stream_user_data = client->pipeline;
+        xai_stream_pipeline_begin(client->pipeline, client, parser);
+    }
+#endif
 
     // Construct full URL from base URL + path
     char full_url[512];
@@ -257,8 +462,30 @@ xai_err_t xai_http_post_stream(
     esp_http_client_set_method(client->client, HTTP_METHOD_POST);
     esp_http_client_set_post_field(client->client, body, body_len);
 
-    // Perform request (streaming)
+    // Perform request (streaming); events are parsed during the transfer
+    xai_mem_phase(XAI_MEM_PHASE_TRANSFER);
     esp_err_t err = esp_http_client_perform(client->client);
+#ifdef CONFIG_XAI_STREAM_PIPELINE
+    if (pipelined) {
+        // Everything received is parsed and delivered before we go on
+        xai_stream_pipeline_end(client->pipeline, &client->stream_stats);
+        client->stream_stats.wall_us += esp_timer_get_time() - client->request_start_us;
+    }
+#endif
+
+    // Deliver an event left unterminated at end of body
+    if (err == ESP_OK && !client->abort_requested) {
+        xai_stream_parser_finish(parser);
+    }
+    http_stream_latency_add(pipelined ? &client->stream_stats.pipelined
+                                      : &client->stream_stats.direct,
+                            &parser->latency);
+
+    if (client->abort_requested) {
+        ESP_LOGW(TAG, "Streaming request aborted");
+        client->abort_requested = false;
+        return XAI_ERR_CANCELLED;
+    }
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "HTTP streaming request failed: %s", esp_err_to_name(err));
         return XAI_ERR_HTTP_FAILED;
@@ -288,16 +515,119 @@ xai_err_t xai_http_post_stream(
         }
     }
 
-    // Clean up parser
-    xai_stream_parser_destroy(parser);
+    xai_err_t stream_err = parser->error;
+    if (stream_err != XAI_OK) {
+        ESP_LOGE(TAG, "Stream completed with error: %d", stream_err);
+        return stream_err;
+    }
 
     return XAI_OK;
 }
 
+/**
+ * @brief Streaming POST with the SSE event buffer borrowed from the pool
+ */
+static xai_err_t http_post_stream_pooled(
+    xai_http_client_t *client,
+    const char *path,
+    const char *body,
+    size_t body_len,
+    xai_stream_callback_t callback,
+    xai_stream_event_callback_t event_callback,
+    void *user_data
+) {
+    xai_buffer_t *sse_buffer = xai_buffer_pool_acquire(client->pool, XAI_POOL_ACQUIRE_TIMEOUT_MS);
+    if (!sse_buffer) {
+        ESP_LOGE(TAG, "No SSE buffer available");
+        return XAI_ERR_NO_MEMORY;
+    }
+
+    xai_err_t err = XAI_ERR_NO_MEMORY;
+    xai_stream_parser_t *parser = http_stream_parser(client, callback, event_callback,
+                                                     user_data, sse_buffer);
+    if (parser) {
+        err = http_post_stream_parser(client, path, body, body_len, parser);
+    }
+
+    xai_buffer_pool_release(client->pool, sse_buffer);
+    return err;
+}
+
+xai_err_t xai_http_post_stream(
+    xai_http_client_t *client,
+    const char *path,
+    const char *body,
+    size_t body_len,
+    xai_stream_callback_t callback,
+    void *user_data
+) {
+    if (!client || !path || !body || !callback) {
+        ESP_LOGE(TAG, "Invalid parameters");
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    return http_post_stream_pooled(client, path, body, body_len, callback, NULL, user_data);
+}
+
+xai_err_t xai_http_post_stream_events(
+    xai_http_client_t *client,
+    const char *path,
+    const char *body,
+    size_t body_len,
+    xai_stream_event_callback_t callback,
+    void *user_data
+) {
+    if (!client || !path || !body || !callback) {
+        ESP_LOGE(TAG, "Invalid parameters");
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    return http_post_stream_pooled(client, path, body, body_len, NULL, callback, user_data);
+}
+
+xai_err_t xai_http_stream_replay(
+    xai_http_client_t *client,
+    const char *body,
+    size_t body_len,
+    size_t chunk_size,
+    xai_stream_callback_t callback,
+    void *user_data
+) {
+    if (!client || !body || chunk_size == 0 || !callback) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    xai_buffer_t *sse_buffer = xai_buffer_pool_acquire(client->pool, XAI_POOL_ACQUIRE_TIMEOUT_MS);
+    if (!sse_buffer) {
+        ESP_LOGE(TAG, "No SSE buffer available");
+        return XAI_ERR_NO_MEMORY;
+    }
+
+    xai_err_t err = XAI_ERR_NO_MEMORY;
+    xai_stream_parser_t *parser = http_stream_parser(client, callback, NULL, user_data, sse_buffer);
+    if (parser) {
+        for (size_t off = 0; off < body_len; off += chunk_size) {
+            size_t n = body_len - off < chunk_size ? body_len - off : chunk_size;
+            xai_stream_parser_feed(body + off, n, parser);
+        }
+        xai_stream_parser_finish(parser);
+        err = parser->error;
+    }
+
+    xai_buffer_pool_release(client->pool, sse_buffer);
+    return err;
+}
+
+void xai_http_abort(xai_http_client_t *client) {
+    if (client) {
+        client->abort_requested = true;
+    }
+}
+
 xai_err_t xai_http_get(
     xai_http_client_t *client,
     const char *path,
-    char **response,
+    xai_buffer_t **response,
     size_t *response_len
 ) {
     if (!client || !path || !response) {
@@ -307,10 +637,10 @@ xai_err_t xai_http_get(
 
     ESP_LOGD(TAG, "GET %s", path);
 
-    // Reset response buffer
-    client->response_size = 0;
-    client->stream_callback = NULL;
-    client->stream_user_data = NULL;
+    xai_err_t err = http_begin_response(client);
+    if (err != XAI_OK) {
+        return err;
+    }
 
     // Construct full URL from base URL + path
     char full_url[512];
@@ -321,42 +651,66 @@ xai_err_t xai_http_get(
     esp_http_client_set_method(client->client, HTTP_METHOD_GET);
 
     // Perform request
-    esp_err_t err = esp_http_client_perform(client->client);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "HTTP GET failed: %s", esp_err_to_name(err));
-        return XAI_ERR_HTTP_FAILED;
+    esp_err_t perform_err = esp_http_client_perform(client->client);
+    return http_end_response(client, perform_err, response, response_len);
+}
+
+xai_err_t xai_http_get_conditional(
+    xai_http_client_t *client,
+    const char *path,
+    xai_http_validators_t *validators,
+    xai_buffer_t **response,
+    size_t *response_len,
+    bool *not_modified
+) {
+    if (!client || !path || !validators || !response || !not_modified) {
+        ESP_LOGE(TAG, "Invalid parameters");
+        return XAI_ERR_INVALID_ARG;
     }
 
-    // Check status code
-    int status_code = esp_http_client_get_status_code(client->client);
-    ESP_LOGI(TAG, "HTTP Status: %d, Response: %zu bytes", status_code, client->response_size);
+    ESP_LOGD(TAG, "GET %s (If-None-Match: %s)", path, validators->etag);
+    *not_modified = false;
 
-    if (status_code < 200 || status_code >= 300) {
-        ESP_LOGW(TAG, "HTTP error status: %d", status_code);
-        
-        if (status_code == 401) {
-            return XAI_ERR_AUTH_FAILED;
-        } else if (status_code == 429) {
-            return XAI_ERR_RATE_LIMIT;
-        } else {
-            return XAI_ERR_API_ERROR;
-        }
+    xai_err_t err = http_begin_response(client);
+    if (err != XAI_OK) {
+        return err;
     }
 
-    // Copy response
-    *response = malloc(client->response_size + 1);
-    if (!*response) {
-        ESP_LOGE(TAG, "Failed to allocate response");
-        return XAI_ERR_NO_MEMORY;
+    char full_url[512];
+    snprintf(full_url, sizeof(full_url), "%s%s", client->base_url, path);
+    esp_http_client_set_url(client->client, full_url);
+    esp_http_client_set_method(client->client, HTTP_METHOD_GET);
+
+    // Headers persist on the handle: remove them again after this request
+    if (validators->etag[0]) {
+        esp_http_client_set_header(client->client, "If-None-Match", validators->etag);
+    }
+    if (validators->last_modified[0]) {
+        esp_http_client_set_header(client->client, "If-Modified-Since", validators->last_modified);
     }
 
-    memcpy(*response, client->response_buffer, client->response_size);
-    (*response)[client->response_size] = '\0';
-    
-    if (response_len) {
-        *response_len = client->response_size;
+    xai_http_validators_t received = {0};
+    client->validators = &received;
+    esp_err_t perform_err = esp_http_client_perform(client->client);
+    client->validators = NULL;
+
+    esp_http_client_delete_header(client->client, "If-None-Match");
+    esp_http_client_delete_header(client->client, "If-Modified-Since");
+
+    if (perform_err == ESP_OK && !client->abort_requested &&
+        esp_http_client_get_status_code(client->client) == 304) {
+        xai_buffer_pool_release(client->pool, client->response);
+        client->response = NULL;
+        *not_modified = true;
+        if (received.etag[0]) {
+            memcpy(validators->etag, received.etag, sizeof(received.etag));
+        }
+        return XAI_OK;
     }
 
-    return XAI_OK;
+    err = http_end_response(client, perform_err, response, response_len);
+    if (err == XAI_OK) {
+        *validators = received;
+    }
+    return err;
 }
-
@@ -52,9 +52,10 @@ xai_err_t xai_generate_image(
     xai_err_t err = XAI_OK;
 
     // Acquire client mutex
-    if (xSemaphoreTake(client_impl->mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
-        ESP_LOGE(TAG, "Failed to acquire mutex");
-        return XAI_ERR_TIMEOUT;
+    err = xai_client_lock(client_impl, XAI_ENDPOINT_IMAGES, XAI_PRIORITY_NORMAL);
+    if (err != XAI_OK) {
+        ESP_LOGE(TAG, "Failed to start request: %s", xai_err_to_string(err));
+        return err;
     }
 
     memset(response, 0, sizeof(xai_image_response_t));
@@ -63,7 +64,7 @@ xai_err_t xai_generate_image(
     cJSON *root = cJSON_CreateObject();
     if (!root) {
         ESP_LOGE(TAG, "Failed to create JSON object");
-        xSemaphoreGive(client_impl->mutex);
+        xai_client_unlock(client_impl);
         return XAI_ERR_NO_MEMORY;
     }
 
@@ -86,48 +87,52 @@ xai_err_t xai_generate_image(
     // NOTE: xAI does NOT support size, quality, style, or user parameters
     // These are silently ignored if provided in the request struct
 
-    char *request_json = cJSON_PrintUnformatted(root);
+    // Serialize straight into a pool buffer; the body size is known, so a
+    // small buffer usually fits
+    xai_buffer_t *request_json = xai_json_print_pooled(client_impl->buffer_pool, root,
+                                                       strlen(request->prompt) + strlen(model) + 128);
     cJSON_Delete(root);
 
     if (!request_json) {
         ESP_LOGE(TAG, "Failed to serialize JSON");
-        xSemaphoreGive(client_impl->mutex);
+        xai_client_unlock(client_impl);
         return XAI_ERR_NO_MEMORY;
     }
 
-    size_t request_len = strlen(request_json);
+    size_t request_len = strlen(request_json->data);
     ESP_LOGI(TAG, "Generating %u image(s): \"%s\" (model: %s, format: %s)", 
              n, request->prompt, model, format);
 
     // Send HTTP POST request
-    char *response_data = NULL;
+    xai_buffer_t *response_data = NULL;
     size_t response_len = 0;
     err = xai_http_post(
         client_impl->http_client,
         "/images/generations",
-        request_json,
+        request_json->data,
         request_len,
         &response_data,
         &response_len
     );
 
-    free(request_json);
+    xai_buffer_pool_release(client_impl->buffer_pool, request_json);
 
     if (err != XAI_OK) {
         ESP_LOGE(TAG, "HTTP request failed: %d", err);
-        xSemaphoreGive(client_impl->mutex);
+        xai_client_unlock(client_impl);
         return err;
     }
 
-    ESP_LOGD(TAG, "Response: %.*s", (int)response_len, response_data);
+    ESP_LOGD(TAG, "Response: %.*s", (int)response_len, response_data->data);
 
     // Parse response
-    cJSON *resp_json = cJSON_Parse(response_data);
-    free(response_data);
+    cJSON *resp_json = cJSON_Parse(response_data->data);
+    xai_mem_sample();
+    xai_buffer_pool_release(client_impl->buffer_pool, response_data);
 
     if (!resp_json) {
         ESP_LOGE(TAG, "Failed to parse response JSON");
-        xSemaphoreGive(client_impl->mutex);
+        xai_client_unlock(client_impl);
         return XAI_ERR_PARSE_FAILED;
     }
 
@@ -139,7 +144,7 @@ xai_err_t xai_generate_image(
             ESP_LOGE(TAG, "API error: %s", message->valuestring);
         }
         cJSON_Delete(resp_json);
-        xSemaphoreGive(client_impl->mutex);
+        xai_client_unlock(client_impl);
         return XAI_ERR_API_ERROR;
     }
 
@@ -154,7 +159,7 @@ xai_err_t xai_generate_image(
     if (!data || !cJSON_IsArray(data)) {
         ESP_LOGE(TAG, "Missing or invalid data array in response");
         cJSON_Delete(resp_json);
-        xSemaphoreGive(client_impl->mutex);
+        xai_client_unlock(client_impl);
         return XAI_ERR_PARSE_FAILED;
     }
 
@@ -162,16 +167,16 @@ xai_err_t xai_generate_image(
     if (response->image_count == 0) {
         ESP_LOGE(TAG, "Empty data array in response");
         cJSON_Delete(resp_json);
-        xSemaphoreGive(client_impl->mutex);
+        xai_client_unlock(client_impl);
         return XAI_ERR_PARSE_FAILED;
     }
 
     // Allocate image data array
-    response->images = calloc(response->image_count, sizeof(xai_image_data_t));
+    response->images = xai_calloc(response->image_count, sizeof(xai_image_data_t));
     if (!response->images) {
         ESP_LOGE(TAG, "Failed to allocate image data array");
         cJSON_Delete(resp_json);
-        xSemaphoreGive(client_impl->mutex);
+        xai_client_unlock(client_impl);
         return XAI_ERR_NO_MEMORY;
     }
 
@@ -182,23 +187,23 @@ xai_err_t xai_generate_image(
         // URL or b64_json
         cJSON *url = cJSON_GetObjectItem(item, "url");
         if (url && cJSON_IsString(url)) {
-            response->images[i].url = strdup(url->valuestring);
+            response->images[i].url = xai_strdup(url->valuestring);
         }
         
         cJSON *b64_json = cJSON_GetObjectItem(item, "b64_json");
         if (b64_json && cJSON_IsString(b64_json)) {
-            response->images[i].b64_json = strdup(b64_json->valuestring);
+            response->images[i].b64_json = xai_strdup(b64_json->valuestring);
         }
         
         // Revised prompt
         cJSON *revised_prompt = cJSON_GetObjectItem(item, "revised_prompt");
         if (revised_prompt && cJSON_IsString(revised_prompt)) {
-            response->images[i].revised_prompt = strdup(revised_prompt->valuestring);
+            response->images[i].revised_prompt = xai_strdup(revised_prompt->valuestring);
         }
     }
 
     cJSON_Delete(resp_json);
-    xSemaphoreGive(client_impl->mutex);
+    xai_client_unlock(client_impl);
 
     ESP_LOGI(TAG, "Image generation successful (%zu images)", response->image_count);
     return XAI_OK;
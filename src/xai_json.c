@@ -374,33 +374,71 @@ xai_err_t xai_json_build_chat_request(
                 cJSON_AddItemToArray(tools_array, tool);
             }
             cJSON_AddItemToObject(root, "tools", tools_array);
+
+            // "auto", "none" and "required" as they are, anything else names a function
+            const char *choice = options->tool_choice;
+            if (choice && (strcmp(choice, "auto") == 0 || strcmp(choice, "none") == 0 ||
+                           strcmp(choice, "required") == 0)) {
+                cJSON_AddStringToObject(root, "tool_choice", choice);
+            } else if (choice) {
+                cJSON *forced = cJSON_CreateObject();
+                cJSON_AddStringToObject(forced, "type", "function");
+                cJSON *function = cJSON_CreateObject();
+                cJSON_AddStringToObject(function, "name", choice);
+                cJSON_AddItemToObject(forced, "function", function);
+                cJSON_AddItemToObject(root, "tool_choice", forced);
+            }
         }
     }
 
-    // Serialize to buffer
-    char *json_str = cJSON_PrintUnformatted(root);
+    // Serialize straight into the caller's buffer (no intermediate heap copy)
+    cJSON_bool printed = cJSON_PrintPreallocated(root, buffer, (int)buffer_size, false);
     cJSON_Delete(root);
 
-    if (!json_str) {
-        ESP_LOGE(TAG, "Failed to serialize JSON");
+    if (!printed) {
+        ESP_LOGE(TAG, "JSON too large for buffer (%zu bytes)", buffer_size);
         return XAI_ERR_NO_MEMORY;
     }
 
-    size_t json_len = strlen(json_str);
-    if (json_len >= buffer_size) {
-        ESP_LOGE(TAG, "JSON too large for buffer: %zu >= %zu", json_len, buffer_size);
-        free(json_str);
-        return XAI_ERR_NO_MEMORY;
+    *bytes_written = strlen(buffer);
+
+    ESP_LOGD(TAG, "Built request JSON (%zu bytes)", *bytes_written);
+    return XAI_OK;
+}
+
+xai_buffer_t* xai_json_print_pooled(
+    xai_buffer_pool_t *pool,
+    const cJSON *root,
+    size_t size_hint
+) {
+    size_t largest = pool->classes[pool->class_count - 1].buffer_size;
+    if (size_hint > largest) {
+        size_hint = largest;
     }
 
-    memcpy(buffer, json_str, json_len);
-    buffer[json_len] = '\0';
-    *bytes_written = json_len;
+    xai_buffer_t *buffer = xai_buffer_pool_acquire_size(pool, size_hint, XAI_POOL_ACQUIRE_TIMEOUT_MS);
+    if (buffer && cJSON_PrintPreallocated((cJSON *)root, buffer->data, (int)buffer->capacity, false)) {
+        return buffer;
+    }
 
-    free(json_str);
+    // The hint was too small (escaping): retry in a full-size buffer
+    size_t tried = buffer ? buffer->capacity : 0;
+    xai_buffer_pool_release(pool, buffer);
+    buffer = NULL;
+    if (tried > 0) {
+        buffer = xai_buffer_pool_acquire(pool, XAI_POOL_ACQUIRE_TIMEOUT_MS);
+        if (buffer && (buffer->capacity <= tried ||
+                       !cJSON_PrintPreallocated((cJSON *)root, buffer->data,
+                                                (int)buffer->capacity, false))) {
+            xai_buffer_pool_release(pool, buffer);
+            buffer = NULL;
+        }
+    }
 
-    ESP_LOGD(TAG, "Built request JSON (%zu bytes)", json_len);
-    return XAI_OK;
+    if (!buffer) {
+        ESP_LOGE(TAG, "Failed to serialize JSON into a pool buffer");
+    }
+    return buffer;
 }
 
 /* ========================================================================
@@ -443,12 +481,16 @@ xai_err_t xai_json_parse_chat_response(
     }
 
     memset(response, 0, sizeof(xai_response_t));
+    // Static clients: fields live in client storage, not on the heap
+    response->_internal = xai_response_storage();
 
     cJSON *root = cJSON_Parse(json_str);
     if (!root) {
         ESP_LOGE(TAG, "Failed to parse JSON response");
         return XAI_ERR_PARSE_FAILED;
     }
+    // The DOM is complete here (and gone before the call ends)
+    xai_mem_sample();
 
     // Check for error response
     cJSON *error = cJSON_GetObjectItem(root, "error");
@@ -478,7 +520,7 @@ xai_err_t xai_json_parse_chat_response(
     // Parse model
     cJSON *model = cJSON_GetObjectItem(root, "model");
     if (model && cJSON_IsString(model)) {
-        response->model = strdup(model->valuestring);
+        response->model = xai_response_strdup(model->valuestring);
     }
 
     // Parse choices
@@ -501,13 +543,13 @@ xai_err_t xai_json_parse_chat_response(
     if (message) {
         cJSON *content = cJSON_GetObjectItem(message, "content");
         if (content && cJSON_IsString(content) && content->valuestring) {
-            response->content = strdup(content->valuestring);
+            response->content = xai_response_strdup(content->valuestring);
         }
 
         // Parse reasoning content (grok-4 models with reasoning)
         cJSON *reasoning_content = cJSON_GetObjectItem(message, "reasoning_content");
         if (reasoning_content && cJSON_IsString(reasoning_content) && reasoning_content->valuestring) {
-            response->reasoning_content = strdup(reasoning_content->valuestring);
+            response->reasoning_content = xai_response_strdup(reasoning_content->valuestring);
         }
 
         // Parse tool calls
@@ -515,7 +557,7 @@ xai_err_t xai_json_parse_chat_response(
         if (tool_calls && cJSON_IsArray(tool_calls)) {
             response->tool_call_count = cJSON_GetArraySize(tool_calls);
             if (response->tool_call_count > 0) {
-                response->tool_calls = calloc(response->tool_call_count, sizeof(xai_tool_call_t));
+                response->tool_calls = xai_response_calloc(response->tool_call_count, sizeof(xai_tool_call_t));
                 if (response->tool_calls) {
                     for (size_t i = 0; i < response->tool_call_count; i++) {
                         cJSON *tc = cJSON_GetArrayItem(tool_calls, i);
@@ -523,7 +565,7 @@ xai_err_t xai_json_parse_chat_response(
                         cJSON *function = cJSON_GetObjectItem(tc, "function");
                         
                         if (id && cJSON_IsString(id)) {
-                            response->tool_calls[i].id = strdup(id->valuestring);
+                            response->tool_calls[i].id = xai_response_strdup(id->valuestring);
                         }
                         
                         if (function) {
@@ -531,10 +573,10 @@ xai_err_t xai_json_parse_chat_response(
                             cJSON *arguments = cJSON_GetObjectItem(function, "arguments");
                             
                             if (name && cJSON_IsString(name)) {
-                                response->tool_calls[i].name = strdup(name->valuestring);
+                                response->tool_calls[i].name = xai_response_strdup(name->valuestring);
                             }
                             if (arguments && cJSON_IsString(arguments)) {
-                                response->tool_calls[i].arguments = strdup(arguments->valuestring);
+                                response->tool_calls[i].arguments = xai_response_strdup(arguments->valuestring);
                             }
                         }
                     }
@@ -546,7 +588,7 @@ xai_err_t xai_json_parse_chat_response(
     // Parse finish reason
     cJSON *finish_reason = cJSON_GetObjectItem(choice, "finish_reason");
     if (finish_reason && cJSON_IsString(finish_reason)) {
-        response->finish_reason = strdup(finish_reason->valuestring);
+        response->finish_reason = xai_response_strdup(finish_reason->valuestring);
     }
 
     // Parse usage
@@ -573,46 +615,46 @@ xai_err_t xai_json_parse_chat_response(
     if (citations && cJSON_IsArray(citations)) {
         response->citation_count = cJSON_GetArraySize(citations);
         if (response->citation_count > 0) {
-            response->citations = calloc(response->citation_count, sizeof(xai_citation_t));
+            response->citations = xai_response_calloc(response->citation_count, sizeof(xai_citation_t));
             if (response->citations) {
                 for (size_t i = 0; i < response->citation_count; i++) {
                     cJSON *cit = cJSON_GetArrayItem(citations, i);
                     
                     // Citations are simple URL strings in the API response
                     if (cit && cJSON_IsString(cit)) {
-                        response->citations[i].url = strdup(cit->valuestring);
-                        response->citations[i].source_type = strdup("url");
+                        response->citations[i].url = xai_response_strdup(cit->valuestring);
+                        response->citations[i].source_type = xai_response_strdup("url");
                     }
                     // Legacy: also handle object format if API changes in future
                     else if (cit && cJSON_IsObject(cit)) {
                         cJSON *source_type = cJSON_GetObjectItem(cit, "source_type");
                         if (source_type && cJSON_IsString(source_type)) {
-                            response->citations[i].source_type = strdup(source_type->valuestring);
+                            response->citations[i].source_type = xai_response_strdup(source_type->valuestring);
                         }
                         
                         cJSON *url = cJSON_GetObjectItem(cit, "url");
                         if (url && cJSON_IsString(url)) {
-                            response->citations[i].url = strdup(url->valuestring);
+                            response->citations[i].url = xai_response_strdup(url->valuestring);
                         }
                         
                         cJSON *title = cJSON_GetObjectItem(cit, "title");
                         if (title && cJSON_IsString(title)) {
-                            response->citations[i].title = strdup(title->valuestring);
+                            response->citations[i].title = xai_response_strdup(title->valuestring);
                         }
                         
                         cJSON *snippet = cJSON_GetObjectItem(cit, "snippet");
                         if (snippet && cJSON_IsString(snippet)) {
-                            response->citations[i].snippet = strdup(snippet->valuestring);
+                            response->citations[i].snippet = xai_response_strdup(snippet->valuestring);
                         }
                         
                         cJSON *author = cJSON_GetObjectItem(cit, "author");
                         if (author && cJSON_IsString(author)) {
-                            response->citations[i].author = strdup(author->valuestring);
+                            response->citations[i].author = xai_response_strdup(author->valuestring);
                         }
                         
                         cJSON *published_date = cJSON_GetObjectItem(cit, "published_date");
                         if (published_date && cJSON_IsString(published_date)) {
-                            response->citations[i].published_date = strdup(published_date->valuestring);
+                            response->citations[i].published_date = xai_response_strdup(published_date->valuestring);
                         }
                     }
                 }
@@ -631,29 +673,49 @@ xai_err_t xai_json_parse_chat_response(
 }
 
 /**
- * @brief Parse streaming chunk (SSE data line)
+ * @brief Emit a text event if item is a non-empty string
+ */
+static void stream_emit_text(
+    cJSON *item,
+    xai_stream_event_t *event,
+    xai_stream_event_callback_t callback,
+    void *user_data
+) {
+    if (cJSON_IsString(item) && item->valuestring && item->valuestring[0] != '\0') {
+        event->text = item->valuestring;
+        event->length = strlen(item->valuestring);
+        callback(event, user_data);
+    }
+}
+
+/**
+ * @brief Parse a streaming chunk into structured events
  * 
- * Streaming chunks come as SSE events:
- * data: {"choices":[{"delta":{"content":"Hello"}}]}
+ * One chunk can carry several events; they are emitted in the order
+ * reasoning, content, tool calls, finish reason, citations, usage.
+ * The "[DONE]" sentinel yields a single DONE event.
  * 
- * Special case:
- * data: [DONE]
+ * Example chunks:
+ * {"choices":[{"delta":{"content":"Hello"}}]}
+ * {"choices":[{"delta":{"tool_calls":[{"index":0,"id":"call_1",
+ *   "function":{"name":"get_weather","arguments":"{\"loc"}}]}}]}
+ * {"choices":[],"usage":{"prompt_tokens":12,"completion_tokens":40,...}}
  */
-xai_err_t xai_json_parse_stream_chunk(
+xai_err_t xai_json_parse_stream_events(
     const char *json_str,
-    char **content_delta,
-    bool *is_done
+    xai_stream_event_callback_t callback,
+    void *user_data
 ) {
-    if (!json_str || !content_delta || !is_done) {
+    if (!json_str || !callback) {
         return XAI_ERR_INVALID_ARG;
     }
 
-    *content_delta = NULL;
-    *is_done = false;
+    xai_stream_event_t event;
 
-    // Check for [DONE] marker
     if (strcmp(json_str, "[DONE]") == 0) {
-        *is_done = true;
+        memset(&event, 0, sizeof(event));
+        event.type = XAI_STREAM_EVENT_DONE;
+        callback(&event, user_data);
         return XAI_OK;
     }
 
@@ -663,25 +725,110 @@ xai_err_t xai_json_parse_stream_chunk(
         return XAI_ERR_PARSE_FAILED;
     }
 
+    // Error object sent in place of a chunk
+    cJSON *error = cJSON_GetObjectItem(root, "error");
+    if (error) {
+        cJSON *message = cJSON_IsObject(error) ? cJSON_GetObjectItem(error, "message") : error;
+        memset(&event, 0, sizeof(event));
+        event.type = XAI_STREAM_EVENT_ERROR;
+        event.error = XAI_ERR_API_ERROR;
+        if (cJSON_IsString(message) && message->valuestring) {
+            event.text = message->valuestring;
+            event.length = strlen(message->valuestring);
+        }
+        callback(&event, user_data);
+        cJSON_Delete(root);
+        return XAI_OK;
+    }
+
     cJSON *choices = cJSON_GetObjectItem(root, "choices");
-    if (choices && cJSON_IsArray(choices) && cJSON_GetArraySize(choices) > 0) {
-        cJSON *choice = cJSON_GetArrayItem(choices, 0);
-        cJSON *delta = cJSON_GetObjectItem(choice, "delta");
-        
-        if (delta) {
-            cJSON *content = cJSON_GetObjectItem(delta, "content");
-            if (content && cJSON_IsString(content) && content->valuestring) {
-                *content_delta = strdup(content->valuestring);
+    cJSON *choice = cJSON_IsArray(choices) ? cJSON_GetArrayItem(choices, 0) : NULL;
+    cJSON *delta = choice ? cJSON_GetObjectItem(choice, "delta") : NULL;
+
+    if (delta) {
+        memset(&event, 0, sizeof(event));
+        event.type = XAI_STREAM_EVENT_REASONING;
+        stream_emit_text(cJSON_GetObjectItem(delta, "reasoning_content"), &event, callback, user_data);
+
+        memset(&event, 0, sizeof(event));
+        event.type = XAI_STREAM_EVENT_CONTENT;
+        stream_emit_text(cJSON_GetObjectItem(delta, "content"), &event, callback, user_data);
+
+        cJSON *tool_calls = cJSON_GetObjectItem(delta, "tool_calls");
+        cJSON *tc = NULL;
+        int position = 0;
+        cJSON_ArrayForEach(tc, tool_calls) {
+            cJSON *index = cJSON_GetObjectItem(tc, "index");
+            cJSON *id = cJSON_GetObjectItem(tc, "id");
+            cJSON *function = cJSON_GetObjectItem(tc, "function");
+            cJSON *name = function ? cJSON_GetObjectItem(function, "name") : NULL;
+            int tool_index = cJSON_IsNumber(index) ? index->valueint : position;
+            position++;
+
+            // id/name arrive once, at the start of the call
+            if (cJSON_IsString(id) || cJSON_IsString(name)) {
+                memset(&event, 0, sizeof(event));
+                event.type = XAI_STREAM_EVENT_TOOL_CALL_START;
+                event.tool_index = tool_index;
+                event.tool_call_id = cJSON_IsString(id) ? id->valuestring : NULL;
+                event.tool_name = cJSON_IsString(name) ? name->valuestring : NULL;
+                callback(&event, user_data);
+            }
+
+            if (function) {
+                memset(&event, 0, sizeof(event));
+                event.type = XAI_STREAM_EVENT_TOOL_CALL_ARGS;
+                event.tool_index = tool_index;
+                stream_emit_text(cJSON_GetObjectItem(function, "arguments"), &event, callback, user_data);
             }
         }
+    }
+
+    if (choice) {
+        memset(&event, 0, sizeof(event));
+        event.type = XAI_STREAM_EVENT_FINISH;
+        stream_emit_text(cJSON_GetObjectItem(choice, "finish_reason"), &event, callback, user_data);
+    }
 
-        // Check finish reason
-        cJSON *finish_reason = cJSON_GetObjectItem(choice, "finish_reason");
-        if (finish_reason && cJSON_IsString(finish_reason)) {
-            *is_done = true;
+    // Citations are URL strings, like in the non-streaming response
+    cJSON *citations = cJSON_GetObjectItem(root, "citations");
+    int citation_count = cJSON_IsArray(citations) ? cJSON_GetArraySize(citations) : 0;
+    if (citation_count > 0) {
+        // cJSON_malloc: served by the request's JSON arena like the tree itself
+        const char **urls = cJSON_malloc(citation_count * sizeof(const char *));
+        if (urls) {
+            size_t n = 0;
+            cJSON *url = NULL;
+            cJSON_ArrayForEach(url, citations) {
+                if (cJSON_IsString(url) && url->valuestring) {
+                    urls[n++] = url->valuestring;
+                }
+            }
+            memset(&event, 0, sizeof(event));
+            event.type = XAI_STREAM_EVENT_CITATIONS;
+            event.citations = urls;
+            event.citation_count = n;
+            callback(&event, user_data);
+            cJSON_free(urls);
         }
     }
 
+    cJSON *usage = cJSON_GetObjectItem(root, "usage");
+    if (cJSON_IsObject(usage)) {
+        memset(&event, 0, sizeof(event));
+        event.type = XAI_STREAM_EVENT_USAGE;
+        cJSON *item = cJSON_GetObjectItem(usage, "prompt_tokens");
+        event.prompt_tokens = cJSON_IsNumber(item) ? (uint32_t)item->valueint : 0;
+        item = cJSON_GetObjectItem(usage, "completion_tokens");
+        event.completion_tokens = cJSON_IsNumber(item) ? (uint32_t)item->valueint : 0;
+        item = cJSON_GetObjectItem(usage, "total_tokens");
+        event.total_tokens = cJSON_IsNumber(item) ? (uint32_t)item->valueint : 0;
+        cJSON *details = cJSON_GetObjectItem(usage, "completion_tokens_details");
+        item = details ? cJSON_GetObjectItem(details, "reasoning_tokens") : NULL;
+        event.reasoning_tokens = cJSON_IsNumber(item) ? (uint32_t)item->valueint : 0;
+        callback(&event, user_data);
+    }
+
     cJSON_Delete(root);
     return XAI_OK;
 }
@@ -0,0 +1,242 @@
+/**
+ * @file xai_memory.c
+ * @brief Per-endpoint heap telemetry and admission control
+ *
+ * Heap use of a call is TLS buffers, esp_http_client state, response
+ * fields and whatever the JSON arena could not hold - nothing a formula
+ * over token counts predicts. Instead, every call samples free internal
+ * RAM and PSRAM while it runs and records how far each dropped, per phase
+ * and per endpoint. The recorded peaks predict the next call of the same
+ * kind, and a call predicted not to fit in the largest free block is
+ * refused before it opens a connection.
+ */
+
+#include "sdkconfig.h"
+#include "xai_internal.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include <string.h>
+#include <stdint.h>
+
+static const char *TAG = "xai_memory";
+
+#ifndef CONFIG_XAI_ADMISSION_MIN_SAMPLES
+#define CONFIG_XAI_ADMISSION_MIN_SAMPLES 4
+#endif
+
+#define MEM_CAPS_INTERNAL (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#define MEM_CAPS_PSRAM    (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+
+/** Percentile of recorded peaks used as the prediction */
+#define MEM_PREDICT_PERCENT 95
+
+static __thread xai_mem_probe_t *s_probe;
+
+static size_t mem_hist_bucket(size_t bytes) {
+    size_t i = 0;
+    while (i < XAI_MEM_HIST_BUCKETS - 1 && bytes >= ((size_t)1024 << i)) {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * @brief Upper bound of the bucket holding the given percentile, capped at
+ *        the largest peak (the last bucket has no upper bound)
+ */
+static size_t mem_hist_predict(const uint32_t *hist, uint32_t total, size_t max_peak) {
+    uint32_t target = (total * MEM_PREDICT_PERCENT + 99) / 100;
+    uint32_t seen = 0;
+    for (size_t i = 0; i < XAI_MEM_HIST_BUCKETS - 1; i++) {
+        seen += hist[i];
+        if (seen >= target) {
+            size_t upper = (size_t)1024 << i;
+            return upper < max_peak ? upper : max_peak;
+        }
+    }
+    return max_peak;
+}
+
+static void mem_read(size_t *internal, size_t *psram) {
+    *internal = heap_caps_get_free_size(MEM_CAPS_INTERNAL);
+    *psram = heap_caps_get_free_size(MEM_CAPS_PSRAM);
+}
+
+static size_t mem_drop(size_t base, size_t low) {
+    return base > low ? base - low : 0;
+}
+
+static void probe_sample(xai_mem_probe_t *probe) {
+    size_t internal, psram;
+    mem_read(&internal, &psram);
+    if (internal < probe->min_internal) {
+        probe->min_internal = internal;
+    }
+    if (psram < probe->min_psram) {
+        probe->min_psram = psram;
+    }
+    if (internal < probe->phase_min_internal) {
+        probe->phase_min_internal = internal;
+    }
+    if (psram < probe->phase_min_psram) {
+        probe->phase_min_psram = psram;
+    }
+}
+
+/**
+ * @brief Fold the current phase's low point and duration into the endpoint stats
+ */
+static void probe_close_phase(xai_mem_probe_t *probe) {
+    xai_mem_stats_t *stats = probe->stats;
+    stats->phase_us[probe->phase] += esp_timer_get_time() - probe->phase_start_us;
+
+    size_t internal = mem_drop(probe->base_internal, probe->phase_min_internal);
+    size_t psram = mem_drop(probe->base_psram, probe->phase_min_psram);
+    if (internal > stats->phase_peak_internal[probe->phase]) {
+        stats->phase_peak_internal[probe->phase] = internal;
+    }
+    if (psram > stats->phase_peak_psram[probe->phase]) {
+        stats->phase_peak_psram[probe->phase] = psram;
+    }
+}
+
+/**
+ * @brief Prediction from an endpoint's stats (caller holds the client mutex)
+ */
+static bool mem_predict(const xai_mem_stats_t *stats, size_t *internal, size_t *psram) {
+    if (stats->requests == 0) {
+        return false;
+    }
+    *internal = mem_hist_predict(stats->hist_internal, stats->requests, stats->max_peak_internal);
+    *psram = mem_hist_predict(stats->hist_psram, stats->requests, stats->max_peak_psram);
+    return true;
+}
+
+xai_err_t xai_mem_begin(struct xai_client_s *client, xai_endpoint_t endpoint) {
+    xai_mem_stats_t *stats = &client->mem_stats[endpoint];
+
+#ifdef CONFIG_XAI_ADMISSION_CONTROL
+    size_t need_internal, need_psram;
+    if (stats->requests >= CONFIG_XAI_ADMISSION_MIN_SAMPLES &&
+        mem_predict(stats, &need_internal, &need_psram)) {
+        size_t largest_internal = heap_caps_get_largest_free_block(MEM_CAPS_INTERNAL);
+        size_t largest_psram = heap_caps_get_total_size(MEM_CAPS_PSRAM) > 0
+            ? heap_caps_get_largest_free_block(MEM_CAPS_PSRAM) : SIZE_MAX;
+        if (need_internal > largest_internal || need_psram > largest_psram) {
+            stats->rejected++;
+            ESP_LOGW(TAG, "Rejecting call (endpoint %d): needs ~%zu internal / %zu PSRAM, "
+                     "largest free blocks %zu / %zu",
+                     endpoint, need_internal, need_psram, largest_internal,
+                     largest_psram == SIZE_MAX ? 0 : largest_psram);
+            return XAI_ERR_NO_MEMORY;
+        }
+    }
+#endif
+
+    xai_mem_probe_t *probe = &client->mem_probe;
+    probe->endpoint = endpoint;
+    probe->stats = stats;
+    probe->phase = XAI_MEM_PHASE_BUILD;
+    mem_read(&probe->base_internal, &probe->base_psram);
+    probe->min_internal = probe->phase_min_internal = probe->base_internal;
+    probe->min_psram = probe->phase_min_psram = probe->base_psram;
+    probe->phase_start_us = esp_timer_get_time();
+    s_probe = probe;
+    return XAI_OK;
+}
+
+void xai_mem_phase(xai_mem_phase_t phase) {
+    xai_mem_probe_t *probe = s_probe;
+    if (!probe || phase == probe->phase) {
+        return;
+    }
+
+    probe_sample(probe);
+    probe_close_phase(probe);
+
+    size_t internal, psram;
+    mem_read(&internal, &psram);
+    probe->phase = phase;
+    probe->phase_min_internal = internal;
+    probe->phase_min_psram = psram;
+    probe->phase_start_us = esp_timer_get_time();
+}
+
+void xai_mem_sample(void) {
+    if (s_probe) {
+        probe_sample(s_probe);
+    }
+}
+
+void xai_mem_end(struct xai_client_s *client) {
+    xai_mem_probe_t *probe = &client->mem_probe;
+    if (s_probe != probe) {
+        return;
+    }
+    s_probe = NULL;
+
+    xai_mem_stats_t *stats = probe->stats;
+    probe_sample(probe);
+    probe_close_phase(probe);
+
+    size_t internal = mem_drop(probe->base_internal, probe->min_internal);
+    size_t psram = mem_drop(probe->base_psram, probe->min_psram);
+    stats->requests++;
+    stats->last_peak_internal = internal;
+    stats->last_peak_psram = psram;
+    if (internal > stats->max_peak_internal) {
+        stats->max_peak_internal = internal;
+    }
+    if (psram > stats->max_peak_psram) {
+        stats->max_peak_psram = psram;
+    }
+    stats->hist_internal[mem_hist_bucket(internal)]++;
+    stats->hist_psram[mem_hist_bucket(psram)]++;
+
+    ESP_LOGD(TAG, "Endpoint %d peak: %zu internal, %zu PSRAM",
+             probe->endpoint, internal, psram);
+}
+
+xai_err_t xai_get_memory_stats(xai_client_t client, xai_endpoint_t endpoint, xai_mem_stats_t *stats) {
+    if (!client || endpoint >= XAI_ENDPOINT_COUNT || !stats) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    // The raw mutex: xai_client_lock() would open a measured call
+    struct xai_client_s *impl = (struct xai_client_s *)client;
+    if (xSemaphoreTake(impl->mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        return XAI_ERR_TIMEOUT;
+    }
+    *stats = impl->mem_stats[endpoint];
+    xSemaphoreGive(impl->mutex);
+    return XAI_OK;
+}
+
+xai_err_t xai_predict_memory(
+    xai_client_t client,
+    xai_endpoint_t endpoint,
+    size_t *internal_bytes,
+    size_t *psram_bytes
+) {
+    if (!client || endpoint >= XAI_ENDPOINT_COUNT || !internal_bytes) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    struct xai_client_s *impl = (struct xai_client_s *)client;
+    if (xSemaphoreTake(impl->mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        return XAI_ERR_TIMEOUT;
+    }
+    size_t internal = 0, psram = 0;
+    bool known = mem_predict(&impl->mem_stats[endpoint], &internal, &psram);
+    xSemaphoreGive(impl->mutex);
+
+    if (!known) {
+        return XAI_ERR_NOT_SUPPORTED;
+    }
+    *internal_bytes = internal;
+    if (psram_bytes) {
+        *psram_bytes = psram;
+    }
+    return XAI_OK;
+}
@@ -4,16 +4,29 @@
  * 
  * Provides model information database and API functions for listing
  * and retrieving model details. Includes all 25+ xAI models.
+ * 
+ * xai_list_models() parses the live /models list into a registry that
+ * is kept in NVS with its ETag, so it is known at boot and revalidated
+ * cheaply once it goes stale.
  */
 
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+#include <inttypes.h>
 #include "xai.h"
 #include "xai_internal.h"
 #include "esp_log.h"
+#ifdef CONFIG_XAI_MODELS_CACHE_NVS
+#include "nvs.h"
+#endif
 
 static const char *TAG = "xai_models";
 
+#ifndef CONFIG_XAI_MODELS_CACHE_TTL_S
+#define CONFIG_XAI_MODELS_CACHE_TTL_S 86400
+#endif
+
 /**
  * @brief Model information database
  * 
@@ -258,6 +271,456 @@ static const xai_model_info_t MODEL_DATABASE[] = {
 
 static const size_t MODEL_DATABASE_SIZE = sizeof(MODEL_DATABASE) / sizeof(MODEL_DATABASE[0]);
 
+// ============================================================================
+// Live registry
+// ============================================================================
+
+/**
+ * @brief One model in the lookup index
+ */
+typedef struct {
+    const xai_model_info_t *info;   /**< Registry or database entry */
+    bool guessed;                   /**< Capabilities guessed from the name */
+} models_index_entry_t;
+
+/**
+ * @brief Copy of the current list for xai_list_models(); rewritten in
+ *        place, replaced only when a longer list outgrows it
+ */
+typedef struct models_array_s {
+    struct models_array_s *outgrown; /**< Smaller array this one replaced, kept alive */
+    size_t capacity;
+    xai_model_info_t models[];
+} models_array_t;
+
+/**
+ * @brief Models parsed from the last /models response
+ * 
+ * Every id ever listed has one entry in the table, allocated when the id
+ * first appears and never freed or changed: xai_get_model_info() returns
+ * it, and callers keep it after the lock is given. A list that changes
+ * reuses the entries of the ids it still has, so the table grows with the
+ * number of distinct ids, not with refreshes. The array handed out by
+ * xai_list_models() is rewritten in place; an outgrown one is kept, and
+ * capacities double, so those stay within twice the longest list. The
+ * index holds the current list and the database entries it does not
+ * override, sorted by id for binary search; it never leaves the lock, so
+ * it is rebuilt in place.
+ */
+typedef struct {
+    xai_model_info_t **table;       /**< Entry of every id listed since boot */
+    size_t table_count;
+    size_t table_capacity;
+    const xai_model_info_t **current; /**< Table entries of the current list */
+    models_array_t *listed;         /**< Current list by value */
+    xai_model_info_t *models;       /**< listed->models, NULL before the first list */
+    size_t count;
+    models_index_entry_t *index;
+    size_t index_count;
+    xai_http_validators_t validators;
+    int64_t fetched_at;             /**< Wall-clock seconds of the last 200/304 (0 = unknown) */
+    int64_t fetched_us;             /**< esp_timer time of the same, this boot (0 = not this boot) */
+    bool nvs_checked;               /**< NVS looked at since boot */
+} models_registry_t;
+
+static models_registry_t s_registry;
+static SemaphoreHandle_t s_registry_lock;
+static StaticSemaphore_t s_registry_lock_buf;
+static atomic_int s_registry_lock_state;
+
+/** time() is treated as unset before 2020 */
+#define MODELS_CLOCK_VALID 1577836800
+
+static void registry_lock(void) {
+    int expected = 0;
+    if (atomic_compare_exchange_strong(&s_registry_lock_state, &expected, 1)) {
+        s_registry_lock = xSemaphoreCreateMutexStatic(&s_registry_lock_buf);
+        atomic_store(&s_registry_lock_state, 2);
+    }
+    while (atomic_load(&s_registry_lock_state) != 2) {
+        vTaskDelay(1);
+    }
+    xSemaphoreTake(s_registry_lock, portMAX_DELAY);
+}
+
+static void registry_unlock(void) {
+    xSemaphoreGive(s_registry_lock);
+}
+
+static const xai_model_info_t* database_find(const char *model_id) {
+    for (size_t i = 0; i < MODEL_DATABASE_SIZE; i++) {
+        if (strcmp(MODEL_DATABASE[i].id, model_id) == 0) {
+            return &MODEL_DATABASE[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief The table entry for an id, added on first sight (lock held)
+ * 
+ * Capabilities come from the local database for known ids; /models only
+ * lists ids, so new ones get capabilities guessed from their names.
+ */
+static const xai_model_info_t* registry_intern(const char *name) {
+    for (size_t i = 0; i < s_registry.table_count; i++) {
+        if (strcmp(s_registry.table[i]->id, name) == 0) {
+            return s_registry.table[i];
+        }
+    }
+
+    if (s_registry.table_count == s_registry.table_capacity) {
+        size_t capacity = s_registry.table_capacity ? s_registry.table_capacity * 2 : 16;
+        xai_model_info_t **table = xai_realloc(s_registry.table, capacity * sizeof(*table));
+        if (!table) {
+            return NULL;
+        }
+        s_registry.table = table;
+        s_registry.table_capacity = capacity;
+    }
+
+    // The entry and its id share one allocation
+    size_t len = strlen(name) + 1;
+    xai_model_info_t *entry = xai_malloc(sizeof(xai_model_info_t) + len);
+    if (!entry) {
+        return NULL;
+    }
+    const xai_model_info_t *known = database_find(name);
+    if (known) {
+        *entry = *known;
+    } else {
+        *entry = (xai_model_info_t){
+            .description = "",
+            .max_tokens = 0,
+            .supports_vision = strstr(name, "vision") || strstr(name, "image"),
+            .supports_tools = !strstr(name, "image"),
+            .supports_reasoning = strstr(name, "reasoning") && !strstr(name, "non-reasoning"),
+            .supports_search = !strstr(name, "image"),
+        };
+    }
+    char *id = (char *)(entry + 1);
+    memcpy(id, name, len);
+    entry->id = id;
+    s_registry.table[s_registry.table_count++] = entry;
+    return entry;
+}
+
+/**
+ * @brief Parse a /models body into the table's entries (lock held)
+ * 
+ * @param current Output: table entries of the listed ids, in list order
+ */
+static xai_err_t registry_parse(const char *body, const xai_model_info_t ***current,
+                                size_t *count) {
+    cJSON *root = cJSON_Parse(body);
+    cJSON *data = root ? cJSON_GetObjectItem(root, "data") : NULL;
+    if (!cJSON_IsArray(data)) {
+        ESP_LOGE(TAG, "Unexpected /models response");
+        cJSON_Delete(root);
+        return XAI_ERR_PARSE_FAILED;
+    }
+
+    size_t n = 0;
+    cJSON *item;
+    cJSON_ArrayForEach(item, data) {
+        n += cJSON_IsString(cJSON_GetObjectItem(item, "id")) ? 1 : 0;
+    }
+
+    const xai_model_info_t **list = xai_malloc((n ? n : 1) * sizeof(*list));
+    if (!list) {
+        cJSON_Delete(root);
+        return XAI_ERR_NO_MEMORY;
+    }
+    size_t i = 0;
+    cJSON_ArrayForEach(item, data) {
+        cJSON *id = cJSON_GetObjectItem(item, "id");
+        if (!cJSON_IsString(id)) {
+            continue;
+        }
+        list[i] = registry_intern(id->valuestring);
+        if (!list[i]) {
+            // Entries added so far stay in the table for the next try
+            free(list);
+            cJSON_Delete(root);
+            return XAI_ERR_NO_MEMORY;
+        }
+        i++;
+    }
+
+    cJSON_Delete(root);
+    *current = list;
+    *count = n;
+    return XAI_OK;
+}
+
+static int index_entry_cmp(const void *a, const void *b) {
+    const models_index_entry_t *x = (const models_index_entry_t *)a;
+    const models_index_entry_t *y = (const models_index_entry_t *)b;
+    int cmp = strcmp(x->info->id, y->info->id);
+    if (cmp == 0) {
+        // Registry entries sort before the database entry they override
+        bool x_db = x->info >= MODEL_DATABASE && x->info < MODEL_DATABASE + MODEL_DATABASE_SIZE;
+        bool y_db = y->info >= MODEL_DATABASE && y->info < MODEL_DATABASE + MODEL_DATABASE_SIZE;
+        cmp = (int)x_db - (int)y_db;
+    }
+    return cmp;
+}
+
+/**
+ * @brief Rebuild the sorted index (lock held); lookups scan linearly
+ *        without one
+ */
+static void registry_index_build(void) {
+    free(s_registry.index);
+    s_registry.index = NULL;
+    s_registry.index_count = 0;
+
+    size_t total = s_registry.count + MODEL_DATABASE_SIZE;
+    models_index_entry_t *index = xai_malloc(total * sizeof(models_index_entry_t));
+    if (!index) {
+        ESP_LOGW(TAG, "No memory for the model index");
+        return;
+    }
+
+    for (size_t i = 0; i < s_registry.count; i++) {
+        index[i].info = s_registry.current[i];
+        index[i].guessed = database_find(s_registry.current[i]->id) == NULL;
+    }
+    for (size_t i = 0; i < MODEL_DATABASE_SIZE; i++) {
+        index[s_registry.count + i].info = &MODEL_DATABASE[i];
+        index[s_registry.count + i].guessed = false;
+    }
+    qsort(index, total, sizeof(models_index_entry_t), index_entry_cmp);
+
+    // Keep the first of each id: the registry's
+    size_t n = 0;
+    for (size_t i = 0; i < total; i++) {
+        if (n == 0 || strcmp(index[n - 1].info->id, index[i].info->id) != 0) {
+            index[n++] = index[i];
+        }
+    }
+    s_registry.index = index;
+    s_registry.index_count = n;
+}
+
+/**
+ * @brief Make a parsed list the registry's (lock held); on failure the
+ *        list is freed and the registry left as it was
+ */
+static xai_err_t registry_replace(const xai_model_info_t **current, size_t count) {
+    models_array_t *listed = s_registry.listed;
+    if (!listed || listed->capacity < count) {
+        size_t capacity = listed ? listed->capacity * 2 : count;
+        capacity = capacity < count ? count : capacity;
+        models_array_t *grown = xai_malloc(sizeof(models_array_t) +
+                                           capacity * sizeof(xai_model_info_t));
+        if (!grown) {
+            free(current);
+            return XAI_ERR_NO_MEMORY;
+        }
+        grown->outgrown = listed;
+        grown->capacity = capacity;
+        listed = grown;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        listed->models[i] = *current[i];
+    }
+    free(s_registry.current);
+    s_registry.current = current;
+    s_registry.listed = listed;
+    s_registry.models = listed->models;
+    s_registry.count = count;
+    registry_index_build();
+    return XAI_OK;
+}
+
+static void registry_mark_fetched(void) {
+    time_t now = time(NULL);
+    s_registry.fetched_at = now >= MODELS_CLOCK_VALID ? (int64_t)now : 0;
+    s_registry.fetched_us = esp_timer_get_time();
+}
+
+/**
+ * @brief Whether the list may be served without asking the server (lock held)
+ */
+static bool registry_fresh(void) {
+    if (!s_registry.models) {
+        return false;
+    }
+    int64_t ttl_s = CONFIG_XAI_MODELS_CACHE_TTL_S;
+    if (s_registry.fetched_us) {
+        return esp_timer_get_time() - s_registry.fetched_us < ttl_s * 1000000;
+    }
+
+    // Loaded from NVS: only the wall clock spans a reboot
+    time_t now = time(NULL);
+    int64_t age = (int64_t)now - s_registry.fetched_at;
+    return now >= MODELS_CLOCK_VALID && s_registry.fetched_at && age >= 0 && age < ttl_s;
+}
+
+#ifdef CONFIG_XAI_MODELS_CACHE_NVS
+
+#define MODELS_NVS_NAMESPACE "xai_models"
+
+/**
+ * @brief Load the list stored by a previous boot (lock held)
+ */
+static void registry_load_nvs(void) {
+    nvs_handle_t nvs;
+    if (nvs_open(MODELS_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+
+    size_t len = 0;
+    char *body = NULL;
+    if (nvs_get_blob(nvs, "body", NULL, &len) == ESP_OK && len > 0 &&
+        (body = xai_malloc(len + 1)) != NULL &&
+        nvs_get_blob(nvs, "body", body, &len) == ESP_OK) {
+        body[len] = '\0';
+        const xai_model_info_t **current;
+        size_t count;
+        if (registry_parse(body, &current, &count) == XAI_OK &&
+            registry_replace(current, count) == XAI_OK) {
+            size_t size = sizeof(s_registry.validators.etag);
+            if (nvs_get_str(nvs, "etag", s_registry.validators.etag, &size) != ESP_OK) {
+                s_registry.validators.etag[0] = '\0';
+            }
+            size = sizeof(s_registry.validators.last_modified);
+            if (nvs_get_str(nvs, "modified", s_registry.validators.last_modified, &size) != ESP_OK) {
+                s_registry.validators.last_modified[0] = '\0';
+            }
+            if (nvs_get_i64(nvs, "fetched", &s_registry.fetched_at) != ESP_OK) {
+                s_registry.fetched_at = 0;
+            }
+            ESP_LOGI(TAG, "Loaded %zu models from NVS", count);
+        }
+    }
+    free(body);
+    nvs_close(nvs);
+}
+
+/**
+ * @brief Store a list (body != NULL) or just its new fetch time
+ */
+static void registry_save_nvs(const char *body, size_t len) {
+    nvs_handle_t nvs;
+    if (nvs_open(MODELS_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        ESP_LOGD(TAG, "NVS not available; model list kept in RAM only");
+        return;
+    }
+
+    esp_err_t err = ESP_OK;
+    if (body) {
+        err = nvs_set_blob(nvs, "body", body, len);
+        if (err == ESP_OK) {
+            err = nvs_set_str(nvs, "etag", s_registry.validators.etag);
+        }
+        if (err == ESP_OK) {
+            err = nvs_set_str(nvs, "modified", s_registry.validators.last_modified);
+        }
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i64(nvs, "fetched", s_registry.fetched_at);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to store model list: %s", esp_err_to_name(err));
+    }
+    nvs_close(nvs);
+}
+
+#else
+
+static void registry_load_nvs(void) {
+}
+
+static void registry_save_nvs(const char *body, size_t len) {
+    (void)body;
+    (void)len;
+}
+
+#endif // CONFIG_XAI_MODELS_CACHE_NVS
+
+/**
+ * @brief Take the registry lock, loading the stored list on first use
+ */
+static void registry_acquire(void) {
+    registry_lock();
+    if (!s_registry.nvs_checked) {
+        s_registry.nvs_checked = true;
+        registry_load_nvs();
+        if (!s_registry.index) {
+            registry_index_build();
+        }
+    }
+}
+
+/**
+ * @brief Exact lookup (lock held)
+ */
+static const models_index_entry_t* registry_find_exact(const char *model_id, models_index_entry_t *scratch) {
+    if (s_registry.index) {
+        size_t lo = 0;
+        size_t hi = s_registry.index_count;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            int cmp = strcmp(model_id, s_registry.index[mid].info->id);
+            if (cmp == 0) {
+                return &s_registry.index[mid];
+            }
+            if (cmp < 0) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        return NULL;
+    }
+
+    for (size_t i = 0; i < s_registry.count; i++) {
+        if (strcmp(s_registry.current[i]->id, model_id) == 0) {
+            scratch->info = s_registry.current[i];
+            scratch->guessed = database_find(model_id) == NULL;
+            return scratch;
+        }
+    }
+    scratch->info = database_find(model_id);
+    scratch->guessed = false;
+    return scratch->info ? scratch : NULL;
+}
+
+/**
+ * @brief Lookup with alias fallback (lock held)
+ * 
+ * An unknown "<base>-latest" or dated "<base>-NNNN" id resolves to <base>.
+ */
+static const models_index_entry_t* registry_find(const char *model_id, models_index_entry_t *scratch) {
+    const models_index_entry_t *entry = registry_find_exact(model_id, scratch);
+    if (entry) {
+        return entry;
+    }
+
+    size_t len = strlen(model_id);
+    size_t base_len = 0;
+    if (len > 7 && strcmp(model_id + len - 7, "-latest") == 0) {
+        base_len = len - 7;
+    } else if (len > 5 && model_id[len - 5] == '-' &&
+               strspn(model_id + len - 4, "0123456789") == 4) {
+        base_len = len - 5;
+    }
+
+    char base[64];
+    if (base_len == 0 || base_len >= sizeof(base)) {
+        return NULL;
+    }
+    memcpy(base, model_id, base_len);
+    base[base_len] = '\0';
+    return registry_find_exact(base, scratch);
+}
+
 /**
  * @brief Get model information by ID
  */
@@ -266,18 +729,119 @@ const xai_model_info_t* xai_get_model_info(const char *model_id) {
         return NULL;
     }
 
-    for (size_t i = 0; i < MODEL_DATABASE_SIZE; i++) {
-        if (strcmp(MODEL_DATABASE[i].id, model_id) == 0) {
-            return &MODEL_DATABASE[i];
+    models_index_entry_t scratch;
+    registry_acquire();
+    const models_index_entry_t *entry = registry_find(model_id, &scratch);
+    const xai_model_info_t *info = entry ? entry->info : NULL;
+    registry_unlock();
+
+    if (!info) {
+        ESP_LOGD(TAG, "Model not found: %s", model_id);
+    }
+    return info;
+}
+
+static uint32_t model_caps(const xai_model_info_t *info) {
+    return (info->supports_vision ? XAI_MODEL_CAP_VISION : 0) |
+           (info->supports_tools ? XAI_MODEL_CAP_TOOLS : 0) |
+           (info->supports_reasoning ? XAI_MODEL_CAP_REASONING : 0) |
+           (info->supports_search ? XAI_MODEL_CAP_SEARCH : 0);
+}
+
+bool xai_model_supports(const char *model_id, uint32_t caps) {
+    const xai_model_info_t *info = xai_get_model_info(model_id);
+    return info && (model_caps(info) & caps) == caps;
+}
+
+uint32_t xai_model_context_tokens(const char *model_id) {
+    const xai_model_info_t *info = xai_get_model_info(model_id);
+    return info ? info->max_tokens : 0;
+}
+
+uint32_t xai_request_caps(
+    const xai_message_t *messages,
+    size_t message_count,
+    const xai_options_t *options
+) {
+    uint32_t need = 0;
+    for (size_t i = 0; i < message_count; i++) {
+        if (messages[i].image_count > 0) {
+            need |= XAI_MODEL_CAP_VISION;
         }
     }
+    if (options) {
+        need |= options->tool_count > 0 ? XAI_MODEL_CAP_TOOLS : 0;
+        need |= options->reasoning_effort ? XAI_MODEL_CAP_REASONING : 0;
+        need |= (options->search_params && options->search_params->mode != XAI_SEARCH_OFF)
+                ? XAI_MODEL_CAP_SEARCH : 0;
+    }
+    return need;
+}
 
-    ESP_LOGW(TAG, "Model not found: %s", model_id);
-    return NULL;
+xai_err_t xai_validate_options(
+    const char *model_id,
+    const xai_message_t *messages,
+    size_t message_count,
+    const xai_options_t *options
+) {
+    if (options) {
+        // Negative values mean "server default" and are not sent
+        if (options->temperature > 2.0f) {
+            ESP_LOGE(TAG, "temperature %.2f is outside 0..2", options->temperature);
+            return XAI_ERR_INVALID_ARG;
+        }
+        if (options->top_p > 1.0f) {
+            ESP_LOGE(TAG, "top_p %.2f is outside 0..1", options->top_p);
+            return XAI_ERR_INVALID_ARG;
+        }
+        if (options->reasoning_effort && strcmp(options->reasoning_effort, "low") != 0 &&
+            strcmp(options->reasoning_effort, "high") != 0) {
+            ESP_LOGE(TAG, "reasoning_effort must be \"low\" or \"high\"");
+            return XAI_ERR_INVALID_ARG;
+        }
+        if (options->tool_count > 0 && !options->tools) {
+            ESP_LOGE(TAG, "tool_count set without tools");
+            return XAI_ERR_INVALID_ARG;
+        }
+    }
+    if (!model_id) {
+        return XAI_OK;
+    }
+
+    models_index_entry_t scratch;
+    registry_acquire();
+    const models_index_entry_t *entry = registry_find(model_id, &scratch);
+    models_index_entry_t found = entry ? *entry : (models_index_entry_t){0};
+    registry_unlock();
+
+    // Unknown models, and new ones whose capabilities are only guessed,
+    // are left for the server to judge
+    if (!found.info || found.guessed) {
+        return XAI_OK;
+    }
+
+    uint32_t missing = xai_request_caps(messages, message_count, options) & ~model_caps(found.info);
+    if (missing) {
+        ESP_LOGE(TAG, "%s does not support%s%s%s%s", model_id,
+                 (missing & XAI_MODEL_CAP_VISION) ? " images" : "",
+                 (missing & XAI_MODEL_CAP_TOOLS) ? " tools" : "",
+                 (missing & XAI_MODEL_CAP_REASONING) ? " reasoning_effort" : "",
+                 (missing & XAI_MODEL_CAP_SEARCH) ? " search" : "");
+        return XAI_ERR_NOT_SUPPORTED;
+    }
+    if (options && found.info->max_tokens && options->max_tokens > found.info->max_tokens) {
+        ESP_LOGE(TAG, "max_tokens %zu exceeds %s's %" PRIu32 "-token context",
+                 options->max_tokens, model_id, found.info->max_tokens);
+        return XAI_ERR_INVALID_ARG;
+    }
+    return XAI_OK;
 }
 
 /**
  * @brief List available models (API endpoint)
+ * 
+ * Served from the registry while it is fresh; otherwise revalidated with
+ * the stored ETag, so an unchanged list costs a 304 and no parsing.
  */
 xai_err_t xai_list_models(
     xai_client_t client,
@@ -291,31 +855,79 @@ xai_err_t xai_list_models(
 
     struct xai_client_s *client_impl = (struct xai_client_s *)client;
 
+    registry_acquire();
+    bool fresh = registry_fresh();
+    xai_http_validators_t validators = s_registry.validators;
+    if (!s_registry.models) {
+        // Nothing to revalidate against
+        memset(&validators, 0, sizeof(validators));
+    }
+    if (fresh) {
+        *models = s_registry.models;
+        *model_count = s_registry.count;
+        registry_unlock();
+        ESP_LOGD(TAG, "Listed %zu models (cached)", *model_count);
+        return XAI_OK;
+    }
+    registry_unlock();
+
+    // The connection is shared with every other call on the client
+    xai_err_t err = xai_client_lock(client_impl, XAI_ENDPOINT_MODELS, XAI_PRIORITY_BACKGROUND);
+    if (err != XAI_OK) {
+        ESP_LOGE(TAG, "Failed to start request: %s", xai_err_to_string(err));
+        return err;
+    }
+
     // Call API endpoint GET /v1/models
-    char *response_data = NULL;
+    xai_buffer_t *response_data = NULL;
     size_t response_len = 0;
-    xai_err_t err = xai_http_get(
+    bool not_modified = false;
+    err = xai_http_get_conditional(
         client_impl->http_client,
         "/models",
+        &validators,
         &response_data,
-        &response_len
+        &response_len,
+        &not_modified
     );
 
-    if (err != XAI_OK) {
+    // Parsed under the lock: the list's ids share the registry's entries
+    registry_lock();
+    bool changed = err == XAI_OK && !not_modified;
+    if (changed) {
+        const xai_model_info_t **current;
+        size_t count;
+        err = registry_parse(response_data->data, &current, &count);
+        if (err == XAI_OK) {
+            err = registry_replace(current, count);
+        }
+    }
+    if (err == XAI_OK) {
+        s_registry.validators = validators;
+        registry_mark_fetched();
+        registry_save_nvs(changed ? response_data->data : NULL, response_len);
+    } else if (s_registry.models) {
+        // Stale beats nothing; the next call tries again
+        ESP_LOGW(TAG, "Failed to refresh models (%s); using the stored list",
+                 xai_err_to_string(err));
+        err = XAI_OK;
+    } else {
         ESP_LOGE(TAG, "Failed to list models: %d", err);
-        return err;
     }
+    *models = s_registry.models;
+    *model_count = s_registry.count;
+    registry_unlock();
 
-    // Parse response (for now, just return local database)
-    // TODO: Parse actual API response
-    free(response_data);
-
-    // Return local database
-    *models = (xai_model_info_t *)MODEL_DATABASE;
-    *model_count = MODEL_DATABASE_SIZE;
+    if (response_data) {
+        xai_buffer_pool_release(client_impl->buffer_pool, response_data);
+    }
+    xai_client_unlock(client_impl);
 
-    ESP_LOGI(TAG, "Listed %zu models", MODEL_DATABASE_SIZE);
-    return XAI_OK;
+    if (err == XAI_OK) {
+        ESP_LOGI(TAG, "Listed %zu models (%s)", *model_count,
+                 not_modified ? "not modified" : "fetched");
+    }
+    return err;
 }
 
 /**
@@ -45,16 +45,18 @@ xai_err_t xai_responses_completion(
     xai_err_t err = XAI_OK;
 
     // Acquire client mutex
-    if (xSemaphoreTake(client_impl->mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
-        ESP_LOGE(TAG, "Failed to acquire mutex");
-        return XAI_ERR_TIMEOUT;
+    err = xai_client_lock(client_impl, XAI_ENDPOINT_RESPONSES, XAI_PRIORITY_NORMAL);
+    if (err != XAI_OK) {
+        ESP_LOGE(TAG, "Failed to start request: %s", xai_err_to_string(err));
+        return err;
     }
 
     // Build JSON request (similar to chat but for responses endpoint)
-    char *request_buffer = malloc(16384);
+    xai_buffer_t *request_buffer = xai_buffer_pool_acquire(client_impl->buffer_pool,
+                                                           XAI_POOL_ACQUIRE_TIMEOUT_MS);
     if (!request_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate request buffer");
-        xSemaphoreGive(client_impl->mutex);
+        ESP_LOGE(TAG, "No request buffer available");
+        xai_client_unlock(client_impl);
         return XAI_ERR_NO_MEMORY;
     }
 
@@ -78,8 +80,8 @@ xai_err_t xai_responses_completion(
 
     size_t request_len = 0;
     err = xai_json_build_chat_request(
-        request_buffer,
-        16384,
+        request_buffer->data,
+        request_buffer->capacity,
         &request_len,
         messages,
         message_count,
@@ -89,42 +91,42 @@ xai_err_t xai_responses_completion(
 
     if (err != XAI_OK) {
         ESP_LOGE(TAG, "Failed to build request: %d", err);
-        free(request_buffer);
-        xSemaphoreGive(client_impl->mutex);
+        xai_buffer_pool_release(client_impl->buffer_pool, request_buffer);
+        xai_client_unlock(client_impl);
         return err;
     }
 
     ESP_LOGI(TAG, "Sending responses API request (%zu bytes)", request_len);
-    ESP_LOGD(TAG, "Request JSON: %.*s", (int)request_len, request_buffer);
+    ESP_LOGD(TAG, "Request JSON: %.*s", (int)request_len, request_buffer->data);
 
     // Send HTTP POST to /responses endpoint
-    char *response_data = NULL;
+    xai_buffer_t *response_data = NULL;
     size_t response_len = 0;
     err = xai_http_post(
         client_impl->http_client,
         "/responses",
-        request_buffer,
+        request_buffer->data,
         request_len,
         &response_data,
         &response_len
     );
 
-    free(request_buffer);
+    xai_buffer_pool_release(client_impl->buffer_pool, request_buffer);
 
     if (err != XAI_OK) {
         ESP_LOGE(TAG, "HTTP request failed: %d", err);
-        xSemaphoreGive(client_impl->mutex);
+        xai_client_unlock(client_impl);
         return err;
     }
 
     ESP_LOGI(TAG, "Received response (%zu bytes)", response_len);
-    ESP_LOGD(TAG, "Response JSON: %.*s", (int)response_len, response_data);
+    ESP_LOGD(TAG, "Response JSON: %.*s", (int)response_len, response_data->data);
 
     // Parse response (same format as chat completions)
-    err = xai_json_parse_chat_response(response_data, response);
-    free(response_data);
+    err = xai_json_parse_chat_response(response_data->data, response);
+    xai_buffer_pool_release(client_impl->buffer_pool, response_data);
 
-    xSemaphoreGive(client_impl->mutex);
+    xai_client_unlock(client_impl);
 
     if (err != XAI_OK) {
         ESP_LOGE(TAG, "Failed to parse response: %d", err);
@@ -0,0 +1,459 @@
+/**
+ * @file xai_router.c
+ * @brief Latency-aware model routing
+ *
+ * The fast models differ less in quality than in how quickly they answer,
+ * and that changes over the day. A routing client picks the model of each
+ * chat request that names none: among the candidates the model registry
+ * says can serve the request, the one with the best measured latency that
+ * meets the configured limits. Every request that goes to a candidate -
+ * routed or named by the caller - updates that candidate's moving averages
+ * of time to first token (kept per prompt size class, since prefill grows
+ * with the prompt) and of tokens per second. Unmeasured candidates are
+ * tried first, and every explore_every decisions the stalest one is
+ * re-measured so a model that got faster can win again.
+ */
+
+#include "sdkconfig.h"
+#include "xai_internal.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+static const char *TAG = "xai_router";
+
+#ifndef CONFIG_XAI_ROUTER_EXPLORE_EVERY
+#define CONFIG_XAI_ROUTER_EXPLORE_EVERY 20
+#endif
+
+/** Rough prompt cost of an attached image, in tokens */
+#define ROUTE_IMAGE_TOKENS 256
+
+static const char *const s_default_models[] = {
+    "grok-3-mini-fast",
+    "grok-3-fast",
+    "grok-4-fast-non-reasoning",
+};
+
+void xai_router_init(xai_router_t *router, const xai_router_config_t *config) {
+    memset(router, 0, sizeof(*router));
+    if (!config || !config->enabled) {
+        return;
+    }
+
+    router->cfg = *config;
+    size_t given = 0;
+    for (size_t i = 0; i < XAI_ROUTER_MAX_MODELS; i++) {
+        given += config->models[i] ? 1 : 0;
+    }
+    for (size_t i = 0; i < XAI_ROUTER_MAX_MODELS; i++) {
+        const char *id = given ? config->models[i]
+                               : (i < sizeof(s_default_models) / sizeof(s_default_models[0])
+                                  ? s_default_models[i] : NULL);
+        router->cfg.models[i] = NULL;
+        if (!id) {
+            continue;
+        }
+        xai_route_model_t *model = &router->model[router->model_count];
+        snprintf(model->id, sizeof(model->id), "%s", id);
+        router->cfg.models[router->model_count++] = model->id;
+    }
+    if (router->cfg.explore_every == 0) {
+        router->cfg.explore_every = CONFIG_XAI_ROUTER_EXPLORE_EVERY;
+    }
+
+    router->lock = xSemaphoreCreateMutexStatic(&router->lock_buf);
+    router->enabled = true;
+    ESP_LOGI(TAG, "Routing between %u models", (unsigned)router->model_count);
+}
+
+void xai_router_deinit(xai_router_t *router) {
+    if (router->lock) {
+        vSemaphoreDelete(router->lock);
+        router->lock = NULL;
+    }
+    router->enabled = false;
+}
+
+/**
+ * @brief Prompt size estimate: four bytes of text per token
+ */
+static uint32_t route_prompt_tokens(
+    const xai_message_t *messages,
+    size_t message_count,
+    const xai_options_t *options
+) {
+    size_t bytes = 0;
+    uint32_t tokens = 0;
+    for (size_t i = 0; i < message_count; i++) {
+        bytes += messages[i].content ? strlen(messages[i].content) : 0;
+        for (size_t j = 0; j < messages[i].tool_call_count; j++) {
+            const xai_tool_call_t *call = &messages[i].tool_calls[j];
+            bytes += call->arguments ? strlen(call->arguments) : 0;
+        }
+        tokens += 4 + (uint32_t)messages[i].image_count * ROUTE_IMAGE_TOKENS;
+    }
+    if (options) {
+        for (size_t i = 0; options->tools && i < options->tool_count; i++) {
+            const xai_tool_t *tool = &options->tools[i];
+            bytes += tool->description ? strlen(tool->description) : 0;
+            bytes += tool->parameters_json ? strlen(tool->parameters_json) : 0;
+        }
+    }
+    return tokens + (uint32_t)(bytes / 4);
+}
+
+static size_t route_class(uint32_t prompt_tokens) {
+    return prompt_tokens < 1024 ? 0 : prompt_tokens < 8192 ? 1 : 2;
+}
+
+/**
+ * @brief Moving average with mean deviation, weighted as TCP's RTT
+ *        estimator (RFC 6298): 1/8 for the mean, 1/4 for the deviation
+ */
+static void route_ewma_add(xai_route_ewma_t *ewma, int32_t ms) {
+    if (ewma->samples++ == 0) {
+        ewma->mean_ms = ms;
+        ewma->dev_ms = ms / 2;
+        return;
+    }
+    int32_t error = ms - ewma->mean_ms;
+    ewma->mean_ms += error / 8;
+    ewma->dev_ms += ((error < 0 ? -error : error) - ewma->dev_ms) / 4;
+}
+
+static uint32_t route_p95(const xai_route_ewma_t *ewma) {
+    return ewma->samples ? (uint32_t)(ewma->mean_ms + 2 * ewma->dev_ms) : 0;
+}
+
+/**
+ * @brief First-token statistics for a prompt class: its own, else those
+ *        of the nearest measured class (NULL if never measured)
+ */
+static const xai_route_ewma_t* route_ttft(const xai_route_model_t *model, size_t cls) {
+    for (size_t d = 0; d < XAI_ROUTER_PROMPT_CLASSES; d++) {
+        if (cls >= d && model->ttft[cls - d].samples) {
+            return &model->ttft[cls - d];
+        }
+        if (cls + d < XAI_ROUTER_PROMPT_CLASSES && model->ttft[cls + d].samples) {
+            return &model->ttft[cls + d];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Expected generation time of a typical answer (0 = rate unknown)
+ */
+static uint32_t route_gen_ms(const xai_router_t *router, const xai_route_model_t *model,
+                             size_t max_tokens) {
+    if (model->tps_samples == 0 || model->tokens_per_s <= 0) {
+        return 0;
+    }
+    uint32_t tokens = (uint32_t)router->answer_tokens;
+    if (max_tokens && tokens > max_tokens) {
+        tokens = (uint32_t)max_tokens;
+    }
+    return (uint32_t)((uint64_t)tokens * 1000 / (uint32_t)model->tokens_per_s);
+}
+
+static void route_predict(const xai_router_t *router, const xai_route_model_t *model,
+                          size_t cls, size_t max_tokens, xai_route_decision_t *decision) {
+    const xai_route_ewma_t *ttft = route_ttft(model, cls);
+    if (ttft) {
+        decision->predicted_ttft_ms = (uint32_t)ttft->mean_ms;
+        decision->predicted_total_ms = (uint32_t)ttft->mean_ms +
+                                       route_gen_ms(router, model, max_tokens);
+    }
+}
+
+static int route_find(const xai_router_t *router, const char *id) {
+    for (size_t i = 0; i < router->model_count; i++) {
+        if (strcmp(router->model[i].id, id) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+const xai_options_t* xai_router_route(
+    struct xai_client_s *client,
+    const xai_message_t *messages,
+    size_t message_count,
+    const xai_options_t *options,
+    xai_options_t *routed,
+    xai_route_decision_t *decision
+) {
+    memset(decision, 0, sizeof(*decision));
+    xai_router_t *router = &client->router;
+    if (!router->enabled) {
+        return options;
+    }
+
+    decision->prompt_tokens = route_prompt_tokens(messages, message_count, options);
+    size_t cls = route_class(decision->prompt_tokens);
+    size_t max_tokens = (options && options->max_tokens) ? options->max_tokens
+                                                         : client->default_max_tokens;
+
+    // A request naming a candidate is measured, not routed
+    if (options && options->model) {
+        int pinned = route_find(router, options->model);
+        if (pinned >= 0) {
+            xSemaphoreTake(router->lock, portMAX_DELAY);
+            decision->model = router->model[pinned].id;
+            decision->reason = XAI_ROUTE_REASON_PINNED;
+            route_predict(router, &router->model[pinned], cls, max_tokens, decision);
+            router->stats.pinned++;
+            xSemaphoreGive(router->lock);
+        }
+        return options;
+    }
+
+    // Capabilities and context come from the registry, which has its own lock
+    uint32_t need = xai_request_caps(messages, message_count, options) | router->cfg.required_caps;
+    bool capable[XAI_ROUTER_MAX_MODELS];
+    for (size_t i = 0; i < router->model_count; i++) {
+        uint32_t context = xai_model_context_tokens(router->model[i].id);
+        capable[i] = xai_model_supports(router->model[i].id, need) &&
+                     (context == 0 || decision->prompt_tokens + max_tokens <= context);
+    }
+
+    xSemaphoreTake(router->lock, portMAX_DELAY);
+    int best = -1, fallback = -1, unmeasured = -1, stalest = -1;
+    uint32_t best_score = 0, fallback_score = 0;
+    for (size_t i = 0; i < router->model_count; i++) {
+        const xai_route_model_t *model = &router->model[i];
+        if (!capable[i]) {
+            continue;
+        }
+        const xai_route_ewma_t *ttft = route_ttft(model, cls);
+        if (!ttft) {
+            if (unmeasured < 0) {
+                unmeasured = (int)i;
+            }
+            continue;
+        }
+
+        uint32_t score;
+        switch (router->cfg.goal) {
+            case XAI_ROUTE_FASTEST_COMPLETION:
+                score = (uint32_t)ttft->mean_ms + route_gen_ms(router, model, max_tokens);
+                break;
+            case XAI_ROUTE_IN_ORDER:
+                score = (uint32_t)i;
+                break;
+            default:
+                score = (uint32_t)ttft->mean_ms;
+                break;
+        }
+        if (fallback < 0 || score < fallback_score) {
+            fallback = (int)i;
+            fallback_score = score;
+        }
+        if (stalest < 0 || model->measured_at < router->model[stalest].measured_at) {
+            stalest = (int)i;
+        }
+
+        bool fast_enough = router->cfg.max_ttft_p95_ms == 0 ||
+                           route_p95(ttft) <= router->cfg.max_ttft_p95_ms;
+        bool rate_enough = router->cfg.min_tokens_per_s == 0 || model->tps_samples == 0 ||
+                           (uint32_t)model->tokens_per_s >= router->cfg.min_tokens_per_s;
+        if (fast_enough && rate_enough && (best < 0 || score < best_score)) {
+            best = (int)i;
+            best_score = score;
+        }
+    }
+
+    if (unmeasured < 0 && fallback < 0) {
+        router->stats.unroutable++;
+        xSemaphoreGive(router->lock);
+        ESP_LOGW(TAG, "No candidate can serve this request; using the default model");
+        return options;
+    }
+
+    int choice;
+    uint32_t n = ++router->stats.decisions;
+    int leader = best >= 0 ? best : fallback;
+    if (unmeasured >= 0) {
+        choice = unmeasured;
+        decision->reason = XAI_ROUTE_REASON_EXPLORE;
+    } else if (n % router->cfg.explore_every == 0 && stalest != leader) {
+        choice = stalest;
+        decision->reason = XAI_ROUTE_REASON_EXPLORE;
+    } else if (best >= 0) {
+        choice = best;
+        decision->reason = XAI_ROUTE_REASON_BEST;
+    } else {
+        choice = fallback;
+        decision->reason = XAI_ROUTE_REASON_FALLBACK;
+        router->stats.fallbacks++;
+    }
+    if (decision->reason == XAI_ROUTE_REASON_EXPLORE) {
+        router->stats.explored++;
+    }
+
+    xai_route_model_t *model = &router->model[choice];
+    model->routed++;
+    decision->model = model->id;
+    route_predict(router, model, cls, max_tokens, decision);
+    xSemaphoreGive(router->lock);
+
+    ESP_LOGD(TAG, "Routed to %s (reason %d, ~%" PRIu32 " prompt tokens, expect %" PRIu32 " ms)",
+             decision->model, (int)decision->reason, decision->prompt_tokens,
+             decision->predicted_ttft_ms);
+
+    if (options) {
+        *routed = *options;
+    } else {
+        *routed = xai_options_default();
+    }
+    routed->model = decision->model;
+    return routed;
+}
+
+/**
+ * @brief Record one request's outcome against decision->model
+ *
+ * @param parser Stream parser of a streamed request, else NULL
+ */
+static void route_record(
+    xai_router_t *router,
+    xai_route_decision_t *decision,
+    xai_err_t err,
+    bool streamed,
+    uint32_t completion_tokens,
+    int64_t start_us,
+    int64_t first_byte_us,
+    int64_t end_us,
+    const xai_stream_parser_t *parser
+) {
+    decision->err = err;
+    decision->streamed = streamed;
+    decision->total_ms = (uint32_t)((end_us - start_us) / 1000);
+    if (streamed && parser) {
+        if (parser->first_token_us != 0) {
+            decision->ttft_ms = (uint32_t)((parser->first_token_us - start_us) / 1000);
+        }
+        completion_tokens = parser->completion_tokens;
+    }
+    decision->completion_tokens = completion_tokens;
+
+    xSemaphoreTake(router->lock, portMAX_DELAY);
+    xai_route_model_t *model = &router->model[route_find(router, decision->model)];
+    xai_route_ewma_t *ttft = &model->ttft[route_class(decision->prompt_tokens)];
+    model->requests++;
+    if (err != XAI_OK) {
+        // A request the server never answered waited total_ms for nothing:
+        // counted when that is slower than usual, never as a fast sample
+        model->errors++;
+        if (first_byte_us == 0 && (int32_t)decision->total_ms > ttft->mean_ms) {
+            route_ewma_add(ttft, (int32_t)decision->total_ms);
+            model->measured_at = router->stats.decisions;
+        }
+    } else {
+        if (streamed && decision->ttft_ms) {
+            route_ewma_add(ttft, (int32_t)decision->ttft_ms);
+            uint32_t gen_ms = decision->total_ms - decision->ttft_ms;
+            if (completion_tokens > 1 && gen_ms > 0) {
+                int32_t rate = (int32_t)((uint64_t)(completion_tokens - 1) * 1000 / gen_ms);
+                model->tokens_per_s = model->tps_samples++ == 0
+                                      ? rate
+                                      : model->tokens_per_s + (rate - model->tokens_per_s) / 8;
+            }
+        } else if (!streamed) {
+            // A buffered answer arrives whole: take off the generation time
+            // the measured rate accounts for (none until a stream measured it)
+            uint32_t gen_ms = model->tokens_per_s > 0
+                              ? (uint32_t)((uint64_t)completion_tokens * 1000 /
+                                           (uint32_t)model->tokens_per_s)
+                              : 0;
+            route_ewma_add(ttft, (int32_t)(decision->total_ms > gen_ms
+                                           ? decision->total_ms - gen_ms : 0));
+        }
+        if (completion_tokens) {
+            router->answer_tokens = router->answer_tokens == 0
+                ? (int32_t)completion_tokens
+                : router->answer_tokens + ((int32_t)completion_tokens - router->answer_tokens) / 8;
+        }
+        model->measured_at = router->stats.decisions;
+    }
+    xSemaphoreGive(router->lock);
+
+    if (router->cfg.on_decision) {
+        router->cfg.on_decision(decision, router->cfg.user_data);
+    }
+}
+
+void xai_router_record(
+    struct xai_client_s *client,
+    xai_route_decision_t *decision,
+    xai_err_t err,
+    bool streamed,
+    uint32_t completion_tokens
+) {
+    if (!decision->model) {
+        return;
+    }
+
+    // The HTTP client still describes this request until the mutex is given
+    xai_http_client_t *http = client->http_client;
+    route_record(&client->router, decision, err, streamed, completion_tokens,
+                 http->request_start_us, http->first_byte_us, esp_timer_get_time(),
+                 http->stream_parser);
+}
+
+void xai_router_record_outcome(
+    struct xai_client_s *client,
+    xai_route_decision_t *decision,
+    xai_err_t err,
+    const xai_request_outcome_t *outcome,
+    uint32_t completion_tokens
+) {
+    int index = decision->model && outcome->model ? route_find(&client->router, outcome->model)
+                                                  : -1;
+    if (index < 0) {
+        return;
+    }
+
+    decision->model = client->router.model[index].id;
+    route_record(&client->router, decision, err, false, completion_tokens,
+                 outcome->start_us, outcome->first_byte_us, outcome->end_us, NULL);
+}
+
+xai_err_t xai_get_router_stats(xai_client_t client, xai_router_stats_t *stats) {
+    if (!client || !stats) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    struct xai_client_s *impl = (struct xai_client_s *)client;
+    xai_router_t *router = &impl->router;
+    if (!router->enabled) {
+        return XAI_ERR_NOT_SUPPORTED;
+    }
+    if (xSemaphoreTake(router->lock, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        return XAI_ERR_TIMEOUT;
+    }
+    *stats = router->stats;
+    stats->model_count = router->model_count;
+    stats->answer_tokens = (uint32_t)router->answer_tokens;
+    for (size_t i = 0; i < router->model_count; i++) {
+        const xai_route_model_t *model = &router->model[i];
+        xai_router_model_stats_t *out = &stats->models[i];
+        memset(out, 0, sizeof(*out));
+        out->model = model->id;
+        out->requests = model->requests;
+        out->routed = model->routed;
+        out->errors = model->errors;
+        for (size_t c = 0; c < XAI_ROUTER_PROMPT_CLASSES; c++) {
+            out->ttft_samples[c] = model->ttft[c].samples;
+            out->ttft_ms[c] = (uint32_t)model->ttft[c].mean_ms;
+            out->ttft_p95_ms[c] = route_p95(&model->ttft[c]);
+        }
+        out->tps_samples = model->tps_samples;
+        out->tokens_per_s = (uint32_t)model->tokens_per_s;
+    }
+    xSemaphoreGive(router->lock);
+    return XAI_OK;
+}
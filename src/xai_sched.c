@@ -0,0 +1,213 @@
+/**
+ * @file xai_sched.c
+ * @brief Priority scheduler in front of the client's connection
+ *
+ * A client owns one HTTP connection, so its calls run one at a time. The
+ * order used to be whoever won the mutex, which let a background token
+ * count hold up a user-facing chat turn and left starved callers with
+ * XAI_ERR_TIMEOUT. Waiting calls now queue on their own stack and the
+ * connection goes to the best-ranked one when it frees up: interactive
+ * first, then normal, then background, with background calls lifted to
+ * normal after waiting CONFIG_XAI_SCHED_AGING_MS.
+ */
+
+#include "sdkconfig.h"
+#include "xai_internal.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+#include <stdint.h>
+
+static const char *TAG = "xai_sched";
+
+#ifndef CONFIG_XAI_SCHED_AGING_MS
+#define CONFIG_XAI_SCHED_AGING_MS 2000
+#endif
+
+#ifndef CONFIG_XAI_SCHED_MAX_INTERACTIVE
+#define CONFIG_XAI_SCHED_MAX_INTERACTIVE 4
+#endif
+
+#ifndef CONFIG_XAI_SCHED_MAX_NORMAL
+#define CONFIG_XAI_SCHED_MAX_NORMAL 8
+#endif
+
+#ifndef CONFIG_XAI_SCHED_MAX_BACKGROUND
+#define CONFIG_XAI_SCHED_MAX_BACKGROUND 2
+#endif
+
+/** Lower is served first; aging never lifts a call to rank 0 */
+static const uint8_t s_rank[XAI_PRIORITY_COUNT] = {
+    [XAI_PRIORITY_INTERACTIVE] = 0,
+    [XAI_PRIORITY_NORMAL] = 1,
+    [XAI_PRIORITY_BACKGROUND] = 2,
+};
+
+static const uint16_t s_default_max_calls[XAI_PRIORITY_COUNT] = {
+    [XAI_PRIORITY_INTERACTIVE] = CONFIG_XAI_SCHED_MAX_INTERACTIVE,
+    [XAI_PRIORITY_NORMAL] = CONFIG_XAI_SCHED_MAX_NORMAL,
+    [XAI_PRIORITY_BACKGROUND] = CONFIG_XAI_SCHED_MAX_BACKGROUND,
+};
+
+void xai_sched_init(xai_sched_t *sched, const xai_scheduler_config_t *config) {
+    memset(sched, 0, sizeof(*sched));
+    sched->lock = xSemaphoreCreateMutexStatic(&sched->lock_buf);
+    for (size_t i = 0; i < XAI_PRIORITY_COUNT; i++) {
+        sched->max_calls[i] = config->max_calls[i] ? config->max_calls[i] : s_default_max_calls[i];
+    }
+    uint32_t aging_ms = config->aging_ms ? config->aging_ms : CONFIG_XAI_SCHED_AGING_MS;
+    sched->aging_us = (int64_t)aging_ms * 1000;
+}
+
+void xai_sched_deinit(xai_sched_t *sched) {
+    if (sched->lock) {
+        vSemaphoreDelete(sched->lock);
+        sched->lock = NULL;
+    }
+}
+
+/**
+ * @brief Effective rank of a waiting call, after aging
+ */
+static uint32_t sched_rank(const xai_sched_t *sched, const xai_sched_waiter_t *waiter, int64_t now) {
+    uint32_t rank = s_rank[waiter->priority];
+    if (rank > 1) {
+        int64_t lift = (now - waiter->enqueued_us) / sched->aging_us;
+        rank = lift >= rank - 1 ? 1 : rank - (uint32_t)lift;
+    }
+    return rank;
+}
+
+static void sched_unlink(xai_sched_t *sched, xai_sched_waiter_t *waiter) {
+    xai_sched_waiter_t *prev = NULL;
+    for (xai_sched_waiter_t *it = sched->head; it; prev = it, it = it->next) {
+        if (it != waiter) {
+            continue;
+        }
+        if (prev) {
+            prev->next = it->next;
+        } else {
+            sched->head = it->next;
+        }
+        if (sched->tail == it) {
+            sched->tail = prev;
+        }
+        return;
+    }
+}
+
+/**
+ * @brief Hand the connection to the best-ranked waiting call, oldest first
+ *        among equals, or mark it free (caller holds the lock)
+ */
+static void sched_grant_next(xai_sched_t *sched) {
+    int64_t now = esp_timer_get_time();
+    xai_sched_waiter_t *best = NULL;
+    uint32_t best_rank = UINT32_MAX;
+    for (xai_sched_waiter_t *it = sched->head; it; it = it->next) {
+        uint32_t rank = sched_rank(sched, it, now);
+        if (rank < best_rank) {
+            best = it;
+            best_rank = rank;
+        }
+    }
+
+    if (!best) {
+        sched->busy = false;
+        return;
+    }
+
+    sched_unlink(sched, best);
+    xai_priority_t priority = best->priority;
+    uint32_t wait_us = (uint32_t)(now - best->enqueued_us);
+    sched->active = priority;
+    sched->stats.queued[priority]--;
+    sched->stats.granted[priority]++;
+    sched->stats.total_wait_us[priority] += wait_us;
+    if (wait_us > sched->stats.max_wait_us[priority]) {
+        sched->stats.max_wait_us[priority] = wait_us;
+    }
+    if (best_rank < s_rank[priority]) {
+        sched->stats.aged[priority]++;
+    }
+
+    best->granted = true;
+    xSemaphoreGive(best->wake);
+}
+
+xai_err_t xai_sched_acquire(xai_sched_t *sched, xai_priority_t priority, uint32_t timeout_ms) {
+    if (priority >= XAI_PRIORITY_COUNT) {
+        priority = XAI_PRIORITY_NORMAL;
+    }
+
+    xSemaphoreTake(sched->lock, portMAX_DELAY);
+
+    if (sched->calls[priority] >= sched->max_calls[priority]) {
+        sched->stats.rejected[priority]++;
+        xSemaphoreGive(sched->lock);
+        ESP_LOGW(TAG, "Class %d at its limit of %u calls", priority, sched->max_calls[priority]);
+        return XAI_ERR_BUSY;
+    }
+    sched->calls[priority]++;
+
+    // Free connection: nobody is waiting either, so take it
+    if (!sched->busy) {
+        sched->busy = true;
+        sched->active = priority;
+        sched->stats.granted[priority]++;
+        xSemaphoreGive(sched->lock);
+        return XAI_OK;
+    }
+
+    xai_sched_waiter_t waiter = {
+        .priority = priority,
+        .enqueued_us = esp_timer_get_time(),
+    };
+    waiter.wake = xSemaphoreCreateBinaryStatic(&waiter.wake_buf);
+    if (sched->tail) {
+        sched->tail->next = &waiter;
+    } else {
+        sched->head = &waiter;
+    }
+    sched->tail = &waiter;
+    if (++sched->stats.queued[priority] > sched->stats.max_queued[priority]) {
+        sched->stats.max_queued[priority] = sched->stats.queued[priority];
+    }
+    xSemaphoreGive(sched->lock);
+
+    xSemaphoreTake(waiter.wake, pdMS_TO_TICKS(timeout_ms));
+
+    // A grant may race the timeout: the flag under the lock decides
+    xai_err_t err = XAI_OK;
+    xSemaphoreTake(sched->lock, portMAX_DELAY);
+    if (!waiter.granted) {
+        sched_unlink(sched, &waiter);
+        sched->stats.queued[priority]--;
+        sched->stats.timeouts[priority]++;
+        sched->calls[priority]--;
+        err = XAI_ERR_TIMEOUT;
+    }
+    xSemaphoreGive(sched->lock);
+
+    vSemaphoreDelete(waiter.wake);
+    return err;
+}
+
+void xai_sched_release(xai_sched_t *sched) {
+    xSemaphoreTake(sched->lock, portMAX_DELAY);
+    sched->calls[sched->active]--;
+    sched_grant_next(sched);
+    xSemaphoreGive(sched->lock);
+}
+
+xai_err_t xai_get_scheduler_stats(xai_client_t client, xai_scheduler_stats_t *stats) {
+    if (!client || !stats) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    xai_sched_t *sched = &((struct xai_client_s *)client)->sched;
+    xSemaphoreTake(sched->lock, portMAX_DELAY);
+    *stats = sched->stats;
+    xSemaphoreGive(sched->lock);
+    return XAI_OK;
+}
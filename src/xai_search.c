@@ -13,6 +13,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include "xai.h"
+#include "xai_internal.h"
 #include "esp_log.h"
 
 static const char *TAG = "xai_search";
@@ -25,7 +26,7 @@ xai_search_params_t* xai_search_params_web(
     bool return_citations,
     const char **allowed_websites
 ) {
-    xai_search_params_t *params = calloc(1, sizeof(xai_search_params_t));
+    xai_search_params_t *params = xai_calloc(1, sizeof(xai_search_params_t));
     if (!params) {
         ESP_LOGE(TAG, "Failed to allocate search params");
         return NULL;
@@ -36,7 +37,7 @@ xai_search_params_t* xai_search_params_web(
     params->max_results = 0;  // Use default
 
     // Create web source
-    params->sources = calloc(1, sizeof(xai_search_source_t));
+    params->sources = xai_calloc(1, sizeof(xai_search_source_t));
     if (!params->sources) {
         ESP_LOGE(TAG, "Failed to allocate source");
         free(params);
@@ -61,7 +62,7 @@ xai_search_params_t* xai_search_params_x(
     bool return_citations,
     const char **x_handles
 ) {
-    xai_search_params_t *params = calloc(1, sizeof(xai_search_params_t));
+    xai_search_params_t *params = xai_calloc(1, sizeof(xai_search_params_t));
     if (!params) {
         ESP_LOGE(TAG, "Failed to allocate search params");
         return NULL;
@@ -72,7 +73,7 @@ xai_search_params_t* xai_search_params_x(
     params->max_results = 0;
 
     // Create X source
-    params->sources = calloc(1, sizeof(xai_search_source_t));
+    params->sources = xai_calloc(1, sizeof(xai_search_source_t));
     if (!params->sources) {
         ESP_LOGE(TAG, "Failed to allocate source");
         free(params);
@@ -100,7 +101,7 @@ xai_search_params_t* xai_search_params_news(
     bool return_citations,
     const char *country
 ) {
-    xai_search_params_t *params = calloc(1, sizeof(xai_search_params_t));
+    xai_search_params_t *params = xai_calloc(1, sizeof(xai_search_params_t));
     if (!params) {
         ESP_LOGE(TAG, "Failed to allocate search params");
         return NULL;
@@ -111,7 +112,7 @@ xai_search_params_t* xai_search_params_news(
     params->max_results = 0;
 
     // Create news source
-    params->sources = calloc(1, sizeof(xai_search_source_t));
+    params->sources = xai_calloc(1, sizeof(xai_search_source_t));
     if (!params->sources) {
         ESP_LOGE(TAG, "Failed to allocate source");
         free(params);
@@ -142,7 +143,7 @@ xai_search_params_t* xai_search_params_rss(
         return NULL;
     }
 
-    xai_search_params_t *params = calloc(1, sizeof(xai_search_params_t));
+    xai_search_params_t *params = xai_calloc(1, sizeof(xai_search_params_t));
     if (!params) {
         ESP_LOGE(TAG, "Failed to allocate search params");
         return NULL;
@@ -153,7 +154,7 @@ xai_search_params_t* xai_search_params_rss(
     params->max_results = 0;
 
     // Create RSS source
-    params->sources = calloc(1, sizeof(xai_search_source_t));
+    params->sources = xai_calloc(1, sizeof(xai_search_source_t));
     if (!params->sources) {
         ESP_LOGE(TAG, "Failed to allocate source");
         free(params);
@@ -161,7 +162,7 @@ xai_search_params_t* xai_search_params_rss(
     }
 
     // Allocate RSS links array (currently supports 1 feed)
-    const char **rss_links = calloc(2, sizeof(char*));  // NULL-terminated
+    const char **rss_links = xai_calloc(2, sizeof(char*));  // NULL-terminated
     if (!rss_links) {
         ESP_LOGE(TAG, "Failed to allocate RSS links");
         free(params->sources);
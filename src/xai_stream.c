@@ -1,15 +1,25 @@
 /**
  * @file xai_stream.c
  * @brief Server-Sent Events (SSE) stream parser
- * 
- * Implements a state machine parser for SSE format used by xAI's streaming API.
- * 
+ *
+ * Line-oriented parser for the SSE format used by xAI's streaming API.
+ * Line boundaries are located with memchr() over the whole chunk, the field
+ * name is classified once per line and value runs are copied with a single
+ * memcpy(), so the per-byte cost is that of memchr/memcpy only.
+ *
  * SSE Format:
  * data: {"choices":[{"delta":{"content":"Hello"}}]}
- * 
+ *
  * data: {"choices":[{"delta":{"content":" world"}}]}
- * 
+ *
  * data: [DONE]
+ *
+ * Spec coverage (WHATWG HTML, "Server-sent events"):
+ * - LF, CR and CRLF line endings (also split across chunks)
+ * - Multi-line data fields joined with '\n'
+ * - event:, id: and retry: fields; comment lines starting with ':'
+ * - Field lines without a colon (empty value)
+ * - Events are dispatched on a blank line
  */
 
 #include "sdkconfig.h"
@@ -18,14 +28,102 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <inttypes.h>
 #include "xai_internal.h"
 #include "esp_log.h"
+#include "esp_heap_caps.h"
 
 static const char *TAG = "xai_stream";
 
+// From Kconfig
+#ifndef CONFIG_XAI_STREAM_BUFFER_INITIAL_SIZE
+#define CONFIG_XAI_STREAM_BUFFER_INITIAL_SIZE 1024
+#endif
+
+#ifndef CONFIG_XAI_STREAM_BUFFER_MAX_SIZE
+#define CONFIG_XAI_STREAM_BUFFER_MAX_SIZE 65536
+#endif
+
 /**
- * @brief Create SSE stream parser
+ * @brief Allocate SSE stream parser
+ *
+ * The event buffer is not allocated here: streams normally run over a pool
+ * buffer handed to xai_stream_parser_reset(), and own_buffer is only
+ * allocated when no storage is given or an event outgrows it.
  */
+static xai_stream_parser_t* sse_parser_alloc(void) {
+    xai_stream_parser_t *parser = xai_calloc(1, sizeof(xai_stream_parser_t));
+    if (!parser) {
+        ESP_LOGE(TAG, "Failed to allocate parser");
+        return NULL;
+    }
+
+    parser->max_event_size = CONFIG_XAI_STREAM_BUFFER_MAX_SIZE;
+    parser->data_buffer = &parser->own_buffer;
+
+    ESP_LOGD(TAG, "Created stream parser");
+    return parser;
+}
+
+xai_err_t xai_stream_parser_reset(
+    xai_stream_parser_t *parser,
+    xai_stream_callback_t callback,
+    xai_stream_event_callback_t event_callback,
+    void *user_data,
+    xai_buffer_t *storage
+) {
+    if (!parser) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    parser->state = SSE_STATE_LINE_START;
+    parser->field = SSE_FIELD_IGNORED;
+    parser->field_len = 0;
+    parser->value_len = 0;
+    parser->skip_space = false;
+    parser->pending_cr = false;
+    parser->stream_start = true;
+
+    parser->event_type[0] = '\0';
+    parser->last_event_id[0] = '\0';
+    parser->retry_ms = 0;
+
+    parser->data_lines = 0;
+    parser->data_overflow = false;
+    parser->error = XAI_OK;
+    parser->events = 0;
+    parser->framing_only = false;
+
+    // own_buffer keeps its capacity for the next stream
+    parser->data_buffer = storage ? storage : &parser->own_buffer;
+    parser->data_buffer->used = 0;
+
+    parser->callback = callback;
+    parser->event_callback = event_callback;
+    parser->user_data = user_data;
+
+    parser->last_delta_us = 0;
+    memset(&parser->latency, 0, sizeof(parser->latency));
+    parser->latency.streams = 1;
+    parser->first_token_us = 0;
+    parser->completion_tokens = 0;
+    return XAI_OK;
+}
+
+xai_stream_parser_t* xai_stream_parser_create_static(xai_static_region_t *region) {
+    xai_stream_parser_t *parser = xai_static_take(region, sizeof(xai_stream_parser_t));
+    if (!parser) {
+        ESP_LOGE(TAG, "No static memory for parser");
+        return NULL;
+    }
+
+    // No own_buffer growth: events are capped at the storage size
+    parser->max_event_size = 0;
+    parser->data_buffer = &parser->own_buffer;
+    parser->static_storage = true;
+    return parser;
+}
+
 xai_stream_parser_t* xai_stream_parser_create(
     xai_stream_callback_t callback,
     void *user_data
@@ -35,45 +133,419 @@ xai_stream_parser_t* xai_stream_parser_create(
         return NULL;
     }
 
-    xai_stream_parser_t *parser = calloc(1, sizeof(xai_stream_parser_t));
-    if (!parser) {
-        ESP_LOGE(TAG, "Failed to allocate parser");
+    xai_stream_parser_t *parser = sse_parser_alloc();
+    xai_stream_parser_reset(parser, callback, NULL, user_data, NULL);
+    return parser;
+}
+
+xai_stream_parser_t* xai_stream_parser_create_events(
+    xai_stream_event_callback_t callback,
+    void *user_data
+) {
+    if (!callback) {
+        ESP_LOGE(TAG, "Callback is required");
         return NULL;
     }
 
-    parser->state = SSE_STATE_IDLE;
-    parser->callback = callback;
-    parser->user_data = user_data;
+    xai_stream_parser_t *parser = sse_parser_alloc();
+    xai_stream_parser_reset(parser, NULL, callback, user_data, NULL);
+    return parser;
+}
 
-    // Allocate data buffer for accumulating JSON
-    parser->data_buffer = calloc(1, sizeof(xai_buffer_t));
-    if (!parser->data_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate data buffer");
-        free(parser);
-        return NULL;
+/* ========================================================================
+ * Line Handling
+ * ======================================================================== */
+
+/**
+ * @brief Find the first CR or LF in [p, end)
+ *
+ * The LF scan bounds the CR scan, so a CRLF-terminated line is scanned
+ * about once by each memchr().
+ */
+static const char *sse_find_eol(const char *p, const char *end) {
+    size_t n = (size_t)(end - p);
+    const char *lf = memchr(p, '\n', n);
+    const char *cr = memchr(p, '\r', lf ? (size_t)(lf - p) : n);
+    return cr ? cr : lf;
+}
+
+static sse_field_t sse_classify_field(const xai_stream_parser_t *parser) {
+    const char *name = parser->field_buffer;
+
+    switch (parser->field_len) {
+        case 4:
+            if (memcmp(name, "data", 4) == 0) return SSE_FIELD_DATA;
+            break;
+        case 5:
+            if (memcmp(name, "event", 5) == 0) return SSE_FIELD_EVENT;
+            if (memcmp(name, "retry", 5) == 0) return SSE_FIELD_RETRY;
+            break;
+        case 2:
+            if (memcmp(name, "id", 2) == 0) return SSE_FIELD_ID;
+            break;
+        default:
+            break;
     }
+    return SSE_FIELD_IGNORED;
+}
 
-    parser->data_buffer->capacity = 8192;  // 8KB buffer for streaming chunks
-    parser->data_buffer->data = malloc(parser->data_buffer->capacity);
-    if (!parser->data_buffer->data) {
-        ESP_LOGE(TAG, "Failed to allocate data buffer memory");
-        free(parser->data_buffer);
-        free(parser);
-        return NULL;
+/**
+ * @brief Make room for @p needed bytes (including the NUL) in the data buffer
+ *
+ * Borrowed pool storage has a fixed size, so an event that outgrows it moves
+ * to own_buffer, which doubles up to max_event_size. own_buffer is kept
+ * across streams, so the parser stops allocating once its largest event has
+ * been seen.
+ */
+static bool sse_reserve(xai_stream_parser_t *parser, size_t needed) {
+    xai_buffer_t *buf = parser->data_buffer;
+    xai_buffer_t *own = &parser->own_buffer;
+
+    if (needed <= buf->capacity) {
+        return true;
+    }
+    if (needed > parser->max_event_size) {
+        return false;
     }
 
-    parser->data_buffer->used = 0;
-    parser->data_buffer->in_use = true;
+    if (needed > own->capacity) {
+        size_t new_capacity = own->capacity ? own->capacity : CONFIG_XAI_STREAM_BUFFER_INITIAL_SIZE;
+        while (new_capacity < needed) {
+            new_capacity *= 2;
+        }
+        if (new_capacity > parser->max_event_size) {
+            new_capacity = parser->max_event_size;
+        }
 
-    ESP_LOGD(TAG, "Created stream parser");
-    return parser;
+        char *data = xai_realloc_bulk(own->data, new_capacity);
+        if (!data) {
+            ESP_LOGE(TAG, "Failed to grow data buffer to %zu bytes", new_capacity);
+            return false;
+        }
+
+        ESP_LOGD(TAG, "Data buffer grown: %zu -> %zu bytes", own->capacity, new_capacity);
+        own->data = data;
+        own->capacity = new_capacity;
+    }
+
+    if (buf != own) {
+        // Leave the pool buffer; the partial event comes along
+        memcpy(own->data, buf->data, buf->used);
+        own->used = buf->used;
+        buf->used = 0;
+        parser->data_buffer = own;
+    }
+    return true;
+}
+
+static void sse_append_data(xai_stream_parser_t *parser, const char *src, size_t n) {
+    xai_buffer_t *buf = parser->data_buffer;
+
+    if (parser->data_overflow) {
+        return;
+    }
+    // Keep one byte for the terminating NUL
+    if (buf->used + n + 1 > buf->capacity) {
+        if (!sse_reserve(parser, buf->used + n + 1)) {
+            parser->data_overflow = true;
+            return;
+        }
+        buf = parser->data_buffer;
+    }
+    memcpy(buf->data + buf->used, src, n);
+    buf->used += n;
+}
+
+/**
+ * @brief A "data" field starts: join with the previous data line, if any
+ */
+static void sse_begin_data_line(xai_stream_parser_t *parser) {
+    if (parser->data_lines > 0) {
+        sse_append_data(parser, "\n", 1);
+    }
+    parser->data_lines++;
+}
+
+/**
+ * @brief Apply a completed event/id/retry field
+ */
+static void sse_apply_field(xai_stream_parser_t *parser) {
+    const char *value = parser->value_buffer;
+    size_t len = parser->value_len;
+
+    switch (parser->field) {
+        case SSE_FIELD_EVENT:
+            if (len >= sizeof(parser->event_type)) {
+                len = sizeof(parser->event_type) - 1;
+            }
+            memcpy(parser->event_type, value, len);
+            parser->event_type[len] = '\0';
+            break;
+
+        case SSE_FIELD_ID:
+            // IDs containing NUL are ignored per spec
+            if (!memchr(value, '\0', len)) {
+                if (len >= sizeof(parser->last_event_id)) {
+                    len = sizeof(parser->last_event_id) - 1;
+                }
+                memcpy(parser->last_event_id, value, len);
+                parser->last_event_id[len] = '\0';
+            }
+            break;
+
+        case SSE_FIELD_RETRY: {
+            // Only ASCII digits are accepted
+            uint32_t retry = 0;
+            if (len == 0) {
+                break;
+            }
+            for (size_t i = 0; i < len; i++) {
+                if (value[i] < '0' || value[i] > '9') {
+                    return;
+                }
+                retry = retry * 10 + (uint32_t)(value[i] - '0');
+            }
+            parser->retry_ms = retry;
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Hand one event to the user: as is, or mapped onto the text callback
+ *
+ * Runs outside the request's JSON arena, so cJSON trees the user keeps
+ * beyond the callback come from the heap.
+ */
+static void sse_user_event(const xai_stream_event_t *event, void *user_data) {
+    xai_stream_parser_t *parser = (xai_stream_parser_t *)user_data;
+    xai_arena_t *arena = xai_arena_suspend();
+
+    if (event->type == XAI_STREAM_EVENT_CONTENT) {
+        // Inter-token latency as the callback sees it
+        int64_t now = esp_timer_get_time();
+        xai_stream_latency_t *latency = &parser->latency;
+        if (parser->last_delta_us != 0) {
+            uint32_t gap = (uint32_t)(now - parser->last_delta_us);
+            latency->gaps++;
+            latency->gap_us += gap;
+            if (gap > latency->max_gap_us) {
+                latency->max_gap_us = gap;
+            }
+        }
+        latency->deltas++;
+        parser->last_delta_us = now;
+    }
+    if (parser->first_token_us == 0 &&
+        (event->type == XAI_STREAM_EVENT_CONTENT || event->type == XAI_STREAM_EVENT_REASONING)) {
+        parser->first_token_us = esp_timer_get_time();
+    } else if (event->type == XAI_STREAM_EVENT_USAGE) {
+        parser->completion_tokens = event->completion_tokens + event->reasoning_tokens;
+    }
+
+    if (parser->event_callback) {
+        parser->event_callback(event, parser->user_data);
+    } else {
+        // Text mode: content deltas only; finish reason and [DONE] end the stream
+        switch (event->type) {
+            case XAI_STREAM_EVENT_CONTENT:
+                parser->callback(event->text, event->length, parser->user_data);
+                break;
+
+            case XAI_STREAM_EVENT_FINISH:
+            case XAI_STREAM_EVENT_DONE:
+                // Signal end of stream with NULL content
+                ESP_LOGD(TAG, "Stream completed");
+                parser->callback(NULL, 0, parser->user_data);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    xai_arena_resume(arena);
+}
+
+/**
+ * @brief Report a stream-level error to an event-mode callback
+ */
+static void sse_emit_error(xai_stream_parser_t *parser, xai_err_t err) {
+    if (parser->event_callback) {
+        xai_stream_event_t event = {
+            .type = XAI_STREAM_EVENT_ERROR,
+            .error = err,
+        };
+        sse_user_event(&event, parser);
+    }
+}
+
+/**
+ * @brief Deliver one JSON payload to the callback
+ */
+static void sse_deliver(xai_stream_parser_t *parser, const char *json_str) {
+    ESP_LOGD(TAG, "Received data: %s", json_str);
+
+    if (parser->framing_only) {
+        return;
+    }
+    if (xai_json_parse_stream_events(json_str, sse_user_event, parser) != XAI_OK) {
+        sse_emit_error(parser, XAI_ERR_PARSE_FAILED);
+    }
+}
+
+/**
+ * @brief Blank line: dispatch the pending event
+ */
+static void sse_dispatch_event(xai_stream_parser_t *parser) {
+    xai_buffer_t *buf = parser->data_buffer;
+
+    // An event whose data is the empty string is not dispatched
+    if (parser->data_lines > 0 && (buf->used > 0 || parser->data_overflow)) {
+        if (parser->data_overflow) {
+            // Never hand truncated JSON to the parser; fail the stream instead
+            ESP_LOGE(TAG, "SSE event exceeds %zu bytes, dropped", parser->max_event_size);
+            if (parser->error == XAI_OK) {
+                parser->error = XAI_ERR_NO_MEMORY;
+            }
+            sse_emit_error(parser, XAI_ERR_NO_MEMORY);
+        } else {
+            buf->data[buf->used] = '\0';
+            if (parser->event_type[0] != '\0' && strcmp(parser->event_type, "message") != 0) {
+                ESP_LOGD(TAG, "Event type: %s", parser->event_type);
+            }
+            parser->events++;
+            sse_deliver(parser, buf->data);
+        }
+    }
+
+    // Reset event state
+    buf->used = 0;
+    parser->data_lines = 0;
+    parser->data_overflow = false;
+    parser->event_type[0] = '\0';
+}
+
+/**
+ * @brief Consume bytes belonging to the current line (no CR/LF inside)
+ */
+static void sse_consume_segment(xai_stream_parser_t *parser, const char *s, size_t n) {
+    if (n == 0) {
+        return;
+    }
+
+    if (parser->state == SSE_STATE_LINE_START) {
+        if (s[0] == ':') {
+            // Comment line: ignore the rest of it
+            parser->field = SSE_FIELD_IGNORED;
+            parser->skip_space = false;
+            parser->state = SSE_STATE_VALUE;
+            return;
+        }
+        parser->field_len = 0;
+        parser->state = SSE_STATE_FIELD;
+    }
+
+    if (parser->state == SSE_STATE_FIELD) {
+        const char *colon = memchr(s, ':', n);
+        size_t name_len = colon ? (size_t)(colon - s) : n;
+
+        if (parser->field_len + name_len <= sizeof(parser->field_buffer)) {
+            memcpy(parser->field_buffer + parser->field_len, s, name_len);
+            parser->field_len += name_len;
+        } else {
+            // Longer than any known field name
+            parser->field_len = sizeof(parser->field_buffer);
+        }
+
+        if (!colon) {
+            return;
+        }
+
+        parser->field = sse_classify_field(parser);
+        parser->value_len = 0;
+        parser->skip_space = true;
+        parser->state = SSE_STATE_VALUE;
+        if (parser->field == SSE_FIELD_DATA) {
+            sse_begin_data_line(parser);
+        }
+
+        n -= name_len + 1;
+        s = colon + 1;
+        if (n == 0) {
+            return;
+        }
+    }
+
+    // SSE_STATE_VALUE
+    if (parser->skip_space) {
+        parser->skip_space = false;
+        if (s[0] == ' ') {
+            s++;
+            n--;
+        }
+    }
+    if (n == 0) {
+        return;
+    }
+
+    switch (parser->field) {
+        case SSE_FIELD_DATA:
+            sse_append_data(parser, s, n);
+            break;
+
+        case SSE_FIELD_EVENT:
+        case SSE_FIELD_ID:
+        case SSE_FIELD_RETRY: {
+            size_t room = sizeof(parser->value_buffer) - parser->value_len;
+            size_t copy = n < room ? n : room;
+            memcpy(parser->value_buffer + parser->value_len, s, copy);
+            parser->value_len += copy;
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief End of line reached
+ */
+static void sse_end_line(xai_stream_parser_t *parser) {
+    switch (parser->state) {
+        case SSE_STATE_LINE_START:
+            sse_dispatch_event(parser);
+            break;
+
+        case SSE_STATE_FIELD:
+            // Field name without colon: the value is the empty string
+            parser->field = sse_classify_field(parser);
+            parser->value_len = 0;
+            if (parser->field == SSE_FIELD_DATA) {
+                sse_begin_data_line(parser);
+            }
+            sse_apply_field(parser);
+            break;
+
+        case SSE_STATE_VALUE:
+            sse_apply_field(parser);
+            break;
+    }
+
+    parser->state = SSE_STATE_LINE_START;
+    parser->field = SSE_FIELD_IGNORED;
+    parser->field_len = 0;
 }
 
 /**
  * @brief Feed data to stream parser
- * 
+ *
  * Parses SSE format line by line:
- * - Lines starting with "data: " contain JSON chunks
+ * - "data:" lines are accumulated (joined with '\n') into the event payload
  * - Empty lines trigger event delivery
  * - "data: [DONE]" signals end of stream
  */
@@ -83,130 +555,73 @@ void xai_stream_parser_feed(
     void *user_data
 ) {
     xai_stream_parser_t *parser = (xai_stream_parser_t *)user_data;
-    
+
     if (!parser || !data || len == 0) {
         return;
     }
 
-    for (size_t i = 0; i < len; i++) {
-        char c = data[i];
-
-        switch (parser->state) {
-            case SSE_STATE_IDLE:
-                if (c == 'd') {
-                    // Start of potential "data:" field
-                    parser->state = SSE_STATE_FIELD;
-                    parser->field_buffer[0] = c;
-                    parser->field_buffer[1] = '\0';
-                } else if (c == '\n' || c == '\r') {
-                    // Empty line, stay idle
-                } else {
-                    // Unknown field, skip
-                    parser->state = SSE_STATE_FIELD;
-                    parser->field_buffer[0] = c;
-                    parser->field_buffer[1] = '\0';
-                }
-                break;
+    const char *p = data;
+    const char *end = data + len;
 
-            case SSE_STATE_FIELD:
-                if (c == ':') {
-                    // End of field name
-                    parser->state = SSE_STATE_VALUE;
-                    
-                    // Skip space after colon if present
-                    if (i + 1 < len && data[i + 1] == ' ') {
-                        i++;
-                    }
-                    
-                    // Check if this is a "data" field
-                    if (strcmp(parser->field_buffer, "data") == 0) {
-                        // Reset data buffer
-                        parser->data_buffer->used = 0;
-                    }
-                } else if (c == '\n' || c == '\r') {
-                    // End of line without colon, reset
-                    parser->state = SSE_STATE_IDLE;
-                } else {
-                    // Accumulate field name
-                    size_t field_len = strlen(parser->field_buffer);
-                    if (field_len < sizeof(parser->field_buffer) - 1) {
-                        parser->field_buffer[field_len] = c;
-                        parser->field_buffer[field_len + 1] = '\0';
-                    }
-                }
-                break;
+    // Strip a leading UTF-8 BOM
+    if (parser->stream_start) {
+        parser->stream_start = false;
+        if (len >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+            p += 3;
+        }
+    }
 
-            case SSE_STATE_VALUE:
-                if (c == '\n' || c == '\r') {
-                    // End of value
-                    parser->state = SSE_STATE_EOL;
-                    
-                    // Process "data" field
-                    if (strcmp(parser->field_buffer, "data") == 0) {
-                        // Null-terminate data
-                        if (parser->data_buffer->used < parser->data_buffer->capacity) {
-                            parser->data_buffer->data[parser->data_buffer->used] = '\0';
-                        }
-                        
-                        const char *json_str = parser->data_buffer->data;
-                        ESP_LOGD(TAG, "Received data: %s", json_str);
-                        
-                        // Check for [DONE] marker
-                        if (strcmp(json_str, "[DONE]") == 0) {
-                            ESP_LOGD(TAG, "Stream completed");
-                            // Signal end of stream with NULL content
-                            parser->callback(NULL, 0, parser->user_data);
-                        } else {
-                            // Parse JSON chunk and extract content delta
-                            char *content_delta = NULL;
-                            bool is_done = false;
-                            
-                            xai_err_t err = xai_json_parse_stream_chunk(
-                                json_str,
-                                &content_delta,
-                                &is_done
-                            );
-                            
-                            if (err == XAI_OK && content_delta) {
-                                // Deliver content to callback
-                                parser->callback(content_delta, strlen(content_delta), parser->user_data);
-                                free(content_delta);
-                            }
-                            
-                            if (is_done) {
-                                // Signal end of stream
-                                parser->callback(NULL, 0, parser->user_data);
-                            }
-                        }
-                        
-                        // Reset data buffer
-                        parser->data_buffer->used = 0;
-                    }
-                } else {
-                    // Accumulate value (for "data" field, this is JSON)
-                    if (strcmp(parser->field_buffer, "data") == 0) {
-                        if (parser->data_buffer->used < parser->data_buffer->capacity - 1) {
-                            parser->data_buffer->data[parser->data_buffer->used++] = c;
-                        } else {
-                            ESP_LOGW(TAG, "Data buffer overflow");
-                        }
-                    }
-                }
-                break;
+    // CRLF split across chunks
+    if (parser->pending_cr) {
+        parser->pending_cr = false;
+        if (p < end && *p == '\n') {
+            p++;
+        }
+    }
 
-            case SSE_STATE_EOL:
-                if (c == '\n' || c == '\r') {
-                    // Another newline, stay in EOL state
-                } else {
-                    // Start of new field
-                    parser->state = SSE_STATE_IDLE;
-                    i--;  // Reprocess this character
-                }
-                break;
+    while (p < end) {
+        const char *eol = sse_find_eol(p, end);
+        if (!eol) {
+            // Partial line: keep its state for the next chunk
+            sse_consume_segment(parser, p, (size_t)(end - p));
+            break;
+        }
+
+        sse_consume_segment(parser, p, (size_t)(eol - p));
+        sse_end_line(parser);
+
+        p = eol + 1;
+        if (*eol == '\r') {
+            if (p == end) {
+                parser->pending_cr = true;
+            } else if (*p == '\n') {
+                p++;
+            }
         }
     }
 }
 
+/**
+ * @brief Flush an event left pending when the stream ends
+ *
+ * Strictly, the spec discards an unterminated event at end of stream; we
+ * deliver it so a final "data: [DONE]" without a blank line still ends the
+ * stream for the caller.
+ */
+void xai_stream_parser_finish(xai_stream_parser_t *parser) {
+    if (!parser) {
+        return;
+    }
+
+    if (parser->state != SSE_STATE_LINE_START) {
+        sse_end_line(parser);
+    }
+    if (parser->data_lines > 0) {
+        sse_dispatch_event(parser);
+    }
+    parser->pending_cr = false;
+}
+
 /**
  * @brief Destroy stream parser
  */
@@ -215,16 +630,225 @@ void xai_stream_parser_destroy(xai_stream_parser_t *parser) {
         return;
     }
 
-    if (parser->data_buffer) {
-        if (parser->data_buffer->data) {
-            free(parser->data_buffer->data);
+    // Borrowed storage belongs to the pool
+    heap_caps_free(parser->own_buffer.data);
+
+    if (!parser->static_storage) {
+        free(parser);
+    }
+    ESP_LOGD(TAG, "Destroyed stream parser");
+}
+
+xai_err_t xai_get_stream_stats(xai_client_t client, xai_stream_stats_t *stats) {
+    if (!client || !stats) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    // Written by streams, which run with the client mutex held
+    struct xai_client_s *impl = (struct xai_client_s *)client;
+    if (xSemaphoreTake(impl->mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        return XAI_ERR_TIMEOUT;
+    }
+    *stats = impl->http_client->stream_stats;
+    xSemaphoreGive(impl->mutex);
+    return XAI_OK;
+}
+
+// ============================================================================
+// Throughput Benchmark
+// ============================================================================
+
+#define SSE_BENCH_DEFAULT_CHUNK 1460    // One TCP segment
+
+#define SSE_BENCH_CHUNK(delta) \
+    "data: {\"id\":\"c7e1\",\"object\":\"chat.completion.chunk\",\"created\":1760000000," \
+    "\"model\":\"grok-3-mini\",\"choices\":[{\"index\":0,\"delta\":" delta \
+    ",\"finish_reason\":null}]}\n\n"
+
+/** A recorded grok-3-mini reply: role, reasoning, 25 content deltas, usage */
+static const char SSE_BENCH_STREAM[] =
+    ": keep-alive\n\n"
+    SSE_BENCH_CHUNK("{\"role\":\"assistant\",\"content\":\"\"}")
+    SSE_BENCH_CHUNK("{\"reasoning_content\":\"The user asks about ESP32-S3 memory.\"}")
+    SSE_BENCH_CHUNK("{\"content\":\"The ESP32-S3 \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"has two \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"Xtensa LX7 \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"cores running \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"at up \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"to 240 \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"MHz, 512 \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"KB of \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"internal SRAM \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"and optional \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"octal PSRAM. \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"For streaming \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"replies, parsing \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"on the \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"second core \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"keeps the \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"receive path \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"free while \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"the first \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"core renders \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"text, so \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"tokens appear \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"as soon \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"as they \"}")
+    SSE_BENCH_CHUNK("{\"content\":\"arrive.\"}")
+    "data: {\"id\":\"c7e1\",\"object\":\"chat.completion.chunk\",\"created\":1760000000,"
+    "\"model\":\"grok-3-mini\",\"choices\":[{\"index\":0,\"delta\":{},\"finish_reason\":\"stop\"}],"
+    "\"usage\":{\"prompt_tokens\":24,\"completion_tokens\":25,\"total_tokens\":49,"
+    "\"completion_tokens_details\":{\"reasoning_tokens\":9}}}\n\n"
+    "data: [DONE]\n\n";
+
+static void sse_bench_event(const xai_stream_event_t *event, void *user_data) {
+    if (event->type == XAI_STREAM_EVENT_CONTENT) {
+        (*(uint32_t *)user_data)++;
+    }
+}
+
+/**
+ * @brief Feed the recorded stream iterations times, chunk_size bytes at a time
+ *
+ * @return Elapsed time in microseconds
+ */
+static uint32_t sse_bench_pass(xai_stream_parser_t *parser, uint32_t iterations,
+                               size_t chunk_size, bool framing_only, uint32_t *deltas) {
+    const size_t len = sizeof(SSE_BENCH_STREAM) - 1;
+
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < iterations; i++) {
+        xai_stream_parser_reset(parser, NULL, sse_bench_event, deltas, NULL);
+        parser->framing_only = framing_only;
+        for (size_t off = 0; off < len; off += chunk_size) {
+            size_t n = len - off < chunk_size ? len - off : chunk_size;
+            xai_stream_parser_feed(SSE_BENCH_STREAM + off, n, parser);
         }
-        free(parser->data_buffer);
+        xai_stream_parser_finish(parser);
+    }
+    return (uint32_t)(esp_timer_get_time() - start);
+}
+
+xai_err_t xai_stream_parser_benchmark(uint32_t iterations, size_t chunk_size,
+                                      xai_stream_parser_bench_t *result) {
+    if (iterations == 0 || !result) {
+        return XAI_ERR_INVALID_ARG;
     }
 
-    free(parser);
-    ESP_LOGD(TAG, "Destroyed stream parser");
+    uint32_t deltas = 0;
+    xai_stream_parser_t *parser = xai_stream_parser_create_events(sse_bench_event, &deltas);
+    if (!parser) {
+        return XAI_ERR_NO_MEMORY;
+    }
+
+    memset(result, 0, sizeof(*result));
+    result->iterations = iterations;
+    result->stream_bytes = sizeof(SSE_BENCH_STREAM) - 1;
+    result->chunk_size = chunk_size ? chunk_size : SSE_BENCH_DEFAULT_CHUNK;
+
+    // One untimed pass sizes the event buffer
+    sse_bench_pass(parser, 1, result->chunk_size, false, &deltas);
+    deltas = 0;
+
+    result->framing_us = sse_bench_pass(parser, iterations, result->chunk_size, true, &deltas);
+    result->events = parser->events;
+    result->parse_us = sse_bench_pass(parser, iterations, result->chunk_size, false, &deltas);
+    result->deltas = deltas / iterations;
+    xai_stream_parser_destroy(parser);
+
+    // Bytes per microsecond is MB/s
+    double bytes = (double)result->stream_bytes * iterations;
+    result->framing_mb_s = result->framing_us ? (float)(bytes / result->framing_us) : 0.0f;
+    result->parse_mb_s = result->parse_us ? (float)(bytes / result->parse_us) : 0.0f;
+
+    ESP_LOGI(TAG, "SSE benchmark (%" PRIu32 " x %zu bytes in %zu-byte chunks, %" PRIu32
+             " events): framing %.1f MB/s, with JSON %.1f MB/s",
+             iterations, result->stream_bytes, result->chunk_size, result->events,
+             result->framing_mb_s, result->parse_mb_s);
+    return XAI_OK;
 }
 
-#endif // CONFIG_XAI_ENABLE_STREAMING
+// ============================================================================
+// Allocation Soak
+// ============================================================================
+
+#define SSE_SOAK_CHUNK 128              // Small reads, as TLS records often are
+
+static void sse_soak_delta(const char *chunk, size_t length, void *user_data) {
+    if (chunk) {
+        (*(uint32_t *)user_data)++;
+    }
+}
+
+/**
+ * @brief One stream through the client's parser, scoped like an API call
+ */
+static xai_err_t sse_soak_stream(struct xai_client_s *client, uint32_t *deltas) {
+    if (xSemaphoreTake(client->mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        return XAI_ERR_TIMEOUT;
+    }
+    const xai_placement_t *outer = xai_placement_begin(&client->placement);
+    xai_arena_begin(client->json_arena);
+
+    xai_err_t err = xai_http_stream_replay(client->http_client, SSE_BENCH_STREAM,
+                                           sizeof(SSE_BENCH_STREAM) - 1, SSE_SOAK_CHUNK,
+                                           sse_soak_delta, deltas);
+
+    xai_arena_end(client->json_arena);
+    xai_placement_end(outer);
+    xSemaphoreGive(client->mutex);
+    return err;
+}
+
+xai_err_t xai_stream_soak(xai_client_t client, uint32_t streams, xai_stream_soak_t *result) {
+    if (!client || streams == 0 || !result) {
+        return XAI_ERR_INVALID_ARG;
+    }
 
+    struct xai_client_s *impl = (struct xai_client_s *)client;
+    memset(result, 0, sizeof(*result));
+
+    // The first stream may create the parser and size its buffers
+    uint32_t deltas = 0;
+    xai_err_t err = sse_soak_stream(impl, &deltas);
+    deltas = 0;
+
+    uint32_t allocs_before = xai_get_alloc_count();
+    for (uint32_t i = 0; i < streams && err == XAI_OK; i++) {
+        err = sse_soak_stream(impl, &deltas);
+        result->streams++;
+    }
+    result->allocations = xai_get_alloc_count() - allocs_before;
+    result->chunks = result->streams *
+                     (uint32_t)((sizeof(SSE_BENCH_STREAM) - 1 + SSE_SOAK_CHUNK - 1) / SSE_SOAK_CHUNK);
+    result->deltas = deltas;
+
+    if (err != XAI_OK) {
+        ESP_LOGE(TAG, "Stream soak failed after %" PRIu32 " streams: %d", result->streams, err);
+        return err;
+    }
+    if (result->allocations > 0) {
+        ESP_LOGE(TAG, "Stream soak: %" PRIu32 " heap allocations in %" PRIu32 " streams",
+                 result->allocations, result->streams);
+        return XAI_ERR_NO_MEMORY;
+    }
+
+    ESP_LOGI(TAG, "Stream soak: %" PRIu32 " streams, %" PRIu32 " chunks, no heap allocations",
+             result->streams, result->chunks);
+    return XAI_OK;
+}
+
+#else // !CONFIG_XAI_ENABLE_STREAMING
+
+#include "xai.h"
+
+xai_err_t xai_stream_parser_benchmark(uint32_t iterations, size_t chunk_size,
+                                      xai_stream_parser_bench_t *result) {
+    return XAI_ERR_NOT_SUPPORTED;
+}
+
+xai_err_t xai_stream_soak(xai_client_t client, uint32_t streams, xai_stream_soak_t *result) {
+    return XAI_ERR_NOT_SUPPORTED;
+}
+
+#endif // CONFIG_XAI_ENABLE_STREAMING
@@ -0,0 +1,323 @@
+/**
+ * @file xai_stream_coalesce.c
+ * @brief Time/size-windowed coalescing of streamed content deltas
+ *
+ * Sits between the SSE parser and the user's stream callback. Deltas are
+ * buffered and delivered when one of the configured triggers fires:
+ * - size:     at least min_bytes are buffered
+ * - time:     the oldest buffered byte is max_delay_ms old (enforced by a
+ *             flush task, so the bound also holds while the server is silent)
+ * - sentence: a delta ends a sentence or a line
+ *
+ * Deliveries always end on a UTF-8 code point boundary. The end-of-stream
+ * marker (NULL chunk) flushes everything before being forwarded.
+ *
+ * Deliveries normally run on the task that feeds deltas. Only a deadline
+ * that expires between deltas is delivered by the coalescer's own flush
+ * task, never from the esp_timer task, so a slow callback cannot hold up
+ * other timers in the system.
+ */
+
+#include "sdkconfig.h"
+
+#ifdef CONFIG_XAI_ENABLE_STREAMING
+
+#include <string.h>
+#include <stdlib.h>
+#include "xai_internal.h"
+#include "esp_log.h"
+#include "freertos/task.h"
+
+static const char *TAG = "xai_coalesce";
+
+#ifndef CONFIG_XAI_STREAM_COALESCE_STACK
+#define CONFIG_XAI_STREAM_COALESCE_STACK 4096
+#endif
+
+#ifndef CONFIG_XAI_STREAM_COALESCE_PRIORITY
+#define CONFIG_XAI_STREAM_COALESCE_PRIORITY 5
+#endif
+
+#define COALESCE_MIN_CAPACITY 256
+
+bool xai_stream_coalesce_enabled(const xai_stream_coalesce_t *cfg) {
+    return cfg && (cfg->min_bytes > 0 || cfg->max_delay_ms > 0 || cfg->flush_on_sentence);
+}
+
+/**
+ * @brief Length of the longest prefix of buf that ends on a code point boundary
+ */
+static size_t utf8_complete_len(const char *buf, size_t len) {
+    // Walk back over at most 3 continuation bytes to the lead byte
+    size_t i = len;
+    size_t back = 0;
+    while (i > 0 && back < 3 && ((unsigned char)buf[i - 1] & 0xC0) == 0x80) {
+        i--;
+        back++;
+    }
+    if (i == 0) {
+        return len;
+    }
+
+    unsigned char lead = (unsigned char)buf[i - 1];
+    size_t need;
+    if (lead < 0x80) {
+        return len;
+    } else if ((lead & 0xE0) == 0xC0) {
+        need = 2;
+    } else if ((lead & 0xF0) == 0xE0) {
+        need = 3;
+    } else if ((lead & 0xF8) == 0xF0) {
+        need = 4;
+    } else {
+        return len;  // Invalid lead byte: nothing to protect
+    }
+
+    // Sequence starting at i-1 is complete if all its bytes are present
+    return (len - (i - 1) >= need) ? len : i - 1;
+}
+
+/**
+ * @brief Deliver the first n buffered bytes (caller holds the mutex)
+ */
+static void coalesce_deliver(xai_stream_coalescer_t *c, size_t n) {
+    if (n == 0) {
+        return;
+    }
+
+    c->callback(c->buf, n, c->user_data);
+    c->deliveries++;
+
+    // first_us stays until the buffer drains: the rest is no younger
+    c->used -= n;
+    if (c->used > 0) {
+        memmove(c->buf, c->buf + n, c->used);
+    }
+}
+
+/**
+ * @brief Deliver buffered text up to the last complete code point
+ */
+static void coalesce_flush(xai_stream_coalescer_t *c, bool final) {
+    coalesce_deliver(c, final ? c->used : utf8_complete_len(c->buf, c->used));
+}
+
+/**
+ * @brief Position just after the last sentence end in buf[from, used), or 0
+ */
+static size_t coalesce_sentence_end(const xai_stream_coalescer_t *c, size_t from) {
+    for (size_t i = c->used; i > from; i--) {
+        char ch = c->buf[i - 1];
+        if (ch == '\n') {
+            return i;
+        }
+        if ((ch == '.' || ch == '!' || ch == '?') &&
+            (i == c->used || c->buf[i] == ' ' || c->buf[i] == '\n')) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Deliver buffered text whose deadline expires between deltas
+ *
+ * Sleeps until the oldest buffered byte is due. feed() wakes it whenever
+ * text lands in an empty buffer, which is when a new deadline starts.
+ */
+static void coalesce_task(void *arg) {
+    xai_stream_coalescer_t *c = (xai_stream_coalescer_t *)arg;
+    TickType_t wait = portMAX_DELAY;
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        xSemaphoreTake(c->mutex, portMAX_DELAY);
+        if (c->shutdown) {
+            xSemaphoreGive(c->mutex);
+            break;
+        }
+        wait = portMAX_DELAY;
+        if (c->active && c->used > 0 && c->cfg.max_delay_ms > 0) {
+            int64_t remaining_us = (int64_t)c->cfg.max_delay_ms * 1000 -
+                                   (esp_timer_get_time() - c->first_us);
+            if (remaining_us <= 0) {
+                // A split code point left behind goes out with the next delta
+                coalesce_flush(c, false);
+            } else {
+                wait = pdMS_TO_TICKS((remaining_us + 999) / 1000) + 1;
+            }
+        }
+        xSemaphoreGive(c->mutex);
+    }
+
+    xSemaphoreGive(c->done_sem);
+    vTaskDelete(NULL);
+}
+
+xai_stream_coalescer_t* xai_stream_coalescer_create(void) {
+    xai_stream_coalescer_t *c = xai_calloc(1, sizeof(xai_stream_coalescer_t));
+    if (!c) {
+        ESP_LOGE(TAG, "Failed to allocate coalescer");
+        return NULL;
+    }
+
+    c->mutex = xSemaphoreCreateMutex();
+    c->done_sem = xSemaphoreCreateBinary();
+    if (!c->mutex || !c->done_sem) {
+        ESP_LOGE(TAG, "Failed to create semaphores");
+        xai_stream_coalescer_destroy(c);
+        return NULL;
+    }
+
+    return c;
+}
+
+xai_err_t xai_stream_coalescer_begin(
+    xai_stream_coalescer_t *c,
+    const xai_stream_coalesce_t *cfg,
+    xai_stream_callback_t callback,
+    void *user_data
+) {
+    if (!c || !cfg || !callback) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    // Room for two size windows so a trigger never forces a partial delivery
+    size_t capacity = cfg->min_bytes * 2;
+    if (capacity < COALESCE_MIN_CAPACITY) {
+        capacity = COALESCE_MIN_CAPACITY;
+    }
+    if (capacity > c->capacity) {
+        char *buf = xai_realloc(c->buf, capacity);
+        if (!buf) {
+            ESP_LOGE(TAG, "Failed to allocate coalescing buffer (%zu bytes)", capacity);
+            return XAI_ERR_NO_MEMORY;
+        }
+        c->buf = buf;
+        c->capacity = capacity;
+    }
+
+    // The flush task is only needed for the time trigger
+    if (cfg->max_delay_ms > 0 && !c->task &&
+        xTaskCreate(coalesce_task, "xai_coalesce", CONFIG_XAI_STREAM_COALESCE_STACK, c,
+                    CONFIG_XAI_STREAM_COALESCE_PRIORITY, &c->task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start flush task");
+        c->task = NULL;
+        return XAI_ERR_NO_MEMORY;
+    }
+
+    xSemaphoreTake(c->mutex, portMAX_DELAY);
+    c->cfg = *cfg;
+    c->callback = callback;
+    c->user_data = user_data;
+    c->used = 0;
+    c->deltas_in = 0;
+    c->deliveries = 0;
+    c->active = true;
+    xSemaphoreGive(c->mutex);
+
+    return XAI_OK;
+}
+
+void xai_stream_coalescer_feed(
+    const char *chunk,
+    size_t length,
+    void *user_data
+) {
+    xai_stream_coalescer_t *c = (xai_stream_coalescer_t *)user_data;
+    if (!c) {
+        return;
+    }
+
+    xSemaphoreTake(c->mutex, portMAX_DELAY);
+
+    if (!chunk) {
+        // End of stream: everything goes out before the marker
+        coalesce_flush(c, true);
+        c->callback(NULL, 0, c->user_data);
+        xSemaphoreGive(c->mutex);
+        return;
+    }
+
+    c->deltas_in++;
+    int64_t now = esp_timer_get_time();
+    size_t delta_start = c->used;
+    bool was_empty = c->used == 0;
+
+    while (length > 0) {
+        size_t room = c->capacity - c->used;
+        if (room == 0) {
+            coalesce_flush(c, false);
+            room = c->capacity - c->used;
+            delta_start = 0;
+        }
+        size_t n = length < room ? length : room;
+        if (c->used == 0) {
+            c->first_us = now;
+        }
+        memcpy(c->buf + c->used, chunk, n);
+        c->used += n;
+        chunk += n;
+        length -= n;
+    }
+
+    if (c->cfg.min_bytes > 0 && c->used >= c->cfg.min_bytes) {
+        coalesce_flush(c, false);
+    } else if (c->cfg.max_delay_ms > 0 &&
+               now - c->first_us >= (int64_t)c->cfg.max_delay_ms * 1000) {
+        coalesce_flush(c, false);
+    } else if (c->cfg.flush_on_sentence) {
+        // Sentence ends are ASCII, so this is always a code point boundary
+        coalesce_deliver(c, coalesce_sentence_end(c, delta_start));
+    }
+
+    // A new deadline starts: have the flush task watch it
+    if (was_empty && c->used > 0 && c->cfg.max_delay_ms > 0) {
+        xTaskNotifyGive(c->task);
+    }
+
+    xSemaphoreGive(c->mutex);
+}
+
+void xai_stream_coalescer_end(xai_stream_coalescer_t *c) {
+    if (!c) {
+        return;
+    }
+
+    xSemaphoreTake(c->mutex, portMAX_DELAY);
+    if (c->active) {
+        coalesce_flush(c, true);
+        c->active = false;
+        ESP_LOGD(TAG, "Coalesced %u deltas into %u deliveries",
+                 (unsigned)c->deltas_in, (unsigned)c->deliveries);
+    }
+    xSemaphoreGive(c->mutex);
+}
+
+void xai_stream_coalescer_destroy(xai_stream_coalescer_t *c) {
+    if (!c) {
+        return;
+    }
+
+    if (c->mutex) {
+        xai_stream_coalescer_end(c);
+    }
+    if (c->task) {
+        xSemaphoreTake(c->mutex, portMAX_DELAY);
+        c->shutdown = true;
+        xSemaphoreGive(c->mutex);
+        xTaskNotifyGive(c->task);
+        xSemaphoreTake(c->done_sem, portMAX_DELAY);
+    }
+    if (c->mutex) {
+        vSemaphoreDelete(c->mutex);
+    }
+    if (c->done_sem) {
+        vSemaphoreDelete(c->done_sem);
+    }
+    free(c->buf);
+    free(c);
+}
+
+#endif // CONFIG_XAI_ENABLE_STREAMING
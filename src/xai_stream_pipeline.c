@@ -0,0 +1,256 @@
+/**
+ * @file xai_stream_pipeline.c
+ * @brief Receive on one core, parse and deliver on the other
+ *
+ * Without the pipeline a stream runs on the caller's task from end to end:
+ * TLS decryption, SSE framing, JSON delta parsing and the user callback
+ * all take turns on one core while the other may sit idle, and a slow
+ * callback holds up the socket. With it, the caller's task only receives
+ * and copies bytes into a lock-free SPSC queue; a worker pinned to
+ * CONFIG_XAI_STREAM_PIPELINE_CORE parses them and runs the callback. Pin
+ * the calling task to the other core (the one running Wi-Fi and lwIP) to
+ * keep the two stages apart.
+ */
+
+#include "sdkconfig.h"
+
+#ifdef CONFIG_XAI_STREAM_PIPELINE
+
+#include <string.h>
+#include <stdlib.h>
+#include "xai_internal.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/task.h"
+
+static const char *TAG = "xai_pipeline";
+
+#ifndef CONFIG_XAI_STREAM_PIPELINE_CORE
+#define CONFIG_XAI_STREAM_PIPELINE_CORE 1
+#endif
+
+#ifndef CONFIG_XAI_STREAM_PIPELINE_QUEUE_SIZE
+#define CONFIG_XAI_STREAM_PIPELINE_QUEUE_SIZE 4096
+#endif
+
+#ifndef CONFIG_XAI_STREAM_PIPELINE_STACK
+#define CONFIG_XAI_STREAM_PIPELINE_STACK 6144
+#endif
+
+#ifndef CONFIG_XAI_STREAM_PIPELINE_PRIORITY
+#define CONFIG_XAI_STREAM_PIPELINE_PRIORITY 5
+#endif
+
+static size_t pipeline_round_pow2(size_t n) {
+    size_t p = 256;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+/**
+ * @brief Parse one stream's bytes until the producer ends it and the queue
+ *        is empty
+ */
+static void pipeline_drain(xai_stream_pipeline_t *pipeline) {
+    size_t mask = pipeline->capacity - 1;
+    size_t tail = atomic_load_explicit(&pipeline->tail, memory_order_relaxed);
+
+    for (;;) {
+        // eos first: once it is seen, head is final
+        bool eos = atomic_load_explicit(&pipeline->eos, memory_order_acquire);
+        size_t head = atomic_load_explicit(&pipeline->head, memory_order_acquire);
+        if (head == tail) {
+            if (eos) {
+                return;
+            }
+            xSemaphoreTake(pipeline->data_sem, portMAX_DELAY);
+            continue;
+        }
+
+        // Parse in place, up to the wrap point; the producer cannot
+        // overwrite these bytes before tail moves past them
+        size_t offset = tail & mask;
+        size_t n = head - tail;
+        if (n > pipeline->capacity - offset) {
+            n = pipeline->capacity - offset;
+        }
+        if (!pipeline->http->abort_requested) {
+            int64_t start = esp_timer_get_time();
+            xai_stream_parser_feed(pipeline->queue + offset, n, pipeline->parser);
+            pipeline->parse_busy_us += esp_timer_get_time() - start;
+        }
+
+        tail += n;
+        atomic_store_explicit(&pipeline->tail, tail, memory_order_release);
+        xSemaphoreGive(pipeline->space_sem);
+    }
+}
+
+static void pipeline_worker(void *arg) {
+    xai_stream_pipeline_t *pipeline = (xai_stream_pipeline_t *)arg;
+
+    for (;;) {
+        xSemaphoreTake(pipeline->start_sem, portMAX_DELAY);
+        if (pipeline->shutdown) {
+            break;
+        }
+
+        // The caller is blocked in the transfer: its arena is ours for now
+        xai_arena_resume(pipeline->arena);
+        const xai_placement_t *outer = xai_placement_begin(pipeline->placement);
+        pipeline_drain(pipeline);
+        xai_placement_end(outer);
+        xai_arena_suspend();
+
+        xSemaphoreGive(pipeline->done_sem);
+    }
+
+    xSemaphoreGive(pipeline->done_sem);
+    vTaskDelete(NULL);
+}
+
+xai_stream_pipeline_t* xai_stream_pipeline_create(void) {
+    xai_stream_pipeline_t *pipeline = xai_calloc(1, sizeof(xai_stream_pipeline_t));
+    if (!pipeline) {
+        ESP_LOGE(TAG, "Failed to allocate pipeline");
+        return NULL;
+    }
+
+    // Touched by both cores on every chunk: keep it out of PSRAM
+    pipeline->capacity = pipeline_round_pow2(CONFIG_XAI_STREAM_PIPELINE_QUEUE_SIZE);
+    pipeline->queue = xai_malloc_placed(XAI_ALLOC_HOT, XAI_PLACE_INTERNAL, pipeline->capacity);
+    pipeline->start_sem = xSemaphoreCreateBinary();
+    pipeline->data_sem = xSemaphoreCreateBinary();
+    pipeline->space_sem = xSemaphoreCreateBinary();
+    pipeline->done_sem = xSemaphoreCreateBinary();
+    atomic_init(&pipeline->head, 0);
+    atomic_init(&pipeline->tail, 0);
+    atomic_init(&pipeline->eos, false);
+    if (!pipeline->queue || !pipeline->start_sem || !pipeline->data_sem ||
+        !pipeline->space_sem || !pipeline->done_sem) {
+        ESP_LOGE(TAG, "Failed to allocate pipeline resources (%zu bytes)", pipeline->capacity);
+        xai_stream_pipeline_destroy(pipeline);
+        return NULL;
+    }
+
+    if (xTaskCreatePinnedToCore(pipeline_worker, "xai_pipeline", CONFIG_XAI_STREAM_PIPELINE_STACK,
+                                pipeline, CONFIG_XAI_STREAM_PIPELINE_PRIORITY, &pipeline->worker,
+                                CONFIG_XAI_STREAM_PIPELINE_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start pipeline worker");
+        pipeline->worker = NULL;
+        xai_stream_pipeline_destroy(pipeline);
+        return NULL;
+    }
+
+    ESP_LOGI(TAG, "Stream pipeline created (%zu byte queue, worker on core %d)",
+             pipeline->capacity, CONFIG_XAI_STREAM_PIPELINE_CORE);
+    return pipeline;
+}
+
+void xai_stream_pipeline_destroy(xai_stream_pipeline_t *pipeline) {
+    if (!pipeline) {
+        return;
+    }
+
+    if (pipeline->worker) {
+        pipeline->shutdown = true;
+        xSemaphoreGive(pipeline->start_sem);
+        xSemaphoreTake(pipeline->done_sem, portMAX_DELAY);
+    }
+    if (pipeline->start_sem) {
+        vSemaphoreDelete(pipeline->start_sem);
+    }
+    if (pipeline->data_sem) {
+        vSemaphoreDelete(pipeline->data_sem);
+    }
+    if (pipeline->space_sem) {
+        vSemaphoreDelete(pipeline->space_sem);
+    }
+    if (pipeline->done_sem) {
+        vSemaphoreDelete(pipeline->done_sem);
+    }
+    heap_caps_free(pipeline->queue);
+    free(pipeline);
+}
+
+void xai_stream_pipeline_begin(
+    xai_stream_pipeline_t *pipeline,
+    xai_http_client_t *http,
+    xai_stream_parser_t *parser
+) {
+    pipeline->http = http;
+    pipeline->parser = parser;
+    pipeline->arena = xai_arena_suspend();
+    xai_arena_resume(pipeline->arena);
+    pipeline->placement = xai_placement_begin(NULL);
+    xai_placement_end(pipeline->placement);
+
+    pipeline->bytes = 0;
+    pipeline->rx_stall_us = 0;
+    pipeline->parse_busy_us = 0;
+    atomic_store_explicit(&pipeline->eos, false, memory_order_relaxed);
+
+    // Wakeups left over from the previous stream
+    xSemaphoreTake(pipeline->data_sem, 0);
+    xSemaphoreTake(pipeline->space_sem, 0);
+
+    // Giving the semaphore publishes the fields above to the worker
+    xSemaphoreGive(pipeline->start_sem);
+}
+
+void xai_stream_pipeline_feed(
+    const char *chunk,
+    size_t length,
+    void *user_data
+) {
+    xai_stream_pipeline_t *pipeline = (xai_stream_pipeline_t *)user_data;
+    size_t mask = pipeline->capacity - 1;
+    size_t head = atomic_load_explicit(&pipeline->head, memory_order_relaxed);
+
+    while (length > 0) {
+        size_t tail = atomic_load_explicit(&pipeline->tail, memory_order_acquire);
+        size_t space = pipeline->capacity - (head - tail);
+        if (space == 0) {
+            // The worker fell behind: hold up receive until it catches up
+            int64_t start = esp_timer_get_time();
+            xSemaphoreTake(pipeline->space_sem, portMAX_DELAY);
+            pipeline->rx_stall_us += esp_timer_get_time() - start;
+            continue;
+        }
+
+        size_t n = length < space ? length : space;
+        size_t offset = head & mask;
+        size_t first = n < pipeline->capacity - offset ? n : pipeline->capacity - offset;
+        memcpy(pipeline->queue + offset, chunk, first);
+        memcpy(pipeline->queue, chunk + first, n - first);
+
+        head += n;
+        pipeline->bytes += n;
+        chunk += n;
+        length -= n;
+        atomic_store_explicit(&pipeline->head, head, memory_order_release);
+        xSemaphoreGive(pipeline->data_sem);
+
+        if (head - tail > pipeline->high_water) {
+            pipeline->high_water = head - tail;
+        }
+    }
+}
+
+void xai_stream_pipeline_end(xai_stream_pipeline_t *pipeline, xai_stream_stats_t *stats) {
+    atomic_store_explicit(&pipeline->eos, true, memory_order_release);
+    xSemaphoreGive(pipeline->data_sem);
+    xSemaphoreTake(pipeline->done_sem, portMAX_DELAY);
+
+    stats->bytes += pipeline->bytes;
+    stats->rx_stall_us += pipeline->rx_stall_us;
+    stats->parse_busy_us += pipeline->parse_busy_us;
+    stats->queue_size = pipeline->capacity;
+    if (pipeline->high_water > stats->queue_high_water) {
+        stats->queue_high_water = pipeline->high_water;
+    }
+}
+
+#endif // CONFIG_XAI_STREAM_PIPELINE
@@ -0,0 +1,324 @@
+/**
+ * @file xai_stream_ring.c
+ * @brief Decoupled streaming through a bounded ring with backpressure
+ *
+ * The HTTP task writes content deltas into a FreeRTOS stream buffer and the
+ * application drains it from its own task, so a slow consumer (TTS, display,
+ * UART) no longer stalls TCP receive directly. When a delta does not fit,
+ * the configured policy decides: wait for the reader, discard the oldest
+ * unread bytes, or abort the request.
+ *
+ * The ring is only fed from the streaming task (or the pipeline worker
+ * parsing for it), so a BLOCK wait holds up that stream and nothing else.
+ */
+
+#include "sdkconfig.h"
+
+#ifdef CONFIG_XAI_ENABLE_STREAMING
+
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "xai_internal.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/task.h"
+
+static const char *TAG = "xai_ring";
+
+#define RING_DEFAULT_CAPACITY 4096
+#define RING_MIN_CAPACITY     64
+
+xai_stream_ring_config_t xai_stream_ring_config_default(void) {
+    xai_stream_ring_config_t config = {
+        .capacity = RING_DEFAULT_CAPACITY,
+        .policy = XAI_STREAM_RING_BLOCK,
+        .block_timeout_ms = 0,
+    };
+    return config;
+}
+
+xai_stream_ring_t xai_stream_ring_create(const xai_stream_ring_config_t *config) {
+    xai_stream_ring_config_t cfg = config ? *config : xai_stream_ring_config_default();
+    if (cfg.capacity < RING_MIN_CAPACITY) {
+        cfg.capacity = RING_MIN_CAPACITY;
+    }
+
+    struct xai_stream_ring_s *ring = xai_calloc(1, sizeof(struct xai_stream_ring_s));
+    if (!ring) {
+        ESP_LOGE(TAG, "Failed to allocate ring");
+        return NULL;
+    }
+    ring->cfg = cfg;
+
+    // A static stream buffer of N bytes stores N - 1
+    ring->storage = xai_malloc_bulk(cfg.capacity + 1);
+    ring->mutex = xSemaphoreCreateMutex();
+    ring->data_sem = xSemaphoreCreateBinary();
+    ring->space_sem = xSemaphoreCreateBinary();
+    if (!ring->storage || !ring->mutex || !ring->data_sem || !ring->space_sem) {
+        ESP_LOGE(TAG, "Failed to allocate ring resources (%zu bytes)", cfg.capacity);
+        xai_stream_ring_destroy(ring);
+        return NULL;
+    }
+
+    ring->sb = xStreamBufferCreateStatic(cfg.capacity + 1, 1, ring->storage, &ring->sb_struct);
+    if (!ring->sb) {
+        ESP_LOGE(TAG, "Failed to create stream buffer");
+        xai_stream_ring_destroy(ring);
+        return NULL;
+    }
+
+    ring->capacity = xStreamBufferSpacesAvailable(ring->sb);
+    ring->stats.capacity = ring->capacity;
+
+    ESP_LOGI(TAG, "Stream ring created (%zu bytes, policy %d)", ring->capacity, cfg.policy);
+    return ring;
+}
+
+void xai_stream_ring_destroy(xai_stream_ring_t ring) {
+    if (!ring) {
+        return;
+    }
+
+    if (ring->sb) {
+        vStreamBufferDelete(ring->sb);
+    }
+    if (ring->mutex) {
+        vSemaphoreDelete(ring->mutex);
+    }
+    if (ring->data_sem) {
+        vSemaphoreDelete(ring->data_sem);
+    }
+    if (ring->space_sem) {
+        vSemaphoreDelete(ring->space_sem);
+    }
+    heap_caps_free(ring->storage);
+    free(ring);
+}
+
+/**
+ * @brief Discard the n oldest unread bytes (caller holds the mutex)
+ */
+static void ring_drop_oldest(struct xai_stream_ring_s *ring, size_t n) {
+    char scratch[64];
+    while (n > 0) {
+        size_t chunk = n < sizeof(scratch) ? n : sizeof(scratch);
+        size_t got = xStreamBufferReceive(ring->sb, scratch, chunk, 0);
+        if (got == 0) {
+            break;
+        }
+        ring->stats.bytes_dropped += got;
+        n -= got;
+    }
+}
+
+/**
+ * @brief Stop the producer early and wake the reader (caller holds the mutex)
+ *
+ * Only flags the abort: the transfer task closes its own connection.
+ */
+static void ring_stop(struct xai_stream_ring_s *ring, xai_err_t reason) {
+    ring->result = reason;
+    ring->finished = true;
+    // Looked up now: a hedged call may have given the client a new connection
+    if (ring->client) {
+        xai_http_abort(ring->client->http_client);
+    }
+    xSemaphoreGive(ring->data_sem);
+}
+
+void xai_stream_ring_feed(
+    const char *chunk,
+    size_t length,
+    void *user_data
+) {
+    struct xai_stream_ring_s *ring = (struct xai_stream_ring_s *)user_data;
+    if (!ring) {
+        return;
+    }
+
+    xSemaphoreTake(ring->mutex, portMAX_DELAY);
+
+    if (ring->finished) {
+        // Already stopped, or a repeated end-of-stream marker
+        xSemaphoreGive(ring->mutex);
+        return;
+    }
+
+    if (!chunk) {
+        ring->finished = true;
+        xSemaphoreGive(ring->mutex);
+        xSemaphoreGive(ring->data_sem);
+        return;
+    }
+
+    if (length > xStreamBufferSpacesAvailable(ring->sb)) {
+        ring->stats.full_events++;
+    }
+
+    int64_t block_start = 0;
+    while (length > 0) {
+        size_t space = xStreamBufferSpacesAvailable(ring->sb);
+
+        if (space < length) {
+            if (ring->cfg.policy == XAI_STREAM_RING_DROP_OLDEST) {
+                if (length > ring->capacity) {
+                    // Only the newest capacity bytes can survive
+                    ring->stats.bytes_dropped += length - ring->capacity;
+                    chunk += length - ring->capacity;
+                    length = ring->capacity;
+                }
+                ring_drop_oldest(ring, length - space);
+                space = xStreamBufferSpacesAvailable(ring->sb);
+            } else if (ring->cfg.policy == XAI_STREAM_RING_CANCEL) {
+                ESP_LOGW(TAG, "Ring full (%zu bytes unread), cancelling request",
+                         ring->capacity - space);
+                ring_stop(ring, XAI_ERR_CANCELLED);
+                break;
+            } else if (space == 0) {
+                // BLOCK: wait for the reader without holding the mutex
+                int64_t now = esp_timer_get_time();
+                if (block_start == 0) {
+                    block_start = now;
+                }
+                TickType_t wait = portMAX_DELAY;
+                if (ring->cfg.block_timeout_ms > 0) {
+                    int64_t left_ms = ring->cfg.block_timeout_ms - (now - block_start) / 1000;
+                    wait = left_ms > 0 ? pdMS_TO_TICKS(left_ms) : 0;
+                }
+
+                xSemaphoreGive(ring->mutex);
+                BaseType_t got_space = xSemaphoreTake(ring->space_sem, wait);
+                xSemaphoreTake(ring->mutex, portMAX_DELAY);
+
+                if (got_space != pdTRUE &&
+                    xStreamBufferSpacesAvailable(ring->sb) == 0) {
+                    ESP_LOGW(TAG, "Reader stalled for %" PRIu32 " ms, cancelling request",
+                             ring->cfg.block_timeout_ms);
+                    ring_stop(ring, XAI_ERR_TIMEOUT);
+                    break;
+                }
+                continue;
+            }
+        }
+
+        size_t n = length < space ? length : space;
+        n = xStreamBufferSend(ring->sb, chunk, n, 0);
+        chunk += n;
+        length -= n;
+        ring->stats.bytes_written += n;
+
+        size_t unread = ring->capacity - xStreamBufferSpacesAvailable(ring->sb);
+        if (unread > ring->stats.high_water) {
+            ring->stats.high_water = unread;
+        }
+        xSemaphoreGive(ring->data_sem);
+    }
+
+    if (block_start != 0) {
+        ring->blocked_us += esp_timer_get_time() - block_start;
+    }
+
+    xSemaphoreGive(ring->mutex);
+}
+
+xai_err_t xai_stream_ring_read(
+    xai_stream_ring_t ring,
+    char *buffer,
+    size_t size,
+    size_t *out_len,
+    uint32_t timeout_ms
+) {
+    if (!ring || !buffer || size == 0 || !out_len) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    *out_len = 0;
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+
+    for (;;) {
+        xSemaphoreTake(ring->mutex, portMAX_DELAY);
+        size_t n = xStreamBufferReceive(ring->sb, buffer, size, 0);
+        bool finished = ring->finished;
+        ring->stats.bytes_read += n;
+        xSemaphoreGive(ring->mutex);
+
+        if (n > 0) {
+            xSemaphoreGive(ring->space_sem);
+            *out_len = n;
+            return XAI_OK;
+        }
+        if (finished) {
+            // Keep the end visible to further reads
+            xSemaphoreGive(ring->data_sem);
+            return XAI_OK;
+        }
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout) {
+            return XAI_ERR_TIMEOUT;
+        }
+        xSemaphoreTake(ring->data_sem, timeout - elapsed);
+    }
+}
+
+xai_err_t xai_stream_ring_get_stats(xai_stream_ring_t ring, xai_stream_ring_stats_t *stats) {
+    if (!ring || !stats) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(ring->mutex, portMAX_DELAY);
+    *stats = ring->stats;
+    stats->blocked_ms = (uint32_t)(ring->blocked_us / 1000);
+    xSemaphoreGive(ring->mutex);
+    return XAI_OK;
+}
+
+xai_err_t xai_chat_completion_stream_ring(
+    xai_client_t client,
+    const xai_message_t *messages,
+    size_t message_count,
+    const xai_options_t *options,
+    xai_stream_ring_t ring
+) {
+    if (!client || !ring) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    struct xai_client_s *client_impl = (struct xai_client_s *)client;
+
+    // No coalescing: the reader already takes text in its own chunk sizes,
+    // and a deadline flush would feed the ring from outside the stream task
+    xai_options_t ring_options = options ? *options : xai_options_default();
+    memset(&ring_options.stream_coalesce, 0, sizeof(ring_options.stream_coalesce));
+
+    // Start from an empty ring; the reader may already be waiting
+    xSemaphoreTake(ring->mutex, portMAX_DELAY);
+    xStreamBufferReset(ring->sb);
+    xSemaphoreTake(ring->space_sem, 0);
+    ring->client = client_impl;
+    ring->finished = false;
+    ring->result = XAI_OK;
+    xSemaphoreGive(ring->mutex);
+
+    xai_err_t err = xai_chat_completion_stream(
+        client, messages, message_count, &ring_options, xai_stream_ring_feed, ring
+    );
+
+    // Release the reader whatever happened
+    xSemaphoreTake(ring->mutex, portMAX_DELAY);
+    ring->finished = true;
+    ring->client = NULL;
+    if (ring->result != XAI_OK) {
+        err = ring->result;
+    }
+    xSemaphoreGive(ring->mutex);
+    xSemaphoreGive(ring->data_sem);
+
+    return err;
+}
+
+#endif // CONFIG_XAI_ENABLE_STREAMING
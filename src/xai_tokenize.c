@@ -3,7 +3,9 @@
  * @brief Tokenization endpoint implementation
  * 
  * Provides token counting functionality for pre-flight resource estimation.
- * Useful for ESP32 memory planning and rate limit management.
+ * Useful for ESP32 memory planning and rate limit management. With
+ * CONFIG_XAI_ENABLE_LOCAL_TOKENIZER, counts come from the on-device
+ * tokenizer (xai_tokenizer.c) and the endpoint is the fallback.
  */
 
 #include <string.h>
@@ -16,35 +18,30 @@
 static const char *TAG = "xai_tokenize";
 
 /**
- * @brief Count tokens in text
+ * @brief Count tokens on the server
  * 
  * Calls POST /v1/tokenize-text endpoint
  */
-xai_err_t xai_count_tokens(
-    xai_client_t client,
+static xai_err_t tokenize_remote(
+    struct xai_client_s *client_impl,
     const char *text,
     const char *model,
     uint32_t *token_count
 ) {
-    if (!client || !text || !token_count) {
-        ESP_LOGE(TAG, "Invalid arguments");
-        return XAI_ERR_INVALID_ARG;
-    }
-
-    struct xai_client_s *client_impl = (struct xai_client_s *)client;
     xai_err_t err = XAI_OK;
 
     // Acquire client mutex
-    if (xSemaphoreTake(client_impl->mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
-        ESP_LOGE(TAG, "Failed to acquire mutex");
-        return XAI_ERR_TIMEOUT;
+    err = xai_client_lock(client_impl, XAI_ENDPOINT_TOKENIZE, XAI_PRIORITY_BACKGROUND);
+    if (err != XAI_OK) {
+        ESP_LOGE(TAG, "Failed to start request: %s", xai_err_to_string(err));
+        return err;
     }
 
     // Build JSON request
     cJSON *root = cJSON_CreateObject();
     if (!root) {
         ESP_LOGE(TAG, "Failed to create JSON object");
-        xSemaphoreGive(client_impl->mutex);
+        xai_client_unlock(client_impl);
         return XAI_ERR_NO_MEMORY;
     }
 
@@ -53,47 +50,50 @@ xai_err_t xai_count_tokens(
     const char *model_to_use = model ? model : client_impl->default_model;
     cJSON_AddStringToObject(root, "model", model_to_use);
 
-    char *request_json = cJSON_PrintUnformatted(root);
+    // Serialize straight into a pool buffer; the body size is known, so a
+    // small buffer usually fits
+    xai_buffer_t *request_json = xai_json_print_pooled(client_impl->buffer_pool, root,
+                                                       strlen(text) + strlen(model_to_use) + 64);
     cJSON_Delete(root);
 
     if (!request_json) {
         ESP_LOGE(TAG, "Failed to serialize JSON");
-        xSemaphoreGive(client_impl->mutex);
+        xai_client_unlock(client_impl);
         return XAI_ERR_NO_MEMORY;
     }
 
-    size_t request_len = strlen(request_json);
+    size_t request_len = strlen(request_json->data);
     ESP_LOGI(TAG, "Counting tokens for text (%zu chars)", strlen(text));
 
     // Send HTTP POST request
-    char *response_data = NULL;
+    xai_buffer_t *response_data = NULL;
     size_t response_len = 0;
     err = xai_http_post(
         client_impl->http_client,
         "/tokenize-text",
-        request_json,
+        request_json->data,
         request_len,
         &response_data,
         &response_len
     );
 
-    free(request_json);
+    xai_buffer_pool_release(client_impl->buffer_pool, request_json);
 
     if (err != XAI_OK) {
         ESP_LOGE(TAG, "HTTP request failed: %d", err);
-        xSemaphoreGive(client_impl->mutex);
+        xai_client_unlock(client_impl);
         return err;
     }
 
-    ESP_LOGD(TAG, "Response: %.*s", (int)response_len, response_data);
+    ESP_LOGD(TAG, "Response: %.*s", (int)response_len, response_data->data);
 
     // Parse response
-    cJSON *response = cJSON_Parse(response_data);
-    free(response_data);
+    cJSON *response = cJSON_Parse(response_data->data);
+    xai_buffer_pool_release(client_impl->buffer_pool, response_data);
 
     if (!response) {
         ESP_LOGE(TAG, "Failed to parse response JSON");
-        xSemaphoreGive(client_impl->mutex);
+        xai_client_unlock(client_impl);
         return XAI_ERR_PARSE_FAILED;
     }
 
@@ -105,28 +105,67 @@ xai_err_t xai_count_tokens(
             ESP_LOGE(TAG, "API error: %s", message->valuestring);
         }
         cJSON_Delete(response);
-        xSemaphoreGive(client_impl->mutex);
+        xai_client_unlock(client_impl);
         return XAI_ERR_API_ERROR;
     }
 
     // Extract token count
-    // Response format: {"token_count": 42}
+    // Response format: {"token_ids": [{"token_id": 1, ...}, ...]} or
+    // {"token_count": 42}
+    cJSON *ids = cJSON_GetObjectItem(response, "token_ids");
     cJSON *count = cJSON_GetObjectItem(response, "token_count");
-    if (!count || !cJSON_IsNumber(count)) {
-        ESP_LOGE(TAG, "Missing or invalid token_count in response");
+    if (cJSON_IsArray(ids)) {
+        *token_count = (uint32_t)cJSON_GetArraySize(ids);
+    } else if (cJSON_IsNumber(count)) {
+        *token_count = count->valueint;
+    } else {
+        ESP_LOGE(TAG, "Missing or invalid token count in response");
         cJSON_Delete(response);
-        xSemaphoreGive(client_impl->mutex);
+        xai_client_unlock(client_impl);
         return XAI_ERR_PARSE_FAILED;
     }
 
-    *token_count = count->valueint;
     cJSON_Delete(response);
-    xSemaphoreGive(client_impl->mutex);
+    xai_client_unlock(client_impl);
+#ifdef CONFIG_XAI_ENABLE_LOCAL_TOKENIZER
+    xai_tokenizer_record(true, false, false);
+#endif
 
     ESP_LOGI(TAG, "Token count: %u", *token_count);
     return XAI_OK;
 }
 
+/**
+ * @brief Count tokens in text
+ * 
+ * Counted on the device when the mapped vocabulary serves the model,
+ * otherwise by the server.
+ */
+xai_err_t xai_count_tokens(
+    xai_client_t client,
+    const char *text,
+    const char *model,
+    uint32_t *token_count
+) {
+    if (!client || !text || !token_count) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    struct xai_client_s *client_impl = (struct xai_client_s *)client;
+
+#ifdef CONFIG_XAI_ENABLE_LOCAL_TOKENIZER
+    if (xai_tokenizer_covers(model ? model : client_impl->default_model)) {
+        xai_token_span_t span = { text, strlen(text) };
+        *token_count = xai_tokenizer_count(&span, 1);
+        ESP_LOGD(TAG, "Token count: %u (local)", *token_count);
+        return XAI_OK;
+    }
+#endif
+
+    return tokenize_remote(client_impl, text, model, token_count);
+}
+
 /**
  * @brief Count tokens in messages (conversation)
  * 
@@ -145,6 +184,36 @@ xai_err_t xai_count_tokens_messages(
         return XAI_ERR_INVALID_ARG;
     }
 
+#ifdef CONFIG_XAI_ENABLE_LOCAL_TOKENIZER
+    struct xai_client_s *client_impl = (struct xai_client_s *)client;
+    if (xai_tokenizer_covers(model ? model : client_impl->default_model)) {
+        // Count the joined text without joining it
+        xai_token_span_t local_spans[32];
+        xai_token_span_t *spans = local_spans;
+        if (message_count * 2 > sizeof(local_spans) / sizeof(local_spans[0])) {
+            spans = xai_malloc(message_count * 2 * sizeof(xai_token_span_t));
+            if (!spans) {
+                ESP_LOGE(TAG, "Failed to allocate span list");
+                return XAI_ERR_NO_MEMORY;
+            }
+        }
+
+        size_t span_count = 0;
+        for (size_t i = 0; i < message_count; i++) {
+            if (messages[i].content) {
+                spans[span_count++] = (xai_token_span_t){ messages[i].content, strlen(messages[i].content) };
+                spans[span_count++] = (xai_token_span_t){ "\n", 1 };
+            }
+        }
+        *token_count = xai_tokenizer_count(spans, span_count);
+        if (spans != local_spans) {
+            free(spans);
+        }
+        ESP_LOGD(TAG, "Message token count: %u (local, approximate)", *token_count);
+        return XAI_OK;
+    }
+#endif
+
     // Concatenate all message contents
     size_t total_len = 0;
     for (size_t i = 0; i < message_count; i++) {
@@ -153,7 +222,7 @@ xai_err_t xai_count_tokens_messages(
         }
     }
 
-    char *combined_text = malloc(total_len + 1);
+    char *combined_text = xai_malloc(total_len + 1);
     if (!combined_text) {
         ESP_LOGE(TAG, "Failed to allocate combined text buffer");
         return XAI_ERR_NO_MEMORY;
@@ -171,7 +240,7 @@ xai_err_t xai_count_tokens_messages(
     combined_text[offset] = '\0';
 
     // Count tokens
-    xai_err_t err = xai_count_tokens(client, combined_text, model, token_count);
+    xai_err_t err = tokenize_remote((struct xai_client_s *)client, combined_text, model, token_count);
     free(combined_text);
 
     if (err == XAI_OK) {
@@ -181,13 +250,63 @@ xai_err_t xai_count_tokens_messages(
     return err;
 }
 
-/**
- * @brief Estimate memory needed for response
- * 
- * Rough estimation: 1 token ≈ 4 bytes for English text
- */
-size_t xai_estimate_memory(uint32_t token_count) {
-    // Conservative estimate: 4 bytes per token + overhead
-    return (token_count * 4) + 1024;  // +1KB overhead for JSON structure
+xai_err_t xai_count_tokens_local(const char *text, uint32_t *token_count) {
+    if (!text || !token_count) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+#ifdef CONFIG_XAI_ENABLE_LOCAL_TOKENIZER
+    if (xai_tokenizer_load()) {
+        xai_token_span_t span = { text, strlen(text) };
+        *token_count = xai_tokenizer_count(&span, 1);
+        return XAI_OK;
+    }
+#endif
+    return XAI_ERR_NOT_SUPPORTED;
 }
 
+xai_err_t xai_tokenizer_verify(
+    xai_client_t client,
+    const char *text,
+    const char *model,
+    uint32_t *local_count,
+    uint32_t *remote_count
+) {
+    if (!client || !text || !local_count || !remote_count) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return XAI_ERR_INVALID_ARG;
+    }
+
+    xai_err_t err = xai_count_tokens_local(text, local_count);
+    if (err != XAI_OK) {
+        return err;
+    }
+    err = tokenize_remote((struct xai_client_s *)client, text, model, remote_count);
+    if (err != XAI_OK) {
+        return err;
+    }
+
+#ifdef CONFIG_XAI_ENABLE_LOCAL_TOKENIZER
+    bool mismatch = *local_count != *remote_count;
+    xai_tokenizer_record(false, true, mismatch);
+    if (mismatch) {
+        ESP_LOGW(TAG, "Local count %u, server count %u for \"%.40s\"",
+                 *local_count, *remote_count, text);
+    }
+#endif
+    return XAI_OK;
+}
+
+xai_err_t xai_get_tokenizer_stats(xai_tokenizer_stats_t *stats) {
+    if (!stats) {
+        return XAI_ERR_INVALID_ARG;
+    }
+
+#ifdef CONFIG_XAI_ENABLE_LOCAL_TOKENIZER
+    xai_tokenizer_get_stats(stats);
+    return XAI_OK;
+#else
+    memset(stats, 0, sizeof(*stats));
+    return XAI_ERR_NOT_SUPPORTED;
+#endif
+}
@@ -0,0 +1,508 @@
+/**
+ * @file xai_tokenizer.c
+ * @brief On-device BPE token counting from a flash-resident vocabulary
+ *
+ * The vocabulary is a hash table of token byte strings and their merge
+ * ranks, written to a data partition by tools/xai_vocab_gen.py and mapped
+ * with esp_partition_mmap(): lookups read flash through the cache and no
+ * RAM copy is made. Text is split into pieces the way the server's
+ * pre-tokenizer does (contractions, letter runs, digit triples,
+ * punctuation runs, whitespace), then each piece is merged byte pair by
+ * byte pair, lowest rank first, and the parts left are its tokens.
+ *
+ * Character classes are ASCII-exact. Outside ASCII, common punctuation
+ * and symbol blocks are told apart from letters; anything else counts as
+ * a letter. xai_tokenizer_verify() checks a text against the server.
+ */
+
+#include "sdkconfig.h"
+
+#ifdef CONFIG_XAI_ENABLE_LOCAL_TOKENIZER
+
+#include <string.h>
+#include <inttypes.h>
+#include "xai_internal.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+
+static const char *TAG = "xai_tokenizer";
+
+#ifndef CONFIG_XAI_TOKENIZER_PARTITION
+#define CONFIG_XAI_TOKENIZER_PARTITION "xai_vocab"
+#endif
+
+/** "XTK1", little-endian */
+#define VOCAB_MAGIC 0x314B5458u
+
+/** Slot marker for an empty hash table entry */
+#define VOCAB_EMPTY 0xFFFFFFFFu
+
+/** Longest piece merged as a whole; longer runs are merged in windows */
+#define TOK_MAX_PIECE 128
+
+#define TOK_NO_RANK UINT32_MAX
+
+/**
+ * @brief Partition header, as written by tools/xai_vocab_gen.py
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t vocab_size;
+    uint32_t slot_count;            /**< Power of two */
+    uint32_t slots_offset;          /**< From the partition start */
+    uint32_t strings_offset;
+    uint32_t strings_size;
+    uint32_t max_token_len;
+    char family[16];                /**< Model name prefix this vocabulary serves */
+} vocab_header_t;
+
+/**
+ * @brief Hash table slot: token bytes at strings + (ref >> 8), ref & 0xff long
+ */
+typedef struct {
+    uint32_t ref;
+    uint32_t rank;
+} vocab_slot_t;
+
+typedef enum {
+    VOCAB_UNLOADED,
+    VOCAB_LOADING,
+    VOCAB_READY,
+    VOCAB_MISSING,
+} vocab_state_t;
+
+static atomic_int s_state = VOCAB_UNLOADED;
+static const vocab_header_t *s_header;
+static const vocab_slot_t *s_slots;
+static const uint8_t *s_strings;
+static esp_partition_mmap_handle_t s_mmap;
+
+static SemaphoreHandle_t s_stats_lock;
+static StaticSemaphore_t s_stats_lock_buf;
+static xai_tokenizer_stats_t s_stats;
+
+// ============================================================================
+// Vocabulary
+// ============================================================================
+
+static bool vocab_map(void) {
+    const esp_partition_t *part = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, CONFIG_XAI_TOKENIZER_PARTITION);
+    if (!part) {
+        ESP_LOGI(TAG, "No '%s' partition; token counts use the network",
+                 CONFIG_XAI_TOKENIZER_PARTITION);
+        return false;
+    }
+
+    const void *base = NULL;
+    if (esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &base, &s_mmap) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map '%s' (%" PRIu32 " bytes)", part->label, part->size);
+        return false;
+    }
+
+    const vocab_header_t *header = (const vocab_header_t *)base;
+    bool valid = header->magic == VOCAB_MAGIC &&
+                 header->slot_count != 0 &&
+                 (header->slot_count & (header->slot_count - 1)) == 0 &&
+                 header->slots_offset + (uint64_t)header->slot_count * sizeof(vocab_slot_t) <= part->size &&
+                 header->strings_offset + (uint64_t)header->strings_size <= part->size;
+    if (!valid) {
+        ESP_LOGE(TAG, "'%s' does not hold a vocabulary (flash one made by xai_vocab_gen.py)",
+                 part->label);
+        esp_partition_munmap(s_mmap);
+        return false;
+    }
+
+    s_header = header;
+    s_slots = (const vocab_slot_t *)((const uint8_t *)base + header->slots_offset);
+    s_strings = (const uint8_t *)base + header->strings_offset;
+    ESP_LOGI(TAG, "Mapped %" PRIu32 "-token '%.16s' vocabulary from '%s'",
+             header->vocab_size, header->family, part->label);
+    return true;
+}
+
+bool xai_tokenizer_load(void) {
+    int state = atomic_load_explicit(&s_state, memory_order_acquire);
+    while (state == VOCAB_UNLOADED || state == VOCAB_LOADING) {
+        int expected = VOCAB_UNLOADED;
+        if (atomic_compare_exchange_strong(&s_state, &expected, VOCAB_LOADING)) {
+            s_stats_lock = xSemaphoreCreateMutexStatic(&s_stats_lock_buf);
+            state = vocab_map() ? VOCAB_READY : VOCAB_MISSING;
+            atomic_store_explicit(&s_state, state, memory_order_release);
+            break;
+        }
+        // Another task is mapping it
+        vTaskDelay(1);
+        state = atomic_load_explicit(&s_state, memory_order_acquire);
+    }
+    return state == VOCAB_READY;
+}
+
+bool xai_tokenizer_covers(const char *model) {
+    if (!xai_tokenizer_load()) {
+        return false;
+    }
+    size_t n = strnlen(s_header->family, sizeof(s_header->family));
+    return model && strncmp(model, s_header->family, n) == 0;
+}
+
+/**
+ * @brief Rank of a byte string, or TOK_NO_RANK if it is not a token
+ */
+static uint32_t vocab_rank(const uint8_t *bytes, size_t len) {
+    if (len > s_header->max_token_len) {
+        return TOK_NO_RANK;
+    }
+
+    // FNV-1a 32, as in xai_vocab_gen.py
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+
+    uint32_t mask = s_header->slot_count - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        uint32_t ref = s_slots[i].ref;
+        if (ref == VOCAB_EMPTY) {
+            return TOK_NO_RANK;
+        }
+        if ((ref & 0xff) == len && memcmp(s_strings + (ref >> 8), bytes, len) == 0) {
+            return s_slots[i].rank;
+        }
+    }
+}
+
+// ============================================================================
+// Byte pair merging
+// ============================================================================
+
+typedef struct {
+    uint8_t start;
+    uint32_t rank;                  /**< Of the pair starting here */
+} tok_part_t;
+
+/**
+ * @brief Rank of parts[i] merged with parts[i + 1], or TOK_NO_RANK
+ */
+static uint32_t pair_rank(const uint8_t *piece, const tok_part_t *parts, size_t n, size_t i) {
+    if (i + 2 >= n) {
+        return TOK_NO_RANK;
+    }
+    return vocab_rank(piece + parts[i].start, parts[i + 2].start - parts[i].start);
+}
+
+/**
+ * @brief Number of tokens one piece encodes to
+ */
+static uint32_t bpe_count(const uint8_t *piece, size_t len) {
+    if (len <= 1 || vocab_rank(piece, len) != TOK_NO_RANK) {
+        return len ? 1 : 0;
+    }
+
+    // parts[i].start .. parts[i + 1].start is a token so far; the last
+    // entry only marks the end
+    tok_part_t parts[TOK_MAX_PIECE + 1];
+    size_t n = len + 1;
+    for (size_t i = 0; i < n; i++) {
+        parts[i].start = (uint8_t)i;
+    }
+    for (size_t i = 0; i < n; i++) {
+        parts[i].rank = pair_rank(piece, parts, n, i);
+    }
+
+    while (n > 2) {
+        size_t best = 0;
+        uint32_t best_rank = TOK_NO_RANK;
+        for (size_t i = 0; i + 1 < n; i++) {
+            if (parts[i].rank < best_rank) {
+                best_rank = parts[i].rank;
+                best = i;
+            }
+        }
+        if (best_rank == TOK_NO_RANK) {
+            break;
+        }
+
+        memmove(&parts[best + 1], &parts[best + 2], (n - best - 2) * sizeof(tok_part_t));
+        n--;
+        parts[best].rank = pair_rank(piece, parts, n, best);
+        if (best > 0) {
+            parts[best - 1].rank = pair_rank(piece, parts, n, best - 1);
+        }
+    }
+    return (uint32_t)(n - 1);
+}
+
+// ============================================================================
+// Pre-tokenizer
+// ============================================================================
+
+typedef enum {
+    CLS_END,
+    CLS_LETTER,
+    CLS_DIGIT,
+    CLS_NEWLINE,
+    CLS_SPACE,
+    CLS_OTHER,
+} tok_class_t;
+
+/**
+ * @brief Reads text that spans several buffers as if it were one
+ */
+typedef struct {
+    const xai_token_span_t *spans;
+    size_t span_count;
+    size_t span;
+    size_t offset;
+} tok_reader_t;
+
+/**
+ * @brief Byte at ahead positions past the cursor, or -1 past the end
+ */
+static int reader_peek(const tok_reader_t *r, size_t ahead) {
+    size_t span = r->span;
+    size_t offset = r->offset + ahead;
+    while (span < r->span_count && offset >= r->spans[span].len) {
+        offset -= r->spans[span].len;
+        span++;
+    }
+    return span < r->span_count ? (uint8_t)r->spans[span].data[offset] : -1;
+}
+
+/**
+ * @brief Class and byte length of the character ahead bytes past the cursor
+ */
+static tok_class_t reader_class(const tok_reader_t *r, size_t ahead, size_t *width) {
+    int c = reader_peek(r, ahead);
+    *width = 1;
+    if (c < 0) {
+        return CLS_END;
+    }
+    if (c < 0x80) {
+        if ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') {
+            return CLS_LETTER;
+        }
+        if (c >= '0' && c <= '9') {
+            return CLS_DIGIT;
+        }
+        if (c == '\r' || c == '\n') {
+            return CLS_NEWLINE;
+        }
+        if (c == ' ' || c == '\t' || c == '\v' || c == '\f') {
+            return CLS_SPACE;
+        }
+        return CLS_OTHER;
+    }
+
+    // Decode UTF-8; a stray continuation byte stands alone
+    uint32_t cp = 0;
+    size_t n = c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : c >= 0xc0 ? 2 : 1;
+    cp = n == 4 ? (c & 0x07) : n == 3 ? (c & 0x0f) : n == 2 ? (c & 0x1f) : c;
+    for (size_t i = 1; i < n; i++) {
+        int cc = reader_peek(r, ahead + i);
+        if (cc < 0 || (cc & 0xc0) != 0x80) {
+            n = i;
+            break;
+        }
+        cp = (cp << 6) | (cc & 0x3f);
+    }
+    *width = n;
+
+    if (cp == 0x85 || cp == 0x2028 || cp == 0x2029) {
+        return CLS_SPACE;
+    }
+    if (cp == 0xa0 || cp == 0x1680 || (cp >= 0x2000 && cp <= 0x200a) ||
+        cp == 0x202f || cp == 0x205f || cp == 0x3000) {
+        return CLS_SPACE;
+    }
+    if ((cp >= 0x80 && cp <= 0xbf && cp != 0xaa && cp != 0xb5 && cp != 0xba) ||
+        cp == 0xd7 || cp == 0xf7 ||
+        (cp >= 0x2000 && cp <= 0x2bff) ||       // punctuation, symbols, arrows, shapes
+        (cp >= 0x3000 && cp <= 0x303f) ||       // CJK punctuation
+        (cp >= 0xfe30 && cp <= 0xfe6f) ||
+        (cp >= 0xff00 && cp <= 0xff20) ||       // fullwidth punctuation
+        cp >= 0x1f000) {                        // emoji
+        return CLS_OTHER;
+    }
+    return CLS_LETTER;
+}
+
+static bool class_is_space(tok_class_t cls) {
+    return cls == CLS_SPACE || cls == CLS_NEWLINE;
+}
+
+/**
+ * @brief Bytes in the run of characters of one kind starting ahead bytes in
+ */
+static size_t reader_run(const tok_reader_t *r, size_t ahead, tok_class_t want, size_t max_chars) {
+    size_t len = 0;
+    for (size_t chars = 0; chars < max_chars; chars++) {
+        size_t width;
+        tok_class_t cls = reader_class(r, ahead + len, &width);
+        bool match = want == CLS_SPACE ? class_is_space(cls) : cls == want;
+        if (!match) {
+            break;
+        }
+        len += width;
+    }
+    return len;
+}
+
+/**
+ * @brief Length of an English contraction at the cursor, or 0
+ */
+static size_t reader_contraction(const tok_reader_t *r) {
+    if (reader_peek(r, 0) != '\'') {
+        return 0;
+    }
+    int a = reader_peek(r, 1) | 0x20;
+    int b = reader_peek(r, 2) | 0x20;
+    if ((a == 'r' && b == 'e') || (a == 'v' && b == 'e') || (a == 'l' && b == 'l')) {
+        return 3;
+    }
+    return (a == 's' || a == 't' || a == 'm' || a == 'd') ? 2 : 0;
+}
+
+/**
+ * @brief Length in bytes of the next pre-tokenizer piece
+ */
+static size_t reader_piece(const tok_reader_t *r) {
+    size_t width;
+    tok_class_t cls = reader_class(r, 0, &width);
+
+    size_t n = reader_contraction(r);
+    if (n) {
+        return n;
+    }
+
+    // [^\r\n\p{L}\p{N}]?\p{L}+
+    if (cls == CLS_LETTER) {
+        return reader_run(r, 0, CLS_LETTER, SIZE_MAX);
+    }
+    if (cls != CLS_NEWLINE && cls != CLS_DIGIT) {
+        size_t letters = reader_run(r, width, CLS_LETTER, SIZE_MAX);
+        if (letters) {
+            return width + letters;
+        }
+    }
+
+    // \p{N}{1,3}
+    if (cls == CLS_DIGIT) {
+        return reader_run(r, 0, CLS_DIGIT, 3);
+    }
+
+    // ' ?[^\s\p{L}\p{N}]+[\r\n]*'
+    size_t lead = reader_peek(r, 0) == ' ' ? 1 : 0;
+    size_t other = reader_run(r, lead, CLS_OTHER, SIZE_MAX);
+    if (other) {
+        return lead + other + reader_run(r, lead + other, CLS_NEWLINE, SIZE_MAX);
+    }
+
+    // \s*[\r\n]+ : up to the last newline in the whitespace run
+    size_t run = 0;
+    size_t last_newline = 0;
+    size_t last_width = 1;
+    for (;;) {
+        tok_class_t c = reader_class(r, run, &width);
+        if (!class_is_space(c)) {
+            break;
+        }
+        run += width;
+        last_width = width;
+        if (c == CLS_NEWLINE) {
+            last_newline = run;
+        }
+    }
+    if (last_newline) {
+        return last_newline;
+    }
+
+    // \s+(?!\S) leaves the last space for the word after it; \s+ otherwise
+    if (run > last_width && reader_peek(r, run) >= 0) {
+        return run - last_width;
+    }
+    return run ? run : width;
+}
+
+static void reader_advance(tok_reader_t *r, uint8_t *out, size_t len) {
+    while (len > 0) {
+        const xai_token_span_t *span = &r->spans[r->span];
+        size_t n = span->len - r->offset;
+        if (n > len) {
+            n = len;
+        }
+        if (out) {
+            memcpy(out, span->data + r->offset, n);
+            out += n;
+        }
+        r->offset += n;
+        len -= n;
+        if (r->offset == span->len) {
+            r->span++;
+            r->offset = 0;
+        }
+    }
+}
+
+uint32_t xai_tokenizer_count(const xai_token_span_t *spans, size_t span_count) {
+    if (!xai_tokenizer_load()) {
+        return 0;
+    }
+
+    int64_t start = esp_timer_get_time();
+    tok_reader_t reader = { .spans = spans, .span_count = span_count };
+    while (reader.span < span_count && spans[reader.span].len == 0) {
+        reader.span++;
+    }
+
+    uint32_t tokens = 0;
+    size_t bytes = 0;
+    uint8_t piece[TOK_MAX_PIECE];
+    while (reader.span < span_count) {
+        size_t len = reader_piece(&reader);
+        bytes += len;
+        while (len > 0) {
+            size_t n = len < TOK_MAX_PIECE ? len : TOK_MAX_PIECE;
+            reader_advance(&reader, piece, n);
+            tokens += bpe_count(piece, n);
+            len -= n;
+        }
+        while (reader.span < span_count && spans[reader.span].len == reader.offset) {
+            reader.span++;
+            reader.offset = 0;
+        }
+    }
+
+    int64_t elapsed = esp_timer_get_time() - start;
+    xSemaphoreTake(s_stats_lock, portMAX_DELAY);
+    s_stats.local_counts++;
+    s_stats.local_bytes += bytes;
+    s_stats.local_us += elapsed;
+    xSemaphoreGive(s_stats_lock);
+    return tokens;
+}
+
+void xai_tokenizer_record(bool remote, bool verified, bool mismatch) {
+    if (!xai_tokenizer_load()) {
+        return;
+    }
+    xSemaphoreTake(s_stats_lock, portMAX_DELAY);
+    s_stats.remote_counts += remote;
+    s_stats.verified += verified;
+    s_stats.mismatches += mismatch;
+    xSemaphoreGive(s_stats_lock);
+}
+
+void xai_tokenizer_get_stats(xai_tokenizer_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!xai_tokenizer_load()) {
+        return;
+    }
+    xSemaphoreTake(s_stats_lock, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_stats_lock);
+    stats->loaded = true;
+    stats->vocab_size = s_header->vocab_size;
+}
+
+#endif // CONFIG_XAI_ENABLE_LOCAL_TOKENIZER
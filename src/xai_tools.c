@@ -0,0 +1,254 @@
+/**
+ * @file xai_tools.c
+ * @brief Concurrent execution of client-side tool calls
+ *
+ * The calls of one model reply are independent, so they run side by side:
+ * a round of jobs is handed to a few short-lived worker tasks that pull
+ * the next job from a shared index, like the connections of a batch. The
+ * caller only waits, so it can give up on a job at its deadline. A job it
+ * gave up on still finishes on its worker, which then discards the result;
+ * the round is reference-counted so it outlives the call that started it.
+ */
+
+#include "sdkconfig.h"
+
+#ifdef CONFIG_XAI_ENABLE_TOOLS
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include "xai.h"
+#include "xai_internal.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+
+static const char *TAG = "xai_tools";
+
+#ifndef CONFIG_XAI_TOOL_TASK_STACK
+#define CONFIG_XAI_TOOL_TASK_STACK 4096
+#endif
+
+#ifndef CONFIG_XAI_TOOL_TIMEOUT_MS
+#define CONFIG_XAI_TOOL_TIMEOUT_MS 5000
+#endif
+
+/** Upper bound on worker tasks per round */
+#define TOOLS_MAX_WORKERS 8
+
+typedef enum {
+    TOOL_JOB_PENDING,
+    TOOL_JOB_RUNNING,
+    TOOL_JOB_DONE,
+    TOOL_JOB_ABANDONED              /**< Past its deadline; the worker discards the result */
+} tool_job_state_t;
+
+typedef struct {
+    xai_tool_handler_t handler;
+    void *user_data;
+    char *arguments;                /**< Copy: the job may outlive the response */
+    char *result;
+    int64_t start_us;
+    int64_t end_us;
+    int64_t deadline_us;
+    uint32_t timeout_ms;
+    size_t call;                    /**< Index into the caller's calls */
+    bool collected;                 /**< Caller only */
+    atomic_int state;               /**< tool_job_state_t */
+} tool_job_t;
+
+typedef struct {
+    tool_job_t *jobs;
+    size_t count;
+    atomic_size_t next;             /**< Next job to hand out */
+    atomic_int refs;                /**< Caller plus running workers; the last frees the round */
+    SemaphoreHandle_t done;         /**< Given per finished job */
+} tool_round_t;
+
+static void tool_round_release(tool_round_t *round) {
+    if (atomic_fetch_sub_explicit(&round->refs, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+    for (size_t i = 0; i < round->count; i++) {
+        free(round->jobs[i].arguments);
+        free(round->jobs[i].result);
+    }
+    vSemaphoreDelete(round->done);
+    free(round);
+}
+
+/**
+ * @brief Run jobs until none are left
+ */
+static void tool_round_work(tool_round_t *round) {
+    for (;;) {
+        size_t i = atomic_fetch_add_explicit(&round->next, 1, memory_order_relaxed);
+        if (i >= round->count) {
+            return;
+        }
+
+        tool_job_t *job = &round->jobs[i];
+        int state = TOOL_JOB_PENDING;
+        if (!atomic_compare_exchange_strong(&job->state, &state, TOOL_JOB_RUNNING)) {
+            continue;               // Given up on before it started
+        }
+        job->start_us = esp_timer_get_time();
+        job->result = job->handler(job->arguments, job->user_data);
+        job->end_us = esp_timer_get_time();
+
+        state = TOOL_JOB_RUNNING;
+        if (!atomic_compare_exchange_strong(&job->state, &state, TOOL_JOB_DONE)) {
+            free(job->result);
+            job->result = NULL;
+        }
+        xSemaphoreGive(round->done);
+    }
+}
+
+static void tool_worker_task(void *arg) {
+    tool_round_t *round = (tool_round_t *)arg;
+    tool_round_work(round);
+    tool_round_release(round);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Hand a settled job's result to its outcome
+ *
+ * @return false if the job is still running and before its deadline
+ */
+static bool tool_collect(tool_job_t *job, xai_tool_outcome_t *outcome, int64_t now) {
+    int state = atomic_load(&job->state);
+    if (state == TOOL_JOB_DONE) {
+        outcome->result = job->result;
+        outcome->err = job->result ? XAI_OK : XAI_ERR_API_ERROR;
+        outcome->latency_ms = (uint32_t)((job->end_us - job->start_us) / 1000);
+        job->result = NULL;
+        return true;
+    }
+    if (now < job->deadline_us) {
+        return false;
+    }
+    if (!atomic_compare_exchange_strong(&job->state, &state, TOOL_JOB_ABANDONED)) {
+        return tool_collect(job, outcome, now);     // Finished just now
+    }
+    outcome->err = XAI_ERR_TIMEOUT;
+    outcome->latency_ms = job->timeout_ms;
+    return true;
+}
+
+void xai_tools_run(
+    const xai_tool_call_t *calls,
+    size_t count,
+    const xai_tool_binding_t *tools,
+    size_t tool_count,
+    size_t workers,
+    xai_tool_outcome_t *outcomes
+) {
+    memset(outcomes, 0, count * sizeof(xai_tool_outcome_t));
+
+    // Match calls to bindings; unmatched ones are answered right away
+    size_t jobs = 0;
+    for (size_t i = 0; i < count; i++) {
+        outcomes[i].tool = -1;
+        outcomes[i].err = XAI_ERR_NOT_SUPPORTED;
+        for (size_t t = 0; t < tool_count && calls[i].name; t++) {
+            if (tools[t].handler && strcmp(calls[i].name, tools[t].tool.name) == 0) {
+                outcomes[i].tool = (int)t;
+                outcomes[i].err = XAI_ERR_NO_MEMORY;
+                jobs++;
+                break;
+            }
+        }
+        if (outcomes[i].tool < 0) {
+            ESP_LOGW(TAG, "No handler for tool '%s'", calls[i].name ? calls[i].name : "");
+        }
+    }
+    if (jobs == 0) {
+        return;
+    }
+
+    tool_round_t *round = xai_calloc(1, sizeof(tool_round_t) + jobs * sizeof(tool_job_t));
+    if (!round) {
+        ESP_LOGE(TAG, "Failed to allocate %zu tool jobs", jobs);
+        return;
+    }
+    round->jobs = (tool_job_t *)(round + 1);
+    round->done = xSemaphoreCreateCounting(jobs, 0);
+    if (!round->done) {
+        free(round);
+        return;
+    }
+    atomic_init(&round->next, 0);
+    atomic_init(&round->refs, 1);
+
+    int64_t start = esp_timer_get_time();
+    for (size_t i = 0; i < count; i++) {
+        if (outcomes[i].tool < 0) {
+            continue;
+        }
+        const xai_tool_binding_t *tool = &tools[outcomes[i].tool];
+        uint32_t timeout_ms = tool->timeout_ms ? tool->timeout_ms : CONFIG_XAI_TOOL_TIMEOUT_MS;
+        tool_job_t *job = &round->jobs[round->count++];
+        job->handler = tool->handler;
+        job->user_data = tool->user_data;
+        job->arguments = xai_strdup(calls[i].arguments ? calls[i].arguments : "{}");
+        job->timeout_ms = timeout_ms;
+        job->deadline_us = start + (int64_t)timeout_ms * 1000;
+        job->call = i;
+        atomic_init(&job->state, job->arguments ? TOOL_JOB_PENDING : TOOL_JOB_DONE);
+    }
+
+    if (workers > TOOLS_MAX_WORKERS) {
+        workers = TOOLS_MAX_WORKERS;
+    }
+    if (workers > jobs) {
+        workers = jobs;
+    }
+    size_t started = 0;
+    while (started < workers) {
+        atomic_fetch_add(&round->refs, 1);
+        if (xTaskCreate(tool_worker_task, "xai_tool", CONFIG_XAI_TOOL_TASK_STACK, round,
+                        uxTaskPriorityGet(NULL), NULL) != pdPASS) {
+            atomic_fetch_sub(&round->refs, 1);
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        // No task to run them on: in turn on this one, without deadlines
+        ESP_LOGW(TAG, "Failed to start tool workers; running %zu calls in turn", jobs);
+        tool_round_work(round);
+    }
+    ESP_LOGD(TAG, "Dispatched %zu tool calls to %zu workers", jobs, started);
+
+    size_t open = jobs;
+    while (open > 0) {
+        int64_t now = esp_timer_get_time();
+        int64_t next = INT64_MAX;
+        for (size_t i = 0; i < round->count; i++) {
+            tool_job_t *job = &round->jobs[i];
+            if (job->collected) {
+                continue;
+            }
+            if (tool_collect(job, &outcomes[job->call], now)) {
+                job->collected = true;
+                open--;
+                if (outcomes[job->call].err == XAI_ERR_TIMEOUT) {
+                    ESP_LOGW(TAG, "Tool '%s' missed its deadline", calls[job->call].name);
+                }
+            } else if (job->deadline_us < next) {
+                next = job->deadline_us;
+            }
+        }
+        if (open > 0) {
+            int64_t wait_ms = (next - now + 999) / 1000;
+            xSemaphoreTake(round->done, pdMS_TO_TICKS(wait_ms) + 1);
+        }
+    }
+
+    tool_round_release(round);
+}
+
+#endif // CONFIG_XAI_ENABLE_TOOLS
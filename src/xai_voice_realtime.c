@@ -9,6 +9,7 @@
 
 #include "xai_voice_realtime.h"
 #include "xai_ws_assembler.h"
+#include "xai_internal.h"
 
 #include "esp_log.h"
 #include "esp_websocket_client.h"
@@ -95,11 +96,10 @@ static void demote_to_disconnected_locked(xai_voice_client_t c)
 static void *xai_heap_malloc_prefer_psram(size_t bytes, bool prefer_psram)
 {
     if (bytes == 0) return NULL;
-    if (prefer_psram && heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0) {
-        void *p = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-        if (p) return p;
-    }
-    return malloc(bytes);
+    // Shared placement path, so these buffers show up in xai_get_placement_stats()
+    return xai_malloc_placed(XAI_ALLOC_BULK,
+                             prefer_psram ? XAI_PLACE_PSRAM : XAI_PLACE_INTERNAL,
+                             bytes);
 }
 
 static void xai_heap_free_any(void *p)
@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""Build the vocabulary partition image for CONFIG_XAI_ENABLE_LOCAL_TOKENIZER.
+
+Input is either a tiktoken-style rank file ("<base64 token> <rank>" per
+line) or a Hugging Face tokenizer.json with a byte-level BPE model. The
+image is a hash table of token byte strings and merge ranks that
+src/xai_tokenizer.c reads in place from flash.
+
+    python xai_vocab_gen.py tokenizer.json xai_vocab.bin --family grok
+    parttool.py write_partition --partition-name xai_vocab --input xai_vocab.bin
+
+The partition table needs a data partition large enough for the image:
+
+    xai_vocab, data, 0x40, , 3M
+"""
+
+import argparse
+import base64
+import json
+import struct
+import sys
+
+MAGIC = 0x314B5458  # "XTK1"
+EMPTY = 0xFFFFFFFF
+HEADER = struct.Struct("<7I16s")
+SLOT = struct.Struct("<II")
+
+
+def fnv1a32(data):
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def byte_decoder():
+    """Inverse of the GPT-2 bytes-to-unicode table used by byte-level BPE."""
+    bs = list(range(ord("!"), ord("~") + 1)) + list(range(ord("¡"), ord("¬") + 1)) + \
+        list(range(ord("®"), ord("ÿ") + 1))
+    cs = bs[:]
+    n = 0
+    for b in range(256):
+        if b not in bs:
+            bs.append(b)
+            cs.append(256 + n)
+            n += 1
+    return {chr(c): b for b, c in zip(bs, cs)}
+
+
+def load_tiktoken(path):
+    ranks = {}
+    with open(path, "rb") as f:
+        for line in f:
+            if line.strip():
+                token, rank = line.split()
+                ranks[base64.b64decode(token)] = int(rank)
+    return ranks
+
+
+def load_hf(path):
+    with open(path, encoding="utf-8") as f:
+        model = json.load(f)["model"]
+    if model.get("type") != "BPE":
+        sys.exit("tokenizer.json: only BPE models are supported")
+    decode = byte_decoder()
+    tokens = {}
+    for token, token_id in model["vocab"].items():
+        try:
+            tokens[bytes(decode[c] for c in token)] = token_id
+        except KeyError:
+            pass  # special or non-byte-level token: never produced by merging
+
+    # Merge order decides which pair goes first; ids need not follow it.
+    # Tokens no merge produces rank after every merge.
+    merges = model.get("merges", [])
+    ranks = {bytes([b]): b for b in range(256)}
+    for i, merge in enumerate(merges):
+        a, b = merge if isinstance(merge, list) else merge.split(" ", 1)
+        merged = bytes(decode[c] for c in a + b)
+        if merged in tokens and merged not in ranks:
+            ranks[merged] = 256 + i
+    for token, token_id in tokens.items():
+        ranks.setdefault(token, 256 + len(merges) + token_id)
+    return ranks
+
+
+def build(ranks, family):
+    strings = bytearray()
+    slot_count = 1
+    while slot_count < len(ranks) * 3 // 2:
+        slot_count <<= 1
+    slots = [(EMPTY, 0)] * slot_count
+    max_len = 0
+    for token, rank in ranks.items():
+        if len(token) > 255:
+            sys.exit("token longer than 255 bytes: %r" % token)
+        offset = len(strings)
+        strings += token
+        max_len = max(max_len, len(token))
+        i = fnv1a32(token) & (slot_count - 1)
+        while slots[i][0] != EMPTY:
+            i = (i + 1) & (slot_count - 1)
+        slots[i] = ((offset << 8) | len(token), rank)
+    if len(strings) >= 1 << 24:
+        sys.exit("token strings exceed 16 MB")
+
+    slots_offset = (HEADER.size + 15) & ~15
+    strings_offset = slots_offset + slot_count * SLOT.size
+    header = HEADER.pack(MAGIC, len(ranks), slot_count, slots_offset, strings_offset,
+                         len(strings), max_len, family.encode()[:16])
+    image = bytearray(header)
+    image += bytes(slots_offset - len(image))
+    for ref, rank in slots:
+        image += SLOT.pack(ref, rank)
+    image += strings
+    return image
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="tokenizer.json or tiktoken rank file")
+    parser.add_argument("output", help="partition image to write")
+    parser.add_argument("--family", default="grok",
+                        help="model name prefix the vocabulary serves (default: grok)")
+    args = parser.parse_args()
+
+    ranks = load_hf(args.input) if args.input.endswith(".json") else load_tiktoken(args.input)
+    image = build(ranks, args.family)
+    with open(args.output, "wb") as f:
+        f.write(image)
+    print("%d tokens, %d bytes" % (len(ranks), len(image)))
+
+
+if __name__ == "__main__":
+    main()